@@ -192,6 +192,7 @@ ifeq ($(ARCH),ARM)
     CORTEX_M7=1
     ARCH_FLASH_OFFSET=0x08000000
     SPI_TARGET=stm32
+    CFLAGS+=-DWOLFBOOT_FLASH_WRITE_BULK
   endif
 
   ifeq ($(TARGET),stm32wb)
@@ -333,6 +334,9 @@ else
         CORTEXM_ARM_EXTRA_CFLAGS=
         SECURE_OBJS+=./src/wc_callable.o
         CFLAGS+=-DWOLFCRYPT_SECURE_MODE
+        ifneq ($(WOLFCRYPT_TZ_RNG_POOL),)
+          CFLAGS+=-DWCS_RNG_POOL_SIZE=$(WOLFCRYPT_TZ_RNG_POOL)
+        endif
         SECURE_LDFLAGS+=-Wl,--cmse-implib -Wl,--out-implib=./src/wc_secure_calls.o
       endif
     endif # TZEN=1
@@ -1072,6 +1076,7 @@ ifeq ("${FSP}", "1")
     ifeq ($(64BIT),1)
       LDFLAGS += -m elf_x86_64 --oformat elf64-x86-64
       CFLAGS += -m64
+      OBJS += src/x86/smp.o
     else
       CFLAGS += -m32
       LDFLAGS += -m elf_i386 --oformat elf32-i386
@@ -1134,6 +1139,11 @@ ifeq ($(ARCH),sim)
   ifeq ($(WOLFHSM_CLIENT),1)
     WOLFHSM_OBJS += $(LIBDIR)/wolfHSM/port/posix/posix_transport_tcp.o
   endif
+  ifeq ($(HASH_TREE),1)
+    LDFLAGS+=-pthread
+  else ifeq ($(HYBRID_PARALLEL_VERIFY),1)
+    LDFLAGS+=-pthread
+  endif
 endif
 
 CFLAGS+=-DARCH_FLASH_OFFSET=$(ARCH_FLASH_OFFSET)
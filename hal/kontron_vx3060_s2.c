@@ -27,6 +27,7 @@
 #include <x86/gdt.h>
 #include <x86/fsp.h>
 #include <x86/common.h>
+#include <x86/smp.h>
 
 #ifdef __WOLFBOOT
 
@@ -94,6 +95,9 @@ void hal_init(void)
 
 void hal_prepare_boot(void)
 {
+#ifdef WOLFBOOT_64BIT
+    x86_smp_park();
+#endif
 }
 #endif
 
@@ -3171,9 +3171,11 @@ void* hal_get_dts_address(void)
 int hal_dts_fixup(void* dts_addr)
 {
 #ifndef BUILD_LOADER_STAGE1
+    static struct fdt_batch batch;
     struct fdt_header *fdt = (struct fdt_header *)dts_addr;
-    int off, i;
-    uint32_t *reg;
+    void* src;
+    int off, i, ret;
+    uint32_t size, *reg;
     const char* prev_compat;
 
     /* verify the FTD is valid */
@@ -3184,16 +3186,18 @@ int hal_dts_fixup(void* dts_addr)
     }
 
     /* display FTD information */
-    wolfBoot_printf("FDT: Version %d, Size %d\n",
-        fdt_version(fdt), fdt_totalsize(fdt));
+    size = fdt_totalsize(fdt);
+    wolfBoot_printf("FDT: Version %d, Size %d\n", fdt_version(fdt), size);
 
-    /* expand total size */
-    fdt->totalsize += 2048; /* expand by 2KB */
-    wolfBoot_printf("FDT: Expanded (2KB) to %d bytes\n", fdt->totalsize);
+    /* The property fixups are queued against a copy of the DTB, placed after
+     * the expanded one, and written back in a single pass by the commit */
+    src = (uint8_t*)dts_addr + size + 2048;
+    memcpy(src, dts_addr, size);
+    ret = fdt_batch_init(&batch, src);
 
     /* fixup the memory region - single bank */
-    off = fdt_find_devtype(fdt, -1, "memory");
-    if (off != -FDT_ERR_NOTFOUND) {
+    off = fdt_find_devtype(src, -1, "memory");
+    if ((ret == 0) && (off != -FDT_ERR_NOTFOUND)) {
         /* build addr/size as 64-bit */
         uint8_t ranges[sizeof(uint64_t) * 2], *p = ranges;
         *(uint64_t*)p = cpu_to_fdt64(DDR_ADDRESS);
@@ -3202,16 +3206,16 @@ int hal_dts_fixup(void* dts_addr)
         p += sizeof(uint64_t);
         wolfBoot_printf("FDT: Set memory, start=0x%x, size=0x%x\n",
             DDR_ADDRESS, (uint32_t)DDR_SIZE);
-        fdt_setprop(fdt, off, "reg", ranges, (int)(p - ranges));
+        ret = fdt_batch_setprop(&batch, off, "reg", ranges, (int)(p - ranges));
     }
 
     /* fixup CPU status and, release address and enable method */
-    off = fdt_find_devtype(fdt, -1, "cpu");
-    while (off != -FDT_ERR_NOTFOUND) {
+    off = fdt_find_devtype(src, -1, "cpu");
+    while ((ret == 0) && (off != -FDT_ERR_NOTFOUND)) {
         int core;
         uint64_t core_spin_table;
 
-        reg = (uint32_t*)fdt_getprop(fdt, off, "reg", NULL);
+        reg = (uint32_t*)fdt_getprop(src, off, "reg", NULL);
         if (reg == NULL)
             break;
         core = (int)fdt32_to_cpu(*reg);
@@ -3223,51 +3227,76 @@ int hal_dts_fixup(void* dts_addr)
         core_spin_table = (uint64_t)((uintptr_t)(
                   (uint8_t*)&_spin_table + (core * ENTRY_SIZE)));
 
-        fdt_fixup_str(fdt, off, "cpu", "status", (core == 0) ? "okay" : "disabled");
-        fdt_fixup_val64(fdt, off, "cpu", "cpu-release-addr", core_spin_table);
-        fdt_fixup_str(fdt, off, "cpu", "enable-method", "spin-table");
-        fdt_fixup_val(fdt, off, "cpu", "timebase-frequency", TIMEBASE_HZ);
-        fdt_fixup_val(fdt, off, "cpu", "clock-frequency", hal_get_core_clk());
-        fdt_fixup_val(fdt, off, "cpu", "bus-frequency", hal_get_plat_clk());
+        ret |= fdt_batch_fixup_str(&batch, off, "cpu", "status",
+            (core == 0) ? "okay" : "disabled");
+        ret |= fdt_batch_fixup_val64(&batch, off, "cpu", "cpu-release-addr",
+            core_spin_table);
+        ret |= fdt_batch_fixup_str(&batch, off, "cpu", "enable-method",
+            "spin-table");
+        ret |= fdt_batch_fixup_val(&batch, off, "cpu", "timebase-frequency",
+            TIMEBASE_HZ);
+        ret |= fdt_batch_fixup_val(&batch, off, "cpu", "clock-frequency",
+            hal_get_core_clk());
+        ret |= fdt_batch_fixup_val(&batch, off, "cpu", "bus-frequency",
+            hal_get_plat_clk());
 
-        off = fdt_find_devtype(fdt, off, "cpu");
+        off = fdt_find_devtype(src, off, "cpu");
     }
 
     /* fixup the soc clock */
-    off = fdt_find_devtype(fdt, -1, "soc");
-    if (off != -FDT_ERR_NOTFOUND) {
-        fdt_fixup_val(fdt, off, "soc", "bus-frequency", hal_get_plat_clk());
+    off = fdt_find_devtype(src, -1, "soc");
+    if ((ret == 0) && (off != -FDT_ERR_NOTFOUND)) {
+        ret = fdt_batch_fixup_val(&batch, off, "soc", "bus-frequency",
+            hal_get_plat_clk());
     }
 
     /* fixup the serial clocks */
-    off = fdt_find_devtype(fdt, -1, "serial");
-    while (off != -FDT_ERR_NOTFOUND) {
-        fdt_fixup_val(fdt, off, "serial", "clock-frequency", hal_get_bus_clk());
-        off = fdt_find_devtype(fdt, off, "serial");
+    off = fdt_find_devtype(src, -1, "serial");
+    while ((ret == 0) && (off != -FDT_ERR_NOTFOUND)) {
+        ret = fdt_batch_fixup_val(&batch, off, "serial", "clock-frequency",
+            hal_get_bus_clk());
+        off = fdt_find_devtype(src, off, "serial");
     }
 
     /* fixup the QE bridge and bus blocks */
-    off = fdt_find_devtype(fdt, -1, "qe");
-    if (off != -FDT_ERR_NOTFOUND) {
-        fdt_fixup_val(fdt, off, "qe", "clock-frequency", hal_get_bus_clk());
-        fdt_fixup_val(fdt, off, "qe", "bus-frequency", hal_get_bus_clk());
-        fdt_fixup_val(fdt, off, "qe", "brg-frequency", hal_get_bus_clk()/2);
+    off = fdt_find_devtype(src, -1, "qe");
+    if ((ret == 0) && (off != -FDT_ERR_NOTFOUND)) {
+        ret |= fdt_batch_fixup_val(&batch, off, "qe", "clock-frequency",
+            hal_get_bus_clk());
+        ret |= fdt_batch_fixup_val(&batch, off, "qe", "bus-frequency",
+            hal_get_bus_clk());
+        ret |= fdt_batch_fixup_val(&batch, off, "qe", "brg-frequency",
+            hal_get_bus_clk()/2);
     }
 
     /* fixup the LIODN */
     prev_compat = NULL;
-    for (i=0; i<(int)(sizeof(liodn_tbl)/sizeof(struct liodn_id_table)); i++) {
+    for (i=0; (ret == 0) &&
+              (i<(int)(sizeof(liodn_tbl)/sizeof(struct liodn_id_table))); i++) {
         if (prev_compat == NULL || strcmp(prev_compat, liodn_tbl[i].compat) != 0) {
             off = -1;
         }
-        off = fdt_node_offset_by_compatible(fdt, off, liodn_tbl[i].compat);
+        off = fdt_node_offset_by_compatible(src, off, liodn_tbl[i].compat);
         if (off >= 0) {
-            fdt_fixup_val(fdt, off, liodn_tbl[i].compat, "fsl,liodn",
-                liodn_tbl[i].id);
+            ret = fdt_batch_fixup_val(&batch, off, liodn_tbl[i].compat,
+                "fsl,liodn", liodn_tbl[i].id);
         }
         prev_compat = liodn_tbl[i].compat;
     }
 
+    /* write the fixed up DTB, expanded by 2KB for the edits below */
+    if (ret == 0)
+        ret = fdt_batch_commit(&batch, dts_addr, size + 2048);
+    if (ret != 0) {
+        wolfBoot_printf("FDT: Batch fixup failed! %d\n", ret);
+        memcpy(dts_addr, src, size);
+        fdt_set_totalsize(fdt, size + 2048);
+    #ifdef WOLFBOOT_FDT_INDEX
+        fdt_index_invalidate(); /* blob replaced in place */
+    #endif
+    }
+    wolfBoot_printf("FDT: Expanded (2KB) to %d bytes\n", fdt_totalsize(fdt));
+
     /* fixup the QMAN portals */
     off = fdt_node_offset_by_compatible(fdt, -1, "fsl,qman-portal");
     while (off != -FDT_ERR_NOTFOUND) {
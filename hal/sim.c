@@ -47,6 +47,10 @@
 #include "elf.h"
 #endif
 
+#if defined(WOLFBOOT_HASH_TREE) || defined(WOLFBOOT_HYBRID_PARALLEL_VERIFY)
+#include <pthread.h>
+#endif
+
 #ifdef WOLFBOOT_ENABLE_WOLFHSM_CLIENT
 #include "wolfhsm/wh_error.h"
 #include "wolfhsm/wh_client.h"
@@ -224,6 +228,46 @@ static int mmap_file(const char *path, uint8_t *address, uint8_t** ret_address)
     return 0;
 }
 
+/* Flash timing model: the simulated flash erases one sector or one larger
+ * block per operation, like a SPI NOR flash (4KB sector erase / 64KB block
+ * erase). Erase time is accumulated and reported in hal_prepare_boot(). */
+#ifndef SIM_FLASH_BLOCK_SIZE
+#define SIM_FLASH_BLOCK_SIZE      0x10000
+#endif
+#ifndef SIM_FLASH_SECTOR_ERASE_US
+#define SIM_FLASH_SECTOR_ERASE_US 45000
+#endif
+#ifndef SIM_FLASH_BLOCK_ERASE_US
+#define SIM_FLASH_BLOCK_ERASE_US  150000
+#endif
+static uint32_t sim_erase_ops;
+static uint64_t sim_erase_us;
+
+static void sim_flash_erase_timing(uintptr_t address, int len)
+{
+    uintptr_t off = address - (uintptr_t)ARCH_FLASH_OFFSET;
+    if ((SIM_FLASH_BLOCK_SIZE > WOLFBOOT_SECTOR_SIZE) &&
+            (len == SIM_FLASH_BLOCK_SIZE) &&
+            ((off & (SIM_FLASH_BLOCK_SIZE - 1)) == 0)) {
+        sim_erase_ops++;
+        sim_erase_us += SIM_FLASH_BLOCK_ERASE_US;
+        return;
+    }
+    /* Otherwise the flash controller erases one sector at a time */
+    while (len > 0) {
+        sim_erase_ops++;
+        sim_erase_us += SIM_FLASH_SECTOR_ERASE_US;
+        len -= WOLFBOOT_SECTOR_SIZE;
+    }
+}
+
+#ifdef WOLFBOOT_FLASH_MULTI_SECTOR_ERASE
+uint32_t hal_flash_erase_granularity(void)
+{
+    return WOLFBOOT_SECTOR_SIZE | SIM_FLASH_BLOCK_SIZE;
+}
+#endif
+
 void hal_flash_unlock(void)
 {
     flashLocked = 0;
@@ -236,7 +280,10 @@ void hal_flash_lock(void)
 
 void hal_prepare_boot(void)
 {
-    /* no op */
+    if (sim_erase_ops > 0) {
+        wolfBoot_printf("Flash erase: %u operations, %u ms (timing model)\n",
+            (unsigned int)sim_erase_ops, (unsigned int)(sim_erase_us / 1000));
+    }
 }
 
 int hal_flash_write(uintptr_t address, const uint8_t *data, int len)
@@ -281,6 +328,7 @@ int hal_flash_erase(uintptr_t address, int len)
     }
     /* implicit cast abide compiler warning */
     wolfBoot_printf( "hal_flash_erase addr %p len %d\n", (void*)address, len);
+    sim_flash_erase_timing(address, len);
     if (address == erasefail_address + WOLFBOOT_PARTITION_BOOT_ADDRESS) {
         wolfBoot_printf( "POWER FAILURE\n");
         /* Corrupt page */
@@ -325,6 +373,16 @@ void hal_init(void)
     }
 }
 
+#ifdef WOLFBOOT_VERIFY_BENCHMARK
+#include <time.h>
+uint64_t hal_timer_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+#endif
+
 void ext_flash_lock(void)
 {
     extFlashLocked = 1;
@@ -361,6 +419,60 @@ int ext_flash_erase(uintptr_t address, int len)
     return 0;
 }
 
+#if defined(WOLFBOOT_HASH_TREE) || defined(WOLFBOOT_HYBRID_PARALLEL_VERIFY)
+/* Secondary cores are emulated with one thread per core */
+#ifndef SIM_SMP_CORES
+#define SIM_SMP_CORES 4
+#endif
+
+static struct sim_smp_core {
+    pthread_t thread;
+    void (*fn)(void *);
+    void *arg;
+} sim_smp[SIM_SMP_CORES];
+
+static void *sim_smp_entry(void *arg)
+{
+    struct sim_smp_core *core = (struct sim_smp_core *)arg;
+    core->fn(core->arg);
+    return NULL;
+}
+
+int hal_smp_cores(void)
+{
+    return SIM_SMP_CORES;
+}
+
+int hal_smp_start(int core, void (*fn)(void *), void *arg)
+{
+    if ((core <= 0) || (core >= SIM_SMP_CORES))
+        return -1;
+    sim_smp[core].fn = fn;
+    sim_smp[core].arg = arg;
+    if (pthread_create(&sim_smp[core].thread, NULL, sim_smp_entry,
+                &sim_smp[core]) != 0)
+        return -1;
+    return 0;
+}
+
+void hal_smp_wait(int core)
+{
+    if ((core > 0) && (core < SIM_SMP_CORES))
+        pthread_join(sim_smp[core].thread, NULL);
+}
+#endif /* WOLFBOOT_HASH_TREE || WOLFBOOT_HYBRID_PARALLEL_VERIFY */
+
+#ifdef WOLFBOOT_VERIFY_CACHE
+/* The simulator has no device secret: use a fixed test key */
+int hal_verify_cache_key(uint8_t *key, int len)
+{
+    int i;
+    for (i = 0; i < len; i++)
+        key[i] = (uint8_t)(0xC5 ^ i);
+    return 0;
+}
+#endif
+
 #ifdef __APPLE__
 #ifdef __GNUC__
     #pragma GCC diagnostic push
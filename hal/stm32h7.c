@@ -84,6 +84,19 @@ static void RAMFUNCTION flash_program_off(uint8_t bank)
     }
 }
 
+/* Flash words with all bits erased are not programmed: with its ECC
+ * written, such a word could not be programmed again before an erase, and
+ * hal_flash_is_erased() could not tell it from an erased one. */
+static int RAMFUNCTION flash_word_is_blank(const uint32_t *word)
+{
+    int i;
+    for (i = 0; i < STM32H7_WORD_SIZE / (int)sizeof(uint32_t); i++) {
+        if (word[i] != 0xFFFFFFFF)
+            return 0;
+    }
+    return 1;
+}
+
 int RAMFUNCTION hal_flash_write(uint32_t address, const uint8_t *data, int len)
 {
     int i = 0, ii =0;
@@ -101,15 +114,17 @@ int RAMFUNCTION hal_flash_write(uint32_t address, const uint8_t *data, int len)
         if ((len - i > 32) && ((((address + i) & 0x1F) == 0) &&
             ((((uint32_t)data) + i) & 0x1F) == 0))
         {
-            flash_wait_last();
-            flash_clear_errors(0);
-            flash_clear_errors(1);
-            flash_program_on(bank);
-            flash_wait_complete(bank);
             src = (uint32_t *)(data + i);
             dst = (uint32_t *)(address + i);
-            for (ii = 0; ii < 8; ii++) {
-                dst[ii] = src[ii];
+            if (!flash_word_is_blank(src)) {
+                flash_wait_last();
+                flash_clear_errors(0);
+                flash_clear_errors(1);
+                flash_program_on(bank);
+                flash_wait_complete(bank);
+                for (ii = 0; ii < 8; ii++) {
+                    dst[ii] = src[ii];
+                }
             }
             i+=32;
         }
@@ -139,18 +154,20 @@ int RAMFUNCTION hal_flash_write(uint32_t address, const uint8_t *data, int len)
             }
 
             /* Actual write from cache to FLASH */
-            flash_wait_last();
-            flash_clear_errors(0);
-            flash_clear_errors(1);
-            flash_program_on(bank);
-            flash_wait_complete(bank);
-            ISB();
-            DSB();
-            for (ii = 0; ii < 8; ii++) {
-                dst[ii] = stm32h7_cache[ii];
+            if (!flash_word_is_blank(stm32h7_cache)) {
+                flash_wait_last();
+                flash_clear_errors(0);
+                flash_clear_errors(1);
+                flash_program_on(bank);
+                flash_wait_complete(bank);
+                ISB();
+                DSB();
+                for (ii = 0; ii < 8; ii++) {
+                    dst[ii] = stm32h7_cache[ii];
+                }
+                ISB();
+                DSB();
             }
-            ISB();
-            DSB();
         }
         flash_wait_complete(bank);
         flash_program_off(bank);
@@ -158,6 +175,51 @@ int RAMFUNCTION hal_flash_write(uint32_t address, const uint8_t *data, int len)
     return 0;
 }
 
+/* Program a run of whole flash words: errors are cleared and the PG bit is
+ * set once for the whole run, then each flash word is written and its
+ * completion awaited. Anything not aligned to flash words goes through
+ * hal_flash_write(). */
+int RAMFUNCTION hal_flash_write_bulk(haladdr_t address, const uint8_t *data,
+    int len)
+{
+    int i, ii;
+    const uint32_t *src;
+    volatile uint32_t *dst;
+    uint8_t bank = 0;
+    uint32_t end = (uint32_t)address + len - 1;
+
+    if ((len <= 0) || ((address & (STM32H7_WORD_SIZE - 1)) != 0) ||
+            ((len & (STM32H7_WORD_SIZE - 1)) != 0) ||
+            ((((uint32_t)data) & 0x3) != 0) ||
+            (((address ^ end) & FLASH_BANK2_BASE_REL) != 0) ||
+            STM32H7_BOOT_FLAGS_PAGE(end) || STM32H7_UPDATE_FLAGS_PAGE(end)) {
+        return hal_flash_write(address, data, len);
+    }
+    if ((address & FLASH_BANK2_BASE_REL) != 0) {
+        bank = 1;
+    }
+
+    flash_wait_last();
+    flash_clear_errors(0);
+    flash_clear_errors(1);
+    flash_program_on(bank);
+    flash_wait_complete(bank);
+    for (i = 0; i < len; i += STM32H7_WORD_SIZE) {
+        src = (const uint32_t *)(data + i);
+        dst = (volatile uint32_t *)(address + i);
+        if (flash_word_is_blank(src))
+            continue;
+        for (ii = 0; ii < 8; ii++) {
+            dst[ii] = src[ii];
+        }
+        ISB();
+        DSB();
+        flash_wait_complete(bank);
+    }
+    flash_program_off(bank);
+    return 0;
+}
+
 void RAMFUNCTION hal_flash_unlock(void)
 {
     flash_wait_complete(1);
@@ -192,10 +254,24 @@ void RAMFUNCTION hal_flash_lock(void)
         FLASH_CR2 |= FLASH_CR_LOCK;
 }
 
+/* Start a sector erase (SER) or a bank erase (BER) and wait for it */
+static void RAMFUNCTION flash_erase_op(uint8_t bank, uint32_t op)
+{
+    volatile uint32_t *cr = (bank == 0) ? &FLASH_CR1 : &FLASH_CR2;
+
+    *cr = (*cr & ~((FLASH_CR_SNB_MASK << FLASH_CR_SNB_SHIFT) |
+        FLASH_CR_PSIZE | FLASH_CR_SER | FLASH_CR_BER)) | op;
+    DMB();
+    *cr |= FLASH_CR_STRT;
+    flash_wait_complete(bank);
+    *cr &= ~(FLASH_CR_SER | FLASH_CR_BER);
+}
+
 int RAMFUNCTION hal_flash_erase(uint32_t address, int len)
 {
     uint32_t end_address;
-    uint32_t p;
+    uint32_t p, off;
+    uint8_t bank;
 
     if (len == 0)
         return -1;
@@ -204,30 +280,59 @@ int RAMFUNCTION hal_flash_erase(uint32_t address, int len)
          p < end_address;
          p += FLASH_PAGE_SIZE)
     {
-        if (p < FLASH_BANK2_BASE_REL) {
-            uint32_t reg = FLASH_CR1 &
-                (~((FLASH_CR_SNB_MASK << FLASH_CR_SNB_SHIFT) | FLASH_CR_PSIZE));
-            FLASH_CR1 = reg |
-                (((p >> 17) << FLASH_CR_SNB_SHIFT) | FLASH_CR_SER | 0x00);
-            DMB();
-            FLASH_CR1 |= FLASH_CR_STRT;
-            flash_wait_complete(1);
-        }
-        if ((p>= FLASH_BANK2_BASE_REL) &&
-            (p <= (FLASH_TOP - FLASHMEM_ADDRESS_SPACE))) {
-            uint32_t reg = FLASH_CR2 &
-                (~((FLASH_CR_SNB_MASK << FLASH_CR_SNB_SHIFT) | FLASH_CR_PSIZE));
-            p-= (FLASH_BANK2_BASE);
-            FLASH_CR2 = reg |
-                (((p >> 17) << FLASH_CR_SNB_SHIFT) | FLASH_CR_SER | 0x00);
-            DMB();
-            FLASH_CR2 |= FLASH_CR_STRT;
-            flash_wait_complete(2);
+        if (p > (FLASH_TOP - FLASHMEM_ADDRESS_SPACE))
+            break;
+        bank = (p < FLASH_BANK2_BASE_REL) ? 0 : 1;
+        off = p - (bank * FLASH_BANK_SIZE);
+        if ((off == 0) && (end_address - p + 1 >= FLASH_BANK_SIZE)) {
+            /* Whole bank: one bank erase instead of one per sector */
+            flash_erase_op(bank, FLASH_CR_BER);
+            p += FLASH_BANK_SIZE - FLASH_PAGE_SIZE;
+            continue;
         }
+        flash_erase_op(bank,
+            ((off >> 17) << FLASH_CR_SNB_SHIFT) | FLASH_CR_SER);
     }
     return 0;
 }
 
+#ifdef WOLFBOOT_FLASH_MULTI_SECTOR_ERASE
+/* 128KB sector erase, 1MB bank erase (see hal_flash_erase()) */
+uint32_t hal_flash_erase_granularity(void)
+{
+    return FLASH_PAGE_SIZE | FLASH_BANK_SIZE;
+}
+#endif
+
+#ifdef WOLFBOOT_FLASH_BLANK_CHECK
+/* Blank flash words are never programmed (see flash_word_is_blank()), so a
+ * word that reads as erased has its ECC erased too. An ECC error raised while
+ * reading the range means that a program or erase operation was interrupted:
+ * the range is reported as not erased. */
+int RAMFUNCTION hal_flash_is_erased(haladdr_t address, int len)
+{
+    const volatile uint32_t *word = (const volatile uint32_t *)address;
+    volatile uint32_t *sr = &FLASH_SR1, *ccr = &FLASH_CCR1;
+    int i;
+
+    if ((address & FLASH_BANK2_BASE_REL) != 0) {
+        sr = &FLASH_SR2;
+        ccr = &FLASH_CCR2;
+    }
+    *ccr = FLASH_SR_SNECCERR | FLASH_SR_DBECCERR;
+    for (i = 0; i < len / (int)sizeof(uint32_t); i++) {
+        if (word[i] != 0xFFFFFFFF)
+            return 0;
+    }
+    DSB();
+    if ((*sr & (FLASH_SR_SNECCERR | FLASH_SR_DBECCERR)) != 0) {
+        *ccr = FLASH_SR_SNECCERR | FLASH_SR_DBECCERR;
+        return 0;
+    }
+    return 1;
+}
+#endif
+
 #ifdef DEBUG_UART
 static int uart_init(void)
 {
@@ -224,17 +224,20 @@
 #define FLASH_KEYR1         (*(volatile uint32_t *)(FLASH_BASE + 0x04)) /* RM0433 - 3.9.2 - FLASH_KEYR 1 */
 #define FLASH_CR1           (*(volatile uint32_t *)(FLASH_BASE + 0x0C)) /* RM0433 - 3.9.4 - FLASH_CR 1 */
 #define FLASH_SR1           (*(volatile uint32_t *)(FLASH_BASE + 0x10)) /* RM0433 - 3.9.5 - FLASH_SR 1 */
+#define FLASH_CCR1          (*(volatile uint32_t *)(FLASH_BASE + 0x14)) /* RM0433 - 3.9.6 - FLASH_CCR 1 */
 
 /* Bank 2 */
 #define FLASH_KEYR2         (*(volatile uint32_t *)(FLASH_BASE + 0x104)) /* RM0433 - 3.9.24 - FLASH_KEYR 2 */
 #define FLASH_SR2           (*(volatile uint32_t *)(FLASH_BASE + 0x110)) /* RM0433 - 3.9.26 - FLASH_SR 2 */
 #define FLASH_CR2           (*(volatile uint32_t *)(FLASH_BASE + 0x10C)) /* RM0433 - 3.9.25 - FLASH_CR 2 */
+#define FLASH_CCR2          (*(volatile uint32_t *)(FLASH_BASE + 0x114)) /* RM0433 - 3.9.27 - FLASH_CCR 2 */
 
 /* Flash Configuration */
 #define FLASHMEM_ADDRESS_SPACE    (0x08000000UL)
 #define FLASH_PAGE_SIZE           (0x20000) /* 128KB */
 #define FLASH_BANK2_BASE          (0x08100000UL) /*!< Base address of : (up to 1 MB) Flash Bank2 accessible over AXI */
 #define FLASH_BANK2_BASE_REL      (FLASH_BANK2_BASE - FLASHMEM_ADDRESS_SPACE)
+#define FLASH_BANK_SIZE           (FLASH_BANK2_BASE_REL) /* 1MB */
 #define FLASH_TOP                 (0x081FFFFFUL) /*!< FLASH end address  */
 
 /* Register values */
@@ -96,6 +96,14 @@ int RAMFUNCTION hal_flash_write(uint32_t address, const uint8_t *data, int len)
         qword[1] = src[(i >> 2) + 1];
         qword[2] = src[(i >> 2) + 2];
         qword[3] = src[(i >> 2) + 3];
+        /* Blank quad-words are not programmed: with its ECC written, such
+         * a quad-word could not be programmed again before an erase, and
+         * hal_flash_is_erased() could not tell it from an erased one. */
+        if ((qword[0] == 0xFFFFFFFF) && (qword[1] == 0xFFFFFFFF) &&
+                (qword[2] == 0xFFFFFFFF) && (qword[3] == 0xFFFFFFFF)) {
+            i += 16;
+            continue;
+        }
         *cr |= FLASH_CR_PG;
         dst[i >> 2] = qword[0];
         ISB();
@@ -219,6 +227,30 @@ int RAMFUNCTION hal_flash_erase(uint32_t address, int len)
     return 0;
 }
 
+#ifdef WOLFBOOT_FLASH_BLANK_CHECK
+/* Blank quad-words are never programmed (see hal_flash_write()), so a location
+ * that reads as erased has its ECC erased too. An ECC correction (ECCC)
+ * while reading the range means that a program or erase operation was
+ * interrupted: the range is reported as not erased. */
+int RAMFUNCTION hal_flash_is_erased(haladdr_t address, int len)
+{
+    const volatile uint32_t *word = (const volatile uint32_t *)address;
+    int i;
+
+    FLASH_ECCR |= FLASH_ECCR_ECCC;
+    for (i = 0; i < len / (int)sizeof(uint32_t); i++) {
+        if (word[i] != 0xFFFFFFFF)
+            return 0;
+    }
+    DSB();
+    if ((FLASH_ECCR & FLASH_ECCR_ECCC) != 0) {
+        FLASH_ECCR |= FLASH_ECCR_ECCC;
+        return 0;
+    }
+    return 1;
+}
+#endif
+
 static void clock_pll_off(void)
 {
     uint32_t reg32, flash_waitstates ;
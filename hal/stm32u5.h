@@ -222,6 +222,10 @@
 #define FLASH_CR_OPTLOCK                    (1 << 30)
 #define FLASH_CR_LOCK                       (1 << 31)
 
+#define FLASH_ECCR          (*(volatile uint32_t *)(FLASH_BASE + 0x30))
+#define FLASH_ECCR_ECCC                     (1 << 30)
+#define FLASH_ECCR_ECCD                     (1 << 31)
+
 
 #define FLASH_ACR           (*(volatile uint32_t *)(FLASH_BASE + 0x00))
 #define FLASH_ACR_LATENCY_MASK              (0x0F)
@@ -29,6 +29,7 @@
 #include <x86/ata.h>
 #include <x86/gdt.h>
 #include <x86/common.h>
+#include <x86/smp.h>
 #include <x86/fsp.h>
 #include <pci.h>
 
@@ -41,6 +42,9 @@ void hal_init(void)
 
 void hal_prepare_boot(void)
 {
+#ifdef WOLFBOOT_64BIT
+    x86_smp_park();
+#endif
 }
 #endif
 
@@ -51,8 +51,16 @@ struct wb_patch_ctx {
     uint32_t blk_sz;
     uint32_t blk_off;
 #ifdef EXT_FLASH
-    uint8_t patch_cache[DELTA_PATCH_BLOCK_SIZE];
-    uint32_t patch_cache_start;
+    /* Page of the patch, after the tail of the previous one when a block
+     * header straddles the two */
+    uint8_t patch_cache[DELTA_PATCH_BLOCK_SIZE + 8];
+    uintptr_t patch_cache_start;
+    uint32_t patch_cache_len;
+#ifdef PART_BOOT_EXT
+    uint8_t src_cache[DELTA_PATCH_BLOCK_SIZE];
+    uintptr_t src_cache_start;
+    uint32_t src_cache_len;
+#endif
 #endif
 };
 
@@ -68,6 +76,7 @@ typedef struct wb_diff_ctx WB_DIFF_CTX;
 
 int wb_diff_init(WB_DIFF_CTX *ctx, uint8_t *src_a, uint32_t len_a, uint8_t *src_b, uint32_t len_b);
 int wb_diff(WB_DIFF_CTX *ctx, uint8_t *patch, uint32_t len);
+int wb_diff_range(WB_DIFF_CTX *ctx, uint32_t start, uint32_t end);
 int wb_patch_init(WB_PATCH_CTX *bm, uint8_t *src, uint32_t ssz, uint8_t *patch, uint32_t psz);
 int wb_patch(WB_PATCH_CTX *ctx, uint8_t *dst, uint32_t len);
 int wolfBoot_get_delta_info(uint8_t part, int inverse, uint32_t **img_offset,
@@ -157,6 +157,47 @@ int fdt_fixup_val64(void* fdt, int off, const char* node, const char* name, uint
 
 int fdt_shrink(void* fdt);
 
+/* Batched fixups: edits are queued against the unmodified DTB, then applied
+ * by rebuilding it into a new buffer in one pass */
+#ifndef FDT_BATCH_MAX_EDITS
+#define FDT_BATCH_MAX_EDITS 128
+#endif
+#ifndef FDT_BATCH_DATA_SIZE
+#define FDT_BATCH_DATA_SIZE 4096
+#endif
+
+struct fdt_batch_edit {
+    int nodeoff;      /* node offset in the source DTB */
+    int nameoff;      /* property name offset in fdt_batch.data */
+    int len;
+    int dataoff;      /* value offset in fdt_batch.data */
+};
+
+struct fdt_batch {
+    const void* fdt;
+    int count;
+    int data_len;
+    struct fdt_batch_edit edits[FDT_BATCH_MAX_EDITS];
+    uint8_t data[FDT_BATCH_DATA_SIZE];
+};
+
+int fdt_batch_init(struct fdt_batch* batch, const void* fdt);
+int fdt_batch_setprop(struct fdt_batch* batch, int nodeoffset,
+    const char* name, const void* val, int len);
+int fdt_batch_fixup_str(struct fdt_batch* batch, int off, const char* node,
+    const char* name, const char* str);
+int fdt_batch_fixup_val(struct fdt_batch* batch, int off, const char* node,
+    const char* name, uint32_t val);
+int fdt_batch_fixup_val64(struct fdt_batch* batch, int off, const char* node,
+    const char* name, uint64_t val);
+int fdt_batch_commit(struct fdt_batch* batch, void* out, int outsz);
+
+#ifdef WOLFBOOT_FDT_INDEX
+/* lookup index (built on first search of a DTB) */
+void fdt_index_invalidate(void);
+void fdt_index_enable(int enable);
+#endif
+
 /* FIT */
 const char* fit_find_images(void* fdt, const char** pkernel, const char** pflat_dt);
 void* fit_load_image(void* fdt, const char* image, int* lenp);
@@ -46,6 +46,11 @@ void hal_set_external_flash_file(const char* file);
 void hal_deinit();
 #endif
 
+#ifdef WOLFBOOT_VERIFY_BENCHMARK
+/* Free-running microsecond counter, used to time signature verification */
+uint64_t hal_timer_us(void);
+#endif
+
 #if !defined(ARCH_64BIT) && \
     (defined(ARCH_x86_64) || defined(ARCH_AARCH64) || defined(ARCH_SIM))
     #define ARCH_64BIT
@@ -69,6 +74,29 @@ void hal_prepare_boot(void);
     void hal_flash_dualbank_swap(void);
 #endif
 
+#ifdef WOLFBOOT_FLASH_MULTI_SECTOR_ERASE
+    /* Erase sizes performed as a single operation by hal_flash_erase(), one
+     * bit per power of two (e.g. 4KB sector | 64KB block | 1MB bank). The
+     * default returns 0: no information, any multiple of the sector size is
+     * erased with one call. */
+    uint32_t hal_flash_erase_granularity(void);
+#endif
+
+#ifdef WOLFBOOT_FLASH_BLANK_CHECK
+    /* Blank check of a sector-aligned range of internal flash: 1 if erased,
+     * 0 if not, negative if unknown (the range is erased). The default reads
+     * the range one word at a time. Targets with a blank-check command, or
+     * where a word programmed with the erased value can't be programmed
+     * again (e.g. flash with ECC), provide their own. */
+    int hal_flash_is_erased(haladdr_t address, int len);
+#endif
+
+#ifdef WOLFBOOT_FLASH_WRITE_BULK
+    /* Program a whole run of flash in one go, used to copy sectors during
+     * updates. Address and length are aligned to the flash write unit. */
+    int hal_flash_write_bulk(haladdr_t address, const uint8_t *data, int len);
+#endif
+
 #ifdef WOLFBOOT_DUALBOOT
     void* hal_get_primary_address(void);
     void* hal_get_update_address(void);
@@ -97,12 +125,32 @@ void hal_prepare_boot(void);
         int ret = 0;
         uint32_t end = address + len - 1;
         uint32_t p;
+#if defined(SPI_FLASH) && defined(WOLFBOOT_FLASH_MULTI_SECTOR_ERASE)
+        /* Aligned 64KB and 32KB blocks in the range are erased with one
+         * block erase command each */
+        uint32_t blk;
+        for (p = address; (p <= end) && (ret == 0); p += blk) {
+            blk = SPI_FLASH_BLOCK_SIZE_64K;
+            while ((blk > SPI_FLASH_BLOCK_SIZE_32K) &&
+                    (((p & (blk - 1)) != 0) || (end - p + 1 < blk))) {
+                blk >>= 1;
+            }
+            if (((p & (blk - 1)) == 0) && (end - p + 1 >= blk)) {
+                ret = spi_flash_block_erase(p, blk);
+            }
+            else {
+                blk = SPI_FLASH_SECTOR_SIZE;
+                ret = spi_flash_sector_erase(p);
+            }
+        }
+#else
         for (p = address; p <= end; p += SPI_FLASH_SECTOR_SIZE) {
             ret = spi_flash_sector_erase(p);
             if (ret != 0) {
                 break;
             }
         }
+#endif
         return ret;
     }
 #endif /* !SPI_FLASH */
@@ -143,6 +191,28 @@ int hal_flash_otp_read(uint32_t flashAddress, void* data, uint32_t length);
 int hal_flash_test(void);
 #endif
 
+#if defined(WOLFBOOT_HASH_TREE) || defined(WOLFBOOT_HYBRID_PARALLEL_VERIFY)
+/* Secondary cores, used to hash the chunks of tree-hashed images and to
+ * verify the two signatures of hybrid images in parallel. Core 0 is the boot
+ * core.
+ * hal_smp_start() runs fn(arg) on the given core and returns 0, or -1 if the
+ * core is not available (the boot core then runs fn itself).
+ * hal_smp_wait() returns when fn is done, with its results visible to the
+ * boot core. Default implementations with no secondary cores are provided.
+ */
+int  hal_smp_cores(void);
+int  hal_smp_start(int core, void (*fn)(void *), void *arg);
+void hal_smp_wait(int core);
+#endif
+
+#ifdef WOLFBOOT_VERIFY_CACHE
+/* Device-unique secret, used as the key of the boot verification cache
+ * records. Must not be readable by the application. Returns 0 on success.
+ * The default implementation has no secret: records are never stored.
+ */
+int hal_verify_cache_key(uint8_t *key, int len);
+#endif
+
 
 #if defined(WOLFBOOT_ENABLE_WOLFHSM_CLIENT)
 
@@ -34,7 +34,8 @@ extern "C" {
 #include "target.h"
 #include "wolfboot/wolfboot.h"
 
-#ifdef EXT_FLASH
+#if defined(EXT_FLASH) || defined(WOLFBOOT_FLASH_MULTI_SECTOR_ERASE) || \
+    defined(WOLFBOOT_FLASH_BLANK_CHECK)
 #include "hal.h"
 #endif
 
@@ -113,6 +114,14 @@ int wolfBot_get_dts_size(void *dts_addr);
 #define SECT_FLAG_UPDATED   0x0f
 #endif
 
+/* Size of the swap partition, in sectors. With more than one, the
+ * interruptible swap moves groups of WOLFBOOT_SWAP_SECTORS sectors at a
+ * time (see wolfBoot_update()).
+ */
+#ifndef WOLFBOOT_SWAP_SECTORS
+#define WOLFBOOT_SWAP_SECTORS 1
+#endif
+
 #ifdef WOLFBOOT_SIGN_ED25519
 #define wolfBoot_verify_signature_primary wolfBoot_verify_signature_ed25519
 #endif
@@ -833,9 +842,23 @@ int wolfBoot_open_image_external(struct wolfBoot_image* img, uint8_t part, uint8
 int wolfBoot_open_image_address(struct wolfBoot_image* img, uint8_t* image);
 int wolfBoot_verify_integrity(struct wolfBoot_image *img);
 int wolfBoot_verify_authenticity(struct wolfBoot_image *img);
+#ifdef WOLFBOOT_VERIFY_CACHE
+int wolfBoot_verify_cached(struct wolfBoot_image *img);
+void wolfBoot_verify_cache_invalidate(void);
+#endif
+#if defined(WOLFBOOT_RAMBOOT_HASH_ON_LOAD) && \
+    (defined(__WOLFBOOT) || defined(UNIT_TEST_AUTH))
+int wolfBoot_image_hash_init(struct wolfBoot_image *img, wolfBoot_hash_t *ctx);
+int wolfBoot_verify_integrity_hash(struct wolfBoot_image *img,
+        wolfBoot_hash_t *ctx);
+#endif
 int wolfBoot_set_partition_state(uint8_t part, uint8_t newst);
 int wolfBoot_get_update_sector_flag(uint16_t sector, uint8_t *flag);
 int wolfBoot_set_update_sector_flag(uint16_t sector, uint8_t newflag);
+#if WOLFBOOT_SWAP_SECTORS > 1
+int wolfBoot_set_update_sector_flags(uint16_t first, uint16_t count,
+    uint8_t newflag);
+#endif
 
 #ifdef WOLFBOOT_ELF_FLASH_SCATTER
 /* Support for ELF scatter/gather format */
@@ -853,6 +876,44 @@ uint16_t wolfBoot_get_header(struct wolfBoot_image *img, uint16_t type, uint8_t
 /* Find the key slot ID based on the SHA hash of the key. */
 int keyslot_id_by_sha(const uint8_t *hint);
 
+#ifdef WOLFBOOT_FLASH_MULTI_SECTOR_ERASE
+/* Erase a sector-aligned range of internal flash with the fewest erase
+ * operations: each hal_flash_erase() call covers the largest aligned block
+ * that hal_flash_erase_granularity() reports and that fits in the range.
+ * With no information from the hal, the whole range goes in one call.
+ */
+static inline int wolfBoot_flash_erase_range(haladdr_t address, uint32_t len)
+{
+    uint32_t sizes = hal_flash_erase_granularity() &
+        ~((uint32_t)WOLFBOOT_SECTOR_SIZE - 1);
+    uint32_t blk;
+    uintptr_t off;
+    int ret = 0;
+
+    if (sizes == 0)
+        return hal_flash_erase(address, (int)len);
+    while ((len > 0) && (ret == 0)) {
+        /* blocks are aligned to the start of the flash */
+    #ifdef ARCH_FLASH_OFFSET
+        off = (uintptr_t)address - (uintptr_t)ARCH_FLASH_OFFSET;
+    #else
+        off = (uintptr_t)address;
+    #endif
+        blk = 0x80000000UL;
+        while ((blk > WOLFBOOT_SECTOR_SIZE) && (((sizes & blk) == 0) ||
+                (blk > len) || ((off & (blk - 1)) != 0))) {
+            blk >>= 1;
+        }
+        if (blk > len)
+            blk = len;
+        ret = hal_flash_erase(address, (int)blk);
+        address += blk;
+        len -= blk;
+    }
+    return ret;
+}
+#endif
+
 #ifdef EXT_FLASH
 # ifdef PART_BOOT_EXT
 #  define BOOT_EXT 1
@@ -893,6 +954,17 @@ static inline int wb_flash_erase(struct wolfBoot_image *img, uint32_t off,
         return hal_flash_erase((uintptr_t)(img->hdr) + off, size);
 }
 
+#ifdef WOLFBOOT_FLASH_MULTI_SECTOR_ERASE
+static inline int wb_flash_erase_range(struct wolfBoot_image *img,
+    uint32_t off, uint32_t size)
+{
+    if (PART_IS_EXT(img))
+        return ext_flash_erase((uintptr_t)(img->hdr) + off, size);
+    else
+        return wolfBoot_flash_erase_range((uintptr_t)(img->hdr) + off, size);
+}
+#endif
+
 static inline int wb_flash_write(struct wolfBoot_image *img, uint32_t off,
     const void *data, uint32_t size)
 {
@@ -902,6 +974,21 @@ static inline int wb_flash_write(struct wolfBoot_image *img, uint32_t off,
         return hal_flash_write((uintptr_t)(img->hdr) + off, data, size);
 }
 
+/* Write a run of whole flash words, e.g. a sector copied during an update */
+static inline int wb_flash_write_bulk(struct wolfBoot_image *img, uint32_t off,
+    const void *data, uint32_t size)
+{
+    if (PART_IS_EXT(img))
+        return ext_flash_check_write((uintptr_t)(img->hdr) + off, data, size);
+#ifdef WOLFBOOT_FLASH_WRITE_BULK
+    else
+        return hal_flash_write_bulk((uintptr_t)(img->hdr) + off, data, size);
+#else
+    else
+        return hal_flash_write((uintptr_t)(img->hdr) + off, data, size);
+#endif
+}
+
 static inline int wb_flash_write_verify_word(struct wolfBoot_image *img,
     uint32_t off, uint32_t word)
 {
@@ -938,11 +1025,27 @@ static inline int wb_flash_write_verify_word(struct wolfBoot_image *img,
 # define PARTN_IS_EXT(x) (0)
 # define wb_flash_erase(im, of, siz) \
     hal_flash_erase(((uintptr_t)(((im)->hdr)) + of), siz)
+# define wb_flash_erase_range(im, of, siz) \
+    wolfBoot_flash_erase_range(((uintptr_t)(((im)->hdr)) + of), siz)
 # define wb_flash_write(im, of, dat, siz) \
     hal_flash_write(((uintptr_t)((im)->hdr)) + of, dat, siz)
+# ifdef WOLFBOOT_FLASH_WRITE_BULK
+#  define wb_flash_write_bulk(im, of, dat, siz) \
+    hal_flash_write_bulk(((uintptr_t)((im)->hdr)) + of, dat, siz)
+# else
+#  define wb_flash_write_bulk(im, of, dat, siz) wb_flash_write(im, of, dat, siz)
+# endif
 
 #endif /* EXT_FLASH */
 
+#ifdef WOLFBOOT_FLASH_BLANK_CHECK
+/* Erase the sectors of a sector-aligned range that are not blank */
+int wolfBoot_flash_erase_written(int ext, haladdr_t address, uint32_t len);
+# define wb_flash_erase_written(im, of, siz) \
+    wolfBoot_flash_erase_written(PART_IS_EXT(im), \
+        ((uintptr_t)((im)->hdr)) + (of), siz)
+#endif
+
 /* -- Image Formats -- */
 /* Legacy U-Boot Image */
 #define UBOOT_IMG_HDR_MAGIC 0x56190527UL
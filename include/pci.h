@@ -81,6 +81,13 @@
 #define PCIE_LINK_CONTROL_OFF (0x10)
 #define PCIE_LINK_STATUS_TRAINING (1 << 11)
 #define PCIE_LINK_CONTROL_RETRAINING (1 << 5)
+
+#define PCI_ENUM_MAX_DEV  32
+#define PCI_ENUM_MAX_FUN  8
+#define PCI_ENUM_MAX_BARS 6
+
+/* Wildcard for the dev/fun fields of struct pci_enum_skip */
+#define PCI_ENUM_ANY 0xff
 typedef  struct {
     int bus;
     int device;
@@ -97,6 +104,47 @@ struct pci_enum_info {
     uint8_t curr_bus_number;
 };
 
+/* Skip list entry: { bus, PCI_ENUM_ANY, PCI_ENUM_ANY } skips a whole bus,
+ * { bus, dev, PCI_ENUM_ANY } all the functions of a device. Skipped functions
+ * are neither probed nor programmed. */
+struct pci_enum_skip {
+    uint8_t bus;
+    uint8_t dev;
+    uint8_t fun;
+};
+
+#ifdef WOLFBOOT_PCI_BAR_CACHE
+#ifndef PCI_BAR_CACHE_ENTRIES
+#define PCI_BAR_CACHE_ENTRIES 32
+#endif
+#define PCI_BAR_CACHE_MAGIC 0x31434250 /* "PBC1" */
+
+#define PCI_BAR_CACHE_NONE   0
+#define PCI_BAR_CACHE_MEM    1
+#define PCI_BAR_CACHE_MEM_PF 2
+#define PCI_BAR_CACHE_IO     3
+#define PCI_BAR_CACHE_KIND_MASK 0x3
+#define PCI_BAR_CACHE_64BIT  0x80
+
+/* BAR assignment of one function, as programmed by a previous enumeration */
+struct pci_bar_cache_entry {
+    uint32_t vd_code;
+    uint8_t bus;
+    uint8_t dev;
+    uint8_t fun;
+    uint8_t kind[PCI_ENUM_MAX_BARS];
+    uint8_t reserved[3];
+    uint32_t bar[PCI_ENUM_MAX_BARS];
+    uint32_t len[PCI_ENUM_MAX_BARS];
+};
+
+struct pci_bar_cache {
+    uint32_t magic;
+    uint32_t count;
+    struct pci_bar_cache_entry entry[PCI_BAR_CACHE_ENTRIES];
+};
+#endif /* WOLFBOOT_PCI_BAR_CACHE */
+
 
 #ifdef __cplusplus
 extern "C"
@@ -120,6 +168,12 @@ void pci_config_write8(uint8_t bus, uint8_t dev, uint8_t fun, uint8_t off,
 uint64_t pci_get_mmio_addr(uint8_t bus, uint8_t dev, uint8_t fun, uint8_t bar);
 
 uint32_t pci_enum_bus(uint8_t bus, struct pci_enum_info *info);
+void pci_enum_set_skip_list(const struct pci_enum_skip *list,
+                            unsigned int count);
+#ifdef WOLFBOOT_PCI_BAR_CACHE
+void pci_enum_set_bar_cache(struct pci_bar_cache *cache);
+int pci_enum_bar_cache_updated(void);
+#endif
 
 int pci_enum_do(void);
 int pci_pre_enum(void);
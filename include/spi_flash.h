@@ -37,6 +37,10 @@
 #define SPI_FLASH_PAGE_SIZE   (256)
 #endif
 
+/* Block erase sizes (commands 0x52 and 0xD8) */
+#define SPI_FLASH_BLOCK_SIZE_32K (0x8000)
+#define SPI_FLASH_BLOCK_SIZE_64K (0x10000)
+
 #if defined(SPI_FLASH) || defined(QSPI_FLASH) || defined(OCTOSPI_FLASH)
 
 #include <stdint.h>
@@ -46,6 +50,9 @@ uint16_t spi_flash_probe(void);
 void spi_flash_release(void);
 
 int spi_flash_sector_erase(uint32_t address);
+#ifdef SPI_FLASH
+int spi_flash_block_erase(uint32_t address, uint32_t size);
+#endif
 int spi_flash_chip_erase(void);
 int spi_flash_read(uint32_t address, void *data, int len);
 int spi_flash_write(uint32_t address, const void *data, int len);
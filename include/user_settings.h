@@ -152,8 +152,17 @@ extern int tolower(int c);
     /* SP MATH */
 #   if !defined(USE_FAST_MATH) && !defined(WOLFSSL_SP_MATH_ALL)
 #       define WOLFSSL_SP_MATH
+#       ifndef WOLFBOOT_ECC_FAST_VERIFY
 #       define WOLFSSL_SP_SMALL
+#       endif
 #       define WOLFSSL_HAVE_SP_ECC
+#   endif
+
+    /* Faster verification: SP uses its precomputed tables for the base point
+     * (stored in flash), and the other math libraries use Shamir's trick to
+     * compute u1*G + u2*Q in a single pass */
+#   ifdef WOLFBOOT_ECC_FAST_VERIFY
+#       define ECC_SHAMIR
 #   endif
 
 #define WOLFSSL_PUBLIC_MP
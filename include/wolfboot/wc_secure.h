@@ -83,6 +83,7 @@ int __attribute__((cmse_nonsecure_entry))
 /* RNG */
 int __attribute__((cmse_nonsecure_entry)) wcs_get_random(uint8_t *rand,
         uint32_t size);
+int __attribute__((cmse_nonsecure_entry)) wcs_rng_refill(void);
 
 /* exposed API for sign/verify with all needed arguments */
 static inline int wcs_ecc_sign(int slot_id, const uint8_t *in,
@@ -69,6 +69,7 @@ extern "C" {
 #define HDR_IMG_DELTA_BASE          0x05
 #define HDR_IMG_DELTA_SIZE          0x06
 #define HDR_IMG_DELTA_BASE_HASH     0x07
+#define HDR_HASH_TREE               0x08
 #define HDR_PUBKEY                  0x10
 #define HDR_SECONDARY_CIPHER        0x11
 #define HDR_SECONDARY_PUBKEY        0x12
@@ -160,7 +161,8 @@ extern "C" {
 #define KEY_VERIFY_SELF_ONLY   KEY_VERIFY_ONLY_ID(0)
 #define KEY_VERIFY_APP_ONLY   KEY_VERIFY_ONLY_ID(1)
 
-#if defined(__WOLFBOOT) || defined(UNIT_TEST_AUTH)
+#if defined(__WOLFBOOT) || defined(UNIT_TEST_AUTH) || \
+    defined(WOLFBOOT_UPDATE_WRITER)
 
 #include "wolfssl/wolfcrypt/settings.h"
 #include "wolfssl/wolfcrypt/visibility.h"
@@ -370,6 +372,12 @@ uint32_t wolfBoot_get_diffbase_version(uint8_t part);
     wolfBoot_get_image_version(PART_BOOT)
 #define wolfBoot_update_firmware_version() \
     wolfBoot_get_image_version(PART_UPDATE)
+#ifdef WOLFBOOT_UPDATE_WRITER
+int wolfBoot_update_writer_open(void);
+int wolfBoot_update_writer_write(const uint8_t *data, uint32_t len);
+int wolfBoot_update_writer_finalize(void);
+int wolfBoot_update_writer_digest(uint8_t *digest);
+#endif
 #endif
 
 int wolfBoot_fallback_is_possible(void);
@@ -118,7 +118,9 @@
 #define HBA_GHC_HR     (1 << 0)  /* HARD RESET */
 #define HBA_GHC_IE     (1 << 1)  /* INT ENABLE */
 
+#define AHCI_CAP_SNCQ (1 << 30)      /* Native Command Queuing supported */
 #define AHCI_CAP_SSS  (1 << 27)      /* Staggered spin-up mode supported */
+#define AHCI_CAP_NCS(cap) (((cap) >> 8) & 0x1F) /* Number of cmd slots - 1 */
 #define AHCI_CAP_SAM (1 << 18)
 
 #define AHCI_PORT_CMD_CPD  (1 << 20) /* Cold-presence detection */
@@ -136,6 +138,9 @@
 #define AHCI_PORT_SSTS_DET 0x01
 #define AHCI_PORT_SSTS_DET_PCE 0x03
 
+#define AHCI_SCTL_DET_MASK 0xf
+#define AHCI_PORT_SCTL_DET_COMRESET 0x01
+
 #define AHCI_PORT_TFD_BSY (1 << 7)
 #define AHCI_PORT_TFD_DRQ (1 << 3)
 #define AHCI_PORT_TFD_ERR (1 << 0)
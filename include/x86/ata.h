@@ -50,6 +50,11 @@ int ata_device_config_identify(int drv);
 int ata_security_freeze_lock(int drv);
 int ata_security_unlock_device(int drv, const char *passphrase, int master);
 int ata_cmd_complete_async();
+#ifdef WOLFBOOT_ATA_NCQ
+int ata_queue_depth(int drv);
+int ata_drive_read_queued(int drv, uint64_t start, uint32_t size, uint8_t *buf);
+int ata_queue_complete(int drv, int tag);
+#endif
 
 /* @brief Enum with the possible state for each drive.
  * See ATA/ATAPI Command Set (ATA8-ACS) section 4.7.4
@@ -87,6 +92,7 @@ enum ata_security_state ata_security_get_state(int);
 /* ATA commands */
 
 #define ATA_CMD_READ_DMA_EX 0x25
+#define ATA_CMD_READ_FPDMA_QUEUED 0x60
 #define ATA_CMD_WRITE_DMA_EX 0x35
 #define ATA_CMD_DEVICE_CONFIGURATION_IDENTIFY 0xB1
 #define ATA_CMD_WRITE_DMA 0xCA
@@ -109,4 +115,8 @@ enum ata_security_state ata_security_get_state(int);
 #define ATA_ERR_BUSY -2
 #define ATA_ERR_OP_IN_PROGRESS -3
 #define ATA_ERR_OP_NOT_IN_PROGRESS -4
+
+/* Queued reads */
+#define ATA_MAX_QUEUED_CMDS 8
+#define ATA_QUEUE_MAX_XFER (4 * 1024 * 1024) /* Single PRDT entry */
 #endif
@@ -25,4 +25,7 @@ int disk_open(int drv);
 int disk_read(int drv, int part, uint64_t off, uint64_t sz, uint8_t *buf);
 int disk_write(int drv, int part, uint64_t off, uint64_t sz, const uint8_t *buf);
 int disk_find_partition_by_label(int drv, const char *label);
+#ifdef WOLFBOOT_ATA_NCQ
+int disk_read_queued(int drv, int part, uint64_t off, uint32_t sz, uint8_t *buf);
+#endif
 #endif
@@ -71,6 +71,20 @@ ifeq ($(WOLFBOOT_SMALL_STACK),1)
   OBJS+=./src/xmalloc.o
 endif
 
+ifeq ($(ECC_FAST_VERIFY),1)
+  ifeq ($(WOLFBOOT_SMALL_STACK),1)
+    $(error ECC_FAST_VERIFY is not supported with WOLFBOOT_SMALL_STACK)
+  endif
+  CFLAGS+=-D"WOLFBOOT_ECC_FAST_VERIFY"
+endif
+
+ifneq ($(VERIFY_BENCHMARK),)
+  ifneq ($(TARGET),sim)
+    $(error VERIFY_BENCHMARK is only supported on the sim target)
+  endif
+  CFLAGS+=-D"WOLFBOOT_VERIFY_BENCHMARK=$(VERIFY_BENCHMARK)"
+endif
+
 
 ECC_OBJS= \
     ./lib/wolfssl/wolfcrypt/src/ecc.o
@@ -473,6 +487,12 @@ ifneq ($(SIGN_SECONDARY),)
     endif
     CFLAGS+=-D"WOLFBOOT_SIGN_ML_DSA" $(ML_DSA_EXTRA)
   endif
+  ifeq ($(HYBRID_PARALLEL_VERIFY),1)
+    ifeq ($(WOLFBOOT_SMALL_STACK),1)
+      $(error HYBRID_PARALLEL_VERIFY is not supported with WOLFBOOT_SMALL_STACK)
+    endif
+    CFLAGS+=-D"WOLFBOOT_HYBRID_PARALLEL_VERIFY"
+  endif
 endif
 
 
@@ -583,6 +603,14 @@ ifeq ($(DISABLE_BACKUP),1)
   CFLAGS+= -D"DISABLE_BACKUP"
 endif
 
+ifneq ($(SWAP_SECTORS),)
+  CFLAGS+= -D"WOLFBOOT_SWAP_SECTORS=$(SWAP_SECTORS)"
+endif
+
+ifeq ($(SWAP_MOVE),1)
+  CFLAGS+= -D"WOLFBOOT_SWAP_MOVE"
+endif
+
 DEBUG_SYMBOLS?=0
 ifeq ($(DEBUG),1)
   CFLAGS+=-O0 -D"DEBUG"
@@ -639,6 +667,16 @@ ifeq ($(DELTA_UPDATES),1)
   endif
 endif
 
+ifeq ($(UPDATE_WRITER),1)
+  CFLAGS+=-D"WOLFBOOT_UPDATE_WRITER"
+  ifneq ($(UPDATE_WRITER_BUF_SIZE),)
+    CFLAGS+=-DWOLFBOOT_UPDATE_WRITER_BUF_SIZE=$(UPDATE_WRITER_BUF_SIZE)
+  endif
+  ifeq ($(UPDATE_WRITER_VERIFY),1)
+    CFLAGS+=-D"WOLFBOOT_UPDATE_WRITER_VERIFY"
+  endif
+endif
+
 ifeq ($(ARMORED),1)
   CFLAGS+=-DWOLFBOOT_ARMORED
 endif
@@ -759,6 +797,23 @@ ifeq ($(HASH),SHA3)
   SIGN_OPTIONS+=--sha3
 endif
 
+ifeq ($(HASH_TREE),1)
+  HASH_TREE_CHUNK?=65536
+  CFLAGS+=-D"WOLFBOOT_HASH_TREE"
+  SIGN_OPTIONS+=--hash-tree $(HASH_TREE_CHUNK)
+endif
+
+ifeq ($(VERIFY_CACHE),1)
+  ifeq ($(VERIFY_CACHE_ADDRESS),)
+    $(error VERIFY_CACHE requires VERIFY_CACHE_ADDRESS)
+  endif
+  CFLAGS+=-D"WOLFBOOT_VERIFY_CACHE"
+  CFLAGS+=-D"WOLFBOOT_VERIFY_CACHE_ADDRESS=$(VERIFY_CACHE_ADDRESS)"
+  ifneq ($(VERIFY_CACHE_SAMPLES),)
+    CFLAGS+=-D"WOLFBOOT_VERIFY_CACHE_SAMPLES=$(VERIFY_CACHE_SAMPLES)"
+  endif
+endif
+
 CFLAGS+=-DIMAGE_HEADER_SIZE=$(IMAGE_HEADER_SIZE)
 OBJS+=$(SECURE_OBJS)
 
@@ -797,6 +852,11 @@ ifeq ($(ELF),1)
 
 endif
 
+# index the device tree for boot-time fixup lookups
+ifeq ($(FDT_INDEX),1)
+  CFLAGS+=-D"WOLFBOOT_FDT_INDEX"
+endif
+
 ifeq ($(MULTIBOOT2),1)
   CFLAGS+=-DWOLFBOOT_MULTIBOOT2
   OBJS += src/multiboot.o
@@ -825,6 +885,21 @@ ifeq ($(DISK_LOCK),1)
   OBJS+=./lib/wolfssl/wolfcrypt/src/coding.o
 endif
 
+ifeq ($(ATA_NCQ),1)
+  CFLAGS+=-DWOLFBOOT_ATA_NCQ
+endif
+
+# Hash while loading to RAM: NO_XIP copy or queued disk reads
+ifeq ($(RAMBOOT_HASH_ON_LOAD),1)
+  ifneq ($(filter 1,$(NO_XIP) $(ATA_NCQ)),)
+    CFLAGS+=-D"WOLFBOOT_RAMBOOT_HASH_ON_LOAD"
+  endif
+endif
+
+ifeq ($(PCI_BAR_CACHE),1)
+  CFLAGS+=-DWOLFBOOT_PCI_BAR_CACHE
+endif
+
 ifeq ($(FSP), 1)
   X86_FSP_OPTIONS := \
     X86_UART_BASE \
@@ -845,6 +920,10 @@ ifeq ($(FLASH_MULTI_SECTOR_ERASE),1)
     CFLAGS+=-DWOLFBOOT_FLASH_MULTI_SECTOR_ERASE
 endif
 
+ifeq ($(FLASH_BLANK_CHECK),1)
+    CFLAGS+=-DWOLFBOOT_FLASH_BLANK_CHECK
+endif
+
 CFLAGS+=$(CFLAGS_EXTRA)
 OBJS+=$(OBJS_EXTRA)
 
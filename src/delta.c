@@ -46,7 +46,7 @@ struct BLOCK_HDR_PACKED block_hdr {
 #include "image.h"
 #define ext_flash_check_write ext_flash_encrypt_write
 #define ext_flash_check_read ext_flash_decrypt_read
-#elif defined(__WOLFBOOT)
+#elif defined(__WOLFBOOT) || (defined(UNIT_TEST) && defined(EXT_FLASH))
 #include "hal.h"
 #define ext_flash_check_write ext_flash_write
 #define ext_flash_check_read ext_flash_read
@@ -63,34 +63,44 @@ int wb_patch_init(WB_PATCH_CTX *bm, uint8_t *src, uint32_t ssz, uint8_t *patch,
     bm->src_size = ssz;
     bm->patch_base = patch;
     bm->patch_size = psz;
-#ifdef EXT_FLASH
-    bm->patch_cache_start = 0xFFFFFFFF;
-#endif
     return 0;
 }
 
 #ifdef EXT_FLASH
-#define PATCH_CACHE_SIZE 256
-#define DELTA_SWAP_CACHE_SIZE 1024
-
+/* Patch window, read one DELTA_PATCH_BLOCK_SIZE page of the external flash at
+ * a time. A whole block header at p_off must be in the window: when it is
+ * not, the bytes left are moved to the start of the window and the next page
+ * is read after them, so each byte of the patch is read only once. */
 static inline uint8_t *patch_read_cache(WB_PATCH_CTX *ctx)
 {
-    if (ctx->patch_cache_start != 0xFFFFFFFF) {
-        if (ctx->patch_cache_start == ctx->p_off)
-            return ctx->patch_cache;
+    uintptr_t addr = (uintptr_t)ctx->patch_base + ctx->p_off;
+    uintptr_t pos = addr - ctx->patch_cache_start;
+    uint32_t keep;
 
-        if (ctx->p_off < ctx->patch_cache_start +
-                (DELTA_PATCH_BLOCK_SIZE - BLOCK_HDR_SIZE))
-            return ctx->patch_cache + ctx->p_off - ctx->patch_cache_start;
+    while ((ctx->patch_cache_len == 0) || (addr < ctx->patch_cache_start) ||
+            (pos >= ctx->patch_cache_len) ||
+            (ctx->patch_cache_len - pos < BLOCK_HDR_SIZE)) {
+        if ((ctx->patch_cache_len == 0) || (addr < ctx->patch_cache_start) ||
+                (pos >= ctx->patch_cache_len)) {
+            /* Start over from the page of p_off */
+            ctx->patch_cache_start = addr - (addr % DELTA_PATCH_BLOCK_SIZE);
+            keep = 0;
+        } else {
+            keep = ctx->patch_cache_len - (uint32_t)pos;
+            memmove(ctx->patch_cache, ctx->patch_cache + pos, keep);
+            ctx->patch_cache_start = addr;
+        }
+        if (ext_flash_check_read(ctx->patch_cache_start + keep,
+                ctx->patch_cache + keep, DELTA_PATCH_BLOCK_SIZE) < 0) {
+            ctx->patch_cache_len = 0;
+            return NULL;
+        }
+        ctx->patch_cache_len = keep + DELTA_PATCH_BLOCK_SIZE;
+        pos = addr - ctx->patch_cache_start;
     }
-    ctx->patch_cache_start = ctx->p_off;
-    ext_flash_check_read(
-            (uintptr_t)(ctx->patch_base + ctx->p_off),
-            ctx->patch_cache, DELTA_PATCH_BLOCK_SIZE);
-    return ctx->patch_cache;
+    return ctx->patch_cache + pos;
 }
 
-
 #else
 
 static inline uint8_t *patch_read_cache(WB_PATCH_CTX *ctx)
@@ -100,6 +110,53 @@ static inline uint8_t *patch_read_cache(WB_PATCH_CTX *ctx)
 
 #endif
 
+#if defined(EXT_FLASH) && defined(PART_BOOT_EXT)
+/* Source window: the base image is in external flash too (never encrypted),
+ * copy blocks are read one DELTA_PATCH_BLOCK_SIZE page at a time. The base
+ * image is rewritten while the update goes on, so the window is only valid
+ * for one call to wb_patch(). */
+static int src_read(WB_PATCH_CTX *ctx, uint8_t *dst, uint32_t off,
+    uint32_t len)
+{
+    uintptr_t addr = (uintptr_t)ctx->src_base + off;
+    uintptr_t pos;
+    uint32_t n;
+
+    while (len > 0) {
+        pos = addr - ctx->src_cache_start;
+        if ((ctx->src_cache_len == 0) || (addr < ctx->src_cache_start) ||
+                (pos >= ctx->src_cache_len)) {
+            ctx->src_cache_start = addr - (addr % DELTA_PATCH_BLOCK_SIZE);
+            if (ext_flash_read(ctx->src_cache_start, ctx->src_cache,
+                    DELTA_PATCH_BLOCK_SIZE) < 0) {
+                ctx->src_cache_len = 0;
+                return -1;
+            }
+            ctx->src_cache_len = DELTA_PATCH_BLOCK_SIZE;
+            pos = addr - ctx->src_cache_start;
+        }
+        n = ctx->src_cache_len - (uint32_t)pos;
+        if (n > len)
+            n = len;
+        memcpy(dst, ctx->src_cache + pos, n);
+        dst += n;
+        addr += n;
+        len -= n;
+    }
+    return 0;
+}
+
+#else
+
+static inline int src_read(WB_PATCH_CTX *ctx, uint8_t *dst, uint32_t off,
+    uint32_t len)
+{
+    memcpy(dst, ctx->src_base + off, len);
+    return 0;
+}
+
+#endif
+
 int wb_patch(WB_PATCH_CTX *ctx, uint8_t *dst, uint32_t len)
 {
     struct block_hdr *hdr;
@@ -111,15 +168,19 @@ int wb_patch(WB_PATCH_CTX *ctx, uint8_t *dst, uint32_t len)
         return -1;
     if (len < BLOCK_HDR_SIZE)
         return -1;
+#if defined(EXT_FLASH) && defined(PART_BOOT_EXT)
+    ctx->src_cache_len = 0;
+#endif
 
     while ( ( (ctx->matching != 0) || (ctx->p_off < ctx->patch_size)) && (dst_off < len)) {
-        uint8_t *pp = patch_read_cache(ctx);
+        uint8_t *pp;
         if (ctx->matching) {
             /* Resume matching block from previous sector */
             sz = ctx->blk_sz;
             if (sz > len)
                 sz = len;
-            memcpy(dst + dst_off, ctx->src_base + ctx->blk_off, sz);
+            if (src_read(ctx, dst + dst_off, ctx->blk_off, sz) < 0)
+                return -1;
             if (ctx->blk_sz > len) {
                 ctx->blk_sz -= len;
                 ctx->blk_off += len;
@@ -131,6 +192,9 @@ int wb_patch(WB_PATCH_CTX *ctx, uint8_t *dst, uint32_t len)
             dst_off += sz;
             continue;
         }
+        pp = patch_read_cache(ctx);
+        if (pp == NULL)
+            return -1;
         if (*pp == ESC) {
             if (*(pp + 1) == ESC) {
                 *(dst + dst_off) = ESC;
@@ -151,7 +215,8 @@ int wb_patch(WB_PATCH_CTX *ctx, uint8_t *dst, uint32_t len)
                 } else {
                     copy_sz = sz;
                 }
-                memcpy(dst + dst_off, ctx->src_base + src_off, copy_sz);
+                if (src_read(ctx, dst + dst_off, src_off, copy_sz) < 0)
+                    return -1;
                 if (sz == copy_sz) {
                     /* End of the block, reset counters and matching state */
                     ctx->matching = 0;
@@ -185,7 +250,7 @@ int wb_diff_get_sector_size(void)
     if (!env_sector_size) {
        fprintf(stderr, "Please set the WOLFBOOT_SECTOR_SIZE environment variable in\n"
                "order to sign a delta update.\n");
-       exit(6);
+       return 0;
     } else {
         sec_sz = atoi(env_sector_size);
         if (sec_sz == 0) {
@@ -193,7 +258,7 @@ int wb_diff_get_sector_size(void)
             sec_sz = strtol(env_sector_size, NULL, 16);
             if (errno != 0) {
                 fprintf(stderr, "Invalid WOLFBOOT_SECTOR_SIZE value\n");
-                exit(6);
+                return 0;
             }
         }
     }
@@ -210,10 +275,27 @@ int wb_diff_init(WB_DIFF_CTX *ctx, uint8_t *src_a, uint32_t len_a, uint8_t *src_
     ctx->size_a = len_a;
     ctx->size_b = len_b;
     wolfboot_sector_size = wb_diff_get_sector_size();
+    if (wolfboot_sector_size == 0)
+        return -1;
     printf("WOLFBOOT_SECTOR_SIZE: %u\n", wolfboot_sector_size);
     return 0;
 }
 
+/* Restrict an initialized context to the bytes [start, end) of image B.
+ * Matches never extend past 'end', so the patches produced for consecutive,
+ * sector aligned ranges can be computed independently and concatenated.
+ */
+int wb_diff_range(WB_DIFF_CTX *ctx, uint32_t start, uint32_t end)
+{
+    if (!ctx || (start >= end) || (end > ctx->size_b))
+        return -1;
+    if ((wolfboot_sector_size == 0) || ((start % wolfboot_sector_size) != 0))
+        return -1;
+    ctx->off_b = start;
+    ctx->size_b = end;
+    return 0;
+}
+
 int wb_diff(WB_DIFF_CTX *ctx, uint8_t *patch, uint32_t len)
 {
     struct block_hdr hdr;
@@ -262,7 +344,8 @@ int wb_diff(WB_DIFF_CTX *ctx, uint8_t *patch, uint32_t len)
                 b_start = ctx->off_b;
                 pa+= BLOCK_HDR_SIZE;
                 ctx->off_b += BLOCK_HDR_SIZE;
-                while (*pa == *(ctx->src_b + ctx->off_b)) {
+                while ((ctx->off_b < ctx->size_b) &&
+                        (*pa == *(ctx->src_b + ctx->off_b))) {
                     /* Extend matching block if possible, as long as the
                      * identical sequence continues.
                      */
@@ -320,7 +403,8 @@ int wb_diff(WB_DIFF_CTX *ctx, uint8_t *patch, uint32_t len)
                     blk_start = pb - ctx->src_b;
                     pb+= BLOCK_HDR_SIZE;
                     ctx->off_b += BLOCK_HDR_SIZE;
-                    while (*pb == *(ctx->src_b + ctx->off_b)) {
+                    while ((ctx->off_b < ctx->size_b) &&
+                            (*pb == *(ctx->src_b + ctx->off_b))) {
                         /* Extend match as long as the areas have the
                          * same content. Block skipping in this case is
                          * not a problem since the distance between the patched
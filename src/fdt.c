@@ -231,12 +231,6 @@ static const struct fdt_property *fdt_get_property(const void *fdt, int offset,
     return NULL;
 }
 
-static void fdt_del_last_string_(void *fdt, const char *s)
-{
-    int newlen = strlen(s) + 1;
-    fdt_set_size_dt_strings(fdt, fdt_size_dt_strings(fdt) - newlen);
-}
-
 static int fdt_splice_(void *fdt, void *splicepoint, int oldlen, int newlen)
 {
     char *p, *end;
@@ -255,6 +249,212 @@ static int fdt_splice_(void *fdt, void *splicepoint, int oldlen, int newlen)
     return 0;
 }
 
+#ifdef WOLFBOOT_FDT_INDEX
+/* Lookup index, built in one pass over the structure block the first time a
+ * DTB is searched. For each node, it records the name, every string in the
+ * "compatible" list and the "device_type" value. Keys in the same bucket are
+ * chained in structure order, so a lookup returns the first match after the
+ * start offset, like the linear scan does.
+ *
+ * The index follows the splices in the structure block: offsets after the
+ * splice point are moved, new subnodes are added, and changing "compatible"
+ * or "device_type" (or deleting a node) drops the index, to be rebuilt by the
+ * next lookup. The edits done here record the new header sizes and offsets;
+ * any other change to them (e.g. a different DTB copied to the same address)
+ * also causes a rebuild. Callers replacing a blob in place with the same
+ * header should still call fdt_index_invalidate().
+ */
+#ifndef FDT_INDEX_MAX_KEYS
+    #define FDT_INDEX_MAX_KEYS 2048
+#endif
+#ifndef FDT_INDEX_BUCKETS
+    #define FDT_INDEX_BUCKETS 512
+#endif
+#if (FDT_INDEX_BUCKETS & (FDT_INDEX_BUCKETS - 1)) != 0
+    #error FDT_INDEX_BUCKETS must be a power of two
+#endif
+
+#define FDT_INDEX_NAME    0
+#define FDT_INDEX_COMPAT  1
+#define FDT_INDEX_DEVTYPE 2
+
+struct fdt_index_key {
+    uint32_t hash;
+    int offset;
+    int next; /* next key in the bucket, -1 if last */
+};
+
+static struct fdt_index {
+    const void *fdt;        /* DTB currently indexed, NULL if none */
+    const void *failed;     /* DTB that does not fit in the index */
+    /* header of the indexed DTB, to detect a different blob at that address */
+    uint32_t totalsize;
+    uint32_t off_dt_strings;
+    uint32_t size_dt_struct;
+    uint32_t size_dt_strings;
+    int nkeys;
+    int head[FDT_INDEX_BUCKETS];
+    struct fdt_index_key keys[FDT_INDEX_MAX_KEYS];
+} fdt_idx;
+
+static int fdt_index_disabled = 0;
+
+static uint32_t fdt_index_hash_(int kind, const char *s, int len)
+{
+    uint32_t h = 2166136261UL ^ (uint32_t)kind; /* FNV-1a */
+    while (len-- > 0) {
+        h ^= (uint8_t)*s++;
+        h *= 16777619UL;
+    }
+    return h;
+}
+
+static int fdt_index_insert_(uint32_t hash, int offset)
+{
+    int *link = &fdt_idx.head[hash & (FDT_INDEX_BUCKETS - 1)];
+    struct fdt_index_key *key;
+
+    if (fdt_idx.nkeys >= FDT_INDEX_MAX_KEYS)
+        return -FDT_ERR_NOSPACE;
+    /* keep the chain sorted by offset */
+    while ((*link >= 0) && (fdt_idx.keys[*link].offset < offset))
+        link = &fdt_idx.keys[*link].next;
+    key = &fdt_idx.keys[fdt_idx.nkeys];
+    key->hash = hash;
+    key->offset = offset;
+    key->next = *link;
+    *link = fdt_idx.nkeys++;
+    return 0;
+}
+
+static int fdt_index_node_(const void *fdt, int offset)
+{
+    const char *name, *prop, *end;
+    int len, ret;
+
+    name = fdt_offset_ptr_(fdt, offset + FDT_TAGSIZE);
+    ret = fdt_index_insert_(
+        fdt_index_hash_(FDT_INDEX_NAME, name, (int)strlen(name)), offset);
+
+    /* property list may contain multiple null terminated strings */
+    prop = (const char*)fdt_getprop(fdt, offset, "compatible", &len);
+    while ((ret == 0) && (prop != NULL) && (len > 0)) {
+        end = memchr(prop, '\0', len);
+        if (end == NULL)
+            break;
+        ret = fdt_index_insert_(
+            fdt_index_hash_(FDT_INDEX_COMPAT, prop, (int)(end - prop)), offset);
+        len -= (int)(end - prop) + 1;
+        prop = end + 1;
+    }
+
+    prop = (const char*)fdt_getprop(fdt, offset, "device_type", &len);
+    if ((ret == 0) && (prop != NULL) && (len > 0)) {
+        ret = fdt_index_insert_(
+            fdt_index_hash_(FDT_INDEX_DEVTYPE, prop, len - 1), offset);
+    }
+    return ret;
+}
+
+/* Record the header after an edit that keeps the index valid */
+static void fdt_index_sync_(const void *fdt)
+{
+    if (fdt_idx.fdt != fdt)
+        return;
+    fdt_idx.totalsize = fdt_totalsize(fdt);
+    fdt_idx.off_dt_strings = fdt_off_dt_strings(fdt);
+    fdt_idx.size_dt_struct = fdt_size_dt_struct(fdt);
+    fdt_idx.size_dt_strings = fdt_size_dt_strings(fdt);
+}
+
+static int fdt_index_build_(const void *fdt)
+{
+    int off, ret = 0;
+
+    fdt_idx.fdt = NULL;
+    fdt_idx.nkeys = 0;
+    memset(fdt_idx.head, 0xFF, sizeof(fdt_idx.head)); /* all -1 */
+    for (off = fdt_next_node(fdt, -1, NULL);
+         (off >= 0) && (ret == 0);
+         off = fdt_next_node(fdt, off, NULL))
+    {
+        ret = fdt_index_node_(fdt, off);
+    }
+    if (ret != 0) {
+        fdt_idx.failed = fdt;
+        return ret;
+    }
+    fdt_idx.fdt = fdt;
+    fdt_idx.failed = NULL;
+    fdt_index_sync_(fdt);
+    return 0;
+}
+
+/* return: 1 if the index can be used to search this DTB */
+static int fdt_index_ready_(const void *fdt)
+{
+    if (fdt_index_disabled)
+        return 0;
+    if ((fdt_idx.fdt == fdt) &&
+        (fdt_idx.totalsize == fdt_totalsize(fdt)) &&
+        (fdt_idx.off_dt_strings == fdt_off_dt_strings(fdt)) &&
+        (fdt_idx.size_dt_struct == fdt_size_dt_struct(fdt)) &&
+        (fdt_idx.size_dt_strings == fdt_size_dt_strings(fdt)))
+        return 1;
+    if ((fdt_idx.failed == fdt) || (fdt_check_header(fdt) != 0))
+        return 0;
+    return (fdt_index_build_(fdt) == 0);
+}
+
+/* return: first key in the bucket for hash, after startoffset */
+static int fdt_index_first_(uint32_t hash, int startoffset)
+{
+    int k = fdt_idx.head[hash & (FDT_INDEX_BUCKETS - 1)];
+    while ((k >= 0) && (fdt_idx.keys[k].offset <= startoffset))
+        k = fdt_idx.keys[k].next;
+    return k;
+}
+
+static void fdt_index_drop_(const void *fdt)
+{
+    if (fdt_idx.fdt == fdt)
+        fdt_idx.fdt = NULL;
+    if (fdt_idx.failed == fdt)
+        fdt_idx.failed = NULL;
+}
+
+/* Move the keys after a splice of the structure block at offset */
+static void fdt_index_splice_(const void *fdt, int offset, int oldlen,
+    int newlen)
+{
+    int i;
+    if (fdt_idx.fdt != fdt)
+        return;
+    for (i = 0; i < fdt_idx.nkeys; i++) {
+        if (fdt_idx.keys[i].offset >= offset + oldlen) {
+            fdt_idx.keys[i].offset += newlen - oldlen;
+        }
+        else if (fdt_idx.keys[i].offset >= offset) {
+            /* node removed */
+            fdt_index_drop_(fdt);
+            return;
+        }
+    }
+    fdt_index_sync_(fdt);
+}
+
+void fdt_index_invalidate(void)
+{
+    fdt_idx.fdt = NULL;
+    fdt_idx.failed = NULL;
+}
+
+void fdt_index_enable(int enable)
+{
+    fdt_index_disabled = !enable;
+}
+#endif /* WOLFBOOT_FDT_INDEX */
+
 static int fdt_splice_struct_(void *fdt, void *p, int oldlen, int newlen)
 {
     int err, delta;
@@ -264,6 +464,10 @@ static int fdt_splice_struct_(void *fdt, void *p, int oldlen, int newlen)
     if (err == 0) {
         fdt_set_size_dt_struct(fdt, fdt_size_dt_struct(fdt) + delta);
         fdt_set_off_dt_strings(fdt, fdt_off_dt_strings(fdt) + delta);
+#ifdef WOLFBOOT_FDT_INDEX
+        fdt_index_splice_(fdt, (int)((char*)p - (char*)fdt_offset_ptr_(fdt, 0)),
+            oldlen, newlen);
+#endif
     }
     return err;
 }
@@ -297,9 +501,21 @@ static int fdt_splice_string_(void *fdt, int newlen)
         return err;
     }
     fdt_set_size_dt_strings(fdt, fdt_size_dt_strings(fdt) + newlen);
+#ifdef WOLFBOOT_FDT_INDEX
+    fdt_index_sync_(fdt);
+#endif
     return 0;
 }
 
+static void fdt_del_last_string_(void *fdt, const char *s)
+{
+    int newlen = strlen(s) + 1;
+    fdt_set_size_dt_strings(fdt, fdt_size_dt_strings(fdt) - newlen);
+#ifdef WOLFBOOT_FDT_INDEX
+    fdt_index_sync_(fdt);
+#endif
+}
+
 static const char* fdt_find_string_(const char *strtab, int tabsize, const char *s)
 {
     int len = strlen(s) + 1;
@@ -552,6 +768,12 @@ int fdt_setprop(void *fdt, int nodeoffset, const char *name, const void *val,
         if (len > 0) {
             memcpy(prop_data, val, len);
         }
+#ifdef WOLFBOOT_FDT_INDEX
+        if ((strcmp(name, "compatible") == 0) ||
+            (strcmp(name, "device_type") == 0)) {
+            fdt_index_drop_(fdt);
+        }
+#endif
     }
     if (err != 0) {
         wolfBoot_printf("FDT: Set prop failed! %d (name %s, off %d)\n",
@@ -604,6 +826,23 @@ int fdt_find_node_offset(void* fdt, int startoff, const char* nodename)
         return -1;
 
     fnlen = (int)strlen(nodename);
+#ifdef WOLFBOOT_FDT_INDEX
+    if (((startoff < 0) || (fdt_check_node_offset_(fdt, startoff) >= 0)) &&
+        fdt_index_ready_(fdt)) {
+        uint32_t hash = fdt_index_hash_(FDT_INDEX_NAME, nodename, fnlen);
+        int k;
+        for (k = fdt_index_first_(hash, startoff); k >= 0;
+             k = fdt_idx.keys[k].next) {
+            off = fdt_idx.keys[k].offset;
+            nstr = fdt_get_name(fdt, off, &nlen);
+            if ((fdt_idx.keys[k].hash == hash) && (nlen == fnlen) &&
+                (memcmp(nstr, nodename, fnlen) == 0)) {
+                return off;
+            }
+        }
+        return -FDT_ERR_NOTFOUND;
+    }
+#endif
     for (off = fdt_next_node(fdt, startoff, NULL);
          off >= 0;
          off = fdt_next_node(fdt, off, NULL))
@@ -626,6 +865,26 @@ int fdt_find_prop_offset(void* fdt, int startoff, const char* propname,
         return -1;
 
     pvallen = (int)strlen(propval)+1;
+#ifdef WOLFBOOT_FDT_INDEX
+    if ((strcmp(propname, "device_type") == 0) &&
+        ((startoff < 0) || (fdt_check_node_offset_(fdt, startoff) >= 0)) &&
+        fdt_index_ready_(fdt)) {
+        uint32_t hash = fdt_index_hash_(FDT_INDEX_DEVTYPE, propval,
+            pvallen - 1);
+        int k;
+        for (k = fdt_index_first_(hash, startoff); k >= 0;
+             k = fdt_idx.keys[k].next) {
+            off = fdt_idx.keys[k].offset;
+            if (fdt_idx.keys[k].hash != hash)
+                continue;
+            val = fdt_getprop(fdt, off, propname, &len);
+            if (val && (len == pvallen) && (memcmp(val, propval, len) == 0)) {
+                return off;
+            }
+        }
+        return -FDT_ERR_NOTFOUND;
+    }
+#endif
     for (off = fdt_next_node(fdt, startoff, NULL);
          off >= 0;
          off = fdt_next_node(fdt, off, NULL))
@@ -648,6 +907,33 @@ int fdt_node_offset_by_compatible(const void *fdt, int startoffset,
 {
     int offset;
     int complen = (int)strlen(compatible);
+#ifdef WOLFBOOT_FDT_INDEX
+    if (((startoffset < 0) ||
+         (fdt_check_node_offset_(fdt, startoffset) >= 0)) &&
+        fdt_index_ready_(fdt)) {
+        uint32_t hash = fdt_index_hash_(FDT_INDEX_COMPAT, compatible, complen);
+        int k, len;
+        const char *prop, *nextprop;
+        for (k = fdt_index_first_(hash, startoffset); k >= 0;
+             k = fdt_idx.keys[k].next) {
+            if (fdt_idx.keys[k].hash != hash)
+                continue;
+            offset = fdt_idx.keys[k].offset;
+            prop = (const char*)fdt_getprop(fdt, offset, "compatible", &len);
+            while (prop != NULL && len > complen) {
+                if (memcmp(compatible, prop, complen+1) == 0) {
+                    return offset;
+                }
+                nextprop = memchr(prop, '\0', len);
+                if (nextprop == NULL)
+                    break;
+                len -= (nextprop - prop) + 1;
+                prop = nextprop + 1;
+            }
+        }
+        return -FDT_ERR_NOTFOUND;
+    }
+#endif
     for (offset = fdt_next_node(fdt, startoffset, NULL);
          offset >= 0;
          offset = fdt_next_node(fdt, offset, NULL))
@@ -709,6 +995,12 @@ int fdt_add_subnode(void* fdt, int parentoff, const char *name)
         endtag = (uint32_t*)((char *)nh + nodelen - FDT_TAGSIZE);
         *endtag = cpu_to_fdt32(FDT_END_NODE);
         err = offset;
+#ifdef WOLFBOOT_FDT_INDEX
+        if ((fdt_idx.fdt == fdt) && (fdt_index_insert_(
+                fdt_index_hash_(FDT_INDEX_NAME, name, namelen), offset) != 0)) {
+            fdt_index_drop_(fdt);
+        }
+#endif
     }
     return err;
 }
@@ -740,7 +1032,11 @@ int fdt_del_node(void *fdt, int nodeoffset)
 int fdt_shrink(void* fdt)
 {
     uint32_t total_size = fdt_data_size_(fdt);
-    return fdt_set_totalsize(fdt, total_size);
+    int ret = fdt_set_totalsize(fdt, total_size);
+#ifdef WOLFBOOT_FDT_INDEX
+    fdt_index_sync_(fdt);
+#endif
+    return ret;
 }
 
 /* FTD Fixup API's */
@@ -769,6 +1065,303 @@ int fdt_fixup_val64(void* fdt, int off, const char* node, const char* name,
 }
 
 
+/* Batched fixups
+ *
+ * Each fdt_setprop() that grows a property moves the whole tail of the blob.
+ * A batch queues the edits instead, with node offsets taken from the source
+ * DTB (they don't move while queuing), and fdt_batch_commit() writes the
+ * updated DTB to a new buffer in a single pass over the source.
+ *
+ * The result is the same as applying the edits in order with fdt_setprop():
+ * existing properties are replaced in place, new ones are added at the start
+ * of the node (last added first), and new names are appended to the strings
+ * block. When a property is set more than once, the last value wins.
+ * Names and values are copied into the batch, so the caller's buffers can be
+ * reused as soon as the edit is queued.
+ */
+static const char* fdt_batch_name_(const struct fdt_batch* batch, int i)
+{
+    return (const char*)batch->data + batch->edits[i].nameoff;
+}
+
+int fdt_batch_init(struct fdt_batch* batch, const void* fdt)
+{
+    batch->fdt = fdt;
+    batch->count = 0;
+    batch->data_len = 0;
+    return fdt_check_header(fdt);
+}
+
+int fdt_batch_setprop(struct fdt_batch* batch, int nodeoffset,
+    const char* name, const void* val, int len)
+{
+    struct fdt_batch_edit* edit;
+    int i, nameoff = -1, namelen = 0;
+
+    if (len < 0)
+        return -FDT_ERR_BADSTRUCTURE;
+    if (fdt_check_node_offset_(batch->fdt, nodeoffset) < 0)
+        return -FDT_ERR_BADOFFSET;
+    /* the name is copied too, unless an earlier edit already holds it */
+    for (i = 0; i < batch->count; i++) {
+        if (strcmp(fdt_batch_name_(batch, i), name) == 0) {
+            nameoff = batch->edits[i].nameoff;
+            break;
+        }
+    }
+    if (nameoff < 0)
+        namelen = (int)strlen(name) + 1;
+    if ((batch->count >= FDT_BATCH_MAX_EDITS) ||
+        (len > FDT_BATCH_DATA_SIZE - batch->data_len - namelen)) {
+        wolfBoot_printf("FDT: Batch full! (name %s, off %d)\n",
+            name, nodeoffset);
+        return -FDT_ERR_NOSPACE;
+    }
+    if (nameoff < 0) {
+        nameoff = batch->data_len;
+        memcpy(batch->data + batch->data_len, name, namelen);
+        batch->data_len += namelen;
+    }
+    edit = &batch->edits[batch->count++];
+    edit->nodeoff = nodeoffset;
+    edit->nameoff = nameoff;
+    edit->len = len;
+    edit->dataoff = batch->data_len;
+    if (len > 0)
+        memcpy(batch->data + batch->data_len, val, len);
+    batch->data_len += len;
+    return 0;
+}
+
+int fdt_batch_fixup_str(struct fdt_batch* batch, int off, const char* node,
+    const char* name, const char* str)
+{
+    wolfBoot_printf("FDT: Set %s (%d), %s=%s\n", node, off, name, str);
+    return fdt_batch_setprop(batch, off, name, str, strlen(str)+1);
+}
+
+int fdt_batch_fixup_val(struct fdt_batch* batch, int off, const char* node,
+    const char* name, uint32_t val)
+{
+    wolfBoot_printf("FDT: Set %s (%d), %s=%u\n", node, off, name, val);
+    val = cpu_to_fdt32(val);
+    return fdt_batch_setprop(batch, off, name, &val, sizeof(val));
+}
+
+int fdt_batch_fixup_val64(struct fdt_batch* batch, int off, const char* node,
+    const char* name, uint64_t val)
+{
+    wolfBoot_printf("FDT: Set %s (%d), %s=%llu\n",
+        node, off, name, (unsigned long long)val);
+    val = cpu_to_fdt64(val);
+    return fdt_batch_setprop(batch, off, name, &val, sizeof(val));
+}
+
+struct fdt_batch_out {
+    uint8_t* p;
+    uint8_t* end;
+};
+
+static int fdt_batch_emit_(struct fdt_batch_out* o, const void* src, int len)
+{
+    if (len > (int)(o->end - o->p))
+        return -FDT_ERR_NOSPACE;
+    memcpy(o->p, src, len);
+    o->p += len;
+    return 0;
+}
+
+static int fdt_batch_emit_prop_(struct fdt_batch_out* o,
+    const struct fdt_batch* batch, const struct fdt_batch_edit* edit,
+    int nameoff)
+{
+    struct fdt_property prop;
+    int pad = FDT_TAGALIGN(edit->len) - edit->len;
+
+    prop.tag = cpu_to_fdt32(FDT_PROP);
+    prop.len = cpu_to_fdt32(edit->len);
+    prop.nameoff = cpu_to_fdt32(nameoff);
+    if ((fdt_batch_emit_(o, &prop, sizeof(prop)) != 0) ||
+        (fdt_batch_emit_(o, batch->data + edit->dataoff, edit->len) != 0) ||
+        (pad > (int)(o->end - o->p))) {
+        return -FDT_ERR_NOSPACE;
+    }
+    memset(o->p, 0, pad);
+    o->p += pad;
+    return 0;
+}
+
+/* return: index of the last edit in idx[first..last-1] setting name, or -1 */
+static int fdt_batch_find_(const struct fdt_batch* batch, const uint16_t* idx,
+    int first, int last, const char* name)
+{
+    while (last-- > first) {
+        if (strcmp(fdt_batch_name_(batch, idx[last]), name) == 0)
+            return idx[last];
+    }
+    return -1;
+}
+
+int fdt_batch_commit(struct fdt_batch* batch, void* out, int outsz)
+{
+    const void* fdt = batch->fdt;
+    const char* strtab = (const char*)fdt + fdt_off_dt_strings(fdt);
+    int strsz = fdt_size_dt_strings(fdt);
+    int nameoff[FDT_BATCH_MAX_EDITS];
+    uint16_t idx[FDT_BATCH_MAX_EDITS];
+    uint8_t existing[FDT_BATCH_MAX_EDITS];
+    struct fdt_batch_out o;
+    const struct fdt_property* prop;
+    const char* name;
+    int i, j, k, first = 0, last = 0, err, newstrsz, off, nextoff, propoff;
+    int structoff, structsz;
+    uint32_t tag, ptag;
+
+    err = fdt_check_header(fdt);
+    if (err != 0)
+        return err;
+    if ((fdt_version(fdt) < 0x10) ||
+        (fdt_off_mem_rsvmap(fdt) > fdt_off_dt_struct(fdt)) ||
+        (fdt_off_dt_struct(fdt) > fdt_off_dt_strings(fdt))) {
+        return -FDT_ERR_BADSTRUCTURE;
+    }
+    if (((uint8_t*)out < (const uint8_t*)fdt + fdt_totalsize(fdt)) &&
+        ((const uint8_t*)fdt < (uint8_t*)out + outsz)) {
+        return -FDT_ERR_BADSTATE; /* buffers can't overlap */
+    }
+
+    /* sort the edits by node offset, keeping the queue order within a node */
+    for (i = 0; i < batch->count; i++) {
+        j = i;
+        while ((j > 0) &&
+            (batch->edits[idx[j-1]].nodeoff > batch->edits[i].nodeoff)) {
+            idx[j] = idx[j-1];
+            j--;
+        }
+        idx[j] = (uint16_t)i;
+    }
+
+    /* assign the name offsets in queue order, new names are appended */
+    newstrsz = strsz;
+    for (i = 0; i < batch->count; i++) {
+        name = fdt_find_string_(strtab, strsz, fdt_batch_name_(batch, i));
+        if (name != NULL) {
+            nameoff[i] = (int)(name - strtab);
+            continue;
+        }
+        nameoff[i] = -1;
+        for (j = 0; j < i; j++) {
+            if ((nameoff[j] >= strsz) &&
+                (batch->edits[j].nameoff == batch->edits[i].nameoff)) {
+                nameoff[i] = nameoff[j];
+                break;
+            }
+        }
+        if (nameoff[i] < 0) {
+            nameoff[i] = newstrsz;
+            newstrsz += (int)strlen(fdt_batch_name_(batch, i)) + 1;
+        }
+    }
+
+    /* header and memory reserve map are copied as they are */
+    structoff = fdt_off_dt_struct(fdt);
+    o.p = (uint8_t*)out;
+    o.end = (uint8_t*)out + outsz;
+    err = fdt_batch_emit_(&o, fdt, structoff);
+
+    /* structure block */
+    k = 0;
+    off = 0;
+    do {
+        tag = fdt_next_tag(fdt, off, &nextoff);
+        if (nextoff < 0) {
+            err = nextoff;
+            break;
+        }
+        if (tag == FDT_PROP) {
+            /* replace the property if it's set by an edit for this node */
+            prop = fdt_offset_ptr_(fdt, off);
+            i = fdt_batch_find_(batch, idx, first, last,
+                fdt_get_string(fdt, fdt32_to_cpu(prop->nameoff), NULL));
+            if (i >= 0) {
+                err = fdt_batch_emit_prop_(&o, batch, &batch->edits[i],
+                    fdt32_to_cpu(prop->nameoff));
+                off = nextoff;
+                continue;
+            }
+        }
+        err = fdt_batch_emit_(&o, fdt_offset_ptr_(fdt, off), nextoff - off);
+        if ((err == 0) && (tag == FDT_BEGIN_NODE)) {
+            /* select the edits for this node */
+            while ((k < batch->count) && (batch->edits[idx[k]].nodeoff < off))
+                k++;
+            first = k;
+            while ((k < batch->count) && (batch->edits[idx[k]].nodeoff == off))
+                k++;
+            last = k;
+
+            /* flag the edits of properties that already exist */
+            memset(existing, 0, sizeof(existing));
+            for (propoff = nextoff;
+                 (first < last) &&
+                 (((ptag = fdt_next_tag(fdt, propoff, &j)) == FDT_PROP) ||
+                    (ptag == FDT_NOP));
+                 propoff = j)
+            {
+                if (ptag == FDT_NOP)
+                    continue;
+                prop = fdt_offset_ptr_(fdt, propoff);
+                name = fdt_get_string(fdt, fdt32_to_cpu(prop->nameoff), NULL);
+                for (i = first; i < last; i++) {
+                    if (strcmp(fdt_batch_name_(batch, idx[i]), name) == 0)
+                        existing[i] = 1;
+                }
+            }
+
+            /* new properties go first, the last one added on top */
+            for (j = last - 1; (j >= first) && (err == 0); j--) {
+                name = fdt_batch_name_(batch, idx[j]);
+                if (existing[j] ||
+                    (fdt_batch_find_(batch, idx, first, j, name) >= 0)) {
+                    continue; /* already there, or added by an earlier edit */
+                }
+                i = fdt_batch_find_(batch, idx, j, last, name);
+                err = fdt_batch_emit_prop_(&o, batch, &batch->edits[i],
+                    nameoff[idx[j]]);
+            }
+        }
+        off = nextoff;
+    } while ((err == 0) && (tag != FDT_END));
+    if (err != 0)
+        return err;
+    structsz = (int)(o.p - (uint8_t*)out) - structoff;
+
+    /* strings block, followed by the new names */
+    err = fdt_batch_emit_(&o, strtab, strsz);
+    j = strsz;
+    for (i = 0; (i < batch->count) && (err == 0); i++) {
+        if (nameoff[i] == j) {
+            k = (int)strlen(fdt_batch_name_(batch, i)) + 1;
+            err = fdt_batch_emit_(&o, fdt_batch_name_(batch, i), k);
+            j += k;
+        }
+    }
+    if (err != 0)
+        return err;
+
+    fdt_set_totalsize(out, outsz);
+    fdt_set_off_dt_strings(out, structoff + structsz);
+    fdt_set_size_dt_struct(out, structsz);
+    fdt_set_size_dt_strings(out, newstrsz);
+#ifdef WOLFBOOT_FDT_INDEX
+    fdt_index_drop_(out);
+#endif
+    batch->count = 0;
+    batch->data_len = 0;
+    return 0;
+}
+
+
 /* FIT Specific */
 const char* fit_find_images(void* fdt, const char** pkernel, const char** pflat_dt)
 {
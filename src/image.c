@@ -1438,6 +1438,115 @@ int wolfBoot_open_image_external(struct wolfBoot_image* img, uint8_t part,
 
 #endif /* WOLFBOOT_FIXED_PARTITIONS */
 
+#if defined(WOLFBOOT_HASH_TREE) || defined(WOLFBOOT_VERIFY_CACHE)
+/* Start a plain hash, not preceded by a manifest header */
+#if defined(WOLFBOOT_HASH_SHA256)
+#define init_hash(ctx) wc_InitSha256(ctx)
+#elif defined(WOLFBOOT_HASH_SHA384)
+#define init_hash(ctx) wc_InitSha384(ctx)
+#elif defined(WOLFBOOT_HASH_SHA3_384)
+#define init_hash(ctx) wc_InitSha3_384(ctx, NULL, INVALID_DEVID)
+#endif
+#endif
+
+#ifdef WOLFBOOT_HASH_TREE
+/* Tree-hashed images (sign tool option --hash-tree): the firmware is split in
+ * chunks of the size stored in the HDR_HASH_TREE field, and the image digest
+ * is calculated over the manifest header followed by the digest of each
+ * chunk. Chunks are independent, so they are handed out to the secondary
+ * cores, one round of hal_smp_cores() chunks at a time.
+ */
+#ifndef WOLFBOOT_HASH_TREE_MAX_CORES
+#define WOLFBOOT_HASH_TREE_MAX_CORES 8
+#endif
+
+struct hash_tree_job {
+    struct wolfBoot_image *img;
+    uint32_t off;
+    uint32_t len;
+    uint8_t digest[WOLFBOOT_SHA_DIGEST_SIZE] XALIGNED(4);
+};
+
+/* Hash one chunk. Runs on any core: for images in memory-mapped flash
+ * get_sha_block() only returns a pointer, without touching shared state. */
+static void hash_tree_leaf(void *arg)
+{
+    struct hash_tree_job *job = (struct hash_tree_job *)arg;
+    wolfBoot_hash_t ctx;
+    uint32_t pos = 0;
+    uint32_t blksz;
+    uint8_t *p;
+
+    init_hash(&ctx);
+    while (pos < job->len) {
+        p = get_sha_block(job->img, job->off + pos);
+        if (p == NULL)
+            break;
+        blksz = WOLFBOOT_SHA_BLOCK_SIZE;
+        if (pos + blksz > job->len)
+            blksz = job->len - pos;
+        update_hash(&ctx, p, blksz);
+        pos += blksz;
+    }
+    final_hash(&ctx, job->digest);
+}
+
+/**
+ * @brief Calculate the digest of a tree-hashed image.
+ *
+ * @param img The image to calculate the hash for.
+ * @param chunk The chunk size, from the HDR_HASH_TREE field.
+ * @param hash A pointer to store the resulting digest.
+ * @return 0 on success, -1 on failure.
+ */
+static int image_hash_tree(struct wolfBoot_image *img, uint32_t chunk,
+    uint8_t *hash)
+{
+    static struct hash_tree_job jobs[WOLFBOOT_HASH_TREE_MAX_CORES];
+    int started[WOLFBOOT_HASH_TREE_MAX_CORES];
+    wolfBoot_hash_t ctx;
+    uint32_t position = 0;
+    int cores, n, i;
+
+    if ((chunk < WOLFBOOT_SHA_BLOCK_SIZE) || ((chunk & (chunk - 1)) != 0))
+        return -1;
+    if (header_hash(&ctx, img) != 0)
+        return -1;
+
+    cores = hal_smp_cores();
+    if (cores > WOLFBOOT_HASH_TREE_MAX_CORES)
+        cores = WOLFBOOT_HASH_TREE_MAX_CORES;
+    /* External flash reads go through a shared buffer */
+    if ((cores < 1) || PART_IS_EXT(img))
+        cores = 1;
+
+    while (position < img->fw_size) {
+        for (n = 0; (n < cores) && (position < img->fw_size); n++) {
+            jobs[n].img = img;
+            jobs[n].off = position;
+            jobs[n].len = chunk;
+            if (jobs[n].len > img->fw_size - position)
+                jobs[n].len = img->fw_size - position;
+            position += jobs[n].len;
+        }
+        for (i = 1; i < n; i++)
+            started[i] = (hal_smp_start(i, hash_tree_leaf, &jobs[i]) == 0);
+        hash_tree_leaf(&jobs[0]);
+        for (i = 1; i < n; i++) {
+            if (started[i])
+                hal_smp_wait(i);
+            else
+                hash_tree_leaf(&jobs[i]);
+        }
+        /* Combine in image order */
+        for (i = 0; i < n; i++)
+            update_hash(&ctx, jobs[i].digest, WOLFBOOT_SHA_DIGEST_SIZE);
+    }
+    final_hash(&ctx, hash);
+    return 0;
+}
+#endif /* WOLFBOOT_HASH_TREE */
+
 /**
  * @brief Verify the integrity of the image using the stored SHA hash.
  *
@@ -1451,9 +1560,19 @@ int wolfBoot_verify_integrity(struct wolfBoot_image *img)
 {
     uint8_t *stored_sha;
     uint16_t stored_sha_len;
+#ifdef WOLFBOOT_HASH_TREE
+    uint8_t *tree_chunk;
+#endif
     stored_sha_len = get_header(img, WOLFBOOT_SHA_HDR, &stored_sha);
     if (stored_sha_len != WOLFBOOT_SHA_DIGEST_SIZE)
         return -1;
+#ifdef WOLFBOOT_HASH_TREE
+    if (get_header(img, HDR_HASH_TREE, &tree_chunk) == sizeof(uint32_t)) {
+        if (image_hash_tree(img, im2n(*(uint32_t *)tree_chunk), digest) != 0)
+            return -1;
+    }
+    else
+#endif
     if (image_hash(img, digest) != 0)
         return -1;
     if (memcmp(digest, stored_sha, stored_sha_len) != 0)
@@ -1463,6 +1582,286 @@ int wolfBoot_verify_integrity(struct wolfBoot_image *img)
     return 0;
 }
 
+#ifdef WOLFBOOT_RAMBOOT_HASH_ON_LOAD
+/**
+ * @brief Start hashing an image incrementally.
+ *
+ * Initializes the hash context and feeds it the manifest header of the image.
+ * The caller is expected to feed the firmware to the context with
+ * update_hash() as it becomes available, e.g. while loading the image to RAM,
+ * and then call wolfBoot_verify_integrity_hash().
+ *
+ * @param img The image to hash. The header must be accessible.
+ * @param ctx The hash context to initialize.
+ * @return 0 on success, -1 on failure.
+ */
+int wolfBoot_image_hash_init(struct wolfBoot_image *img, wolfBoot_hash_t *ctx)
+{
+    return header_hash(ctx, img);
+}
+
+/**
+ * @brief Verify the integrity of an image hashed incrementally.
+ *
+ * Finalizes a context started with wolfBoot_image_hash_init() and compares
+ * the result with the digest stored in the manifest header. On success, the
+ * image is marked as verified, like wolfBoot_verify_integrity() does.
+ *
+ * @param img The image being verified.
+ * @param ctx The hash context, fed with the whole firmware.
+ * @return 0 on success, -1 on failure.
+ */
+int wolfBoot_verify_integrity_hash(struct wolfBoot_image *img,
+        wolfBoot_hash_t *ctx)
+{
+    uint8_t *stored_sha;
+    uint16_t stored_sha_len;
+#ifdef WOLFBOOT_HASH_TREE
+    uint8_t *tree_chunk;
+    /* The incremental digest does not apply to tree-hashed images: check
+     * the image that was just loaded instead */
+    if (get_header(img, HDR_HASH_TREE, &tree_chunk) == sizeof(uint32_t)) {
+        final_hash(ctx, digest);
+        return wolfBoot_verify_integrity(img);
+    }
+#endif
+    stored_sha_len = get_header(img, WOLFBOOT_SHA_HDR, &stored_sha);
+    if (stored_sha_len != WOLFBOOT_SHA_DIGEST_SIZE)
+        return -1;
+    final_hash(ctx, digest);
+    if (memcmp(digest, stored_sha, stored_sha_len) != 0)
+        return -1;
+    img->sha_ok = 1;
+    img->sha_hash = stored_sha;
+    return 0;
+}
+#endif /* WOLFBOOT_RAMBOOT_HASH_ON_LOAD */
+
+#ifdef WOLFBOOT_VERIFY_CACHE
+/* Boot verification cache.
+ *
+ * Once an image in IMG_STATE_SUCCESS has passed the full verification, a
+ * record is stored in the flash sector at WOLFBOOT_VERIFY_CACHE_ADDRESS. The
+ * record is a MAC, keyed with the device secret from hal_verify_cache_key(),
+ * over:
+ *  - the partition, its state and the image position and size
+ *  - the whole manifest header, which includes the image digest
+ *  - the public keys in the keystore
+ *  - WOLFBOOT_VERIFY_CACHE_SAMPLES blocks of the firmware, at offsets derived
+ *    from the device secret
+ * On the following boots, the image is accepted if the MAC still matches,
+ * without hashing the whole firmware and verifying the signature again.
+ * Updates erase the record, and the next state change (e.g. TESTING)
+ * invalidates it.
+ */
+#ifndef WOLFBOOT_FIXED_PARTITIONS
+#error WOLFBOOT_VERIFY_CACHE requires WOLFBOOT_FIXED_PARTITIONS
+#endif
+#ifndef WOLFBOOT_VERIFY_CACHE_ADDRESS
+#error WOLFBOOT_VERIFY_CACHE requires WOLFBOOT_VERIFY_CACHE_ADDRESS
+#endif
+#ifndef WOLFBOOT_VERIFY_CACHE_SAMPLES
+#define WOLFBOOT_VERIFY_CACHE_SAMPLES 8
+#endif
+#ifndef WOLFBOOT_VERIFY_CACHE_SAMPLE_SIZE
+#define WOLFBOOT_VERIFY_CACHE_SAMPLE_SIZE 1024
+#endif
+
+/* HMAC block size of the image hash */
+#if defined(WOLFBOOT_HASH_SHA256)
+#define VERIFY_CACHE_MAC_BLOCK 64
+#elif defined(WOLFBOOT_HASH_SHA384)
+#define VERIFY_CACHE_MAC_BLOCK 128
+#elif defined(WOLFBOOT_HASH_SHA3_384)
+#define VERIFY_CACHE_MAC_BLOCK 104
+#endif
+
+#define VERIFY_CACHE_MAGIC 0x43564257UL /* "WBVC" */
+
+struct verify_cache_record {
+    uint32_t magic;
+    uint32_t reserved;
+    uint8_t mac[WOLFBOOT_SHA_DIGEST_SIZE];
+};
+
+static uint8_t verify_cache_key[WOLFBOOT_SHA_DIGEST_SIZE] XALIGNED(4);
+
+/* HMAC: start the inner (0x36) or the outer (0x5C) hash */
+static void verify_cache_mac_init(wolfBoot_hash_t *ctx, uint8_t pad_byte)
+{
+    uint8_t pad[VERIFY_CACHE_MAC_BLOCK];
+    int i;
+
+    memset(pad, pad_byte, sizeof(pad));
+    for (i = 0; i < WOLFBOOT_SHA_DIGEST_SIZE; i++)
+        pad[i] ^= verify_cache_key[i];
+    init_hash(ctx);
+    update_hash(ctx, pad, sizeof(pad));
+    memset(pad, 0, sizeof(pad));
+}
+
+static void verify_cache_mac_final(wolfBoot_hash_t *ctx, uint8_t *mac)
+{
+    uint8_t inner[WOLFBOOT_SHA_DIGEST_SIZE];
+
+    final_hash(ctx, inner);
+    verify_cache_mac_init(ctx, 0x5C);
+    update_hash(ctx, inner, sizeof(inner));
+    final_hash(ctx, mac);
+}
+
+static void verify_cache_hash_fw(wolfBoot_hash_t *ctx,
+    struct wolfBoot_image *img, uint32_t off, uint32_t len)
+{
+    uint32_t blksz;
+    uint8_t *p;
+
+    while (len > 0) {
+        p = get_sha_block(img, off);
+        if (p == NULL)
+            break;
+        blksz = WOLFBOOT_SHA_BLOCK_SIZE;
+        if (blksz > len)
+            blksz = len;
+        update_hash(ctx, p, blksz);
+        off += blksz;
+        len -= blksz;
+    }
+}
+
+/**
+ * @brief Calculate the cache record MAC of an image.
+ *
+ * @param img The image, opened with wolfBoot_open_image().
+ * @param mac A pointer to store the resulting MAC.
+ * @return 0 on success, -1 if the image cannot be cached: no device secret,
+ * or partition state other than IMG_STATE_SUCCESS.
+ */
+static int verify_cache_mac(struct wolfBoot_image *img, uint8_t *mac)
+{
+    wolfBoot_hash_t ctx, pos_ctx;
+    uint8_t pos_mac[WOLFBOOT_SHA_DIGEST_SIZE];
+    uint32_t meta[4];
+    uint32_t blocks, off, len, i, sample;
+    uint8_t state;
+#ifndef WOLFBOOT_NO_SIGN
+    int key_slot;
+#endif
+
+    if ((img->fw_size == 0) ||
+            (wolfBoot_get_partition_state(img->part, &state) != 0) ||
+            (state != IMG_STATE_SUCCESS))
+        return -1;
+    if (hal_verify_cache_key(verify_cache_key,
+                sizeof(verify_cache_key)) != 0)
+        return -1;
+
+    verify_cache_mac_init(&ctx, 0x36);
+    meta[0] = img->part;
+    meta[1] = state;
+    meta[2] = (uint32_t)(uintptr_t)img->fw_base;
+    meta[3] = img->fw_size;
+    update_hash(&ctx, (uint8_t *)meta, sizeof(meta));
+    update_hash(&ctx, get_img_hdr(img), IMAGE_HEADER_SIZE);
+#ifndef WOLFBOOT_NO_SIGN
+    for (key_slot = 0; key_slot < keystore_num_pubkeys(); key_slot++) {
+        update_hash(&ctx, keystore_get_buffer(key_slot),
+                keystore_get_size(key_slot));
+    }
+#endif
+
+    /* Sampled blocks: the offset of block i is the MAC of the header and i */
+    blocks = (img->fw_size + WOLFBOOT_VERIFY_CACHE_SAMPLE_SIZE - 1) /
+        WOLFBOOT_VERIFY_CACHE_SAMPLE_SIZE;
+    for (i = 0; i < WOLFBOOT_VERIFY_CACHE_SAMPLES; i++) {
+        verify_cache_mac_init(&pos_ctx, 0x36);
+        update_hash(&pos_ctx, get_img_hdr(img), IMAGE_HEADER_SIZE);
+        update_hash(&pos_ctx, (uint8_t *)&i, sizeof(i));
+        verify_cache_mac_final(&pos_ctx, pos_mac);
+        memcpy(&sample, pos_mac, sizeof(sample)); /* may be unaligned */
+        off = (sample % blocks) * WOLFBOOT_VERIFY_CACHE_SAMPLE_SIZE;
+        len = WOLFBOOT_VERIFY_CACHE_SAMPLE_SIZE;
+        if (len > img->fw_size - off)
+            len = img->fw_size - off;
+        update_hash(&ctx, (uint8_t *)&off, sizeof(off));
+        verify_cache_hash_fw(&ctx, img, off, len);
+    }
+    verify_cache_mac_final(&ctx, mac);
+    memset(verify_cache_key, 0, sizeof(verify_cache_key));
+    return 0;
+}
+
+/**
+ * @brief Erase the boot verification cache record.
+ *
+ * Called before any change to the content of the partitions. The sector is
+ * only erased if it holds a record.
+ */
+void wolfBoot_verify_cache_invalidate(void)
+{
+    const struct verify_cache_record *rec =
+        (const struct verify_cache_record *)WOLFBOOT_VERIFY_CACHE_ADDRESS;
+
+    if (rec->magic != VERIFY_CACHE_MAGIC)
+        return;
+    hal_flash_unlock();
+    hal_flash_erase(WOLFBOOT_VERIFY_CACHE_ADDRESS, WOLFBOOT_SECTOR_SIZE);
+    hal_flash_lock();
+}
+
+/**
+ * @brief Verify an image, using the boot verification cache.
+ *
+ * If the record stored by a previous boot matches the image, the image is
+ * marked as verified (hash and signature) without hashing the whole
+ * firmware. Otherwise, the image goes through wolfBoot_verify_integrity()
+ * and wolfBoot_verify_authenticity(), and a new record is stored if both
+ * succeed and the image can be cached.
+ *
+ * @param img The image, opened with wolfBoot_open_image().
+ * @return 0 on success, negative value if the image is not valid.
+ */
+int wolfBoot_verify_cached(struct wolfBoot_image *img)
+{
+    const struct verify_cache_record *rec =
+        (const struct verify_cache_record *)WOLFBOOT_VERIFY_CACHE_ADDRESS;
+    struct verify_cache_record new_rec;
+    uint8_t *stored_sha;
+    uint8_t diff = 0;
+    int cacheable;
+    int i, ret;
+
+    if (get_header(img, WOLFBOOT_SHA_HDR, &stored_sha) !=
+            WOLFBOOT_SHA_DIGEST_SIZE)
+        return -1;
+    cacheable = (verify_cache_mac(img, new_rec.mac) == 0);
+    if (cacheable && (rec->magic == VERIFY_CACHE_MAGIC)) {
+        for (i = 0; i < WOLFBOOT_SHA_DIGEST_SIZE; i++)
+            diff |= rec->mac[i] ^ new_rec.mac[i];
+        if (diff == 0) {
+            img->sha_ok = 1;
+            img->sha_hash = stored_sha;
+            wolfBoot_image_confirm_signature_ok(img);
+            return 0;
+        }
+    }
+
+    ret = wolfBoot_verify_integrity(img);
+    if (ret == 0)
+        ret = wolfBoot_verify_authenticity(img);
+    if ((ret == 0) && cacheable) {
+        new_rec.magic = VERIFY_CACHE_MAGIC;
+        new_rec.reserved = 0;
+        hal_flash_unlock();
+        hal_flash_erase(WOLFBOOT_VERIFY_CACHE_ADDRESS, WOLFBOOT_SECTOR_SIZE);
+        hal_flash_write(WOLFBOOT_VERIFY_CACHE_ADDRESS, (uint8_t *)&new_rec,
+                sizeof(new_rec));
+        hal_flash_lock();
+    }
+    return ret;
+}
+#endif /* WOLFBOOT_VERIFY_CACHE */
+
 #ifdef WOLFBOOT_ELF_FLASH_SCATTER
 #include "elf.h"
 
@@ -1478,37 +1877,61 @@ typedef union {
     elf64_header elf64;
 } elfHeaderMaxBuf;
 
+static int update_hash_flash_addr(wolfBoot_hash_t* ctx, uintptr_t addr,
+                                  uint32_t size, int src_ext);
+
 /*
- * Copies an arbitrary amount of data between two flash memory locations
- * (internal or external) using an intermediate RAM buffer.
+ * Erases the flash sectors covering a destination range (internal or
+ * external). The range is extended to whole sectors.
  */
-static int copy_flash_buffered(uintptr_t src_addr, uintptr_t dst_addr,
-                               size_t total_size, int is_src_ext,
-                               int is_dst_ext)
+static int erase_flash_sectors(uintptr_t dst_addr, size_t size, int is_dst_ext)
 {
-    size_t  bytes_copied = 0;
-
-#ifndef BUFFER_DECLARED
-#define BUFFER_DECLARED
-    static uint8_t buffer[FLASHBUFFER_SIZE] XALIGNED(4);
-#endif
+    uintptr_t start = dst_addr & ~((uintptr_t)WOLFBOOT_SECTOR_SIZE - 1);
+    uintptr_t end = (dst_addr + size + WOLFBOOT_SECTOR_SIZE - 1) &
+                    ~((uintptr_t)WOLFBOOT_SECTOR_SIZE - 1);
+    int ret;
 
-#ifdef WOLFBOOT_FLASH_MULTI_SECTOR_ERASE
-/* Mass erase destination flash in one go before writing */
+    if (size == 0)
+        return 0;
 #ifdef EXT_FLASH
     if (is_dst_ext) {
         ext_flash_unlock();
-        ext_flash_erase(dst_addr, total_size);
+        ret = ext_flash_erase(start, (int)(end - start));
         ext_flash_lock();
     }
     else
 #endif
     {
+        (void)is_dst_ext;
         hal_flash_unlock();
-        hal_flash_erase(dst_addr, total_size);
+#ifdef WOLFBOOT_FLASH_MULTI_SECTOR_ERASE
+        ret = wolfBoot_flash_erase_range(start, (uint32_t)(end - start));
+#else
+        ret = hal_flash_erase(start, (int)(end - start));
+#endif
         hal_flash_lock();
     }
-#endif /* WOLFBOOT_FLASH_MULTI_SECTOR_ERASE */
+    return ret;
+}
+
+/*
+ * Copies an arbitrary amount of data between two flash memory locations
+ * (internal or external) using an intermediate RAM buffer. The destination
+ * must have been erased by the caller.
+ * If ctx is not NULL, each chunk is read back from the destination after
+ * being written, and fed to the hash.
+ */
+static int copy_flash_buffered(uintptr_t src_addr, uintptr_t dst_addr,
+                               size_t total_size, int is_src_ext,
+                               int is_dst_ext, wolfBoot_hash_t* ctx)
+{
+    size_t  bytes_copied = 0;
+    int     ret;
+
+#ifndef BUFFER_DECLARED
+#define BUFFER_DECLARED
+    static uint8_t buffer[FLASHBUFFER_SIZE] XALIGNED(4);
+#endif
 
     /* Loop until all requested bytes are copied */
     while (bytes_copied < total_size) {
@@ -1522,12 +1945,15 @@ static int copy_flash_buffered(uintptr_t src_addr, uintptr_t dst_addr,
 #ifdef EXT_FLASH
         if (is_src_ext) {
             ext_flash_unlock();
-            ext_flash_read(src_addr + bytes_copied, buffer, chunk_size);
+            ret = ext_flash_read(src_addr + bytes_copied, buffer, chunk_size);
             ext_flash_lock();
+            if (ret < 0)
+                return -1;
         }
         else
 #endif
         {
+            (void)is_src_ext;
             memcpy(buffer, (const void*)(src_addr + bytes_copied), chunk_size);
         }
 
@@ -1535,22 +1961,25 @@ static int copy_flash_buffered(uintptr_t src_addr, uintptr_t dst_addr,
 #ifdef EXT_FLASH
         if (is_dst_ext) {
             ext_flash_unlock();
-#ifndef WOLFBOOT_FLASH_MULTI_SECTOR_ERASE
-            ext_flash_erase(dst_addr + bytes_copied, chunk_size);
-#endif
-            ext_flash_write(dst_addr + bytes_copied, buffer, chunk_size);
+            ret = ext_flash_write(dst_addr + bytes_copied, buffer, chunk_size);
             ext_flash_lock();
         }
         else
 #endif
         {
             hal_flash_unlock();
-#ifndef WOLFBOOT_FLASH_MULTI_SECTOR_ERASE
-            hal_flash_erase(dst_addr + bytes_copied, chunk_size);
-#endif
-            hal_flash_write(dst_addr + bytes_copied, buffer, chunk_size);
+            ret = hal_flash_write(dst_addr + bytes_copied, buffer, chunk_size);
             hal_flash_lock();
         }
+        if (ret < 0)
+            return -1;
+
+        /* Hash what actually landed in the destination */
+        if ((ctx != NULL) &&
+            (update_hash_flash_addr(ctx, dst_addr + bytes_copied,
+                                    (uint32_t)chunk_size, is_dst_ext) != 0)) {
+            return -1;
+        }
 
         /* Update the count of bytes successfully copied */
         bytes_copied += chunk_size;
@@ -1911,27 +2340,90 @@ int wolfBoot_check_flash_image_elf(uint8_t part, unsigned long* entry_out)
     return 0;
 }
 
+/*
+ * Reads the program header at entry_off. Returns the size of the program
+ * header, or -1 if it cannot be read or the segment is not loadable.
+ */
+static int read_elf_load_segment(struct wolfBoot_image* boot, int is_elf32,
+                                 size_t entry_off, unsigned long* paddr,
+                                 unsigned long* offset, unsigned long* filesz)
+{
+    if (is_elf32) {
+        elf32_program_header p32;
+        if ((read_flash_fwimage(boot, entry_off, &p32, sizeof(p32)) != 0) ||
+            (p32.type != ELF_PT_LOAD)) {
+            return -1;
+        }
+        *paddr  = (unsigned long)p32.paddr;
+        *offset = (unsigned long)p32.offset;
+        *filesz = (unsigned long)p32.file_size;
+        return (int)sizeof(p32);
+    }
+    else {
+        elf64_program_header p64;
+        if ((read_flash_fwimage(boot, entry_off, &p64, sizeof(p64)) != 0) ||
+            (p64.type != ELF_PT_LOAD)) {
+            return -1;
+        }
+        *paddr  = (unsigned long)p64.paddr;
+        *offset = (unsigned long)p64.offset;
+        *filesz = (unsigned long)p64.file_size;
+        return (int)sizeof(p64);
+    }
+}
+
+/*
+ * Stores each loadable segment of the ELF image to its load address, hashing
+ * every chunk back from the destination right after it is written. Headers
+ * and padding are hashed in the same order as wolfBoot_check_flash_image_elf(),
+ * so the digest is verified in the same pass and no second walk over the
+ * scattered segments is needed.
+ *
+ * The sectors covering all the segments are erased before the first segment
+ * is written: a segment sharing a sector with a previous one must not erase
+ * data that was already hashed.
+ *
+ * Returns 0 if the image was loaded and the digest matches, -2 on digest
+ * mismatch, -1 on other errors.
+ */
 int wolfBoot_load_flash_image_elf(int part, unsigned long* entry_out, int ext_flash)
 {
     const unsigned char*  image;
     int                   is_elf32;
     uint16_t              entry_count;
     size_t                entry_off;
-    size_t                ph_size;
+    size_t                ph_start;
+    int                   ph_size;
+    size_t                elf_hdr_sz;
+    uint64_t              hashed_end;
+    uint32_t              len;
     int                   i;
     const void*           eh;
     struct wolfBoot_image boot;
     uint8_t               elfHdrBuf[sizeof(elfHeaderMaxBuf)];
+    uint8_t               calc_digest[WOLFBOOT_SHA_DIGEST_SIZE] XALIGNED_STACK(4);
+    uint8_t*              exp_digest;
+    wolfBoot_hash_t       ctx;
 
     if (wolfBoot_open_image(&boot, part) < 0) {
         return -1;
     }
     image = boot.fw_base;
 
+    /* Initialize hash, feed the manifest header to it */
+    if (header_hash(&ctx, &boot) < 0) {
+        return -1;
+    }
+    if (get_header(&boot, HDR_HASH, &exp_digest) != WOLFBOOT_SHA_DIGEST_SIZE) {
+        return -1;
+    }
+
     /* Get the elf header from the image into a local buffer. We may overread
      * the buffer depending on architecture */
     memset(elfHdrBuf, 0, sizeof(elfHdrBuf));
-    read_flash_fwimage(&boot, 0, elfHdrBuf, sizeof(elfHeaderMaxBuf));
+    if (read_flash_fwimage(&boot, 0, elfHdrBuf, sizeof(elfHeaderMaxBuf)) != 0) {
+        return -1;
+    }
     if (elf_open(elfHdrBuf, &is_elf32) != 0) {
         return -1;
     }
@@ -1960,34 +2452,49 @@ int wolfBoot_load_flash_image_elf(int part, unsigned long* entry_out, int ext_fl
                         (unsigned long)entry_off, entry_count);
     }
 
+    /* Erase the destination of every segment before writing any of them */
+    ph_start = entry_off;
+    for (i = 0; i < entry_count; ++i) {
+        unsigned long paddr, filesz, offset;
+
+        ph_size = read_elf_load_segment(&boot, is_elf32, entry_off, &paddr,
+                                        &offset, &filesz);
+        if (ph_size < 0) {
+            wolfBoot_printf("ELF: [STORE] ERROR: non-loadable segment\n");
+            return -1;
+        }
+        if (erase_flash_sectors((uintptr_t)(paddr + BASE_OFF), filesz,
+                                ext_flash) < 0) {
+            wolfBoot_printf("ELF: [STORE] ERROR: erase failed at 0x%08lx\n",
+                            (unsigned long)(paddr + BASE_OFF));
+            return -1;
+        }
+        entry_off += ph_size;
+    }
+
+    /* Hash the elf header and program header table */
+    elf_hdr_sz = (size_t)elf_hdr_pht_combined_size(elfHdrBuf);
+    if (update_hash_flash_fwimg(&ctx, &boot, 0, elf_hdr_sz) != 0) {
+        return -1;
+    }
+    hashed_end = elf_hdr_sz;
+
     /* Walk the program header table and store each loadable segment */
+    entry_off = ph_start;
     for (i = 0; i < entry_count; ++i) {
         unsigned long paddr, filesz, offset;
-        int           is_loadable;
         uintptr_t     load_addr;
 
-        /* Read the current program header into a local buffer */
-        if (is_elf32) {
-            elf32_program_header p32;
-            read_flash_fwimage(&boot, entry_off, &p32, sizeof(p32));
-            is_loadable = (p32.type == ELF_PT_LOAD);
-            paddr       = (unsigned long)p32.paddr;
-            offset      = (unsigned long)p32.offset;
-            filesz      = (unsigned long)p32.file_size;
-            ph_size     = sizeof(p32);
-        }
-        else {
-            elf64_program_header p64;
-            read_flash_fwimage(&boot, entry_off, &p64, sizeof(p64));
-            is_loadable = (p64.type == ELF_PT_LOAD);
-            paddr       = (unsigned long)p64.paddr;
-            offset      = (unsigned long)p64.offset;
-            filesz      = (unsigned long)p64.file_size;
-            ph_size     = sizeof(p64);
+        ph_size = read_elf_load_segment(&boot, is_elf32, entry_off, &paddr,
+                                        &offset, &filesz);
+        if (ph_size < 0) {
+            return -1;
         }
-        /* Skip non-loadable segments */
-        if (!is_loadable) {
-            wolfBoot_printf("ELF: [STORE] ERROR: non-loadable segment\n");
+
+        /* Hash the file content between the previous segment and this one */
+        if ((offset > hashed_end) &&
+            (update_hash_flash_fwimg(&ctx, &boot, (uint32_t)hashed_end,
+                                     (uint32_t)(offset - hashed_end)) != 0)) {
             return -1;
         }
 
@@ -1995,13 +2502,36 @@ int wolfBoot_load_flash_image_elf(int part, unsigned long* entry_out, int ext_fl
         wolfBoot_printf("ELF: [STORE] Writing loadable segment: "
                         "loadaddr=0x%08lx, offset=0x%08lx, size=%lu\n",
                         load_addr, offset, filesz);
-        copy_flash_buffered((uintptr_t)(image + offset), load_addr, filesz,
-                            ext_flash, ext_flash);
+        if (copy_flash_buffered((uintptr_t)(image + offset), load_addr, filesz,
+                                ext_flash, ext_flash, &ctx) != 0) {
+            wolfBoot_printf("ELF: [STORE] ERROR: could not store segment at "
+                            "0x%08lx\n", load_addr);
+            return -1;
+        }
 
+        hashed_end = offset + filesz;
         entry_off += ph_size;
     }
 
-    wolfBoot_printf("ELF: [STORE] Image loading complete\n");
+    /* Hash any trailing data after the last segment/header */
+    if (hashed_end > boot.fw_size) {
+        wolfBoot_printf("ELF: [STORE] Final offset (%d) exceeds image size "
+                        "(%d)\n", (int32_t)hashed_end, (int32_t)boot.fw_size);
+        return -1;
+    }
+    len = boot.fw_size - (uint32_t)hashed_end;
+    if ((len > 0) &&
+        (update_hash_flash_fwimg(&ctx, &boot, (uint32_t)hashed_end, len) != 0)) {
+        return -1;
+    }
+
+    final_hash(&ctx, calc_digest);
+    if (memcmp(calc_digest, exp_digest, WOLFBOOT_SHA_DIGEST_SIZE) != 0) {
+        wolfBoot_printf("ELF: [STORE] SHA verification FAILED\n");
+        return -2;
+    }
+
+    wolfBoot_printf("ELF: [STORE] Image loading complete, digest verified\n");
     return 0;
 }
 
@@ -2025,6 +2555,52 @@ int wolfBoot_verify_authenticity(struct wolfBoot_image *img)
     return 0;
 }
 #else
+
+#if defined(SIGN_HYBRID) && defined(WOLFBOOT_HYBRID_PARALLEL_VERIFY)
+/* The secondary signature of hybrid images is verified on core 1 while the
+ * boot core verifies the primary one. The job works on a private copy of the
+ * image, so the two verifications never write the same signature_ok flags.
+ */
+struct hybrid_verify_job {
+    struct wolfBoot_image img;
+    int key_slot;
+    uint8_t *sig;
+};
+
+static void hybrid_verify_secondary(void *arg)
+{
+    struct hybrid_verify_job *job = (struct hybrid_verify_job *)arg;
+    wolfBoot_verify_signature_secondary(job->key_slot, &job->img, job->sig);
+}
+#endif
+
+#ifdef WOLFBOOT_VERIFY_BENCHMARK
+/**
+ * @brief Time the verification of the primary signature of an image.
+ *
+ * The verification is repeated WOLFBOOT_VERIFY_BENCHMARK times, and the
+ * average time is printed. The result of these runs is discarded: the
+ * signature_ok flag is cleared afterwards, so the image still has to pass the
+ * regular verification.
+ */
+static void verify_benchmark(int key_slot, struct wolfBoot_image *img,
+        uint8_t *sig)
+{
+    uint64_t start, elapsed;
+    int i;
+
+    start = hal_timer_us();
+    for (i = 0; i < WOLFBOOT_VERIFY_BENCHMARK; i++) {
+        wolfBoot_verify_signature_primary(key_slot, img, sig);
+    }
+    elapsed = hal_timer_us() - start;
+    wolfBoot_image_clear_signature_ok(img);
+    wolfBoot_printf("Verify benchmark: %d runs, %lu us/verify\n",
+            WOLFBOOT_VERIFY_BENCHMARK,
+            (unsigned long)(elapsed / WOLFBOOT_VERIFY_BENCHMARK));
+}
+#endif
+
 int wolfBoot_verify_authenticity(struct wolfBoot_image *img)
 {
     uint8_t *stored_signature;
@@ -2170,6 +2746,56 @@ int wolfBoot_verify_authenticity(struct wolfBoot_image *img)
      * img->signature_ok to 1.
      *
      */
+#ifdef WOLFBOOT_VERIFY_BENCHMARK
+    verify_benchmark(key_slot, img, stored_signature);
+#endif
+#if defined(SIGN_HYBRID) && defined(WOLFBOOT_HYBRID_PARALLEL_VERIFY)
+    {
+        static struct hybrid_verify_job job;
+        int secondary_started;
+
+        /* Look up the secondary key first, then verify both signatures
+         * at the same time */
+        pubkey_hint_size = get_header(img, HDR_SECONDARY_PUBKEY, &pubkey_hint);
+        if (pubkey_hint_size != WOLFBOOT_SHA_DIGEST_SIZE)
+            return -2;
+        job.key_slot = keyslot_id_by_sha(pubkey_hint);
+        if (job.key_slot < 0) {
+            return -1; /* Key was not found */
+        }
+        key_mask = keystore_get_mask(job.key_slot);
+        if (((1U << image_part) & key_mask) != (1U << image_part)) {
+            return -1; /* Key not allowed to verify this partition id */
+        }
+        CONFIRM_MASK_VALID(image_part, key_mask);
+        (void)get_header(img, HDR_SECONDARY_SIGNATURE, &job.sig);
+        memcpy(&job.img, img, sizeof(job.img));
+        wolfBoot_image_clear_signature_ok(&job.img);
+
+        wolfBoot_printf("Verification of hybrid signature\n");
+        secondary_started =
+            (hal_smp_start(1, hybrid_verify_secondary, &job) == 0);
+        wolfBoot_verify_signature_primary(key_slot, img, stored_signature);
+        if (secondary_started)
+            hal_smp_wait(1);
+        else
+            hybrid_verify_secondary(&job);
+        wolfBoot_printf("Done.\n");
+        (void)stored_signature_size;
+
+        /* Both must pass: the flag set by the primary verification is only
+         * kept if the secondary verification has set its own */
+        if (img->signature_ok == 1) {
+            wolfBoot_image_clear_signature_ok(img);
+            if (job.img.signature_ok == 1)
+                wolfBoot_image_confirm_signature_ok(img);
+        }
+        wolfBoot_image_clear_signature_ok(&job.img);
+    }
+    if (img->signature_ok == 1)
+        return 0;
+    return -2;
+#else
     wolfBoot_verify_signature_primary(key_slot, img, stored_signature);
     (void)stored_signature_size;
     if (img->signature_ok == 1)
@@ -2203,6 +2829,7 @@ int wolfBoot_verify_authenticity(struct wolfBoot_image *img)
 #endif
         return 0;
     return -2;
+#endif /* SIGN_HYBRID && WOLFBOOT_HYBRID_PARALLEL_VERIFY */
 }
 #endif
 
@@ -297,16 +297,19 @@ finish:
 }
 
 /**
- * @brief Write the trailer in a non-volatile memory.
+ * @brief Write a range of the trailer in a non-volatile memory.
  *
- * This function writes the trailer in a non-volatile memory.
+ * This function writes consecutive bytes of the trailer in a non-volatile
+ * memory, with a single rewrite of the trailer sector.
  *
  * @param[in] part Partition number.
- * @param[in] addr Address of the trailer.
- * @param[in] val New value to write in the trailer.
+ * @param[in] addr Address of the first byte in the trailer.
+ * @param[in] val New values to write in the trailer.
+ * @param[in] len Number of bytes, all in the same trailer sector.
  * @return 0 on success, -1 on failure.
  */
-static int RAMFUNCTION trailer_write(uint8_t part, uintptr_t addr, uint8_t val)
+static int RAMFUNCTION trailer_write_range(uint8_t part, uintptr_t addr,
+    const uint8_t *val, uint32_t len)
 {
     uintptr_t addr_align = (size_t)(addr & (~(NVM_CACHE_SIZE - 1)));
     uintptr_t addr_read, addr_write;
@@ -316,7 +319,7 @@ static int RAMFUNCTION trailer_write(uint8_t part, uintptr_t addr, uint8_t val)
     nvm_cached_sector = nvm_select_fresh_sector(part);
     addr_read = addr_align - (nvm_cached_sector * NVM_CACHE_SIZE);
     XMEMCPY(NVM_CACHE, (void*)addr_read, NVM_CACHE_SIZE);
-    NVM_CACHE[addr_off] = val;
+    XMEMCPY(NVM_CACHE + addr_off, val, len);
 
     /* Calculate write address */
     addr_write = addr_align - ((!nvm_cached_sector) * NVM_CACHE_SIZE);
@@ -340,6 +343,8 @@ static int RAMFUNCTION trailer_write(uint8_t part, uintptr_t addr, uint8_t val)
     return ret;
 }
 
+#define trailer_write(part, addr, val) trailer_write_range(part, addr, &(val), 1)
+
 /**
  * @brief Write the partition magic in a non-volatile memory.
  *
@@ -369,6 +374,8 @@ static int RAMFUNCTION partition_magic_write(uint8_t part, uintptr_t addr)
 
 #else
 #   define trailer_write(part,addr, val) hal_flash_write(addr, (void *)&val, 1)
+#   define trailer_write_range(part, addr, val, len) \
+                                hal_flash_write(addr, val, len)
 #   define partition_magic_write(part,addr) hal_flash_write(addr, \
                                 (void*)&wolfboot_magic_trail, sizeof(uint32_t));
 #endif /* NVM_FLASH_WRITEONCE */
@@ -596,6 +603,40 @@ static uint8_t* RAMFUNCTION get_update_sector_flags(uint32_t pos)
     return (uint8_t *)get_trailer_at(PART_UPDATE, 2 + pos);
 }
 
+#if WOLFBOOT_SWAP_SECTORS > 1
+/**
+ * @brief Set the flags of consecutive update sector positions.
+ *
+ * The flags are stored backwards from the end of the partition, so the
+ * first value is written at position pos, the next one at pos - 1, etc.
+ * On internal flash the whole range is written at once.
+ *
+ * @param[in] pos Highest update sector position.
+ * @param[in] val New flags values to set.
+ * @param[in] len Number of positions.
+ */
+static void RAMFUNCTION set_update_sector_flags_range(uint32_t pos,
+    const uint8_t *val, uint32_t len)
+{
+#if !defined(CUSTOM_PARTITION_TRAILER) && !defined(MOCK_PARTITION_TRAILER)
+#ifdef EXT_FLASH
+    if (!FLAGS_UPDATE_EXT())
+#endif
+    {
+        trailer_write_range(PART_UPDATE, PART_UPDATE_ENDFLAGS -
+            (sizeof(uint32_t) + 2 + pos), val, len);
+        return;
+    }
+#endif
+    while (len > 0) {
+        set_update_sector_flags(pos, *val);
+        pos--;
+        val++;
+        len--;
+    }
+}
+#endif /* WOLFBOOT_SWAP_SECTORS > 1 */
+
 /**
  * @brief Set the state of a partition.
  *
@@ -651,6 +692,63 @@ int RAMFUNCTION wolfBoot_set_update_sector_flag(uint16_t sector,
     return 0;
 }
 
+#if WOLFBOOT_SWAP_SECTORS > 1
+#ifndef SECTOR_FLAGS_BATCH_SIZE
+#define SECTOR_FLAGS_BATCH_SIZE 16 /* bytes, two sectors each */
+#endif
+
+/**
+ * @brief Set the flag for a range of sectors
+ *
+ * Same as wolfBoot_set_update_sector_flag() for the sectors
+ * [first, first + count), but the flags are written in batches of
+ * SECTOR_FLAGS_BATCH_SIZE bytes: with NVM_FLASH_WRITEONCE each batch costs
+ * a single rewrite of the trailer sector instead of one per sector.
+ *
+ * @param[in] first First sector number.
+ * @param[in] count Number of sectors.
+ * @param[in] newflag Nibble (4-bits) for sector flag
+ * @return 0 on success, -1 on failure.
+ */
+int RAMFUNCTION wolfBoot_set_update_sector_flags(uint16_t first,
+    uint16_t count, uint8_t newflag)
+{
+    uint32_t *magic;
+    uint8_t *flags;
+    uint8_t buf[SECTOR_FLAGS_BATCH_SIZE];
+    uint32_t last = (uint32_t)first + count - 1;
+    uint32_t pos, hi, i, n;
+    int changed;
+
+    if (count == 0)
+        return 0;
+    magic = get_partition_magic(PART_UPDATE);
+    if (*magic != wolfboot_magic_trail)
+        set_partition_magic(PART_UPDATE);
+
+    for (pos = first >> 1; pos <= (last >> 1); pos += n) {
+        n = (last >> 1) - pos + 1;
+        if (n > SECTOR_FLAGS_BATCH_SIZE)
+            n = SECTOR_FLAGS_BATCH_SIZE;
+        hi = pos + n - 1;
+        changed = 0;
+        for (i = 0; i < n; i++) {
+            flags = get_update_sector_flags(hi - i);
+            buf[i] = *flags;
+            if (((hi - i) << 1) >= first)
+                buf[i] = (buf[i] & 0xF0) | (newflag & 0x0F);
+            if ((((hi - i) << 1) + 1) <= last)
+                buf[i] = ((newflag & 0x0F) << 4) | (buf[i] & 0x0F);
+            if (buf[i] != *flags)
+                changed = 1;
+        }
+        if (changed)
+            set_update_sector_flags_range(hi, buf, n);
+    }
+    return 0;
+}
+#endif /* WOLFBOOT_SWAP_SECTORS > 1 */
+
 /**
  * @brief Get the state of a partition.
  *
@@ -702,6 +800,110 @@ int wolfBoot_get_update_sector_flag(uint16_t sector, uint8_t *flag)
     return 0;
 }
 
+#ifdef WOLFBOOT_FLASH_BLANK_CHECK
+/* Default blank check: compare the content with the erased value, one word
+ * at a time. With NVM_FLASH_WRITEONCE a word programmed with the erased value
+ * reads blank but can't be programmed again: the state is unknown, and the
+ * sector is always erased unless the port provides its own check. */
+int WEAKFUNCTION hal_flash_is_erased(haladdr_t address, int len)
+{
+#ifdef NVM_FLASH_WRITEONCE
+    (void)address;
+    (void)len;
+    return -1;
+#else
+    const volatile uint32_t *word =
+        (const volatile uint32_t *)(uintptr_t)address;
+    int i;
+
+    for (i = 0; i < len / (int)sizeof(uint32_t); i++) {
+        if (word[i] != FLASH_WORD_ERASED)
+            return 0;
+    }
+    return 1;
+#endif
+}
+
+static int flash_sector_is_erased(int ext, haladdr_t address)
+{
+#ifdef EXT_FLASH
+    uint32_t buf[16];
+    uint32_t pos;
+    int i;
+
+    if (ext) {
+        for (pos = 0; pos < WOLFBOOT_SECTOR_SIZE; pos += sizeof(buf)) {
+            if (ext_flash_read(address + pos, (uint8_t *)buf, sizeof(buf)) < 0)
+                return -1;
+            for (i = 0; i < (int)(sizeof(buf) / sizeof(uint32_t)); i++) {
+                if (buf[i] != FLASH_WORD_ERASED)
+                    return 0;
+            }
+        }
+        return 1;
+    }
+#else
+    (void)ext;
+#endif
+    return hal_flash_is_erased(address, WOLFBOOT_SECTOR_SIZE);
+}
+
+static int RAMFUNCTION flash_erase_run(int ext, haladdr_t address,
+    uint32_t len)
+{
+#ifdef EXT_FLASH
+    if (ext)
+        return ext_flash_erase(address, len);
+#endif
+#if defined(WOLFBOOT_FLASH_MULTI_SECTOR_ERASE) && defined(__WOLFBOOT)
+    return wolfBoot_flash_erase_range(address, len);
+#else
+    return hal_flash_erase(address, len);
+#endif
+}
+
+/**
+ * @brief Erase the sectors of a range that are not blank.
+ *
+ * Nothing was written after the last sector that is not blank (the
+ * high-water mark of the range): the blank space after it is skipped
+ * altogether. Below it, each run of sectors that are not blank is erased
+ * with one call.
+ *
+ * @param[in] ext Non-zero if the range is in external flash.
+ * @param[in] address Start of the range, aligned to WOLFBOOT_SECTOR_SIZE.
+ * @param[in] len Length of the range, multiple of WOLFBOOT_SECTOR_SIZE.
+ * @return 0 on success, the error of the first failed erase otherwise.
+ */
+int RAMFUNCTION wolfBoot_flash_erase_written(int ext, haladdr_t address,
+    uint32_t len)
+{
+    uint32_t hwm = len;
+    uint32_t start, end = 0;
+    int ret = 0;
+
+    while ((hwm > 0) && (flash_sector_is_erased(ext,
+            address + hwm - WOLFBOOT_SECTOR_SIZE) == 1)) {
+        hwm -= WOLFBOOT_SECTOR_SIZE;
+    }
+    while ((end < hwm) && (ret == 0)) {
+        start = end;
+        while ((start < hwm) && (flash_sector_is_erased(ext,
+                address + start) == 1)) {
+            start += WOLFBOOT_SECTOR_SIZE;
+        }
+        end = start;
+        while ((end < hwm) && (flash_sector_is_erased(ext,
+                address + end) != 1)) {
+            end += WOLFBOOT_SECTOR_SIZE;
+        }
+        if (end > start)
+            ret = flash_erase_run(ext, address + start, end - start);
+    }
+    return ret;
+}
+#endif /* WOLFBOOT_FLASH_BLANK_CHECK */
+
 /**
  * @brief Erase a partition.
  *
@@ -725,20 +927,35 @@ void RAMFUNCTION wolfBoot_erase_partition(uint8_t part)
             break;
         case PART_SWAP:
             address = (uint32_t)WOLFBOOT_PARTITION_SWAP_ADDRESS;
-            size = WOLFBOOT_SECTOR_SIZE;
+            size = WOLFBOOT_SECTOR_SIZE * WOLFBOOT_SWAP_SECTORS;
             break;
         default:
             break;
     }
 
     if (size > 0) {
+#ifdef WOLFBOOT_FLASH_BLANK_CHECK
+        /* Sectors that are blank already are not erased again */
+        if (PARTN_IS_EXT(part)) {
+            ext_flash_unlock();
+            wolfBoot_flash_erase_written(1, address, size);
+            ext_flash_lock();
+        } else {
+            wolfBoot_flash_erase_written(0, address, size);
+        }
+#else
         if (PARTN_IS_EXT(part)) {
             ext_flash_unlock();
             ext_flash_erase(address, size);
             ext_flash_lock();
         } else {
+#if defined(WOLFBOOT_FLASH_MULTI_SECTOR_ERASE) && defined(__WOLFBOOT)
+            wolfBoot_flash_erase_range(address, size);
+#else
             hal_flash_erase(address, size);
+#endif
         }
+#endif /* WOLFBOOT_FLASH_BLANK_CHECK */
     }
 }
 
@@ -1999,3 +2216,372 @@ int wolfBoot_ram_decrypt(uint8_t *src, uint8_t *dst)
 }
 #endif /* MMU */
 #endif /* EXT_ENCRYPTED */
+
+#if defined(WOLFBOOT_UPDATE_WRITER) && defined(WOLFBOOT_FIXED_PARTITIONS) && \
+    !defined(__WOLFBOOT)
+#include <string.h>
+
+/* Streaming update writer.
+ *
+ * The image is received in chunks of any size and stored in the UPDATE
+ * partition, while its digest is calculated the same way wolfBoot does at
+ * boot. Flash sectors are erased the first time they are touched, and writes
+ * are grouped in blocks of WOLFBOOT_UPDATE_WRITER_BUF_SIZE bytes.
+ */
+#ifndef WOLFBOOT_UPDATE_WRITER_BUF_SIZE
+    #if WOLFBOOT_SECTOR_SIZE > 4096
+        #define WOLFBOOT_UPDATE_WRITER_BUF_SIZE 4096
+    #else
+        #define WOLFBOOT_UPDATE_WRITER_BUF_SIZE WOLFBOOT_SECTOR_SIZE
+    #endif
+#endif
+/* Sectors are erased when a block starts at their first byte */
+#if (WOLFBOOT_SECTOR_SIZE % WOLFBOOT_UPDATE_WRITER_BUF_SIZE) != 0
+    #error "WOLFBOOT_UPDATE_WRITER_BUF_SIZE must divide WOLFBOOT_SECTOR_SIZE"
+#endif
+
+/* Space available for the image: the sector(s) holding the partition flags
+ * are erased by wolfBoot_update_trigger() */
+#ifdef FLAGS_HOME
+    #define UPDATE_WRITER_MAX_SIZE WOLFBOOT_PARTITION_SIZE
+#elif defined(NVM_FLASH_WRITEONCE)
+    #define UPDATE_WRITER_MAX_SIZE \
+        (WOLFBOOT_PARTITION_SIZE - 2 * WOLFBOOT_SECTOR_SIZE)
+#else
+    #define UPDATE_WRITER_MAX_SIZE \
+        (WOLFBOOT_PARTITION_SIZE - WOLFBOOT_SECTOR_SIZE)
+#endif
+
+#if defined(WOLFBOOT_HASH_SHA256)
+    #define update_writer_init_hash(ctx) wc_InitSha256(ctx)
+#elif defined(WOLFBOOT_HASH_SHA384)
+    #define update_writer_init_hash(ctx) wc_InitSha384(ctx)
+#elif defined(WOLFBOOT_HASH_SHA3_384)
+    #define update_writer_init_hash(ctx) wc_InitSha3_384(ctx, NULL, INVALID_DEVID)
+#endif
+
+#define UPDATE_WRITER_IDLE   0
+#define UPDATE_WRITER_OPEN   1
+#define UPDATE_WRITER_DONE   2
+#define UPDATE_WRITER_FAILED 3
+
+static struct {
+    int state;
+    uint32_t pos;       /* Bytes received so far */
+    uint32_t img_size;  /* Header + firmware, 0 until the header is parsed */
+    uint32_t flash_off; /* Partition offset of update_writer_buf */
+    uint32_t buf_len;
+    wolfBoot_hash_t ctx;
+#ifdef WOLFBOOT_HASH_TREE
+    wolfBoot_hash_t leaf;
+    uint32_t tree_chunk; /* 0: flat hash */
+#endif
+    uint8_t digest[WOLFBOOT_SHA_DIGEST_SIZE];
+} update_writer;
+static uint8_t update_writer_hdr[IMAGE_HEADER_SIZE] XALIGNED(4);
+static uint8_t update_writer_buf[WOLFBOOT_UPDATE_WRITER_BUF_SIZE] XALIGNED(4);
+
+/* Write the buffered block, erasing the sector first when the block is the
+ * first one in its sector. The tail of the last block is padded with 0xFF. */
+static int update_writer_flush(void)
+{
+    uintptr_t address = (uintptr_t)WOLFBOOT_PARTITION_UPDATE_ADDRESS +
+        update_writer.flash_off;
+    int erase = ((update_writer.flash_off % WOLFBOOT_SECTOR_SIZE) == 0);
+    int ret = 0;
+
+    if (update_writer.buf_len == 0)
+        return 0;
+    if (update_writer.buf_len < WOLFBOOT_UPDATE_WRITER_BUF_SIZE) {
+        XMEMSET(update_writer_buf + update_writer.buf_len, 0xFF,
+            WOLFBOOT_UPDATE_WRITER_BUF_SIZE - update_writer.buf_len);
+    }
+#ifdef EXT_FLASH
+    if (PARTN_IS_EXT(PART_UPDATE)) {
+        ext_flash_unlock();
+        if (erase)
+            ret = ext_flash_erase(address, WOLFBOOT_SECTOR_SIZE);
+        if (ret == 0) {
+            ret = ext_flash_check_write(address, update_writer_buf,
+                WOLFBOOT_UPDATE_WRITER_BUF_SIZE);
+        }
+        ext_flash_lock();
+    } else
+#endif
+    {
+        hal_flash_unlock();
+        if (erase)
+            ret = hal_flash_erase(address, WOLFBOOT_SECTOR_SIZE);
+        if (ret == 0) {
+            ret = hal_flash_write(address, update_writer_buf,
+                WOLFBOOT_UPDATE_WRITER_BUF_SIZE);
+        }
+        hal_flash_lock();
+    }
+    update_writer.flash_off += WOLFBOOT_UPDATE_WRITER_BUF_SIZE;
+    update_writer.buf_len = 0;
+    return (ret < 0) ? -1 : 0;
+}
+
+/* Called once the whole manifest header has been received: check it and
+ * start the digest with the header fields preceding the stored hash. */
+static int update_writer_parse_header(void)
+{
+    uint8_t *stored_sha;
+    uint32_t fw_size;
+#ifdef WOLFBOOT_HASH_TREE
+    uint8_t *tree_chunk;
+#endif
+
+    if (*((uint32_t *)update_writer_hdr) != WOLFBOOT_MAGIC)
+        return -1;
+    fw_size = im2n(*((uint32_t *)(update_writer_hdr + sizeof(uint32_t))));
+    if ((fw_size == 0) ||
+            (fw_size > UPDATE_WRITER_MAX_SIZE - IMAGE_HEADER_SIZE))
+        return -1;
+    if (wolfBoot_find_header(update_writer_hdr + IMAGE_HEADER_OFFSET,
+            WOLFBOOT_SHA_HDR, &stored_sha) != WOLFBOOT_SHA_DIGEST_SIZE)
+        return -1;
+    update_writer.img_size = IMAGE_HEADER_SIZE + fw_size;
+
+    update_writer_init_hash(&update_writer.ctx);
+    update_hash(&update_writer.ctx, update_writer_hdr,
+        (stored_sha - (2 * sizeof(uint16_t))) - update_writer_hdr);
+#ifdef WOLFBOOT_HASH_TREE
+    update_writer.tree_chunk = 0;
+    if (wolfBoot_find_header(update_writer_hdr + IMAGE_HEADER_OFFSET,
+            HDR_HASH_TREE, &tree_chunk) == sizeof(uint32_t)) {
+        update_writer.tree_chunk = im2n(*((uint32_t *)tree_chunk));
+        if ((update_writer.tree_chunk < WOLFBOOT_SHA_BLOCK_SIZE) ||
+                ((update_writer.tree_chunk &
+                  (update_writer.tree_chunk - 1)) != 0))
+            return -1;
+        update_writer_init_hash(&update_writer.leaf);
+    }
+#endif
+    return 0;
+}
+
+/* Feed firmware bytes (after the header) to the digest */
+static void update_writer_hash(const uint8_t *data, uint32_t len)
+{
+#ifdef WOLFBOOT_HASH_TREE
+    uint32_t off, n;
+    uint8_t leaf_digest[WOLFBOOT_SHA_DIGEST_SIZE];
+
+    if (update_writer.tree_chunk != 0) {
+        while (len > 0) {
+            off = (update_writer.pos - IMAGE_HEADER_SIZE) %
+                update_writer.tree_chunk;
+            n = update_writer.tree_chunk - off;
+            if (n > len)
+                n = len;
+            update_hash(&update_writer.leaf, data, n);
+            update_writer.pos += n;
+            data += n;
+            len -= n;
+            if ((off + n == update_writer.tree_chunk) ||
+                    (update_writer.pos == update_writer.img_size)) {
+                final_hash(&update_writer.leaf, leaf_digest);
+                update_hash(&update_writer.ctx, leaf_digest,
+                    WOLFBOOT_SHA_DIGEST_SIZE);
+                update_writer_init_hash(&update_writer.leaf);
+            }
+        }
+        return;
+    }
+#endif
+    update_hash(&update_writer.ctx, data, len);
+    update_writer.pos += len;
+}
+
+/**
+ * @brief Start streaming a new image to the UPDATE partition.
+ *
+ * Any transfer in progress is discarded. The partition is not erased here:
+ * sectors are erased as the image is written.
+ *
+ * @return 0 on success.
+ */
+int wolfBoot_update_writer_open(void)
+{
+    XMEMSET(&update_writer, 0, sizeof(update_writer));
+    update_writer.state = UPDATE_WRITER_OPEN;
+    return 0;
+}
+
+/**
+ * @brief Write the next chunk of the update image.
+ *
+ * Chunks can have any size. The manifest header is checked as soon as it has
+ * been received: an invalid header, an image that does not fit in the
+ * partition, or data beyond the size declared in the header stop the
+ * transfer, and any further call fails until the writer is opened again.
+ *
+ * @param data Pointer to the chunk.
+ * @param len Size of the chunk.
+ * @return 0 on success, -1 on failure.
+ */
+int wolfBoot_update_writer_write(const uint8_t *data, uint32_t len)
+{
+    uint32_t n;
+
+    if (update_writer.state != UPDATE_WRITER_OPEN)
+        return -1;
+    if ((data == NULL) && (len > 0))
+        goto fail;
+    while (len > 0) {
+        if (update_writer.pos < IMAGE_HEADER_SIZE) {
+            n = IMAGE_HEADER_SIZE - update_writer.pos;
+            if (n > len)
+                n = len;
+            XMEMCPY(update_writer_hdr + update_writer.pos, data, n);
+            update_writer.pos += n;
+            if ((update_writer.pos == IMAGE_HEADER_SIZE) &&
+                    (update_writer_parse_header() != 0))
+                goto fail;
+        } else {
+            n = update_writer.img_size - update_writer.pos;
+            if (n == 0)
+                goto fail;
+            if (n > len)
+                n = len;
+            update_writer_hash(data, n);
+        }
+        /* Same bytes to flash */
+        len -= n;
+        while (n > 0) {
+            uint32_t room = WOLFBOOT_UPDATE_WRITER_BUF_SIZE -
+                update_writer.buf_len;
+            if (room > n)
+                room = n;
+            XMEMCPY(update_writer_buf + update_writer.buf_len, data, room);
+            update_writer.buf_len += room;
+            data += room;
+            n -= room;
+            if ((update_writer.buf_len == WOLFBOOT_UPDATE_WRITER_BUF_SIZE) &&
+                    (update_writer_flush() != 0))
+                goto fail;
+        }
+    }
+    return 0;
+
+fail:
+    update_writer.state = UPDATE_WRITER_FAILED;
+    return -1;
+}
+
+/**
+ * @brief Complete the transfer and check the image digest.
+ *
+ * Writes the last buffered block and compares the digest calculated while
+ * receiving the image with the one stored in its manifest header. With
+ * WOLFBOOT_UPDATE_WRITER_VERIFY, the signature in the header is also verified
+ * against the keystore; otherwise only the integrity of the image is checked
+ * here, and its signature is verified by wolfBoot before installing the
+ * update. On success the caller can mark the update with
+ * wolfBoot_update_trigger().
+ *
+ * @return 0 if the complete image was received and its digest (and
+ * signature, with WOLFBOOT_UPDATE_WRITER_VERIFY) matches, -1 otherwise.
+ */
+int wolfBoot_update_writer_finalize(void)
+{
+    uint8_t *stored_sha;
+#ifdef WOLFBOOT_UPDATE_WRITER_VERIFY
+    struct wolfBoot_image img;
+#endif
+
+    if ((update_writer.state != UPDATE_WRITER_OPEN) ||
+            (update_writer.img_size == 0) ||
+            (update_writer.pos != update_writer.img_size))
+        goto fail;
+    if (update_writer_flush() != 0)
+        goto fail;
+    final_hash(&update_writer.ctx, update_writer.digest);
+    wolfBoot_find_header(update_writer_hdr + IMAGE_HEADER_OFFSET,
+        WOLFBOOT_SHA_HDR, &stored_sha);
+    if (XMEMCMP(update_writer.digest, stored_sha,
+            WOLFBOOT_SHA_DIGEST_SIZE) != 0)
+        goto fail;
+#ifdef WOLFBOOT_UPDATE_WRITER_VERIFY
+    /* The digest was just checked: verify the signature over it, without
+     * reading the image back from the partition */
+    if (wolfBoot_open_image(&img, PART_UPDATE) != 0)
+        goto fail;
+    img.sha_hash = update_writer.digest;
+    if ((wolfBoot_verify_authenticity(&img) != 0) || (img.signature_ok != 1))
+        goto fail;
+#endif
+    update_writer.state = UPDATE_WRITER_DONE;
+    return 0;
+
+fail:
+    update_writer.state = UPDATE_WRITER_FAILED;
+    return -1;
+}
+
+/**
+ * @brief Get the digest of the last image completed by the writer.
+ *
+ * Applications holding the public key can verify the signature stored in the
+ * manifest header (HDR_SIGNATURE) against this digest before triggering the
+ * update.
+ *
+ * @param digest Buffer of WOLFBOOT_SHA_DIGEST_SIZE bytes.
+ * @return 0 on success, -1 if wolfBoot_update_writer_finalize() did not
+ * succeed.
+ */
+int wolfBoot_update_writer_digest(uint8_t *digest)
+{
+    if ((digest == NULL) || (update_writer.state != UPDATE_WRITER_DONE))
+        return -1;
+    XMEMCPY(digest, update_writer.digest, WOLFBOOT_SHA_DIGEST_SIZE);
+    return 0;
+}
+#endif /* WOLFBOOT_UPDATE_WRITER && WOLFBOOT_FIXED_PARTITIONS && !__WOLFBOOT */
+
+#if (defined(WOLFBOOT_HASH_TREE) || \
+     defined(WOLFBOOT_HYBRID_PARALLEL_VERIFY)) && defined(__WOLFBOOT)
+/* Default: no secondary cores, the boot core does all the work (hashing the
+ * chunks of tree-hashed images, verifying both hybrid signatures).
+ * Targets with SMP support override these in the hal. */
+int WEAKFUNCTION hal_smp_cores(void)
+{
+    return 1;
+}
+
+int WEAKFUNCTION hal_smp_start(int core, void (*fn)(void *), void *arg)
+{
+    (void)core;
+    (void)fn;
+    (void)arg;
+    return -1;
+}
+
+void WEAKFUNCTION hal_smp_wait(int core)
+{
+    (void)core;
+}
+#endif /* (WOLFBOOT_HASH_TREE || WOLFBOOT_HYBRID_PARALLEL_VERIFY) &&
+        * __WOLFBOOT */
+
+#if defined(WOLFBOOT_FLASH_MULTI_SECTOR_ERASE) && defined(__WOLFBOOT)
+/* Default: no information on the erase operations of the flash, each range
+ * is erased with a single hal_flash_erase() call */
+uint32_t WEAKFUNCTION hal_flash_erase_granularity(void)
+{
+    return 0;
+}
+#endif /* WOLFBOOT_FLASH_MULTI_SECTOR_ERASE && __WOLFBOOT */
+
+#if defined(WOLFBOOT_VERIFY_CACHE) && defined(__WOLFBOOT)
+/* Default: no device secret, the boot verification cache is never used.
+ * Targets provide one in the hal (OTP, hardware unique key, TPM NV...) */
+int WEAKFUNCTION hal_verify_cache_key(uint8_t *key, int len)
+{
+    (void)key;
+    (void)len;
+    return -1;
+}
+#endif /* WOLFBOOT_VERIFY_CACHE && __WOLFBOOT */
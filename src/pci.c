@@ -70,10 +70,6 @@
 #define PCI_IO32_BASE 0x2000
 #endif /* PCI_IO32_BASE */
 
-#define PCI_ENUM_MAX_DEV  32
-#define PCI_ENUM_MAX_FUN  8
-#define PCI_ENUM_MAX_BARS 6
-
 #define PCI_ENUM_MMIND_MASK   (0x1)
 #define PCI_ENUM_TYPE_MASK    (0x1 << 1 | 0x1 << 2)
 #define PCI_ENUM_TYPE_SHIFT   1
@@ -402,26 +398,214 @@ static int pci_enum_next_aligned32(uint32_t address, uint32_t *next,
     return 0;
 }
 
-static int pci_pre_enum_cb(uint8_t bus, uint8_t dev, uint8_t fun)
-{
 #ifdef WOLFBOOT_TGL
-    if (bus != 0)
-        return 0;
+static const struct pci_enum_skip pci_enum_skip_default[] = {
     /* don't change UART mapping */
-    if (dev == 0x1e && (fun == 0 || fun == 1)) {
-        return 1;
-    }
+    { 0, 0x1e, 0 },
+    { 0, 0x1e, 1 },
     /* PMC BARs shouldn't be programmed as per FSP integration guide */
-    if (dev == 31 && fun == 2)
-        return 1;
+    { 0, 31, 2 },
+};
+static const struct pci_enum_skip *pci_enum_skip_list = pci_enum_skip_default;
+static unsigned int pci_enum_skip_count =
+    sizeof(pci_enum_skip_default) / sizeof(pci_enum_skip_default[0]);
 #else
-    (void)bus;
-    (void)dev;
-    (void)fun;
+static const struct pci_enum_skip *pci_enum_skip_list = 0;
+static unsigned int pci_enum_skip_count = 0;
 #endif /* WOLFBOOT_TGL */
+
+/**
+ * @brief Replace the list of buses/devices/functions skipped by enumeration
+ *
+ * Must be called before pci_enum_do(). The list is not copied.
+ *
+ * @param list skip list entries
+ * @param count number of entries in list
+ */
+void pci_enum_set_skip_list(const struct pci_enum_skip *list,
+                            unsigned int count)
+{
+    pci_enum_skip_list = list;
+    pci_enum_skip_count = count;
+}
+
+/* dev and fun can be PCI_ENUM_ANY to ask whether the whole bus, or device, is
+ * skipped: a wildcard only matches a wildcard entry */
+static int pci_enum_skip_match(uint8_t bus, uint8_t dev, uint8_t fun)
+{
+    const struct pci_enum_skip *s;
+    unsigned int i;
+
+    for (i = 0; i < pci_enum_skip_count; i++) {
+        s = &pci_enum_skip_list[i];
+        if (s->bus != bus)
+            continue;
+        if (s->dev != PCI_ENUM_ANY && s->dev != dev)
+            continue;
+        if (s->fun != PCI_ENUM_ANY && s->fun != fun)
+            continue;
+        return 1;
+    }
     return 0;
 }
 
+static int pci_pre_enum_cb(uint8_t bus, uint8_t dev, uint8_t fun)
+{
+    return pci_enum_skip_match(bus, dev, fun);
+}
+
+#ifdef WOLFBOOT_PCI_BAR_CACHE
+static struct pci_bar_cache *pci_bar_cache;
+static struct pci_bar_cache_entry *pci_bar_cache_rec;
+static unsigned int pci_bar_cache_pos;
+static int pci_bar_cache_miss;
+static int pci_bar_cache_dirty;
+
+/**
+ * @brief Use the BAR assignment stored in cache by a previous boot
+ *
+ * Functions are matched in enumeration order by location and vendor/device
+ * ID. Matching functions get their BARs written back without sizing; from the
+ * first mismatch on, BARs are sized and the new assignment is recorded into
+ * cache. The board is responsible for persisting cache when
+ * pci_enum_bar_cache_updated() returns 1 after pci_enum_do().
+ *
+ * @param cache cache storage, or NULL to disable
+ */
+void pci_enum_set_bar_cache(struct pci_bar_cache *cache)
+{
+    pci_bar_cache = cache;
+    pci_bar_cache_rec = 0;
+    pci_bar_cache_pos = 0;
+    pci_bar_cache_dirty = 0;
+    pci_bar_cache_miss = (cache == 0 || cache->magic != PCI_BAR_CACHE_MAGIC ||
+                          cache->count > PCI_BAR_CACHE_ENTRIES);
+}
+
+int pci_enum_bar_cache_updated(void)
+{
+    return pci_bar_cache_dirty;
+}
+
+static void pci_bar_cache_record_start(struct pci_bar_cache_entry *e,
+                                       uint8_t bus, uint8_t dev, uint8_t fun,
+                                       uint32_t vd_code)
+{
+    int i;
+
+    pci_bar_cache_miss = 1;
+    pci_bar_cache_dirty = 1;
+    e->vd_code = vd_code;
+    e->bus = bus;
+    e->dev = dev;
+    e->fun = fun;
+    for (i = 0; i < PCI_ENUM_MAX_BARS; i++) {
+        e->kind[i] = PCI_BAR_CACHE_NONE;
+        e->bar[i] = 0;
+        e->len[i] = 0;
+    }
+    pci_bar_cache->magic = PCI_BAR_CACHE_MAGIC;
+    pci_bar_cache->count = pci_bar_cache_pos;
+    pci_bar_cache_rec = e;
+}
+
+/* Returns the cached entry for this function, or NULL if BARs must be sized.
+ * In the latter case the sizing results are recorded in the next slot. */
+static struct pci_bar_cache_entry *pci_bar_cache_get(uint8_t bus, uint8_t dev,
+                                                     uint8_t fun,
+                                                     uint32_t vd_code)
+{
+    struct pci_bar_cache_entry *e;
+
+    pci_bar_cache_rec = 0;
+    if (pci_bar_cache == 0 || pci_bar_cache_pos >= PCI_BAR_CACHE_ENTRIES)
+        return 0;
+    e = &pci_bar_cache->entry[pci_bar_cache_pos++];
+    if (!pci_bar_cache_miss && pci_bar_cache_pos <= pci_bar_cache->count &&
+        e->vd_code == vd_code && e->bus == bus && e->dev == dev &&
+        e->fun == fun)
+        return e;
+    pci_bar_cache_record_start(e, bus, dev, fun, vd_code);
+    return 0;
+}
+
+static void pci_bar_cache_record(uint8_t bar_idx, uint32_t bar,
+                                 uint32_t len, uint8_t kind)
+{
+    if (pci_bar_cache_rec == 0)
+        return;
+    pci_bar_cache_rec->kind[bar_idx] = kind;
+    pci_bar_cache_rec->bar[bar_idx] = bar;
+    pci_bar_cache_rec->len[bar_idx] = len;
+}
+
+/* Drop the entries of functions that are gone since the cache was built */
+static void pci_bar_cache_finish(void)
+{
+    if (pci_bar_cache == 0)
+        return;
+    if (!pci_bar_cache_miss && pci_bar_cache_pos < pci_bar_cache->count) {
+        pci_bar_cache->count = pci_bar_cache_pos;
+        pci_bar_cache_dirty = 1;
+    }
+    pci_bar_cache_rec = 0;
+}
+
+/* Write back a cached assignment. The entry is checked against the current
+ * windows first, so that a stale cache can never map a BAR outside of them or
+ * below an address already handed out. */
+static int pci_bar_cache_replay(uint8_t bus, uint8_t dev, uint8_t fun,
+                                const struct pci_bar_cache_entry *e,
+                                struct pci_enum_info *info)
+{
+    struct pci_enum_info next = *info;
+    uint32_t *base;
+    uint32_t limit;
+    uint32_t align;
+    uint8_t bar_off;
+    int i;
+
+    for (i = 0; i < PCI_ENUM_MAX_BARS; i++) {
+        switch (e->kind[i] & PCI_BAR_CACHE_KIND_MASK) {
+        case PCI_BAR_CACHE_NONE:
+            continue;
+        case PCI_BAR_CACHE_MEM:
+            base = &next.mem;
+            limit = next.mem_limit;
+            break;
+        case PCI_BAR_CACHE_MEM_PF:
+            base = &next.mem_pf;
+            limit = next.mem_pf_limit;
+            break;
+        default:
+            base = &next.io;
+            limit = 0xffffffff;
+            break;
+        }
+        if (e->len[i] == 0 || (e->len[i] & (e->len[i] - 1)) != 0)
+            return -1;
+        align = e->len[i] < 0x1000 ? 0x1000 : e->len[i];
+        if ((e->bar[i] & (align - 1)) != 0 || e->bar[i] < *base ||
+            e->bar[i] >= limit || e->len[i] - 1 > limit - e->bar[i])
+            return -1;
+        if ((e->kind[i] & PCI_BAR_CACHE_64BIT) && i == PCI_ENUM_MAX_BARS - 1)
+            return -1;
+        *base = e->bar[i] + e->len[i];
+    }
+
+    for (i = 0; i < PCI_ENUM_MAX_BARS; i++) {
+        if (e->kind[i] == PCI_BAR_CACHE_NONE)
+            continue;
+        bar_off = PCI_BAR0_OFFSET + i * 4;
+        pci_config_write32(bus, dev, fun, bar_off, e->bar[i]);
+        if (e->kind[i] & PCI_BAR_CACHE_64BIT)
+            pci_config_write32(bus, dev, fun, bar_off + 4, 0x0);
+    }
+    *info = next;
+    return 0;
+}
+#endif /* WOLFBOOT_PCI_BAR_CACHE */
+
 static int pci_post_enum_cb(uint8_t bus, uint8_t dev, uint8_t fun)
 {
     (void)bus;
@@ -518,6 +702,13 @@ static int pci_program_bar(uint8_t bus, uint8_t dev, uint8_t fun,
     if (*is_64bit)
         pci_config_write32(bus, dev, fun, bar_off + 4, 0x0);
     *base = bar_value + length;
+#ifdef WOLFBOOT_PCI_BAR_CACHE
+    pci_bar_cache_record(bar_idx, bar_value, length,
+                         (is_mmio ? (is_prefetch ? PCI_BAR_CACHE_MEM_PF :
+                                                   PCI_BAR_CACHE_MEM) :
+                                    PCI_BAR_CACHE_IO) |
+                         (*is_64bit ? PCI_BAR_CACHE_64BIT : 0));
+#endif
     PCI_DEBUG_PRINTF("PCI enum: %s bus: %x:%x.%x bar: %d [%x,%x] (0x%x %s %s)\r\n",
                     (is_mmio ? "mm" : "io"), bus, dev, fun, bar_idx, bar_value,
                      bar_value + length, length, (*is_64bit) ? "64bit" : "",
@@ -526,7 +717,7 @@ static int pci_program_bar(uint8_t bus, uint8_t dev, uint8_t fun,
     return 0;
 
 restore_bar:
-    pci_config_write32(bus, dev, fun, bar_idx, orig_bar);
+    pci_config_write32(bus, dev, fun, bar_off, orig_bar);
 
     return ret;
 }
@@ -547,8 +738,11 @@ static void pci_dump_id(uint8_t bus, uint8_t dev, uint8_t fun)
 #endif
 
 static int pci_program_bars(uint8_t bus, uint8_t dev, uint8_t fun,
-                            struct pci_enum_info *info)
+                            uint32_t vd_code, struct pci_enum_info *info)
 {
+#ifdef WOLFBOOT_PCI_BAR_CACHE
+    struct pci_bar_cache_entry *cached;
+#endif
     uint32_t orig_cmd;
     uint8_t is64bit;
     int _bar_idx;
@@ -557,6 +751,21 @@ static int pci_program_bars(uint8_t bus, uint8_t dev, uint8_t fun,
     orig_cmd = pci_config_read16(bus, dev, fun, PCI_COMMAND_OFFSET);
     pci_config_write16(bus, dev, fun, PCI_COMMAND_OFFSET, 0);
 
+#ifdef WOLFBOOT_PCI_BAR_CACHE
+    cached = pci_bar_cache_get(bus, dev, fun, vd_code);
+    if (cached != 0) {
+        if (pci_bar_cache_replay(bus, dev, fun, cached, info) == 0) {
+            PCI_DEBUG_PRINTF("PCI enum: %x:%x.%x BARs from cache\r\n",
+                             bus, dev, fun);
+            pci_config_write16(bus, dev, fun, PCI_COMMAND_OFFSET, orig_cmd);
+            return 0;
+        }
+        pci_bar_cache_record_start(cached, bus, dev, fun, vd_code);
+    }
+#else
+    (void)vd_code;
+#endif
+
     for (_bar_idx = 0; _bar_idx < PCI_ENUM_MAX_BARS; _bar_idx++) {
         ret = pci_program_bar(bus, dev, fun, _bar_idx, info, &is64bit);
         if (ret != 0)
@@ -726,18 +935,57 @@ static int pci_program_bridge(uint8_t bus, uint8_t dev, uint8_t fun,
     return -1;
 }
 
+/* Read the vendor/device ID of function 0 in every slot of the bus and
+ * return a bitmap of the devices that answer. This is still one config read
+ * per slot; with ECAM the address is just stepped by one device (32KB)
+ * instead of being rebuilt for each slot. */
+static uint32_t pci_enum_probe_slots(uint8_t bus,
+                                  uint32_t vd_codes[PCI_ENUM_MAX_DEV])
+{
+#ifdef PCI_USE_ECAM
+    uintptr_t addr;
+#endif
+    uint32_t present = 0;
+    uint32_t dev;
+
+#ifdef PCI_USE_ECAM
+    addr = pci_config_ecam_make_address(bus, 0, 0, PCI_VENDOR_ID_OFFSET);
+#endif
+    for (dev = 0; dev < PCI_ENUM_MAX_DEV; dev++) {
+        vd_codes[dev] = 0xFFFFFFFF;
+        if (pci_enum_skip_match(bus, dev, PCI_ENUM_ANY))
+            continue;
+#ifdef PCI_USE_ECAM
+        vd_codes[dev] = mmio_read32(addr + (dev << 15));
+#else
+        vd_codes[dev] = pci_config_read32(bus, dev, 0, PCI_VENDOR_ID_OFFSET);
+#endif
+        if (vd_codes[dev] != 0xFFFFFFFF)
+            present |= (1U << dev);
+    }
+    return present;
+}
+
 uint32_t pci_enum_bus(uint8_t bus, struct pci_enum_info *info)
 {
+    uint32_t vd_codes[PCI_ENUM_MAX_DEV];
     uint16_t header_type;
+    uint32_t present;
     uint32_t vd_code;
     uint32_t dev, fun;
 
     PCI_DEBUG_PRINTF("enumerating bus %d\r\n", bus);
 
+    if (pci_enum_skip_match(bus, PCI_ENUM_ANY, PCI_ENUM_ANY)) {
+        PCI_DEBUG_PRINTF("Skipping bus %x\r\n", bus);
+        return 0;
+    }
+
+    present = pci_enum_probe_slots(bus, vd_codes);
+
     for (dev = 0; dev < PCI_ENUM_MAX_DEV; dev++) {
 
-        vd_code = pci_config_read32(bus, dev, 0, PCI_VENDOR_ID_OFFSET);
-        if (vd_code == 0xFFFFFFFF) {
+        if ((present & (1U << dev)) == 0) {
             PCI_DEBUG_PRINTF("Skipping %x:%x\r\n", bus, dev);
             /* No device here. */
             continue;
@@ -749,7 +997,11 @@ uint32_t pci_enum_bus(uint8_t bus, struct pci_enum_info *info)
                 continue;
             }
 
-            vd_code = pci_config_read32(bus, dev, fun, PCI_VENDOR_ID_OFFSET);
+            if (fun == 0)
+                vd_code = vd_codes[dev];
+            else
+                vd_code = pci_config_read32(bus, dev, fun,
+                                            PCI_VENDOR_ID_OFFSET);
             if (vd_code == 0xFFFFFFFF) {
                 PCI_DEBUG_PRINTF("Skipping %x:%x.%x\r\n", bus, dev, fun);
                 /* No device here, try next function*/
@@ -759,7 +1011,7 @@ uint32_t pci_enum_bus(uint8_t bus, struct pci_enum_info *info)
                                             PCI_HEADER_TYPE_OFFSET);
             pci_dump_id(bus, dev, fun);
             if ((header_type & PCI_HEADER_TYPE_TYPE_MASK) == PCI_HEADER_TYPE_DEVICE) {
-                pci_program_bars(bus, dev, fun, info);
+                pci_program_bars(bus, dev, fun, vd_code, info);
                 pci_post_enum_cb(bus, dev, fun);
             } else {
                 pci_program_bridge(bus, dev, fun, info);
@@ -911,6 +1163,9 @@ int pci_enum_do(void)
     }
 
     ret = pci_enum_bus(0, &enum_info);
+#ifdef WOLFBOOT_PCI_BAR_CACHE
+    pci_bar_cache_finish();
+#endif
 
     PCI_DEBUG_PRINTF("PCI Memory Mapped I/O range [0x%x,0x%x] (0x%x)\r\n",
                      (uint32_t)PCI_MMIO32_BASE, enum_info.mem,
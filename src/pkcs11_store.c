@@ -120,15 +120,24 @@ struct store_handle {
     void     *buffer;
     struct obj_hdr *hdr;
     uint32_t in_buffer_offset;
+    struct obj_hdr pending; /* Nodes table entry, committed on close */
 };
 
 #define STORE_FLAGS_OPEN (1 << 0)
 #define STORE_FLAGS_READONLY (1 << 1)
+#define STORE_FLAGS_DIRTY (1 << 2)
 
 static struct store_handle openstores_handles[MAX_OPEN_STORES] = {};
 
 static uint8_t cached_sector[WOLFBOOT_SECTOR_SIZE];
 
+/* Writes are coalesced in RAM, and committed to flash only once, when the
+ * object is closed. Only one object at a time is staged here: opening any
+ * other object commits the pending one first.
+ */
+static uint8_t obj_buffer[KEYVAULT_OBJ_SIZE];
+static struct store_handle *obj_buffer_owner = NULL;
+
 static void bitmap_put(uint32_t pos, int val)
 {
     uint32_t octet = pos / 8;
@@ -142,20 +151,43 @@ static void bitmap_put(uint32_t pos, int val)
     }
 }
 
-static int bitmap_get(uint32_t pos)
+#if defined(__GNUC__)
+    #define bitmap_ctz(x) __builtin_ctz(x)
+#else
+static int bitmap_ctz(uint32_t x)
 {
-    uint32_t octet = pos / 8;
-    uint32_t bit = pos % 8;
-    uint8_t *bitmap = vault_base + sizeof(uint32_t);
-    return (bitmap[octet] & (1 << bit)) >> bit;
+    int n = 0;
+    while ((x & 1) == 0) {
+        x >>= 1;
+        n++;
+    }
+    return n;
 }
+#endif
 
+/* Scan the bitmap one 32-bit word at a time, and use ctz to find the first
+ * free position within the word.
+ */
 static int bitmap_find_free_pos(void)
 {
-    int i, j;
-    for (i = 0; i < KEYVAULT_MAX_ITEMS; i++) {
-        if (bitmap_get(i) == 0)
-            return i;
+    uint8_t *bitmap = vault_base + sizeof(uint32_t);
+    uint32_t word;
+    int i, j, pos;
+
+    for (i = 0; i < BITMAP_SIZE; i += 4) {
+        word = 0;
+        for (j = 0; (j < 4) && (i + j < BITMAP_SIZE); j++)
+            word |= (uint32_t)bitmap[i + j] << (8 * j);
+        if (j < 4) {
+            /* Past the end of the bitmap: mark as used */
+            word |= 0xFFFFFFFFUL << (8 * j);
+        }
+        if (word == 0xFFFFFFFFUL)
+            continue;
+        pos = i * 8 + bitmap_ctz(~word);
+        if (pos < KEYVAULT_MAX_ITEMS)
+            return pos;
+        break;
     }
     return -1;
 }
@@ -169,6 +201,115 @@ static int bitmap_find_free_pos(void)
  */
 
 #define NODES_TABLE ( (struct obj_hdr *)(vault_base + STORE_PRIV_HDR_OFFSET) )
+#define NODES_TABLE_ENTRIES \
+    ((WOLFBOOT_SECTOR_SIZE - STORE_PRIV_HDR_OFFSET) / STORE_PRIV_HDR_SIZE)
+
+/* RAM index of the nodes table: open addressing hash table, keyed on
+ * (type, token_id, object_id). Each bucket contains the position of the
+ * entry in the nodes table + 1, or 0 if empty.
+ *
+ * The index is rebuilt by check_vault() when the nodes table is restored or
+ * initialized, or after an object is deleted. New objects are added when
+ * they are committed. If the nodes table contains more entries than the
+ * index can hold, lookups fall back to scanning the table, and the index is
+ * not rebuilt until an object is deleted or the nodes table is replaced.
+ */
+#ifndef KEYVAULT_INDEX_SIZE
+    #if KEYVAULT_MAX_ITEMS <= 32
+        #define KEYVAULT_INDEX_SIZE 64
+    #elif KEYVAULT_MAX_ITEMS <= 128
+        #define KEYVAULT_INDEX_SIZE 256
+    #elif KEYVAULT_MAX_ITEMS <= 512
+        #define KEYVAULT_INDEX_SIZE 1024
+    #else
+        #define KEYVAULT_INDEX_SIZE 4096
+    #endif
+#endif
+
+#if (KEYVAULT_INDEX_SIZE & (KEYVAULT_INDEX_SIZE - 1)) != 0
+    #error KEYVAULT_INDEX_SIZE must be a power of two
+#endif
+
+static uint16_t store_index[KEYVAULT_INDEX_SIZE];
+static uint32_t store_index_used = 0;
+static uint32_t store_index_free = 0; /* First free entry in the nodes table */
+static int store_index_valid = 0;
+static int store_index_overflow = 0; /* Nodes table too large for the index */
+
+static uint32_t store_index_hash(int32_t type, uint32_t tok_id,
+        uint32_t obj_id)
+{
+    uint32_t h = tok_id * 0x9E3779B1U;
+    h ^= obj_id * 0x85EBCA77U;
+    h ^= (uint32_t)type * 0xC2B2AE3DU;
+    h ^= h >> 15;
+    return h & (KEYVAULT_INDEX_SIZE - 1);
+}
+
+static void store_index_insert(uint32_t entry)
+{
+    struct obj_hdr *hdr = NODES_TABLE + entry;
+    struct obj_hdr *cur;
+    uint32_t i;
+
+    if (store_index_used >= KEYVAULT_INDEX_SIZE / 2) {
+        /* Keep the load factor below 50%, otherwise scan the table */
+        store_index_valid = 0;
+        store_index_overflow = 1;
+        return;
+    }
+    i = store_index_hash(hdr->type, hdr->token_id, hdr->object_id);
+    while (store_index[i] != 0) {
+        cur = NODES_TABLE + (store_index[i] - 1);
+        if ((cur->token_id == hdr->token_id) &&
+                (cur->object_id == hdr->object_id) &&
+                (cur->type == hdr->type)) {
+            return; /* Already indexed: first entry in the table wins */
+        }
+        i = (i + 1) & (KEYVAULT_INDEX_SIZE - 1);
+    }
+    store_index[i] = (uint16_t)(entry + 1);
+    store_index_used++;
+}
+
+static void store_index_rebuild(void)
+{
+    struct obj_hdr *hdr = NODES_TABLE;
+    uint32_t i;
+
+    memset(store_index, 0, sizeof(store_index));
+    store_index_used = 0;
+    store_index_free = NODES_TABLE_ENTRIES;
+    store_index_valid = 1;
+    store_index_overflow = 0;
+    for (i = 0; i < NODES_TABLE_ENTRIES; i++) {
+        if (hdr[i].token_id == PKCS11_INVALID_ID) {
+            if (store_index_free == NODES_TABLE_ENTRIES)
+                store_index_free = i;
+            continue;
+        }
+        store_index_insert(i);
+        if (!store_index_valid)
+            return;
+    }
+}
+
+static struct obj_hdr *store_index_lookup(int32_t type, uint32_t tok_id,
+        uint32_t obj_id)
+{
+    struct obj_hdr *hdr;
+    uint32_t i = store_index_hash(type, tok_id, obj_id);
+
+    while (store_index[i] != 0) {
+        hdr = NODES_TABLE + (store_index[i] - 1);
+        if ((hdr->token_id == tok_id) && (hdr->object_id == obj_id)
+                && (hdr->type == type)) {
+            return hdr;
+        }
+        i = (i + 1) & (KEYVAULT_INDEX_SIZE - 1);
+    }
+    return NULL;
+}
 
 /* A backup sector immediately after the header sector */
 
@@ -210,19 +351,23 @@ static void check_vault(void)
 
     if (*magic != VAULT_HEADER_MAGIC) {
         uint32_t *magic = (uint32_t *)BACKUP_SECTOR_ADDRESS;
+        store_index_valid = 0;
+        store_index_overflow = 0;
         if (*magic == VAULT_HEADER_MAGIC) {
             restore_backup(0);
-            return;
+        } else {
+            memset(cached_sector, 0xFF, WOLFBOOT_SECTOR_SIZE);
+            magic = (uint32_t *)cached_sector;
+            *magic = VAULT_HEADER_MAGIC;
+            memset(cached_sector + sizeof(uint32_t), 0x00, BITMAP_SIZE);
+            cache_commit(0);
+            hal_flash_unlock();
+            hal_flash_erase((uintptr_t)vault_base + WOLFBOOT_SECTOR_SIZE * 2, total_vault_size);
+            hal_flash_lock();
         }
-        memset(cached_sector, 0xFF, WOLFBOOT_SECTOR_SIZE);
-        magic = (uint32_t *)cached_sector;
-        *magic = VAULT_HEADER_MAGIC;
-        memset(cached_sector + sizeof(uint32_t), 0x00, BITMAP_SIZE);
-        cache_commit(0);
-        hal_flash_unlock();
-        hal_flash_erase((uintptr_t)vault_base + WOLFBOOT_SECTOR_SIZE * 2, total_vault_size);
-        hal_flash_lock();
     }
+    if (!store_index_valid && !store_index_overflow)
+        store_index_rebuild();
 }
 
 static void delete_object(int32_t type, uint32_t tok_id, uint32_t obj_id)
@@ -238,6 +383,7 @@ static void delete_object(int32_t type, uint32_t tok_id, uint32_t obj_id)
             hdr->object_id = PKCS11_INVALID_ID;
             bitmap_put(hdr->pos, 0);
             cache_commit(0);
+            store_index_rebuild();
             return;
         }
         hdr++;
@@ -249,119 +395,148 @@ static void delete_object(int32_t type, uint32_t tok_id, uint32_t obj_id)
  * started at physical 0x0000 0000, the buffers are stored from sector
  * 2 onwards.
  */
-static uint8_t *find_object_buffer(int32_t type, uint32_t tok_id, uint32_t obj_id)
+static struct obj_hdr *find_object_header(int32_t type, uint32_t tok_id,
+        uint32_t obj_id)
 {
     struct obj_hdr *hdr = NODES_TABLE;
-    uint32_t *tok_obj_stored = NULL;
+
+    if (store_index_valid)
+        return store_index_lookup(type, tok_id, obj_id);
+
     while ((uintptr_t)hdr < ((uintptr_t)NODES_TABLE + WOLFBOOT_SECTOR_SIZE)) {
         if ((hdr->token_id == tok_id) && (hdr->object_id == obj_id)
                 && (hdr->type == type)) {
-            tok_obj_stored = (uint32_t *) (vault_base + (2 * WOLFBOOT_SECTOR_SIZE) + (hdr->pos * KEYVAULT_OBJ_SIZE));
-            if ((tok_obj_stored[0] != tok_id) || (tok_obj_stored[1] != obj_id)) {
-                /* Id's don't match. Try backup sector. */
-                uint32_t in_sector_off = (hdr->pos * KEYVAULT_OBJ_SIZE) %
-                    WOLFBOOT_SECTOR_SIZE;
-                uint32_t sector_base = hdr->pos * KEYVAULT_OBJ_SIZE +
-                    2 * WOLFBOOT_SECTOR_SIZE - in_sector_off;
-                tok_obj_stored = (uint32_t *)((BACKUP_SECTOR_ADDRESS + in_sector_off));
-                if ((tok_obj_stored[0] == tok_id) && (tok_obj_stored[1] == obj_id)) {
-                    /* Found backup! restoring... */
-                    restore_backup(sector_base);
-                } else {
-                    delete_object(type, tok_id, obj_id);
-                    return NULL; /* Cannot recover object payload */
-                }
-            }
-            /* Object is now OK */
-            return vault_base + 2 * WOLFBOOT_SECTOR_SIZE + hdr->pos * KEYVAULT_OBJ_SIZE;
+            return hdr;
         }
         hdr++;
     }
-    return NULL; /* object not found */
+    return NULL;
 }
 
-static struct obj_hdr *find_object_header(int32_t type, uint32_t tok_id,
-        uint32_t obj_id)
+static uint8_t *find_object_buffer(int32_t type, uint32_t tok_id, uint32_t obj_id)
 {
-    struct obj_hdr *hdr = NODES_TABLE;
+    struct obj_hdr *hdr;
     uint32_t *tok_obj_stored = NULL;
-    while ((uintptr_t)hdr < ((uintptr_t)NODES_TABLE + WOLFBOOT_SECTOR_SIZE)) {
-        if ((hdr->token_id == tok_id) && (hdr->object_id == obj_id)
-                && (hdr->type == type)) {
-            return hdr;
+
+    hdr = find_object_header(type, tok_id, obj_id);
+    if (hdr == NULL)
+        return NULL; /* object not found */
+
+    tok_obj_stored = (uint32_t *) (vault_base + (2 * WOLFBOOT_SECTOR_SIZE) + (hdr->pos * KEYVAULT_OBJ_SIZE));
+    if ((tok_obj_stored[0] != tok_id) || (tok_obj_stored[1] != obj_id)) {
+        /* Id's don't match. Try backup sector. */
+        uint32_t in_sector_off = (hdr->pos * KEYVAULT_OBJ_SIZE) %
+            WOLFBOOT_SECTOR_SIZE;
+        uint32_t sector_base = hdr->pos * KEYVAULT_OBJ_SIZE +
+            2 * WOLFBOOT_SECTOR_SIZE - in_sector_off;
+        tok_obj_stored = (uint32_t *)((BACKUP_SECTOR_ADDRESS + in_sector_off));
+        if ((tok_obj_stored[0] == tok_id) && (tok_obj_stored[1] == obj_id)) {
+            /* Found backup! restoring... */
+            restore_backup(sector_base);
+        } else {
+            delete_object(type, tok_id, obj_id);
+            return NULL; /* Cannot recover object payload */
         }
-        hdr++;
     }
-    return NULL;
+    /* Object is now OK */
+    return vault_base + 2 * WOLFBOOT_SECTOR_SIZE + hdr->pos * KEYVAULT_OBJ_SIZE;
 }
 
-static struct obj_hdr *create_object(int32_t type, uint32_t tok_id, uint32_t obj_id)
+/* Find a free entry in the nodes table and a free position in the vault
+ * for a new object. Nothing is written to flash here: the entry is claimed
+ * when the object is committed, by store_flush().
+ */
+static struct obj_hdr *reserve_object(int32_t type, uint32_t tok_id,
+        uint32_t obj_id, uint32_t *pos)
 {
-    struct obj_hdr *hdr = NULL;
-    uint32_t *tok_obj_id;
+    struct obj_hdr *hdr = NODES_TABLE;
+    int free_pos;
+
     /* Refuse to create an object that's already in store */
     if (find_object_buffer(type, tok_id, obj_id) != NULL) {
         return NULL;
     }
-
-    /* Caching sector 0 */
-    memcpy(cached_sector, vault_base , WOLFBOOT_SECTOR_SIZE);
-    hdr = (struct obj_hdr *)(cached_sector + STORE_PRIV_HDR_OFFSET);
-    while ((uintptr_t)hdr < ((uintptr_t)cached_sector + WOLFBOOT_SECTOR_SIZE)) {
+    if (store_index_valid) {
+        if (store_index_free >= NODES_TABLE_ENTRIES)
+            return NULL; /* No space left in the nodes table */
+        hdr += store_index_free;
+    }
+    while ((uintptr_t)hdr < ((uintptr_t)vault_base + WOLFBOOT_SECTOR_SIZE)) {
         if (hdr->token_id == PKCS11_INVALID_ID) {
-            uint32_t sector_base, in_sector_off;
-            int pos = bitmap_find_free_pos();
-            if (pos < 0) {
+            free_pos = bitmap_find_free_pos();
+            if (free_pos < 0) {
                 return NULL;
             }
-            hdr->pos = (unsigned)pos;
-            in_sector_off = (hdr->pos * KEYVAULT_OBJ_SIZE) %
-                WOLFBOOT_SECTOR_SIZE;
-            sector_base = hdr->pos * KEYVAULT_OBJ_SIZE +
-                2 * WOLFBOOT_SECTOR_SIZE - in_sector_off;
-            /* Claim the spot in the table */
-            hdr->token_id = tok_id;
-            hdr->object_id = obj_id;
-            hdr->type = type;
-            /* Set vault initial size to eight bytes (this includes the
-             * tok/obj id at the beginning of the buffer, before the
-             * payload). When an object is opened, the initial 'in_buffer_offset'
-             * is set to 8 as well.
-            */
-            hdr->size = 2 * sizeof(uint32_t);
-            /* Set the bit to claim the position in flash */
-            bitmap_put(hdr->pos, 1);
-            cache_commit(0);
-            /* Mark the beginning of the object in the sector,
-             * write the tok/obj ids
-             */
-            memcpy(cached_sector, vault_base + sector_base,
-                    WOLFBOOT_SECTOR_SIZE);
-            tok_obj_id = (void*)(cached_sector + in_sector_off);
-            tok_obj_id[0] = tok_id;
-            tok_obj_id[1] = obj_id;
-            cache_commit(sector_base);
-            /* Return the address of the header in flash */
-            return (struct obj_hdr *)(vault_base + ((uint8_t *)hdr - (uint8_t *)cached_sector));
+            *pos = (uint32_t)free_pos;
+            return hdr;
         }
         hdr++;
     }
     return NULL; /* No space left in the nodes table */
 }
 
-static void update_store_size(struct obj_hdr *hdr, uint32_t size)
+/* Commit the object staged in obj_buffer for this handle.
+ *
+ * The sectors of the object are written first, then the nodes table entry
+ * (which claims the object, if new, and sets its size). Sectors that are
+ * already up to date in flash are skipped.
+ */
+static void store_flush(struct store_handle *handle)
 {
-    uint32_t off;
+    uint32_t obj_off, off, len, in_sector_off, sector_base, entry;
     struct obj_hdr *hdr_mem;
-    if (((uint8_t *)hdr) < vault_base ||
-        ((uint8_t *)hdr > vault_base + WOLFBOOT_SECTOR_SIZE))
+
+    if ((handle->flags & STORE_FLAGS_DIRTY) == 0)
         return;
-    check_vault();
-    off = (uintptr_t)hdr - (uintptr_t)vault_base;
-    memcpy(cached_sector, vault_base, WOLFBOOT_SECTOR_SIZE);
-    hdr_mem = (struct obj_hdr *)(cached_sector + off);
-    hdr_mem->size = size;
-    cache_commit(0);
+    obj_off = (uint32_t)((uint8_t *)handle->buffer - vault_base);
+    for (off = 0; off < handle->pending.size; off += len) {
+        in_sector_off = (obj_off + off) % WOLFBOOT_SECTOR_SIZE;
+        sector_base = obj_off + off - in_sector_off;
+        len = WOLFBOOT_SECTOR_SIZE - in_sector_off;
+        if (len > handle->pending.size - off)
+            len = handle->pending.size - off;
+        if (memcmp(vault_base + obj_off + off, obj_buffer + off, len) == 0)
+            continue;
+        memcpy(cached_sector, vault_base + sector_base, WOLFBOOT_SECTOR_SIZE);
+        memcpy(cached_sector + in_sector_off, obj_buffer + off, len);
+        cache_commit(sector_base);
+    }
+
+    if (memcmp(handle->hdr, &handle->pending, sizeof(struct obj_hdr)) != 0) {
+        memcpy(cached_sector, vault_base, WOLFBOOT_SECTOR_SIZE);
+        hdr_mem = (struct obj_hdr *)(cached_sector +
+                ((uint8_t *)handle->hdr - vault_base));
+        memcpy(hdr_mem, &handle->pending, sizeof(struct obj_hdr));
+        /* Set the bit to claim the position in flash */
+        bitmap_put(handle->pending.pos, 1);
+        cache_commit(0);
+        if (store_index_valid) {
+            entry = (uint32_t)(handle->hdr - NODES_TABLE);
+            store_index_insert(entry);
+            while ((store_index_free < NODES_TABLE_ENTRIES) &&
+                    (NODES_TABLE[store_index_free].token_id !=
+                     PKCS11_INVALID_ID)) {
+                store_index_free++;
+            }
+        }
+    }
+    handle->flags &= ~STORE_FLAGS_DIRTY;
+    if (obj_buffer_owner == handle)
+        obj_buffer_owner = NULL;
+}
+
+/* Load the current content of the object in obj_buffer, to resume writing
+ * through this handle. Any other pending object is committed first.
+ */
+static void store_stage(struct store_handle *handle)
+{
+    if (obj_buffer_owner == handle)
+        return;
+    if (obj_buffer_owner != NULL)
+        store_flush(obj_buffer_owner);
+    memcpy(obj_buffer, handle->buffer, KEYVAULT_OBJ_SIZE);
+    obj_buffer_owner = handle;
+    handle->flags |= STORE_FLAGS_DIRTY;
 }
 
 /* Find a free handle in openstores_handles[] array
@@ -383,10 +558,10 @@ static struct store_handle *find_free_handle(void)
 int wolfPKCS11_Store_Open(int type, CK_ULONG id1, CK_ULONG id2, int read,
     void** store)
 {
-    unsigned int i;
     struct store_handle *handle;
     uint8_t *buf;
-    struct obj_hdr *hdr = NULL;
+    uint32_t *tok_obj_id;
+    uint32_t pos = 0;
 
 
     /* Check if there is one handle available to open the slot */
@@ -396,6 +571,10 @@ int wolfPKCS11_Store_Open(int type, CK_ULONG id1, CK_ULONG id2, int read,
         return SESSION_COUNT_E;
     }
 
+    /* Commit the pending writes before looking up objects */
+    if (obj_buffer_owner != NULL)
+        store_flush(obj_buffer_owner);
+
     /* Check if the target object exists */
     check_vault();
     buf = find_object_buffer(type, id1, id2);
@@ -405,23 +584,20 @@ int wolfPKCS11_Store_Open(int type, CK_ULONG id1, CK_ULONG id2, int read,
     }
 
     if ((buf == NULL) && (!read)) {
-        handle->hdr = create_object(type, id1, id2);
+        handle->hdr = reserve_object(type, id1, id2, &pos);
         if (handle->hdr == NULL) {
             *store = NULL;
             return FIND_FULL_E;
 
         }
-        buf = find_object_buffer(type, id1, id2);
-        if (!buf) {
-            *store = NULL;
-            return NOT_AVAILABLE_E;
-        }
-    } else { /* buf != NULL, readonly */
+        buf = vault_base + 2 * WOLFBOOT_SECTOR_SIZE + pos * KEYVAULT_OBJ_SIZE;
+    } else { /* buf != NULL */
         handle->hdr = find_object_header(type, id1, id2);
         if (!handle->hdr) {
             *store = NULL;
             return NOT_AVAILABLE_E;
         }
+        pos = handle->hdr->pos;
     }
 
     /* Set the position of the buffer in the handle */
@@ -435,8 +611,19 @@ int wolfPKCS11_Store_Open(int type, CK_ULONG id1, CK_ULONG id2, int read,
         handle->flags |= STORE_FLAGS_READONLY;
     else {
         handle->flags &= ~STORE_FLAGS_READONLY;
-        /* Truncate the slot when opening in write mode */
-        update_store_size(handle->hdr, 2 * sizeof(uint32_t));
+        /* Truncate the slot when opening in write mode. The object starts
+         * with the tok/obj ids, before the payload.
+         */
+        memcpy(&handle->pending, handle->hdr, sizeof(struct obj_hdr));
+        handle->pending.token_id = id1;
+        handle->pending.object_id = id2;
+        handle->pending.type = type;
+        handle->pending.pos = pos;
+        handle->pending.size = 2 * sizeof(uint32_t);
+        store_stage(handle);
+        tok_obj_id = (uint32_t *)obj_buffer;
+        tok_obj_id[0] = id1;
+        tok_obj_id[1] = id2;
     }
 
 
@@ -449,6 +636,8 @@ int wolfPKCS11_Store_Open(int type, CK_ULONG id1, CK_ULONG id2, int read,
 void wolfPKCS11_Store_Close(void* store)
 {
     struct store_handle *handle = store;
+    /* Commit all the writes since the object was opened */
+    store_flush(handle);
     /* This removes all flags (including STORE_FLAGS_OPEN) */
     handle->flags = 0;
     handle->hdr = NULL;
@@ -484,20 +673,13 @@ int wolfPKCS11_Store_Read(void* store, unsigned char* buffer, int len)
 int wolfPKCS11_Store_Write(void* store, unsigned char* buffer, int len)
 {
     struct store_handle *handle = store;
-    uint32_t obj_size = 0;
-    uint32_t in_sector_offset = 0;
-    uint32_t in_sector_len = 0;
-    uint32_t sector_base = 0;
-    int written = 0;
-
 
     if ((handle == NULL) || (handle->hdr == NULL) || (handle->buffer == NULL))
        return -1;
     if ((handle->flags & STORE_FLAGS_READONLY) != 0)
         return -1;
 
-    obj_size = handle->hdr->size;
-    if (obj_size > KEYVAULT_OBJ_SIZE)
+    if (handle->pending.size > KEYVAULT_OBJ_SIZE)
         return -1;
 
     if (len + handle->in_buffer_offset > KEYVAULT_OBJ_SIZE)
@@ -506,27 +688,11 @@ int wolfPKCS11_Store_Write(void* store, unsigned char* buffer, int len)
     if (len < 0)
         return -1;
 
-
-    while (written < len) {
-        in_sector_offset = ((uintptr_t)(handle->buffer) + handle->in_buffer_offset)
-           % WOLFBOOT_SECTOR_SIZE;
-        sector_base = (uintptr_t)handle->buffer + handle->in_buffer_offset - in_sector_offset;
-        in_sector_len = WOLFBOOT_SECTOR_SIZE - in_sector_offset;
-        if (in_sector_len > (uint32_t)len)
-            in_sector_len = len;
-
-        /* Cache the corresponding sector */
-        memcpy(cached_sector, (void *)(uintptr_t)sector_base, WOLFBOOT_SECTOR_SIZE);
-        /* Write content into cache */
-        memcpy(cached_sector + in_sector_offset, buffer + written, in_sector_len);
-        /* Adjust in_buffer position for the handle accordingly */
-        handle->in_buffer_offset += in_sector_len;
-        written += in_sector_len;
-        /* Write sector to flash */
-        cache_commit((uintptr_t)sector_base - (uintptr_t)vault_base);
-    }
-    obj_size += written;
-    update_store_size(handle->hdr, obj_size);
+    /* Write content into the RAM buffer, committed on close */
+    store_stage(handle);
+    memcpy(obj_buffer + handle->in_buffer_offset, buffer, len);
+    handle->in_buffer_offset += len;
+    handle->pending.size += len;
     return len;
 }
 
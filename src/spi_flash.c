@@ -44,6 +44,8 @@
 #define WREN            0x06
 #define WRDI            0x04
 #define SECTOR_ERASE    0x20
+#define BLOCK_ERASE_32K 0x52
+#define BLOCK_ERASE_64K 0xD8
 #define CHIP_ERASE      0x60
 #define BYTE_READ       0x03
 #define BYTE_WRITE      0x02
@@ -233,6 +235,31 @@ int RAMFUNCTION spi_flash_sector_erase(uint32_t address)
     return 0;
 }
 
+/* Erase a 32KB or 64KB block with one command. The address is aligned down
+ * to the block size. */
+int RAMFUNCTION spi_flash_block_erase(uint32_t address, uint32_t size)
+{
+    uint8_t cmd;
+
+    if (size == SPI_FLASH_BLOCK_SIZE_64K)
+        cmd = BLOCK_ERASE_64K;
+    else if (size == SPI_FLASH_BLOCK_SIZE_32K)
+        cmd = BLOCK_ERASE_32K;
+    else
+        return -1;
+    address &= (~(size - 1));
+
+    wait_busy();
+    flash_write_enable();
+    spi_cs_on(SPI_CS_PIO_BASE, SPI_CS_FLASH);
+    spi_write(cmd);
+    spi_read();
+    write_address(address);
+    spi_cs_off(SPI_CS_PIO_BASE, SPI_CS_FLASH);
+    wait_busy();
+    return 0;
+}
+
 int RAMFUNCTION spi_flash_chip_erase(void)
 {
     wait_busy();
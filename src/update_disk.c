@@ -70,6 +70,153 @@
 /* from the linker, where wolfBoot ends */
 extern uint8_t _end_wb[];
 
+#ifdef WOLFBOOT_ATA_NCQ
+#ifndef ATA_QUEUE_CHUNK_SIZE
+#define ATA_QUEUE_CHUNK_SIZE (64 * 1024)
+#endif
+#define DISK_SECTOR_SIZE 512
+
+#ifdef WOLFBOOT_RAMBOOT_HASH_ON_LOAD
+/* Hash each chunk while the next ones are being read */
+#define DISK_HASH_ON_LOAD
+#if ATA_QUEUE_CHUNK_SIZE < IMAGE_HEADER_SIZE
+#error ATA_QUEUE_CHUNK_SIZE must hold the whole image header
+#endif
+
+/**
+ * @brief Feed a chunk of the image, already in RAM, to the hash.
+ *
+ * The first chunk contains the manifest header: the image is parsed from this
+ * RAM copy, which is the one verified and booted, and the hash is started.
+ *
+ * @param[in] idx The index of the chunk.
+ * @param[in] size The number of bytes loaded (header included).
+ * @param[in] dst The address of the image in RAM.
+ * @param[out] img The image being loaded.
+ * @param[in,out] ctx The hash context.
+ *
+ * @return 0 on success, -1 if the header is not valid.
+ */
+static int disk_hash_chunk(uint32_t idx, uint32_t size, uint8_t *dst,
+        struct wolfBoot_image *img, wolfBoot_hash_t *ctx)
+{
+    uint32_t start = idx * ATA_QUEUE_CHUNK_SIZE;
+    uint32_t end = start + ATA_QUEUE_CHUNK_SIZE;
+
+    if (idx == 0) {
+        img->sha_ok = 0;
+        img->hdr = NULL;
+        img->hdr_ok = 0;
+        if ((wolfBoot_open_image_address(img, dst) < 0) ||
+                (img->fw_size + IMAGE_HEADER_SIZE != size) ||
+                (wolfBoot_image_hash_init(img, ctx) < 0))
+            return -1;
+        start = IMAGE_HEADER_SIZE;
+    }
+    if (end > size)
+        end = size;
+    update_hash(ctx, dst + start, end - start);
+    return 0;
+}
+#endif /* WOLFBOOT_RAMBOOT_HASH_ON_LOAD */
+
+/**
+ * @brief Load an image from a disk partition into RAM using queued reads.
+ *
+ * The image is split in chunks of ATA_QUEUE_CHUNK_SIZE bytes. Up to
+ * `ata_queue_depth()` chunks are kept in flight, so the drive can serve the
+ * next reads while the previous ones are being reaped. Chunks are reaped in
+ * order, so the part of the image before `done` is always in RAM.
+ *
+ * With WOLFBOOT_RAMBOOT_HASH_ON_LOAD, the chunks that are in RAM are hashed
+ * after the queue has been refilled, while the drive serves the next reads.
+ * The image is then checked with wolfBoot_verify_integrity_hash().
+ *
+ * @param[in] drv The drive number.
+ * @param[in] part The partition number.
+ * @param[in] size The number of bytes to load from the start of the partition.
+ * @param[out] dst The destination address in RAM.
+ * @param[out] img The image being loaded (WOLFBOOT_RAMBOOT_HASH_ON_LOAD).
+ * @param[out] ctx The hash context (WOLFBOOT_RAMBOOT_HASH_ON_LOAD).
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int disk_load_queued(int drv, int part, uint32_t size, uint8_t *dst,
+        struct wolfBoot_image *img, wolfBoot_hash_t *ctx)
+{
+    int tags[ATA_MAX_QUEUED_CMDS];
+    uint32_t n_chunks = (size + ATA_QUEUE_CHUNK_SIZE - 1) / ATA_QUEUE_CHUNK_SIZE;
+    uint32_t issued = 0, done = 0;
+#ifdef DISK_HASH_ON_LOAD
+    uint32_t hashed = 0;
+#else
+    (void)img;
+    (void)ctx;
+#endif
+    int depth = ata_queue_depth(drv);
+    int ret = 0;
+
+    if (depth <= 0)
+        return -1;
+    if (depth > ATA_MAX_QUEUED_CMDS)
+        depth = ATA_MAX_QUEUED_CMDS;
+
+    while (done < n_chunks) {
+        /* Keep the queue full */
+        while ((issued < n_chunks) && ((issued - done) < (uint32_t)depth)) {
+            uint32_t off = issued * ATA_QUEUE_CHUNK_SIZE;
+            uint32_t len = ATA_QUEUE_CHUNK_SIZE;
+            if (len > size - off) {
+                /* Last chunk: read whole sectors */
+                len = (size - off + DISK_SECTOR_SIZE - 1) &
+                    ~(DISK_SECTOR_SIZE - 1);
+            }
+            ret = disk_read_queued(drv, part, off, len, dst + off);
+            if (ret < 0)
+                break;
+            tags[issued % depth] = ret;
+            issued++;
+        }
+        if ((ret < 0) && (ret != ATA_ERR_BUSY))
+            break;
+#ifdef DISK_HASH_ON_LOAD
+        /* Hash the chunks already in RAM while the drive serves the queue */
+        while (hashed < done) {
+            if (disk_hash_chunk(hashed, size, dst, img, ctx) < 0)
+                break;
+            hashed++;
+        }
+        if (hashed < done) {
+            ret = -1;
+            break;
+        }
+#endif
+        ret = ata_queue_complete(drv, tags[done % depth]);
+        if (ret == ATA_ERR_BUSY)
+            continue;
+        if (ret < 0)
+            break;
+        done++;
+    }
+    if (done < n_chunks) {
+        /* Release the tags still in flight before returning */
+        while (done < issued) {
+            if (ata_queue_complete(drv, tags[done % depth]) != ATA_ERR_BUSY)
+                done++;
+        }
+        return -1;
+    }
+#ifdef DISK_HASH_ON_LOAD
+    while (hashed < done) {
+        if (disk_hash_chunk(hashed, size, dst, img, ctx) < 0)
+            return -1;
+        hashed++;
+    }
+#endif
+    return 0;
+}
+#endif /* WOLFBOOT_ATA_NCQ */
+
 /**
  * @brief function for starting the boot process.
  *
@@ -89,7 +236,12 @@ void RAMFUNCTION wolfBoot_start(void)
     uint32_t img_size = 0;
     uint32_t *load_address;
     int failures = 0;
+#ifndef WOLFBOOT_ATA_NCQ
     uint32_t load_off;
+#endif
+#ifdef DISK_HASH_ON_LOAD
+    wolfBoot_hash_t hash_ctx;
+#endif
     uint32_t sata_bar;
 
 #if defined(WOLFBOOT_FSP)
@@ -170,6 +322,17 @@ void RAMFUNCTION wolfBoot_start(void)
                             (uint32_t)(uintptr_t)load_address + img_size,
                             "ELF");
         wolfBoot_printf("Loading image from disk...");
+#ifdef WOLFBOOT_ATA_NCQ
+    #ifdef DISK_HASH_ON_LOAD
+        ret = disk_load_queued(BOOT_DISK, cur_part,
+                img_size + IMAGE_HEADER_SIZE, (uint8_t *)load_address,
+                &os_image, &hash_ctx);
+    #else
+        ret = disk_load_queued(BOOT_DISK, cur_part,
+                img_size + IMAGE_HEADER_SIZE, (uint8_t *)load_address,
+                NULL, NULL);
+    #endif
+#else
         load_off = 0;
         do {
             ret = disk_read(BOOT_DISK, cur_part, load_off, 512,
@@ -178,6 +341,7 @@ void RAMFUNCTION wolfBoot_start(void)
                 break;
             load_off += ret;
         } while (load_off < img_size + IMAGE_HEADER_SIZE);
+#endif
 
         if (ret < 0) {
             wolfBoot_printf("Error reading image from disk: p%d\r\n",
@@ -186,15 +350,22 @@ void RAMFUNCTION wolfBoot_start(void)
             continue;
         }
         wolfBoot_printf("done.\r\n");
+#ifndef DISK_HASH_ON_LOAD
         ret = wolfBoot_open_image_address(&os_image, (void *)load_address);
         if (ret < 0) {
             wolfBoot_printf("Error parsing loaded image\r\n");
             selected ^= 1;
             continue;
         }
+#endif
 
         wolfBoot_printf("Checking image integrity...");
-        if (wolfBoot_verify_integrity(&os_image) != 0) {
+#ifdef DISK_HASH_ON_LOAD
+        ret = wolfBoot_verify_integrity_hash(&os_image, &hash_ctx);
+#else
+        ret = wolfBoot_verify_integrity(&os_image);
+#endif
+        if (ret != 0) {
             wolfBoot_printf("Error validating integrity for partition %c\r\n",
                     'A' + selected);
             selected ^= 1;
@@ -132,8 +132,8 @@ void RAMFUNCTION wolfBoot_check_self_update(void)
 }
 #endif /* RAM_CODE for self_update */
 
-static int RAMFUNCTION wolfBoot_copy_sector(struct wolfBoot_image *src,
-    struct wolfBoot_image *dst, uint32_t sector)
+static int RAMFUNCTION wolfBoot_copy_sector_ex(struct wolfBoot_image *src,
+    struct wolfBoot_image *dst, uint32_t sector, int erase)
 {
     uint32_t pos = 0;
     uint32_t src_sector_offset = (sector * WOLFBOOT_SECTOR_SIZE);
@@ -170,13 +170,16 @@ static int RAMFUNCTION wolfBoot_copy_sector(struct wolfBoot_image *src,
     crypto_set_iv(nonce, iv_counter);
 #endif
 
+    /* The destination may have been erased already, with its neighbours */
+    if (erase)
+        wb_flash_erase(dst, dst_sector_offset, WOLFBOOT_SECTOR_SIZE);
+
 #ifdef EXT_FLASH
     if (PART_IS_EXT(src)) {
 #ifndef BUFFER_DECLARED
 #define BUFFER_DECLARED
         static uint8_t buffer[FLASHBUFFER_SIZE] XALIGNED(4);
 #endif
-        wb_flash_erase(dst, dst_sector_offset, WOLFBOOT_SECTOR_SIZE);
         while (pos < WOLFBOOT_SECTOR_SIZE)  {
           if (src_sector_offset + pos <
               (src->fw_size + IMAGE_HEADER_SIZE + FLASHBUFFER_SIZE)) {
@@ -198,18 +201,22 @@ static int RAMFUNCTION wolfBoot_copy_sector(struct wolfBoot_image *src,
         return pos;
     }
 #endif
-    wb_flash_erase(dst, dst_sector_offset, WOLFBOOT_SECTOR_SIZE);
-    while (pos < WOLFBOOT_SECTOR_SIZE) {
-        if (src_sector_offset + pos < (src->fw_size + IMAGE_HEADER_SIZE +
-            FLASHBUFFER_SIZE))  {
-            uint8_t *orig = (uint8_t*)(src->hdr + src_sector_offset + pos);
-            wb_flash_write(dst, dst_sector_offset + pos, orig, FLASHBUFFER_SIZE);
-        }
+    /* Source is memory mapped: copy the used part of the sector at once */
+    while ((pos < WOLFBOOT_SECTOR_SIZE) &&
+           (src_sector_offset + pos < (src->fw_size + IMAGE_HEADER_SIZE +
+            FLASHBUFFER_SIZE))) {
         pos += FLASHBUFFER_SIZE;
     }
-    return pos;
+    if (pos > 0) {
+        wb_flash_write_bulk(dst, dst_sector_offset,
+            src->hdr + src_sector_offset, pos);
+    }
+    return WOLFBOOT_SECTOR_SIZE;
 }
 
+#define wolfBoot_copy_sector(src, dst, sector) \
+    wolfBoot_copy_sector_ex(src, dst, sector, 1)
+
 #ifdef EXT_ENCRYPTED
 static int RAMFUNCTION wolfBoot_backup_last_boot_sector(uint32_t sector)
 {
@@ -347,10 +354,12 @@ static int RAMFUNCTION wolfBoot_swap_and_final_erase(int resume)
     /* If update state isn't set to FINAL_FLAGS, this is the first run of the function */
     /* IMG_STATE_FINAL_FLAGS allows re-entry without blowing away swap */
     if (updateState != IMG_STATE_FINAL_FLAGS) {
+#ifndef WOLFBOOT_SWAP_MOVE /* free sector, never part of the image */
         /* First, backup the staging sector (sector at tmpBootPos) into swap partition */
         /* This sector will be modified with the magic trailer, so we need to preserve it */
         wolfBoot_backup_last_boot_sector(tmpBootPos / WOLFBOOT_SECTOR_SIZE);
         wolfBoot_printf("Copied boot sector to swap\n");
+#endif
         /* Mark update as being in final swap phase to allow resumption if power fails */
         wolfBoot_set_partition_state(PART_UPDATE, IMG_STATE_FINAL_FLAGS);
     }
@@ -433,6 +442,11 @@ static int wolfBoot_delta_update(struct wolfBoot_image *boot,
     uint8_t *delta_base_hash;
     uint16_t base_hash_sz;
     uint8_t *base_hash;
+    uint8_t *base_hdr;
+#if defined(EXT_FLASH) && defined(PART_BOOT_EXT)
+    /* Base image header, read from the external flash */
+    static uint8_t boot_hdr[IMAGE_HEADER_SIZE] XALIGNED(4);
+#endif
 
     /* Use biggest size for the swap */
     total_size = boot->fw_size + IMAGE_HEADER_SIZE;
@@ -467,14 +481,20 @@ static int wolfBoot_delta_update(struct wolfBoot_image *boot,
         }
     }
 
+#if defined(EXT_FLASH) && defined(PART_BOOT_EXT)
+    ext_flash_read((uintptr_t)boot->hdr, boot_hdr, IMAGE_HEADER_SIZE);
+    base_hdr = boot_hdr;
+#else
+    base_hdr = boot->hdr;
+#endif
 #if defined(WOLFBOOT_HASH_SHA256)
-    base_hash_sz = wolfBoot_find_header(boot->hdr + IMAGE_HEADER_OFFSET,
+    base_hash_sz = wolfBoot_find_header(base_hdr + IMAGE_HEADER_OFFSET,
             HDR_SHA256, &base_hash);
 #elif defined(WOLFBOOT_HASH_SHA384)
-    base_hash_sz = wolfBoot_find_header(boot->hdr + IMAGE_HEADER_OFFSET,
+    base_hash_sz = wolfBoot_find_header(base_hdr + IMAGE_HEADER_OFFSET,
             HDR_SHA384, &base_hash);
 #elif defined(WOLFBOOT_HASH_SHA3_384)
-    base_hash_sz = wolfBoot_find_header(boot->hdr + IMAGE_HEADER_OFFSET,
+    base_hash_sz = wolfBoot_find_header(base_hdr + IMAGE_HEADER_OFFSET,
             HDR_SHA3_384, &base_hash);
 #else
     #error "Delta update: Fatal error, no hash algorithm defined!"
@@ -569,11 +589,17 @@ static int wolfBoot_delta_update(struct wolfBoot_image *boot,
         if (sector == 0) {
             /* New total image size after first sector is patched */
             volatile uint32_t update_size;
+#if defined(EXT_FLASH) && defined(PART_BOOT_EXT)
+            ext_flash_read((uintptr_t)WOLFBOOT_PARTITION_BOOT_ADDRESS,
+                    boot_hdr, 2 * sizeof(uint32_t));
+            update_size = wolfBoot_image_size(boot_hdr) + IMAGE_HEADER_SIZE;
+#else
             hal_flash_lock();
             update_size =
                 wolfBoot_image_size((uint8_t *)WOLFBOOT_PARTITION_BOOT_ADDRESS)
                 + IMAGE_HEADER_SIZE;
             hal_flash_unlock();
+#endif
             if (update_size > total_size)
                 total_size = update_size;
             if (total_size <= IMAGE_HEADER_SIZE) {
@@ -590,6 +616,19 @@ static int wolfBoot_delta_update(struct wolfBoot_image *boot,
     }
     ret = 0;
     /* erase to the last sector, writeonce has 2 sectors */
+#ifdef WOLFBOOT_FLASH_MULTI_SECTOR_ERASE
+    {
+    #ifdef NVM_FLASH_WRITEONCE
+        uint32_t end = WOLFBOOT_PARTITION_SIZE - 2 * WOLFBOOT_SECTOR_SIZE;
+    #else
+        uint32_t end = WOLFBOOT_PARTITION_SIZE - WOLFBOOT_SECTOR_SIZE;
+    #endif
+        if ((sector * WOLFBOOT_SECTOR_SIZE) < end) {
+            wb_flash_erase_range(boot, sector * WOLFBOOT_SECTOR_SIZE,
+                end - (sector * WOLFBOOT_SECTOR_SIZE));
+        }
+    }
+#else
     while((sector * WOLFBOOT_SECTOR_SIZE) < WOLFBOOT_PARTITION_SIZE -
         WOLFBOOT_SECTOR_SIZE
 #ifdef NVM_FLASH_WRITEONCE
@@ -599,6 +638,7 @@ static int wolfBoot_delta_update(struct wolfBoot_image *boot,
         wb_flash_erase(boot, sector * WOLFBOOT_SECTOR_SIZE, WOLFBOOT_SECTOR_SIZE);
         sector++;
     }
+#endif
 out:
 #ifdef EXT_FLASH
     ext_flash_lock();
@@ -618,6 +658,126 @@ out:
 
 #endif
 
+#if !defined(DISABLE_BACKUP) && (WOLFBOOT_SWAP_SECTORS > 1)
+/* Multi-sector swap: the sectors of the BOOT and UPDATE partitions are moved
+ * in groups of up to WOLFBOOT_SWAP_SECTORS, sector n going through slot
+ * (n % WOLFBOOT_SWAP_SECTORS) of the swap partition. Each step of the
+ * three-way swap is done for the whole group: the destination sectors are
+ * erased together, then programmed, then the sector flags of the group are
+ * written at once. The flags still record the progress of each sector, so
+ * an interrupted step is resumed only for the sectors that need it.
+ */
+static int RAMFUNCTION wolfBoot_swap_flag_rank(uint8_t flag)
+{
+    switch (flag) {
+        case SECT_FLAG_NEW:
+            return 0;
+        case SECT_FLAG_SWAPPING:
+            return 1;
+        case SECT_FLAG_BACKUP:
+            return 2;
+        default:
+            return 3;
+    }
+}
+
+static void RAMFUNCTION wolfBoot_swap_group_step(struct wolfBoot_image *src,
+    struct wolfBoot_image *dst, uint32_t first, uint32_t count,
+    uint8_t *flags, uint8_t newflag)
+{
+    const uint32_t sector_size = WOLFBOOT_SECTOR_SIZE;
+    struct wolfBoot_image slot;
+    struct wolfBoot_image *s, *d;
+    uint32_t i, n, run, off;
+    int todo[WOLFBOOT_SWAP_SECTORS];
+
+    for (i = 0; i < count; i++) {
+        todo[i] = wolfBoot_swap_flag_rank(flags[i]) <
+            wolfBoot_swap_flag_rank(newflag);
+    }
+
+    /* Erase the destination, one call for each run of sectors */
+    for (i = 0; i < count; i += run) {
+        run = 1;
+        if (!todo[i])
+            continue;
+        while ((i + run < count) && todo[i + run])
+            run++;
+        off = first + i;
+        if (dst->part == PART_SWAP)
+            off %= WOLFBOOT_SWAP_SECTORS;
+#ifdef WOLFBOOT_FLASH_MULTI_SECTOR_ERASE
+        wb_flash_erase_range(dst, off * sector_size, run * sector_size);
+#else
+        wb_flash_erase(dst, off * sector_size, run * sector_size);
+#endif
+    }
+
+    for (i = 0; i < count; i++) {
+        if (!todo[i])
+            continue;
+        s = src;
+        d = dst;
+        if ((src->part == PART_SWAP) || (dst->part == PART_SWAP)) {
+            /* wolfBoot_copy_sector() uses the start of the swap partition */
+            slot = (src->part == PART_SWAP) ? *src : *dst;
+            slot.hdr += ((first + i) % WOLFBOOT_SWAP_SECTORS) * sector_size;
+            if (src->part == PART_SWAP)
+                s = &slot;
+            else
+                d = &slot;
+        }
+        wolfBoot_copy_sector_ex(s, d, first + i, 0);
+    }
+
+    /* Flags of the group, skipping the sector that holds the trailer */
+    for (i = 0; i < count; i += run) {
+        run = 1;
+        if (!todo[i])
+            continue;
+        while ((i + run < count) && todo[i + run])
+            run++;
+        n = run;
+        while ((n > 0) &&
+                (((first + i + n) * sector_size) >= WOLFBOOT_PARTITION_SIZE))
+            n--;
+        if (n > 0)
+            wolfBoot_set_update_sector_flags(first + i, n, newflag);
+    }
+    for (i = 0; i < count; i++) {
+        if (todo[i])
+            flags[i] = newflag;
+    }
+}
+#endif /* !DISABLE_BACKUP && WOLFBOOT_SWAP_SECTORS > 1 */
+
+#if !defined(DISABLE_BACKUP) && defined(WOLFBOOT_SWAP_MOVE)
+#if defined(EXT_ENCRYPTED) || (WOLFBOOT_SWAP_SECTORS > 1)
+#error "WOLFBOOT_SWAP_MOVE is not compatible with EXT_ENCRYPTED or SWAP_SECTORS"
+#endif
+
+/* Copy a whole sector of src into a (possibly different) sector of dst.
+ * wolfBoot_copy_sector() uses the same offset in both partitions: shift the
+ * start of one of the two images instead. */
+static int RAMFUNCTION wolfBoot_move_sector(struct wolfBoot_image *src,
+    uint32_t src_sector, struct wolfBoot_image *dst, uint32_t dst_sector)
+{
+    struct wolfBoot_image s = *src, d = *dst;
+    uint32_t sector = dst_sector;
+
+    if (src_sector > dst_sector)
+        s.hdr += (src_sector - dst_sector) * WOLFBOOT_SECTOR_SIZE;
+    else if (dst_sector > src_sector) {
+        d.hdr += (dst_sector - src_sector) * WOLFBOOT_SECTOR_SIZE;
+        sector = src_sector;
+    }
+    /* Sectors are moved regardless of the size in the header, which is not
+     * where it belongs while the images are being moved */
+    s.fw_size = WOLFBOOT_PARTITION_SIZE;
+    return wolfBoot_copy_sector(&s, &d, sector);
+}
+#endif /* !DISABLE_BACKUP && WOLFBOOT_SWAP_MOVE */
+
 
 #ifdef WOLFBOOT_ARMORED
 #    ifdef __GNUC__
@@ -628,11 +788,19 @@ out:
 #    endif
 #endif
 
+/* The BOOT image is moved up by one sector during a WOLFBOOT_SWAP_MOVE
+ * update: the sector before the trailer must stay free */
+#if !defined(DISABLE_BACKUP) && defined(WOLFBOOT_SWAP_MOVE)
+    #define SWAP_MOVE_SPARE_SIZE WOLFBOOT_SECTOR_SIZE
+#else
+    #define SWAP_MOVE_SPARE_SIZE 0
+#endif
+
 /* Reserve space for two sectors in case of NVM_FLASH_WRITEONCE, for redundancy */
 #ifndef NVM_FLASH_WRITEONCE
-    #define MAX_UPDATE_SIZE (size_t)((WOLFBOOT_PARTITION_SIZE - WOLFBOOT_SECTOR_SIZE))
+    #define MAX_UPDATE_SIZE (size_t)((WOLFBOOT_PARTITION_SIZE - WOLFBOOT_SECTOR_SIZE - SWAP_MOVE_SPARE_SIZE))
 #else
-    #define MAX_UPDATE_SIZE (size_t)((WOLFBOOT_PARTITION_SIZE - (2 *WOLFBOOT_SECTOR_SIZE)))
+    #define MAX_UPDATE_SIZE (size_t)((WOLFBOOT_PARTITION_SIZE - (2 *WOLFBOOT_SECTOR_SIZE) - SWAP_MOVE_SPARE_SIZE))
 #endif
 
 static int wolfBoot_get_total_size(struct wolfBoot_image* boot,
@@ -660,8 +828,14 @@ static int RAMFUNCTION wolfBoot_update(int fallback_allowed)
     uint8_t flag = SECT_FLAG_NEW;
     struct wolfBoot_image boot, update, swap;
     uint16_t update_type;
+#ifndef WOLFBOOT_SWAP_MOVE
     uint32_t fw_size;
+#endif
     uint32_t size;
+#if !defined(DISABLE_BACKUP) && (WOLFBOOT_SWAP_SECTORS > 1)
+    uint8_t flags[WOLFBOOT_SWAP_SECTORS];
+    uint32_t i, count;
+#endif
 #if defined(DISABLE_BACKUP) && defined(EXT_ENCRYPTED)
     uint8_t key[ENCRYPT_KEY_SIZE];
     uint8_t nonce[ENCRYPT_NONCE_SIZE];
@@ -708,6 +882,14 @@ static int RAMFUNCTION wolfBoot_update(int fallback_allowed)
             wolfBoot_printf("Invalid update size %u\n", update.fw_size);
             return -1;
         }
+#if !defined(DISABLE_BACKUP) && defined(WOLFBOOT_SWAP_MOVE)
+        /* The current image is moved too */
+        if (total_size > MAX_UPDATE_SIZE) {
+            wolfBoot_printf("Current image too large to be moved (%u)\n",
+                total_size);
+            return -1;
+        }
+#endif
         if (!update.hdr_ok
                 || (wolfBoot_verify_integrity(&update) < 0)
                 || (wolfBoot_verify_authenticity(&update) < 0)) {
@@ -735,6 +917,11 @@ static int RAMFUNCTION wolfBoot_update(int fallback_allowed)
 #endif
     }
 
+#ifdef WOLFBOOT_VERIFY_CACHE
+    /* The BOOT partition is about to change */
+    wolfBoot_verify_cache_invalidate();
+#endif
+
 #ifdef DELTA_UPDATES
     if ((update_type & 0x00F0) == HDR_IMG_TYPE_DIFF) {
         cur_v = wolfBoot_current_firmware_version();
@@ -784,11 +971,84 @@ static int RAMFUNCTION wolfBoot_update(int fallback_allowed)
     ext_flash_unlock();
     #endif
 
+#ifdef WOLFBOOT_SWAP_MOVE
+    /* Swap without the swap partition, using the free sector at the end of
+     * the BOOT partition as a hole that moves through the image.
+     * The status is saved in the sector flags of the update partition:
+     * SWAPPING: BOOT sector moved up by one
+     * BACKUP:   UPDATE sector copied into the BOOT partition
+     * UPDATED:  former BOOT sector copied into the UPDATE partition
+     * If something goes wrong, the operation will be resumed upon reboot.
+     */
+
+    /* 1. Move the BOOT image up by one sector, starting from the end. The
+     * headers are not touched until all the sectors are moved. */
+    for (sector = (total_size + sector_size - 1) / sector_size; sector > 0;
+            sector--) {
+        flag = SECT_FLAG_NEW;
+        wolfBoot_get_update_sector_flag(sector - 1, &flag);
+        if (flag == SECT_FLAG_NEW) {
+            wolfBoot_move_sector(&boot, sector - 1, &boot, sector);
+            wolfBoot_set_update_sector_flag(sector - 1, SECT_FLAG_SWAPPING);
+        }
+    }
+
+    /* 2. Move the hole up: the new sector goes into the hole, and the former
+     * BOOT sector, one sector above, into the UPDATE partition */
+    while ((sector * sector_size) < total_size) {
+        flag = SECT_FLAG_NEW;
+        wolfBoot_get_update_sector_flag(sector, &flag);
+        switch (flag) {
+            case SECT_FLAG_SWAPPING:
+                wolfBoot_move_sector(&update, sector, &boot, sector);
+                wolfBoot_set_update_sector_flag(sector, SECT_FLAG_BACKUP);
+                /* FALL THROUGH */
+            case SECT_FLAG_BACKUP:
+                wolfBoot_move_sector(&boot, sector + 1, &update, sector);
+                wolfBoot_set_update_sector_flag(sector, SECT_FLAG_UPDATED);
+                break;
+            case SECT_FLAG_UPDATED:
+                /* FALL THROUGH */
+            default:
+                break;
+        }
+        sector++;
+
+        /* both headers are in place again: recalculate total_size, which
+         * could be invalid if the power failed while moving the first
+         * sector */
+        if (sector == 1) {
+            wolfBoot_open_image(&boot, PART_BOOT);
+            wolfBoot_open_image(&update, PART_UPDATE);
+            total_size = wolfBoot_get_total_size(&boot, &update);
+        }
+    }
+#else
     /* Interruptible swap
      * The status is saved in the sector flags of the update partition.
      * If something goes wrong, the operation will be resumed upon reboot.
      */
     while ((sector * sector_size) < total_size) {
+#if WOLFBOOT_SWAP_SECTORS > 1
+        /* Groups are aligned to the size of the swap partition, so that a
+         * sector always goes through the same swap slot */
+        count = WOLFBOOT_SWAP_SECTORS - (sector % WOLFBOOT_SWAP_SECTORS);
+        if (((sector + count) * sector_size) > total_size) {
+            count = (total_size - (sector * sector_size) + sector_size - 1) /
+                sector_size;
+        }
+        for (i = 0; i < count; i++) {
+            flags[i] = SECT_FLAG_NEW;
+            wolfBoot_get_update_sector_flag(sector + i, &flags[i]);
+        }
+        wolfBoot_swap_group_step(&update, &swap, sector, count, flags,
+            SECT_FLAG_SWAPPING);
+        wolfBoot_swap_group_step(&boot, &update, sector, count, flags,
+            SECT_FLAG_BACKUP);
+        wolfBoot_swap_group_step(&swap, &boot, sector, count, flags,
+            SECT_FLAG_UPDATED);
+        sector += count;
+#else
         flag = SECT_FLAG_NEW;
         wolfBoot_get_update_sector_flag(sector, &flag);
         switch (flag) {
@@ -822,12 +1082,17 @@ static int RAMFUNCTION wolfBoot_update(int fallback_allowed)
                 break;
         }
         sector++;
+#endif
 
         /* headers that can be in different positions depending on when the
          * power fails are now in a known state, re-read and swap fw_size
          * because the locations are correct but the metadata is now swapped
          * also recalculate total_size since it could be invalid */
+#if WOLFBOOT_SWAP_SECTORS > 1
+        if (sector == count) {
+#else
         if (sector == 1) {
+#endif
             wolfBoot_open_image(&boot, PART_BOOT);
             wolfBoot_open_image(&update, PART_UPDATE);
 
@@ -840,9 +1105,11 @@ static int RAMFUNCTION wolfBoot_update(int fallback_allowed)
             total_size = wolfBoot_get_total_size(&boot, &update);
         }
     }
+#endif /* WOLFBOOT_SWAP_MOVE */
 
     /* Erase remainder of partition */
-#if defined(WOLFBOOT_FLASH_MULTI_SECTOR_ERASE) || defined(PRINTF_ENABLED)
+#if defined(WOLFBOOT_FLASH_MULTI_SECTOR_ERASE) || \
+    defined(WOLFBOOT_FLASH_BLANK_CHECK) || defined(PRINTF_ENABLED)
     /* calculate number of remaining bytes */
     /* reserve 1 sector for status (2 sectors for NV write once) */
 #ifdef NVM_FLASH_WRITEONCE
@@ -855,12 +1122,15 @@ static int RAMFUNCTION wolfBoot_update(int fallback_allowed)
         size/sector_size);
 #endif
 
-#ifdef WOLFBOOT_FLASH_MULTI_SECTOR_ERASE
-    /* Erase remainder of flash sectors in one HAL command. */
-    /* This can improve performance if the HAL supports erase of
-     * multiple sectors */
-    wb_flash_erase(&boot, sector * sector_size, size);
-    wb_flash_erase(&update, sector * sector_size, size);
+#if defined(WOLFBOOT_FLASH_BLANK_CHECK)
+    /* Most of the remainder is usually blank: only erase what was written */
+    wb_flash_erase_written(&boot, sector * sector_size, size);
+    wb_flash_erase_written(&update, sector * sector_size, size);
+#elif defined(WOLFBOOT_FLASH_MULTI_SECTOR_ERASE)
+    /* Erase remainder of flash sectors with the largest erase operations
+     * the HAL supports (see hal_flash_erase_granularity()) */
+    wb_flash_erase_range(&boot, sector * sector_size, size);
+    wb_flash_erase_range(&update, sector * sector_size, size);
 #else
     /* Iterate over every remaining sector and erase individually. */
     /* This loop is smallest code size */
@@ -899,8 +1169,9 @@ static int RAMFUNCTION wolfBoot_update(int fallback_allowed)
     if (wolfBoot_check_flash_image_elf(PART_BOOT, &entry) < 0) {
         wolfBoot_printf("ELF Scattered image digest check: failed. Restoring "
                         "scattered image...\n");
-        wolfBoot_load_flash_image_elf(PART_BOOT, &entry, PART_IS_EXT(boot));
-        if (wolfBoot_check_flash_image_elf(PART_BOOT, &entry) < 0) {
+        /* Segments are hashed as they are written, no need to check again */
+        if (wolfBoot_load_flash_image_elf(PART_BOOT, &entry,
+                                          PART_IS_EXT(boot)) != 0) {
             wolfBoot_printf(
                 "Fatal: Could not verify digest after scattering. Panic().\n");
             wolfBoot_panic();
@@ -934,10 +1205,22 @@ static int RAMFUNCTION wolfBoot_update(int fallback_allowed)
     wolfBoot_printf("Erasing remainder of partition (%d sectors)...\n",
         size/sector_size);
 #endif
+#if defined(WOLFBOOT_FLASH_BLANK_CHECK)
+    if ((sector * sector_size) < WOLFBOOT_PARTITION_SIZE) {
+        wb_flash_erase_written(&boot, sector * sector_size,
+            WOLFBOOT_PARTITION_SIZE - (sector * sector_size));
+    }
+#elif defined(WOLFBOOT_FLASH_MULTI_SECTOR_ERASE)
+    if ((sector * sector_size) < WOLFBOOT_PARTITION_SIZE) {
+        wb_flash_erase_range(&boot, sector * sector_size,
+            WOLFBOOT_PARTITION_SIZE - (sector * sector_size));
+    }
+#else
     while ((sector * sector_size) < WOLFBOOT_PARTITION_SIZE) {
         wb_flash_erase(&boot, sector * sector_size, sector_size);
         sector++;
     }
+#endif
 
 
     wolfBoot_set_partition_state(PART_BOOT, IMG_STATE_SUCCESS);
@@ -1210,8 +1493,12 @@ void RAMFUNCTION wolfBoot_start(void)
     //     wolfBoot_get_blob_version(boot.hdr));
 
     if (bootRet < 0
+#ifdef WOLFBOOT_VERIFY_CACHE
+            || (wolfBoot_verify_cached(&boot) < 0)
+#else
             || (wolfBoot_verify_integrity(&boot) < 0)
             || (wolfBoot_verify_authenticity(&boot) < 0)
+#endif
     ) {
         wolfBoot_printf("Boot failed: Hdr %d, Hash %d, Sig %d\n",
             boot.hdr_ok, boot.sha_ok, boot.signature_ok);
@@ -1247,13 +1534,9 @@ void RAMFUNCTION wolfBoot_start(void)
     if (wolfBoot_check_flash_image_elf(PART_BOOT, &entry) < 0) {
         wolfBoot_printf("ELF Scattered image digest check: failed. Restoring "
                         "scattered image...\n");
+        /* Segments are hashed as they are written, no need to check again */
         if (wolfBoot_load_flash_image_elf(PART_BOOT, &entry,
-                                          PART_IS_EXT(&boot)) < 0) {
-            wolfBoot_printf(
-                "ELF: [BOOT] ERROR: could not store scattered image\n");
-            wolfBoot_panic();
-        }
-        if (wolfBoot_check_flash_image_elf(PART_BOOT, &entry) < 0) {
+                                          PART_IS_EXT(&boot)) != 0) {
             wolfBoot_printf(
                 "Fatal: Could not verify digest after scattering. Panic().\n");
             wolfBoot_panic();
@@ -51,8 +51,12 @@ void RAMFUNCTION wolfBoot_start(void)
 
     for (;;) {
         if ((wolfBoot_open_image(&fw_image, active) < 0) ||
+#ifdef WOLFBOOT_VERIFY_CACHE
+            (wolfBoot_verify_cached(&fw_image) < 0)) {
+#else
             (wolfBoot_verify_integrity(&fw_image) < 0) ||
             (wolfBoot_verify_authenticity(&fw_image) < 0)) {
+#endif
 
             /* panic if authentication fails and no backup */
             if (!wolfBoot_fallback_is_possible())
@@ -50,6 +50,15 @@ extern uint32_t dts_load_addr;
     #define WOLFBOOT_USE_RAMBOOT
 #endif
 
+#if defined(WOLFBOOT_USE_RAMBOOT) && defined(WOLFBOOT_RAMBOOT_HASH_ON_LOAD) && \
+    !(defined(EXT_ENCRYPTED) && defined(MMU))
+    /* Hash the image while it is copied to RAM (single pass) */
+    #define RAMBOOT_HASH_ON_LOAD
+    #ifndef WOLFBOOT_RAMBOOT_CHUNK_SIZE
+    #define WOLFBOOT_RAMBOOT_CHUNK_SIZE 4096
+    #endif
+#endif
+
 #ifdef WOLFBOOT_USE_RAMBOOT
 
 /* Function to load image from flash to ram */
@@ -57,6 +66,10 @@ int wolfBoot_ramboot(struct wolfBoot_image *img, uint8_t *src, uint8_t *dst)
 {
     int ret;
     uint32_t img_size;
+#ifdef RAMBOOT_HASH_ON_LOAD
+    wolfBoot_hash_t hash_ctx;
+    uint32_t off, len;
+#endif
 
     /* read header into RAM */
     wolfBoot_printf("Loading header %d bytes from %p to %p\n",
@@ -81,6 +94,44 @@ int wolfBoot_ramboot(struct wolfBoot_image *img, uint8_t *src, uint8_t *dst)
     /* determine size of partition */
     img_size = wolfBoot_image_size((uint8_t*)dst);
 
+#ifdef RAMBOOT_HASH_ON_LOAD
+    /* Parse the header in RAM and start hashing it */
+    img->sha_ok = 0;
+    img->hdr = NULL;
+    img->hdr_ok = 0;
+    img->not_ext = 1;
+    if ((wolfBoot_open_image_address(img, dst) < 0) ||
+            (wolfBoot_image_hash_init(img, &hash_ctx) < 0)) {
+        wolfBoot_printf("Error parsing header at %p\n", src);
+        return -1;
+    }
+    img_size = img->fw_size;
+
+    /* Load the image in chunks, hashing each chunk while still in cache */
+    wolfBoot_printf("Loading and hashing image %d bytes from %p to %p\n",
+        img_size, src + IMAGE_HEADER_SIZE, dst + IMAGE_HEADER_SIZE);
+    for (off = 0; off < img_size; off += len) {
+        uint8_t *chunk = dst + IMAGE_HEADER_SIZE + off;
+        len = img_size - off;
+        if (len > WOLFBOOT_RAMBOOT_CHUNK_SIZE)
+            len = WOLFBOOT_RAMBOOT_CHUNK_SIZE;
+    #if defined(EXT_FLASH) && defined(NO_XIP)
+        ret = ext_flash_read((uintptr_t)src + IMAGE_HEADER_SIZE + off,
+            chunk, len);
+        if (ret < 0) {
+            wolfBoot_printf("Error reading image at %p\n", src);
+            return -1;
+        }
+    #else
+        memcpy(chunk, src + IMAGE_HEADER_SIZE + off, len);
+    #endif
+        update_hash(&hash_ctx, chunk, len);
+    }
+    if (wolfBoot_verify_integrity_hash(img, &hash_ctx) < 0) {
+        wolfBoot_printf("Integrity check failed for image at %p\n", src);
+        return -1;
+    }
+#else
     /* Read the entire image into RAM */
     wolfBoot_printf("Loading image %d bytes from %p to %p\n",
         img_size, src + IMAGE_HEADER_SIZE, dst + IMAGE_HEADER_SIZE);
@@ -94,6 +145,7 @@ int wolfBoot_ramboot(struct wolfBoot_image *img, uint8_t *src, uint8_t *dst)
 #else
     memcpy(dst + IMAGE_HEADER_SIZE, src + IMAGE_HEADER_SIZE, img_size);
 #endif
+#endif /* RAMBOOT_HASH_ON_LOAD */
 
     /* mark image as no longer external */
     img->not_ext = 1;
@@ -169,8 +221,17 @@ void RAMFUNCTION wolfBoot_start(void)
         ret = wolfBoot_open_image(&os_image, active);
     #endif
         if ( (ret < 0) ||
+    #if defined(WOLFBOOT_VERIFY_CACHE) && !defined(WOLFBOOT_USE_RAMBOOT)
+            ((ret = wolfBoot_verify_cached(&os_image)) < 0)) {
+    #else
+    #ifdef RAMBOOT_HASH_ON_LOAD
+            /* Already hashed by wolfBoot_ramboot() while loading */
+            (os_image.sha_ok != 1) ||
+    #else
             ((ret = wolfBoot_verify_integrity(&os_image) < 0)) ||
+    #endif
             ((ret = wolfBoot_verify_authenticity(&os_image)) < 0)) {
+    #endif
             goto backup_on_failure;
 
         } else {
@@ -24,20 +24,101 @@
 #include "wolfssl/wolfcrypt/ecc.h"
 #include "wolfssl/wolfcrypt/aes.h"
 #include "wolfssl/wolfcrypt/random.h"
+#include "wolfssl/wolfcrypt/error-crypt.h"
 #include "wolfboot/wolfboot.h"
 #include "wolfboot/wc_secure.h"
 #include "hal.h"
 #include <stdint.h>
+#include <string.h>
+
+/* Number of requests served by one DRBG instance before it is instantiated
+ * again from fresh TRNG entropy. The Hash-DRBG also reseeds itself every
+ * RESEED_INTERVAL blocks.
+ */
+#ifndef WCS_RNG_RESEED_REQUESTS
+    #define WCS_RNG_RESEED_REQUESTS 4096
+#endif
+
+static WC_RNG wcs_rng;
+static int wcs_rng_ready = 0;
+static uint32_t wcs_rng_requests = 0;
+
+#if defined(WCS_RNG_POOL_SIZE) && (WCS_RNG_POOL_SIZE > 0)
+/* Pre-generated random bytes, served from the end. Refilled by
+ * wcs_rng_refill(), e.g. from the idle loop of the non-secure application.
+ */
+static uint8_t wcs_rng_pool[WCS_RNG_POOL_SIZE];
+static uint32_t wcs_rng_pool_avail = 0;
+#endif
+
+static int wcs_rng_instantiate(void)
+{
+    int ret;
+    if (wcs_rng_ready) {
+        if (wcs_rng_requests < WCS_RNG_RESEED_REQUESTS)
+            return 0;
+        wc_FreeRng(&wcs_rng);
+        wcs_rng_ready = 0;
+    }
+    ret = wc_InitRng(&wcs_rng);
+    if (ret == 0) {
+        wcs_rng_ready = 1;
+        wcs_rng_requests = 0;
+    }
+    return ret;
+}
+
+static int wcs_rng_generate(uint8_t *out, uint32_t size)
+{
+    int ret = wcs_rng_instantiate();
+    if (ret == 0) {
+        ret = wc_RNG_GenerateBlock(&wcs_rng, out, size);
+        wcs_rng_requests++;
+        if (ret == RNG_FAILURE_E) {
+            /* Failed health test: drop the instance and try a new one */
+            wcs_rng_requests = WCS_RNG_RESEED_REQUESTS;
+            ret = wcs_rng_instantiate();
+            if (ret == 0) {
+                ret = wc_RNG_GenerateBlock(&wcs_rng, out, size);
+                wcs_rng_requests++;
+            }
+        }
+    }
+    return ret;
+}
 
 int __attribute__((cmse_nonsecure_entry))
 wcs_get_random(uint8_t *rand, uint32_t size)
 {
+#if defined(WCS_RNG_POOL_SIZE) && (WCS_RNG_POOL_SIZE > 0)
+    if (size <= wcs_rng_pool_avail) {
+        wcs_rng_pool_avail -= size;
+        memcpy(rand, wcs_rng_pool + wcs_rng_pool_avail, size);
+        /* Never hand out the same bytes twice */
+        memset(wcs_rng_pool + wcs_rng_pool_avail, 0, size);
+        return 0;
+    }
+#endif
+    return wcs_rng_generate(rand, size);
+}
+
+int __attribute__((cmse_nonsecure_entry))
+wcs_rng_refill(void)
+{
+#if defined(WCS_RNG_POOL_SIZE) && (WCS_RNG_POOL_SIZE > 0)
     int ret;
-    WC_RNG wcs_rng;
-    wc_InitRng(&wcs_rng);
-    ret = wc_RNG_GenerateBlock(&wcs_rng, rand, size);
-    wc_FreeRng(&wcs_rng);
+    if (wcs_rng_pool_avail == WCS_RNG_POOL_SIZE)
+        return 0;
+    ret = wcs_rng_generate(wcs_rng_pool, WCS_RNG_POOL_SIZE);
+    if (ret == 0)
+        wcs_rng_pool_avail = WCS_RNG_POOL_SIZE;
+    else
+        wcs_rng_pool_avail = 0;
     return ret;
+#else
+    /* No pool: only make sure the DRBG is ready for the next request */
+    return wcs_rng_instantiate();
+#endif
 }
 
 void wcs_Init(void)
@@ -41,6 +41,30 @@
 
 #define CACHE_INVALID 0xBADF00DBADC0FFEEULL
 
+/* Sector cache: ATA_CACHE_LINES lines of ATA_CACHE_LINE_SECTORS sectors each,
+ * with LRU replacement. ATA_CACHE_LINE_SECTORS must be a power of two.
+ */
+#ifndef ATA_CACHE_LINES
+#define ATA_CACHE_LINES 4
+#endif
+#ifndef ATA_CACHE_LINE_SECTORS
+#define ATA_CACHE_LINE_SECTORS 4
+#endif
+
+/* ahci.c reserves HBA_TBL_SIZE (0x800) bytes of command tables per port,
+ * which is room for eight `struct hba_cmd_table`, one per command slot.
+ */
+#define ATA_CMD_TABLE_SIZE 0x100
+#define ATA_MAX_CMD_SLOTS ATA_MAX_QUEUED_CMDS
+
+/* IDENTIFY DEVICE words 75/76: queue depth and Serial ATA capabilities */
+#define ATA_ID_QUEUE_DEPTH_POS 75 * 2
+#define ATA_ID_SATA_CAP_POS    76 * 2
+#define ATA_ID_SATA_CAP_NCQ    (1 << 8)
+
+/* Port recovery: link wait after a COMRESET, in ms */
+#define ATA_COMRESET_TRIES 1000
+
 #ifdef DEBUG_ATA
 /**
  * @brief This macro is used to conditionally print debug messages for the ATA
@@ -57,6 +81,7 @@
 
 
 static int ata_drive_count = -1;
+static void ata_invalidate_cache(int drv);
 struct ata_async_info{
     int in_progress;
     int drv;
@@ -64,6 +89,17 @@ struct ata_async_info{
 };
 
 static struct ata_async_info ata_async_info;
+/**
+ * @brief This structure holds a line of the sector cache: a block of
+ * consecutive sectors read from the disk with a single command.
+ */
+struct ata_cache_line {
+    uint8_t  data[ATA_CACHE_LINE_SECTORS * MAX_SECTOR_SIZE];
+    uint64_t start;     /* First sector in the line, or CACHE_INVALID */
+    uint32_t count;     /* Number of valid sectors in the line */
+    uint32_t last_use;  /* Value of cache_clock at the last access */
+};
+
 /**
  * @brief This structure holds the necessary information for an ATA drive,
  * including AHCI base address, AHCI port number, and sector cache.
@@ -75,9 +111,16 @@ struct ata_drive {
     uint32_t ctable_port;
     uint32_t fis_port;
     uint32_t sector_size_shift;
-    uint8_t  sector_cache[MAX_SECTOR_SIZE];
-    uint64_t cached;
+    struct ata_cache_line cache[ATA_CACHE_LINES];
+    uint32_t cache_clock;
     enum ata_security_state sec;
+#ifdef WOLFBOOT_ATA_NCQ
+    uint32_t queued;      /* slots with a queued read in flight */
+    uint32_t completed;   /* slots completed, not yet reaped */
+    uint32_t failed;      /* slots aborted by a port error */
+    uint32_t queue_depth; /* max number of reads in flight */
+    int ncq;              /* 1 if both HBA and device support NCQ */
+#endif
 };
 
 /**
@@ -205,7 +248,15 @@ int ata_drive_new(uint32_t ahci_base, unsigned ahci_port, uint32_t clb,
     ata->ctable_port = ctable;
     ata->fis_port = fis;
     ata->sector_size_shift = 9; /* 512 */
-    ata->cached = CACHE_INVALID;
+    ata->cache_clock = 0;
+    ata_invalidate_cache(ata_drive_count);
+#ifdef WOLFBOOT_ATA_NCQ
+    ata->queued = 0;
+    ata->completed = 0;
+    ata->failed = 0;
+    ata->queue_depth = 1;
+    ata->ncq = 0;
+#endif
     return ata_drive_count;
 }
 
@@ -226,7 +277,11 @@ static int find_cmd_slot(int drv)
     sact = mmio_read32((AHCI_PxSACT(ata->ahci_base, ata->ahci_port)));
     ci = mmio_read32((AHCI_PxCI(ata->ahci_base, ata->ahci_port)));
     slots = sact | ci;
-    for (i = 0; i < 32; i++) {
+#ifdef WOLFBOOT_ATA_NCQ
+    /* Slots completed but not yet reaped by ata_queue_complete() */
+    slots |= ata->queued | ata->completed | ata->failed;
+#endif
+    for (i = 0; i < ATA_MAX_CMD_SLOTS; i++) {
         if ((slots & 1) == 0)
             return i;
         slots >>= 1;
@@ -260,8 +315,8 @@ static int prepare_cmd_h2d_slot(int drv, const uint8_t *buf, int sz, int w)
     cmd += slot;
     memset(cmd, 0, sizeof(struct hba_cmd_header));
     cmd->cfl = FIS_LEN_H2D / 4;
-    cmd->ctba = (uint32_t)(ata->ctable_port);
-    tbl = (struct hba_cmd_table *)(uintptr_t)(ata->ctable_port);
+    cmd->ctba = (uint32_t)(ata->ctable_port + slot * ATA_CMD_TABLE_SIZE);
+    tbl = (struct hba_cmd_table *)(uintptr_t)(cmd->ctba);
     memset(tbl, 0, sizeof(struct hba_cmd_table));
     cmd->prdtl = 1;
     cmd->w = w;
@@ -270,6 +325,65 @@ static int prepare_cmd_h2d_slot(int drv, const uint8_t *buf, int sz, int w)
     return slot;
 }
 
+/**
+ * @brief Restart the command list processing of the port after a task file
+ * error. The device aborts all the outstanding queued commands when an error
+ * occurs, so the port must be stopped and restarted before it can accept new
+ * commands (AHCI 1.3.1, Sec. 6.2.2.1). If the device is still busy (BSY or
+ * DRQ set) once the port is stopped, the link is reset with a COMRESET
+ * before restarting (Sec. 6.2.2.2).
+ *
+ * @param[in] drv The index of the ATA drive in the ATA_Drv array.
+ */
+static void ata_port_recover(int drv)
+{
+    struct ata_drive *ata = &ATA_Drv[drv];
+    uint32_t reg;
+    int count;
+
+    reg = mmio_read32(AHCI_PxCMD(ata->ahci_base, ata->ahci_port));
+    mmio_write32(AHCI_PxCMD(ata->ahci_base, ata->ahci_port),
+            reg & ~AHCI_PORT_CMD_START);
+    while (mmio_read32(AHCI_PxCMD(ata->ahci_base, ata->ahci_port)) &
+            AHCI_PORT_CMD_CR)
+        ;
+
+    if (mmio_read32(AHCI_PxTFD(ata->ahci_base, ata->ahci_port)) &
+            (AHCI_PORT_TFD_BSY | AHCI_PORT_TFD_DRQ)) {
+        wolfBoot_printf("ATA%d: device busy, resetting the link\r\n", drv);
+        /* COMRESET: DET=1 for at least 1ms, then DET=0 */
+        reg = mmio_read32(AHCI_PxSCTL(ata->ahci_base, ata->ahci_port)) &
+            ~AHCI_SCTL_DET_MASK;
+        mmio_write32(AHCI_PxSCTL(ata->ahci_base, ata->ahci_port),
+                reg | AHCI_PORT_SCTL_DET_COMRESET);
+        delay(1);
+        mmio_write32(AHCI_PxSCTL(ata->ahci_base, ata->ahci_port), reg);
+
+        /* wait for the link, then for the device to be ready */
+        for (count = 0; count < ATA_COMRESET_TRIES; count++) {
+            reg = mmio_read32(AHCI_PxSSTS(ata->ahci_base, ata->ahci_port));
+            if ((reg & AHCI_SSTS_DET_MASK) == AHCI_PORT_SSTS_DET_PCE)
+                break;
+            delay(1);
+        }
+        reg = mmio_read32(AHCI_PxSERR(ata->ahci_base, ata->ahci_port));
+        mmio_write32(AHCI_PxSERR(ata->ahci_base, ata->ahci_port), reg);
+        for (; count < ATA_COMRESET_TRIES; count++) {
+            if ((mmio_read32(AHCI_PxTFD(ata->ahci_base, ata->ahci_port)) &
+                    (AHCI_PORT_TFD_BSY | AHCI_PORT_TFD_DRQ)) == 0)
+                break;
+            delay(1);
+        }
+        if (count >= ATA_COMRESET_TRIES)
+            wolfBoot_printf("ATA%d: link reset timed out\r\n", drv);
+    }
+    reg = mmio_read32(AHCI_PxSERR(ata->ahci_base, ata->ahci_port));
+    mmio_write32(AHCI_PxSERR(ata->ahci_base, ata->ahci_port), reg);
+    reg = mmio_read32(AHCI_PxIS(ata->ahci_base, ata->ahci_port));
+    mmio_write32(AHCI_PxIS(ata->ahci_base, ata->ahci_port), reg);
+    mmio_or32(AHCI_PxCMD(ata->ahci_base, ata->ahci_port), AHCI_PORT_CMD_START);
+}
+
 /**
  * @brief Check the completion status of an asynchronous ATA command.
  *
@@ -292,6 +406,7 @@ int ata_cmd_complete_async()
     ata = &ATA_Drv[ata_async_info.drv];
     if (mmio_read32(AHCI_PxIS(ata->ahci_base, ata->ahci_port)) & AHCI_PORT_IS_TFES) {
         ata_async_info.in_progress = 0;
+        ata_port_recover(ata_async_info.drv);
         return -1;
     }
 
@@ -303,6 +418,51 @@ int ata_cmd_complete_async()
     return 0;
 }
 
+#ifdef WOLFBOOT_ATA_NCQ
+/**
+ * @brief Update the state of the queued reads for the specified drive, by
+ * moving the slots that are no longer active in PxSACT/PxCI from the `queued`
+ * to the `completed` mask. On a task file error, all the slots still in
+ * flight are moved to the `failed` mask and the port is restarted.
+ *
+ * @param[in] drv The index of the ATA drive in the ATA_Drv array.
+ */
+static void ata_queue_poll(int drv)
+{
+    struct ata_drive *ata = &ATA_Drv[drv];
+    uint32_t busy;
+
+    if (ata->queued == 0)
+        return;
+    if (mmio_read32(AHCI_PxIS(ata->ahci_base, ata->ahci_port)) &
+            AHCI_PORT_IS_TFES) {
+        wolfBoot_printf("ATA: port error\r\n");
+        ata->failed |= ata->queued;
+        ata->queued = 0;
+        ata_port_recover(drv);
+        return;
+    }
+    busy = mmio_read32(AHCI_PxSACT(ata->ahci_base, ata->ahci_port)) |
+        mmio_read32(AHCI_PxCI(ata->ahci_base, ata->ahci_port));
+    ata->completed |= ata->queued & ~busy;
+    ata->queued &= busy;
+}
+
+/**
+ * @brief Wait until all the queued reads for the specified drive have left
+ * the command list. Non-queued commands cannot be issued while FPDMA QUEUED
+ * commands are outstanding. Results stay available to
+ * `ata_queue_complete()`.
+ *
+ * @param[in] drv The index of the ATA drive in the ATA_Drv array.
+ */
+static void ata_queue_drain(int drv)
+{
+    while (ATA_Drv[drv].queued != 0)
+        ata_queue_poll(drv);
+}
+#endif /* WOLFBOOT_ATA_NCQ */
+
 /**
  * @brief This static function executes the command in the specified command
  * slot for the ATA drive, if async = 0 waits for the command to complete
@@ -332,6 +492,10 @@ static int exec_cmd_slot_ex(int drv, int slot, int async)
     if (ata_async_info.in_progress)
         return ATA_ERR_OP_IN_PROGRESS;
 
+#ifdef WOLFBOOT_ATA_NCQ
+    ata_queue_drain(drv);
+#endif
+
     /* Clear IS */
     reg = mmio_read32(AHCI_PxIS(ata->ahci_base, ata->ahci_port));
     mmio_write32(AHCI_PxIS(ata->ahci_base, ata->ahci_port), reg);
@@ -351,6 +515,7 @@ static int exec_cmd_slot_ex(int drv, int slot, int async)
     while ((mmio_read32(AHCI_PxCI(ata->ahci_base, ata->ahci_port)) & (1 << slot)) != 0) {
         if (mmio_read32(AHCI_PxIS(ata->ahci_base, ata->ahci_port)) & AHCI_PORT_IS_TFES) {
             wolfBoot_printf("ATA: port error\r\n");
+            ata_port_recover(drv);
             return -1;
         }
     }
@@ -674,6 +839,30 @@ int ata_identify_device(int drv)
         }
         ATA_DEBUG_PRINTF(" - Security state: SEC%d\r\n",
                 (int)ata->sec);
+#ifdef WOLFBOOT_ATA_NCQ
+        {
+            uint16_t sata_cap, queue_depth;
+            uint32_t hba_cap = mmio_read32(AHCI_HBA_CAP(ata->ahci_base));
+            memcpy(&sata_cap, buffer + ATA_ID_SATA_CAP_POS, 2);
+            memcpy(&queue_depth, buffer + ATA_ID_QUEUE_DEPTH_POS, 2);
+            /* Without NCQ, multiple READ DMA EXT commands can still be
+             * posted to the command list: the HBA executes them back to
+             * back, saving the round trip to software between transfers.
+             */
+            ata->queue_depth = ATA_MAX_CMD_SLOTS;
+            ata->ncq = 0;
+            if ((sata_cap != 0xFFFF) && (sata_cap & ATA_ID_SATA_CAP_NCQ) &&
+                    (hba_cap & AHCI_CAP_SNCQ)) {
+                ata->ncq = 1;
+                if ((uint32_t)(queue_depth & 0x1F) + 1 < ata->queue_depth)
+                    ata->queue_depth = (queue_depth & 0x1F) + 1;
+                if (AHCI_CAP_NCS(hba_cap) + 1 < ata->queue_depth)
+                    ata->queue_depth = AHCI_CAP_NCS(hba_cap) + 1;
+            }
+            ATA_DEBUG_PRINTF(" - NCQ: %ssupported, queue depth: %u\r\n",
+                    ata->ncq ? "" : "not ", ata->queue_depth);
+        }
+#endif
     }
     return ret;
 }
@@ -710,7 +899,8 @@ static int ata_drive_read_sector(int drv, uint64_t start, uint32_t count,
     cmdfis->lba5 = (uint8_t)((start >> 40) & 0xFF);
     cmdfis->device = (1 << 6); /* LBA mode */
     cmdfis->count = (uint16_t)(count & 0xFFFF);
-    exec_cmd_slot(drv, slot);
+    if (exec_cmd_slot(drv, slot) != 0)
+        return -1;
     return count << ata->sector_size_shift;
 }
 
@@ -740,34 +930,263 @@ static int ata_drive_write_sector(int drv, uint64_t start, uint32_t count,
     cmdfis->device = (1 << 6); /* LBA mode */
     cmdfis->count = (uint16_t)(count & 0xFFFF);
 
-    exec_cmd_slot(drv, slot);
+    if (exec_cmd_slot(drv, slot) != 0)
+        return -1;
     return count << ata->sector_size_shift;
 }
 
+#ifdef WOLFBOOT_ATA_NCQ
+/**
+ * @brief Return the number of reads that can be queued at the same time on
+ * the specified drive using `ata_drive_read_queued()`. The value is only
+ * meaningful after `ata_identify_device()` has been called.
+ *
+ * @param[in] drv The index of the ATA drive in the ATA_Drv array.
+ *
+ * @return The queue depth, or -1 if the drive index is not valid.
+ */
+int ata_queue_depth(int drv)
+{
+    if ((drv < 0) || (drv > ata_drive_count))
+        return -1;
+    return (int)ATA_Drv[drv].queue_depth;
+}
+
+/**
+ * @brief Queue an asynchronous DMA read on the specified drive. When both the
+ * HBA and the device support Native Command Queuing, the read is issued as
+ * READ FPDMA QUEUED, so that the device can serve multiple outstanding reads
+ * in any order. Otherwise a READ DMA EXT is posted to the command list and
+ * executed by the HBA after the previous ones.
+ * The function returns immediately: software must call
+ * `ata_queue_complete()` with the returned tag to reap the result, before
+ * reading from `buf`.
+ *
+ * @param[in] drv The index of the ATA drive in the ATA_Drv array.
+ * @param[in] start The starting address in bytes. Must be sector aligned.
+ * @param[in] size The size of the data to read in bytes. Must be a multiple
+ * of the sector size, not bigger than ATA_QUEUE_MAX_XFER.
+ * @param[out] buf The destination buffer, reachable by the HBA with 32-bit DMA.
+ *
+ * @return
+ *   - >= 0: the tag associated to the queued read.
+ *   - ATA_ERR_BUSY: all the command slots are in use, reap some results first.
+ *   - ATA_ERR_OP_IN_PROGRESS: a non-queued asynchronous command is running.
+ *   - -1: invalid arguments.
+ */
+int ata_drive_read_queued(int drv, uint64_t start, uint32_t size, uint8_t *buf)
+{
+    struct ata_drive *ata;
+    struct hba_cmd_header *cmd;
+    struct hba_cmd_table *tbl;
+    struct fis_reg_h2d *cmdfis;
+    uint64_t lba;
+    uint32_t count, busy, in_use;
+    int slot;
+
+    if ((drv < 0) || (drv > ata_drive_count))
+        return -1;
+    ata = &ATA_Drv[drv];
+    if (ata_async_info.in_progress)
+        return ATA_ERR_OP_IN_PROGRESS;
+    if ((size == 0) || (size > ATA_QUEUE_MAX_XFER))
+        return -1;
+    lba = start >> ata->sector_size_shift;
+    count = size >> ata->sector_size_shift;
+    if (((lba << ata->sector_size_shift) != start) ||
+            ((count << ata->sector_size_shift) != size))
+        return -1;
+
+    /* Limit the number of slots in use to the queue depth */
+    ata_queue_poll(drv);
+    busy = ata->queued | ata->completed | ata->failed;
+    for (in_use = 0; busy != 0; busy >>= 1)
+        in_use += busy & 1;
+    if (in_use >= ata->queue_depth)
+        return ATA_ERR_BUSY;
+
+    slot = prepare_cmd_h2d_slot(drv, buf, size, 0);
+    if (slot < 0)
+        return ATA_ERR_BUSY;
+    cmd = (struct hba_cmd_header *)(uintptr_t)ata->clb_port;
+    cmd += slot;
+    tbl = (struct hba_cmd_table *)(uintptr_t)cmd->ctba;
+    cmdfis = (struct fis_reg_h2d *)(&tbl->cfis);
+    cmdfis->fis_type = FIS_TYPE_REG_H2D;
+    cmdfis->c = 1;
+    cmdfis->lba0 = (uint8_t)(lba & 0xFF);
+    cmdfis->lba1 = (uint8_t)((lba >> 8) & 0xFF);
+    cmdfis->lba2 = (uint8_t)((lba >> 16) & 0xFF);
+    cmdfis->lba3 = (uint8_t)((lba >> 24) & 0xFF);
+    cmdfis->lba4 = (uint8_t)((lba >> 32) & 0xFF);
+    cmdfis->lba5 = (uint8_t)((lba >> 40) & 0xFF);
+    cmdfis->device = (1 << 6); /* LBA mode */
+    if (ata->ncq) {
+        /* FPDMA QUEUED: sector count in FEATURE, tag in COUNT(7:3) */
+        cmdfis->command = ATA_CMD_READ_FPDMA_QUEUED;
+        cmdfis->feature_l = (uint8_t)(count & 0xFF);
+        cmdfis->feature_h = (uint8_t)((count >> 8) & 0xFF);
+        cmdfis->count = (uint16_t)(slot << 3);
+        mmio_write32(AHCI_PxSACT(ata->ahci_base, ata->ahci_port), 1 << slot);
+    } else {
+        cmdfis->command = ATA_CMD_READ_DMA_EX;
+        cmdfis->count = (uint16_t)(count & 0xFFFF);
+    }
+    ata->queued |= (1 << slot);
+    mmio_write32(AHCI_PxCI(ata->ahci_base, ata->ahci_port), 1 << slot);
+    return slot;
+}
+
+/**
+ * @brief Check the completion status of a read previously queued with
+ * `ata_drive_read_queued()`. When the function returns 0 or -1 the tag is
+ * released and can be reused by the next queued read.
+ *
+ * @param[in] drv The index of the ATA drive in the ATA_Drv array.
+ * @param[in] tag The tag returned by `ata_drive_read_queued()`.
+ *
+ * @return
+ *   - 0: the read completed successfully, data is available in the buffer.
+ *   - ATA_ERR_BUSY: the read is still in progress.
+ *   - ATA_ERR_OP_NOT_IN_PROGRESS: no read queued with this tag.
+ *   - -1: the read was aborted because of a port error.
+ */
+int ata_queue_complete(int drv, int tag)
+{
+    struct ata_drive *ata;
+    uint32_t mask;
+
+    if ((drv < 0) || (drv > ata_drive_count) || (tag < 0) ||
+            (tag >= ATA_MAX_CMD_SLOTS))
+        return ATA_ERR_OP_NOT_IN_PROGRESS;
+    ata = &ATA_Drv[drv];
+    mask = (1 << tag);
+    ata_queue_poll(drv);
+    if (ata->completed & mask) {
+        ata->completed &= ~mask;
+        return 0;
+    }
+    if (ata->failed & mask) {
+        ata->failed &= ~mask;
+        return -1;
+    }
+    if (ata->queued & mask)
+        return ATA_ERR_BUSY;
+    return ATA_ERR_OP_NOT_IN_PROGRESS;
+}
+#endif /* WOLFBOOT_ATA_NCQ */
+
+/**
+ * @brief Invalidate all the lines in the sector cache of the drive.
+ *
+ * @param[in] drv The index of the ATA drive in the ATA_Drv array.
+ */
 static void ata_invalidate_cache(int drv)
 {
     struct ata_drive *ata = &ATA_Drv[drv];
-    ata->cached = CACHE_INVALID;
+    int i;
+    for (i = 0; i < ATA_CACHE_LINES; i++) {
+        ata->cache[i].start = CACHE_INVALID;
+        ata->cache[i].count = 0;
+        ata->cache[i].last_use = 0;
+    }
 }
 
-static void ata_cache_pull(int drv, uint64_t sector)
+/**
+ * @brief Invalidate the cache lines containing any of the sectors in the
+ * given range. Called when the sectors are written directly to the disk.
+ *
+ * @param[in] drv The index of the ATA drive in the ATA_Drv array.
+ * @param[in] sector The first sector in the range.
+ * @param[in] count The number of sectors in the range.
+ */
+static void ata_cache_invalidate_range(int drv, uint64_t sector,
+        uint32_t count)
 {
     struct ata_drive *ata = &ATA_Drv[drv];
-    if (ata->cached == sector)
-        return;
-    if (ata_drive_read_sector(drv, sector, 1, ata->sector_cache) < 0) {
-        ata_invalidate_cache(drv);
-        return;
+    int i;
+    for (i = 0; i < ATA_CACHE_LINES; i++) {
+        struct ata_cache_line *line = &ata->cache[i];
+        if (line->start == CACHE_INVALID)
+            continue;
+        if ((sector < line->start + line->count) &&
+                (line->start < sector + count)) {
+            line->start = CACHE_INVALID;
+            line->count = 0;
+            line->last_use = 0;
+        }
     }
-    ata->cached = sector;
 }
 
-static void ata_cache_commit(int drv)
+/**
+ * @brief Return a pointer to the cached copy of the given sector, reading it
+ * from the disk if needed. On a miss, the least recently used line is
+ * replaced with the ATA_CACHE_LINE_SECTORS-aligned block of sectors
+ * containing the requested one, so that the following sectors are read
+ * ahead in the same command.
+ *
+ * @param[in] drv The index of the ATA drive in the ATA_Drv array.
+ * @param[in] sector The sector to access.
+ *
+ * @return A pointer to the sector data in the cache, or NULL if the sector
+ * cannot be read.
+ */
+static uint8_t *ata_cache_pull(int drv, uint64_t sector)
 {
     struct ata_drive *ata = &ATA_Drv[drv];
-    if (ata->cached == CACHE_INVALID)
-        return;
-    ata_drive_write_sector(drv, ata->cached, 1, ata->sector_cache);
+    struct ata_cache_line *line = NULL;
+    uint64_t base;
+    int i;
+
+    ata->cache_clock++;
+    for (i = 0; i < ATA_CACHE_LINES; i++) {
+        struct ata_cache_line *l = &ata->cache[i];
+        if ((l->start != CACHE_INVALID) && (sector >= l->start) &&
+                (sector < l->start + l->count)) {
+            l->last_use = ata->cache_clock;
+            return l->data + ((sector - l->start) << ata->sector_size_shift);
+        }
+        /* Select the victim: empty lines have last_use = 0 */
+        if ((line == NULL) || (l->last_use < line->last_use))
+            line = l;
+    }
+
+    base = sector & ~((uint64_t)ATA_CACHE_LINE_SECTORS - 1);
+    line->start = CACHE_INVALID;
+    line->count = 0;
+    line->last_use = 0;
+    if (ata_drive_read_sector(drv, base, ATA_CACHE_LINE_SECTORS,
+                line->data) >= 0) {
+        line->start = base;
+        line->count = ATA_CACHE_LINE_SECTORS;
+    } else if (ata_drive_read_sector(drv, sector, 1, line->data) >= 0) {
+        /* Read-ahead failed, e.g. past the end of the disk */
+        line->start = sector;
+        line->count = 1;
+    } else {
+        return NULL;
+    }
+    line->last_use = ata->cache_clock;
+    return line->data + ((sector - line->start) << ata->sector_size_shift);
+}
+
+/**
+ * @brief Write a sector previously modified in the cache back to the disk.
+ * The cache is write-through: the line stays valid after the write.
+ *
+ * @param[in] drv The index of the ATA drive in the ATA_Drv array.
+ * @param[in] sector The sector to write.
+ * @param[in] data Pointer to the sector in the cache, from ata_cache_pull().
+ *
+ * @return 0 on success, -1 if the write fails.
+ */
+static int ata_cache_commit(int drv, uint64_t sector, const uint8_t *data)
+{
+    if (ata_drive_write_sector(drv, sector, 1, data) < 0) {
+        ata_cache_invalidate_range(drv, sector, 1);
+        return -1;
+    }
+    return 0;
 }
 
 /**
@@ -788,6 +1207,7 @@ int ata_drive_read(int drv, uint64_t start, uint32_t size, uint8_t *buf)
     uint32_t count = 0;
     struct ata_drive *ata = &ATA_Drv[drv];
     uint32_t buffer_off = 0;
+    uint8_t *cached;
     sect_start = start >> ata->sector_size_shift;
     sect_off = start - (sect_start << ata->sector_size_shift);
 
@@ -798,10 +1218,10 @@ int ata_drive_read(int drv, uint64_t start, uint32_t size, uint8_t *buf)
         uint32_t len = MAX_SECTOR_SIZE - sect_off;
         if (len > size)
             len = size;
-        ata_cache_pull(drv, sect_start);
-        if (ata->cached != sect_start)
+        cached = ata_cache_pull(drv, sect_start);
+        if (cached == NULL)
             return -1;
-        memcpy(buf, ata->sector_cache + sect_off, len);
+        memcpy(buf, cached + sect_off, len);
         size -= len;
         buffer_off += len;
         sect_start++;
@@ -816,8 +1236,10 @@ int ata_drive_read(int drv, uint64_t start, uint32_t size, uint8_t *buf)
         sect_start += count;
     }
     if (size > 0) {
-        ata_cache_pull(drv, sect_start);
-        memcpy(buf + buffer_off, ata->sector_cache, size);
+        cached = ata_cache_pull(drv, sect_start);
+        if (cached == NULL)
+            return -1;
+        memcpy(buf + buffer_off, cached, size);
         buffer_off += size;
     }
     return buffer_off;
@@ -842,6 +1264,7 @@ int ata_drive_write(int drv, uint64_t start, uint32_t size,
     uint32_t count;
     struct ata_drive *ata = &ATA_Drv[drv];
     uint32_t buffer_off = 0;
+    uint8_t *cached;
     sect_start = start >> ata->sector_size_shift;
     sect_off = start - (sect_start << ata->sector_size_shift);
 
@@ -852,11 +1275,12 @@ int ata_drive_write(int drv, uint64_t start, uint32_t size,
         uint32_t len = MAX_SECTOR_SIZE - sect_off;
         if (len > size)
             len = size;
-        ata_cache_pull(drv, sect_start);
-        if (ata->cached != sect_start)
+        cached = ata_cache_pull(drv, sect_start);
+        if (cached == NULL)
+            return -1;
+        memcpy(cached + sect_off, buf, len);
+        if (ata_cache_commit(drv, sect_start, cached) < 0)
             return -1;
-        memcpy(ata->sector_cache + sect_off, buf, len);
-        ata_cache_commit(drv);
         size -= len;
         buffer_off += len;
         sect_start++;
@@ -865,6 +1289,7 @@ int ata_drive_write(int drv, uint64_t start, uint32_t size,
     if (size > 0)
         count = size >> ata->sector_size_shift;
     if (count > 0) {
+        ata_cache_invalidate_range(drv, sect_start, count);
         if (ata_drive_write_sector(drv, sect_start, count, buf + buffer_off) < 0)
             return -1;
         size -= (count << ata->sector_size_shift);
@@ -872,9 +1297,12 @@ int ata_drive_write(int drv, uint64_t start, uint32_t size,
         sect_start += count;
     }
     if (size > 0) {
-        ata_cache_pull(drv, sect_start);
-        memcpy(ata->sector_cache, buf + buffer_off, size);
-        ata_cache_commit(drv);
+        cached = ata_cache_pull(drv, sect_start);
+        if (cached == NULL)
+            return -1;
+        memcpy(cached, buf + buffer_off, size);
+        if (ata_cache_commit(drv, sect_start, cached) < 0)
+            return -1;
         buffer_off += size;
     }
     return buffer_off;
@@ -326,6 +326,34 @@ int disk_read(int drv, int part, uint64_t off, uint64_t sz, uint8_t *buf)
     return ret;
 }
 
+#ifdef WOLFBOOT_ATA_NCQ
+/**
+ * @brief Queues an asynchronous read from a disk partition.
+ *
+ * The read is queued on the drive with `ata_drive_read_queued()`; the caller
+ * must reap the returned tag with `ata_queue_complete()` before accessing the
+ * data in the buffer.
+ *
+ * @param[in] drv The drive number of the disk containing the partition (0 to `MAX_DISKS - 1`).
+ * @param[in] part The partition number on the disk (0 to `MAX_PARTITIONS - 1`).
+ * @param[in] off The offset in bytes from the start of the partition, sector aligned.
+ * @param[in] sz The size of the data to read in bytes, multiple of the sector size.
+ * @param[out] buf The buffer to store the read data.
+ *
+ * @return The tag of the queued read on success, ATA_ERR_BUSY if the queue is
+ * full, or a negative value if an error occurs.
+ */
+int disk_read_queued(int drv, int part, uint64_t off, uint32_t sz, uint8_t *buf)
+{
+    struct disk_partition *p = open_part(drv, part);
+    if (p == NULL)
+        return -1;
+    if ((sz == 0) || ((p->start + off + sz - 1) > p->end))
+        return -1;
+    return ata_drive_read_queued(drv, p->start + off, sz, buf);
+}
+#endif /* WOLFBOOT_ATA_NCQ */
+
 /**
  * @brief Writes data to a disk partition from the provided buffer.
  *
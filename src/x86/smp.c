@@ -0,0 +1,308 @@
+/* smp.c
+ *
+ * Copyright (C) 2024 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ *
+ */
+/**
+ * @file smp.c
+ *
+ * @brief Secondary cores (APs) support for x86_64 FSP targets
+ *
+ * The APs are started with an INIT-SIPI-SIPI broadcast on the first call to
+ * hal_smp_cores(). Each AP runs a real mode trampoline, copied below 1MB,
+ * that switches to long mode with the GDT and the page tables of the boot
+ * core, then waits in x86_smp_ap_main() for work assigned by
+ * hal_smp_start(). hal_prepare_boot() sends the APs back to the
+ * wait-for-SIPI state with x86_smp_park() before the OS is started.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <hal.h>
+#include <printf.h>
+#include <x86/common.h>
+#include <x86/gdt.h>
+#include <x86/smp.h>
+
+#if defined(WOLFBOOT_HASH_TREE) || defined(WOLFBOOT_HYBRID_PARALLEL_VERIFY)
+
+#define LAPIC_ICR_LOW 0xfee00300
+#define LAPIC_ICR_HIGH 0xfee00310
+#define LAPIC_ICR_INIT (0x5 << 8)
+#define LAPIC_ICR_STARTUP (0x6 << 8)
+#define LAPIC_ICR_PENDING (1 << 12)
+#define LAPIC_ICR_ASSERT (1 << 14)
+#define LAPIC_ICR_ALL_BUT_SELF (0x3 << 18)
+
+/* 4KB aligned, below 1MB. The SIPI vector is the page number. */
+#ifndef X86_SMP_TRAMPOLINE
+#define X86_SMP_TRAMPOLINE 0x8000
+#endif
+#ifndef X86_SMP_MAX_CORES
+#define X86_SMP_MAX_CORES 8
+#endif
+#ifndef X86_SMP_STACK_SIZE
+#define X86_SMP_STACK_SIZE 0x10000
+#endif
+/* Time given to the APs to check in after the second SIPI */
+#ifndef X86_SMP_STARTUP_MS
+#define X86_SMP_STARTUP_MS 10
+#endif
+
+#if (X86_SMP_TRAMPOLINE & 0xfff) != 0 || X86_SMP_TRAMPOLINE >= 0x100000
+#error "X86_SMP_TRAMPOLINE must be 4KB aligned and below 1MB"
+#endif
+
+#define _STR(x) #x
+#define STR(x) _STR(x)
+
+/* Filled by the boot core in the copy of the trampoline, before the SIPI.
+ * The offsets are used by the trampoline code below. */
+struct x86_smp_trampoline_data {
+    uint16_t gdt_limit;     /* 0x00 */
+    uint32_t gdt_base;      /* 0x02 */
+    uint16_t reserved0;
+    uint32_t cr3;           /* 0x08 */
+    uint32_t reserved1;
+    uint64_t entry;         /* 0x10 */
+    uint64_t stacks;        /* 0x18 */
+    uint32_t count;         /* 0x20 */
+} __attribute__((packed));
+
+extern uint8_t x86_smp_trampoline_start[];
+extern uint8_t x86_smp_trampoline_data[];
+extern uint8_t x86_smp_trampoline_end[];
+
+#define TRAMPOLINE_ADDR(sym) \
+    STR(X86_SMP_TRAMPOLINE) " + " #sym " - x86_smp_trampoline_start"
+
+/* Entered at X86_SMP_TRAMPOLINE in real mode, CS = X86_SMP_TRAMPOLINE >> 4 */
+__asm__ (
+    ".section .text.x86_smp_trampoline,\"ax\"\r\n"
+    ".code16\r\n"
+    ".globl x86_smp_trampoline_start\r\n"
+    "x86_smp_trampoline_start:\r\n"
+    "cli\r\n"
+    "cld\r\n"
+    "mov %cs, %ax\r\n"
+    "mov %ax, %ds\r\n"
+    "lgdtl x86_smp_trampoline_data - x86_smp_trampoline_start\r\n"
+    /* protected mode */
+    "movl %cr0, %eax\r\n"
+    "orl $0x1, %eax\r\n"
+    "movl %eax, %cr0\r\n"
+    "ljmpl $" STR(GDT_CS_32BIT) ", $" TRAMPOLINE_ADDR(ap_pm32) "\r\n"
+    ".code32\r\n"
+    "ap_pm32:\r\n"
+    "movw $" STR(GDT_DS) ", %ax\r\n"
+    "movw %ax, %ds\r\n"
+    "movw %ax, %es\r\n"
+    "movw %ax, %ss\r\n"
+    /* long mode, same steps as switch_to_long_mode() */
+    "movl %cr4, %eax\r\n"
+    "orl $0x20, %eax\r\n"
+    "movl %eax, %cr4\r\n"
+    "movl " TRAMPOLINE_ADDR(x86_smp_trampoline_data) " + 0x08, %eax\r\n"
+    "movl %eax, %cr3\r\n"
+    "movl $0xc0000080, %ecx\r\n"
+    "rdmsr\r\n"
+    "orl $0x100, %eax\r\n"
+    "wrmsr\r\n"
+    "movl %cr0, %eax\r\n"
+    "orl $0x80000000, %eax\r\n"
+    "movl %eax, %cr0\r\n"
+    "ljmpl $" STR(GDT_CS_64BIT) ", $" TRAMPOLINE_ADDR(ap_lm64) "\r\n"
+    ".code64\r\n"
+    "ap_lm64:\r\n"
+    /* core index = 1 + number of APs that checked in before this one */
+    "movl $1, %eax\r\n"
+    "lock xaddl %eax, " TRAMPOLINE_ADDR(x86_smp_trampoline_data) " + 0x20\r\n"
+    "incl %eax\r\n"
+    "cmpl $" STR(X86_SMP_MAX_CORES) ", %eax\r\n"
+    "jae ap_park\r\n"
+    "movl %eax, %edi\r\n"
+    "movl %eax, %ecx\r\n"
+    "imulq $" STR(X86_SMP_STACK_SIZE) ", %rcx\r\n"
+    "movq " TRAMPOLINE_ADDR(x86_smp_trampoline_data) " + 0x18, %rsp\r\n"
+    "addq %rcx, %rsp\r\n"
+    "movq " TRAMPOLINE_ADDR(x86_smp_trampoline_data) " + 0x10, %rax\r\n"
+    "callq *%rax\r\n"
+    "ap_park:\r\n"
+    "cli\r\n"
+    "hlt\r\n"
+    "jmp ap_park\r\n"
+    ".balign 8\r\n"
+    ".globl x86_smp_trampoline_data\r\n"
+    "x86_smp_trampoline_data:\r\n"
+    ".fill 0x28, 1, 0\r\n"
+    ".globl x86_smp_trampoline_end\r\n"
+    "x86_smp_trampoline_end:\r\n"
+    ".previous\r\n"
+);
+
+#define X86_SMP_IDLE 0
+#define X86_SMP_RUN  1
+#define X86_SMP_DONE 2
+
+static struct x86_smp_core {
+    volatile uint32_t state;
+    void (*fn)(void *);
+    void *arg;
+} x86_smp_core[X86_SMP_MAX_CORES];
+
+static uint8_t x86_smp_stacks[(X86_SMP_MAX_CORES - 1) * X86_SMP_STACK_SIZE]
+    __attribute__((aligned(16)));
+
+static struct {
+    uint16_t limit;
+    uint64_t base;
+} __attribute__((packed)) x86_smp_idtr;
+
+static int x86_smp_started;
+static int x86_smp_aps;
+
+/**
+ * @brief Main loop of the APs, entered from the trampoline in long mode.
+ *
+ * @param core The index of the AP, from 1 to X86_SMP_MAX_CORES - 1.
+ */
+static void __attribute__((used)) x86_smp_ap_main(uint32_t core)
+{
+    struct x86_smp_core *c = &x86_smp_core[core];
+
+    __asm__ volatile ("lidt %0" : : "m"(x86_smp_idtr));
+    while (1) {
+        while (c->state != X86_SMP_RUN)
+            __asm__ volatile ("pause" : : : "memory");
+        c->fn(c->arg);
+        __asm__ volatile ("" : : : "memory");
+        c->state = X86_SMP_DONE;
+    }
+}
+
+static void x86_smp_send_ipi(uint32_t icr)
+{
+    mmio_write32(LAPIC_ICR_HIGH, 0);
+    mmio_write32(LAPIC_ICR_LOW, LAPIC_ICR_ALL_BUT_SELF | icr);
+    while ((mmio_read32(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING) != 0)
+        ;
+}
+
+/**
+ * @brief Start the APs and count the ones that reached x86_smp_ap_main().
+ */
+static void x86_smp_init(void)
+{
+    struct x86_smp_trampoline_data *data;
+    struct {
+        uint16_t limit;
+        uint64_t base;
+    } __attribute__((packed)) gdtr;
+    uintptr_t cr3;
+    uint32_t count;
+
+    x86_smp_started = 1;
+    __asm__ volatile ("sgdt %0" : "=m"(gdtr));
+    __asm__ volatile ("sidt %0" : "=m"(x86_smp_idtr));
+    __asm__ volatile ("mov %%cr3, %0" : "=r"(cr3));
+    /* The trampoline loads both from 32-bit code */
+    if (((gdtr.base >> 32) != 0) || (((uint64_t)cr3 >> 32) != 0)) {
+        wolfBoot_printf("SMP: GDT or page tables above 4GB\r\n");
+        return;
+    }
+
+    memcpy((void *)X86_SMP_TRAMPOLINE, x86_smp_trampoline_start,
+        x86_smp_trampoline_end - x86_smp_trampoline_start);
+    data = (struct x86_smp_trampoline_data *)(uintptr_t)(X86_SMP_TRAMPOLINE +
+        (x86_smp_trampoline_data - x86_smp_trampoline_start));
+    data->gdt_limit = gdtr.limit;
+    data->gdt_base = (uint32_t)gdtr.base;
+    data->cr3 = (uint32_t)cr3;
+    data->entry = (uintptr_t)x86_smp_ap_main;
+    data->stacks = (uintptr_t)x86_smp_stacks;
+    data->count = 0;
+
+    x86_smp_send_ipi(LAPIC_ICR_INIT | LAPIC_ICR_ASSERT);
+    delay(10);
+    x86_smp_send_ipi(LAPIC_ICR_STARTUP | (X86_SMP_TRAMPOLINE >> 12));
+    delay(1);
+    x86_smp_send_ipi(LAPIC_ICR_STARTUP | (X86_SMP_TRAMPOLINE >> 12));
+    delay(X86_SMP_STARTUP_MS);
+
+    count = *(volatile uint32_t *)&data->count;
+    if (count > X86_SMP_MAX_CORES - 1)
+        count = X86_SMP_MAX_CORES - 1;
+    x86_smp_aps = (int)count;
+    wolfBoot_printf("SMP: %d secondary cores started\r\n", x86_smp_aps);
+}
+
+int hal_smp_cores(void)
+{
+    if (!x86_smp_started)
+        x86_smp_init();
+    return 1 + x86_smp_aps;
+}
+
+int hal_smp_start(int core, void (*fn)(void *), void *arg)
+{
+    struct x86_smp_core *c;
+
+    if ((core <= 0) || (core > x86_smp_aps))
+        return -1;
+    c = &x86_smp_core[core];
+    if (c->state != X86_SMP_IDLE)
+        return -1;
+    c->fn = fn;
+    c->arg = arg;
+    __asm__ volatile ("" : : : "memory");
+    c->state = X86_SMP_RUN;
+    return 0;
+}
+
+void hal_smp_wait(int core)
+{
+    struct x86_smp_core *c;
+
+    if ((core <= 0) || (core > x86_smp_aps))
+        return;
+    c = &x86_smp_core[core];
+    while (c->state != X86_SMP_DONE)
+        __asm__ volatile ("pause" : : : "memory");
+    c->state = X86_SMP_IDLE;
+}
+
+/**
+ * @brief Put the APs back in the wait-for-SIPI state, as the OS expects
+ * them. Their loop and stacks are in wolfBoot memory, which the OS reuses.
+ */
+void x86_smp_park(void)
+{
+    if (x86_smp_aps > 0)
+        x86_smp_send_ipi(LAPIC_ICR_INIT | LAPIC_ICR_ASSERT);
+    x86_smp_aps = 0;
+}
+
+#else
+
+void x86_smp_park(void)
+{
+}
+
+#endif /* WOLFBOOT_HASH_TREE || WOLFBOOT_HYBRID_PARALLEL_VERIFY */
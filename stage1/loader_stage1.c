@@ -55,6 +55,85 @@
 #endif
 #endif
 
+#ifdef WOLFBOOT_STAGE1_VERIFY
+/* Size and digest of wolfboot.bin, generated by stage1/Makefile */
+#include "loader_stage1_payload.h"
+
+#if defined(WOLFBOOT_HASH_SHA256)
+    #include <wolfssl/wolfcrypt/sha256.h>
+    #define STAGE1_DIGEST_SIZE  WC_SHA256_DIGEST_SIZE
+    #define stage1_hash_t       wc_Sha256
+    #define stage1_hash_init    wc_InitSha256
+    #define stage1_hash_update  wc_Sha256Update
+    #define stage1_hash_final   wc_Sha256Final
+#elif defined(WOLFBOOT_HASH_SHA384)
+    #include <wolfssl/wolfcrypt/sha512.h>
+    #define STAGE1_DIGEST_SIZE  WC_SHA384_DIGEST_SIZE
+    #define stage1_hash_t       wc_Sha384
+    #define stage1_hash_init    wc_InitSha384
+    #define stage1_hash_update  wc_Sha384Update
+    #define stage1_hash_final   wc_Sha384Final
+#elif defined(WOLFBOOT_HASH_SHA3_384)
+    #include <wolfssl/wolfcrypt/sha3.h>
+    #define STAGE1_DIGEST_SIZE  WC_SHA3_384_DIGEST_SIZE
+    #define stage1_hash_t       wc_Sha3
+    #define stage1_hash_init(h) wc_InitSha3_384((h), NULL, INVALID_DEVID)
+    #define stage1_hash_update  wc_Sha3_384_Update
+    #define stage1_hash_final   wc_Sha3_384_Final
+#else
+    #error Unsupported hash algorithm for the stage 1 loader
+#endif
+
+#if WOLFBOOT_STAGE1_PAYLOAD_SIZE > BOOTLOADER_PARTITION_SIZE
+    #error wolfboot.bin does not fit in the boot-loader partition
+#endif
+
+/* Memory mapped flash is copied and hashed one chunk at a time, while the
+ * chunk is still in the L1 data cache */
+#ifndef WOLFBOOT_STAGE1_CHUNK_SIZE
+    #define WOLFBOOT_STAGE1_CHUNK_SIZE (16 * 1024)
+#endif
+
+static const uint8_t payload_digest[STAGE1_DIGEST_SIZE] =
+    WOLFBOOT_STAGE1_PAYLOAD_DIGEST;
+
+/* Copy wolfBoot to RAM and check its digest. Returns 0 if it can be started */
+static int load_wolfboot(uint8_t* dst)
+{
+    stage1_hash_t hash;
+    uint8_t digest[STAGE1_DIGEST_SIZE];
+    uint32_t pos, len;
+    uint8_t diff = 0;
+    int ret, i;
+
+    ret = stage1_hash_init(&hash);
+#ifdef EXT_FLASH
+    /* a single read, the driver picks the transfer size */
+    if (ret == 0) {
+        ret = ext_flash_read((uintptr_t)WOLFBOOT_ORIGIN, dst,
+            WOLFBOOT_STAGE1_PAYLOAD_SIZE);
+    }
+#endif
+    for (pos = 0; (ret >= 0) && (pos < WOLFBOOT_STAGE1_PAYLOAD_SIZE);
+            pos += len) {
+        len = WOLFBOOT_STAGE1_PAYLOAD_SIZE - pos;
+        if (len > WOLFBOOT_STAGE1_CHUNK_SIZE)
+            len = WOLFBOOT_STAGE1_CHUNK_SIZE;
+    #ifndef EXT_FLASH
+        memcpy(dst + pos, (uint8_t*)WOLFBOOT_ORIGIN + pos, len);
+    #endif
+        ret = stage1_hash_update(&hash, dst + pos, len);
+    }
+    if (ret >= 0)
+        ret = stage1_hash_final(&hash, digest);
+    if (ret < 0)
+        return ret;
+    for (i = 0; i < STAGE1_DIGEST_SIZE; i++)
+        diff |= digest[i] ^ payload_digest[i];
+    return (diff == 0) ? 0 : -1;
+}
+#endif /* WOLFBOOT_STAGE1_VERIFY */
+
 int main(void)
 {
     int ret = -1;
@@ -94,7 +173,16 @@ int main(void)
     uart_write("Loading wolfBoot to DDR\n", 24);
 #endif
 
-#ifdef EXT_FLASH
+#ifdef WOLFBOOT_STAGE1_VERIFY
+    ret = load_wolfboot((uint8_t*)WOLFBOOT_STAGE1_LOAD_ADDR);
+    if (ret != 0) {
+    #ifdef DEBUG_UART
+        uart_write("wolfBoot digest mismatch, halting\n", 34);
+    #endif
+        while (1)
+            ;
+    }
+#elif defined(EXT_FLASH)
     ret = ext_flash_read(
         (uintptr_t)WOLFBOOT_ORIGIN,         /* flash offset */
         (uint8_t*)WOLFBOOT_STAGE1_LOAD_ADDR,/* ram destination */
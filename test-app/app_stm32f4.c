@@ -31,6 +31,9 @@
 #include "wolfboot/wolfboot.h"
 #include "spi_flash.h"
 #include "target.h"
+#ifdef UART_UPDATE_V2
+#include "update_rx.h"
+#endif
 
 #ifdef TARGET_stm32f4
 
@@ -232,6 +235,44 @@ static int check(uint8_t *pkt, int size)
     return -1;
 }
 
+#ifdef UART_UPDATE_V2
+static int update_uart_rx(uint8_t *c)
+{
+    if ((UART_SR & UART_SR_RX_NOTEMPTY) == 0)
+        return 0;
+    *c = (uint8_t)(UART_DR & 0xff);
+    return 1;
+}
+
+static void update_uart_tx(uint8_t c)
+{
+    uart_write((char)c);
+}
+
+static int update_flash_erase(uint32_t off, uint32_t len)
+{
+    return hal_flash_erase(WOLFBOOT_PARTITION_UPDATE_ADDRESS + off, len);
+}
+
+static int update_flash_write(uint32_t off, const uint8_t *data, uint32_t len)
+{
+    return hal_flash_write(WOLFBOOT_PARTITION_UPDATE_ADDRESS + off, data, len);
+}
+
+static int update_flash_read(uint32_t off, uint8_t *data, uint32_t len)
+{
+    memcpy(data, (void *)(WOLFBOOT_PARTITION_UPDATE_ADDRESS + off), len);
+    return 0;
+}
+
+/* The last sector holds the partition flags */
+static const struct update_rx_ops update_ops = {
+    update_uart_rx, update_uart_tx,
+    update_flash_erase, update_flash_write, update_flash_read,
+    WOLFBOOT_SECTOR_SIZE, WOLFBOOT_PARTITION_SIZE - WOLFBOOT_SECTOR_SIZE
+};
+#endif
+
 volatile uint32_t time_elapsed = 0;
 void main(void) {
     uint32_t tlen = 0;
@@ -273,15 +314,25 @@ void main(void) {
 #ifdef EXT_ENCRYPTED
     wolfBoot_set_encrypt_key("0123456789abcdef0123456789abcdef", 32);
 #endif
+#ifndef UART_UPDATE_V2
     uart_write(START);
     for (i = 3; i >= 0; i--) {
         uart_write(v_array[i]);
     }
+#endif
 #ifdef WOLFBOOT_NO_SIGN
     while(time_elapsed < 140)
 	WFI();
     arch_reboot();
 #endif
+#ifdef UART_UPDATE_V2
+    if (update_rx_run(&update_ops, version) > 0) {
+        spi_flash_probe();
+        wolfBoot_update_trigger();
+        spi_flash_release();
+    }
+    hal_flash_lock();
+#else
     while (1) {
         r_total = 0;
         do {
@@ -345,6 +396,7 @@ void main(void) {
             break;
         }
     }
+#endif
     /* Wait for reboot */
     while(1)
         ;
@@ -0,0 +1,271 @@
+/* update_rx.c
+ *
+ * Device side of the UART update protocol, version 2.
+ *
+ * Data frames carry the offset of their payload, so they can be accepted in
+ * any order within a window of UPDATE_RX_WINDOW frames: each ack reports the
+ * offset up to which the image is stored, plus a bitmap of the frames held
+ * in RAM after it, so the host only retransmits what is actually missing.
+ * After a reset the host asks for the CRC32 of the partition content and
+ * resumes from the first sector that differs from the image.
+ *
+ * Copyright (C) 2025 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+#include <stdint.h>
+#include <string.h>
+#include "update_rx.h"
+
+#if UPDATE_RX_WINDOW > 32
+#error UPDATE_RX_WINDOW must be 32 or less
+#endif
+
+#define UPDATE_RX_MAX_PAYLOAD (4 + UPDATE_RX_FRAME_SIZE)
+
+static uint8_t window[UPDATE_RX_WINDOW][UPDATE_RX_FRAME_SIZE];
+static uint16_t window_len[UPDATE_RX_WINDOW];
+static uint8_t frame[5 + UPDATE_RX_MAX_PAYLOAD + 4];
+
+uint32_t update_crc32(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+    uint32_t i;
+    int b;
+    crc = ~crc;
+    for (i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (b = 0; b < 8; b++)
+            crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+    }
+    return ~crc;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void send_frame(const struct update_rx_ops *ops, uint8_t type,
+    const uint8_t *payload, uint16_t len)
+{
+    uint8_t hdr[3];
+    uint8_t crc[4];
+    uint32_t c;
+    uint16_t i;
+
+    hdr[0] = type;
+    hdr[1] = len & 0xFF;
+    hdr[2] = len >> 8;
+    c = update_crc32(0, hdr, sizeof(hdr));
+    c = update_crc32(c, payload, len);
+    put_u32(crc, c);
+    ops->tx(UPDATE_SYNC0);
+    ops->tx(UPDATE_SYNC1);
+    for (i = 0; i < sizeof(hdr); i++)
+        ops->tx(hdr[i]);
+    for (i = 0; i < len; i++)
+        ops->tx(payload[i]);
+    for (i = 0; i < sizeof(crc); i++)
+        ops->tx(crc[i]);
+}
+
+static void send_hello(const struct update_rx_ops *ops, uint32_t version)
+{
+    uint8_t p[15];
+    put_u32(p, version);
+    put_u32(p + 4, ops->sector_size);
+    put_u32(p + 8, ops->max_size);
+    p[12] = UPDATE_RX_FRAME_SIZE & 0xFF;
+    p[13] = UPDATE_RX_FRAME_SIZE >> 8;
+    p[14] = UPDATE_RX_WINDOW;
+    send_frame(ops, UPDATE_HELLO, p, sizeof(p));
+}
+
+static void send_ack(const struct update_rx_ops *ops, uint32_t base,
+    uint32_t bitmap)
+{
+    uint8_t p[8];
+    put_u32(p, base);
+    put_u32(p + 4, bitmap);
+    send_frame(ops, UPDATE_ACK, p, sizeof(p));
+}
+
+static void send_error(const struct update_rx_ops *ops, uint8_t code)
+{
+    send_frame(ops, UPDATE_ERROR, &code, 1);
+}
+
+/* Read one valid frame into 'frame'. Returns the payload length. Frames with
+ * a wrong CRC are dropped: the host retransmits what is not acknowledged. */
+static int recv_frame(const struct update_rx_ops *ops)
+{
+    uint32_t pos = 0, need = 2, len = 0;
+    uint8_t c;
+
+    while (1) {
+        while (ops->rx(&c) == 0)
+            ;
+        if (pos == 0) {
+            if (c == UPDATE_SYNC0)
+                pos = 1;
+            continue;
+        }
+        if (pos == 1) {
+            if (c == UPDATE_SYNC1) {
+                pos = 2;
+                need = 5;
+            } else if (c != UPDATE_SYNC0) {
+                pos = 0;
+            }
+            continue;
+        }
+        frame[pos - 2] = c;
+        pos++;
+        if (pos == 5) {
+            len = frame[1] | (frame[2] << 8);
+            if (len > UPDATE_RX_MAX_PAYLOAD) {
+                pos = 0;
+                continue;
+            }
+            need = 5 + len + 4;
+        }
+        if (pos == need) {
+            pos = 0;
+            if (update_crc32(0, frame, 3 + len) == get_u32(frame + 3 + len))
+                return (int)len;
+        }
+    }
+}
+
+/* CRC32 of the first 'len' bytes of the partition */
+static uint32_t partition_crc(const struct update_rx_ops *ops, uint32_t len)
+{
+    uint8_t buf[64];
+    uint32_t off = 0, n, crc = 0;
+    while (off < len) {
+        n = len - off;
+        if (n > sizeof(buf))
+            n = sizeof(buf);
+        if (ops->read(off, buf, n) < 0)
+            break;
+        crc = update_crc32(crc, buf, n);
+        off += n;
+    }
+    return crc;
+}
+
+int update_rx_run(const struct update_rx_ops *ops, uint32_t version)
+{
+    uint32_t total = 0, base = 0, bitmap = 0;
+    uint32_t off, idx, slot;
+    uint8_t *payload = frame + 3;
+    uint8_t reply[8];
+    int started = 0;
+    int len;
+
+    if ((ops->sector_size % UPDATE_RX_FRAME_SIZE) != 0)
+        return -1;
+    send_hello(ops, version);
+    while (1) {
+        len = recv_frame(ops);
+        switch (frame[0]) {
+            case UPDATE_PROBE:
+                send_hello(ops, version);
+                break;
+            case UPDATE_QUERY:
+                if (len != 4)
+                    break;
+                off = get_u32(payload);
+                if (off > ops->max_size) {
+                    send_error(ops, UPDATE_ERR_SIZE);
+                    break;
+                }
+                put_u32(reply, off);
+                put_u32(reply + 4, partition_crc(ops, off));
+                send_frame(ops, UPDATE_CRC, reply, sizeof(reply));
+                break;
+            case UPDATE_START:
+                if (len != 8)
+                    break;
+                total = get_u32(payload);
+                off = get_u32(payload + 4);
+                if ((total == 0) || (total > ops->max_size)) {
+                    send_error(ops, UPDATE_ERR_SIZE);
+                    break;
+                }
+                if ((off > total) || ((off % ops->sector_size) != 0)) {
+                    send_error(ops, UPDATE_ERR_OFFSET);
+                    break;
+                }
+                base = off;
+                bitmap = 0;
+                started = 1;
+                send_ack(ops, base, bitmap);
+                break;
+            case UPDATE_DATA:
+                if (!started) {
+                    send_error(ops, UPDATE_ERR_STATE);
+                    break;
+                }
+                if (len <= 4)
+                    break;
+                off = get_u32(payload);
+                len -= 4;
+                if (((off % UPDATE_RX_FRAME_SIZE) != 0) ||
+                        ((off + len != total) &&
+                         (len != UPDATE_RX_FRAME_SIZE)) ||
+                        (off + len > total)) {
+                    send_error(ops, UPDATE_ERR_OFFSET);
+                    break;
+                }
+                if (off >= base) {
+                    idx = (off - base) / UPDATE_RX_FRAME_SIZE;
+                    if (idx < UPDATE_RX_WINDOW) {
+                        slot = (off / UPDATE_RX_FRAME_SIZE) % UPDATE_RX_WINDOW;
+                        memcpy(window[slot], payload + 4, len);
+                        window_len[slot] = (uint16_t)len;
+                        bitmap |= (1U << idx);
+                    }
+                }
+                /* Store the frames that are now in order */
+                while (bitmap & 1U) {
+                    slot = (base / UPDATE_RX_FRAME_SIZE) % UPDATE_RX_WINDOW;
+                    if (((base % ops->sector_size) == 0) &&
+                            (ops->erase(base, ops->sector_size) < 0))
+                        return -1;
+                    if (ops->write(base, window[slot], window_len[slot]) < 0)
+                        return -1;
+                    base += window_len[slot];
+                    bitmap >>= 1;
+                }
+                send_ack(ops, base, bitmap);
+                if (base == total)
+                    return (int)total;
+                break;
+            default:
+                break;
+        }
+    }
+}
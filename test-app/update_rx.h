@@ -0,0 +1,85 @@
+/* update_rx.h
+ *
+ * Device side of the UART update protocol, version 2.
+ * The host side is tools/test-update-server.
+ *
+ * Copyright (C) 2025 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#ifndef UPDATE_RX_H_INCLUDED
+#define UPDATE_RX_H_INCLUDED
+
+#include <stdint.h>
+
+/* Frame: SYNC0 SYNC1 type len(2) payload(len) crc32(4)
+ * All fields little-endian, the CRC32 covers type, len and payload.
+ */
+#define UPDATE_SYNC0            0xA5
+#define UPDATE_SYNC1            0x5B
+#define UPDATE_FRAME_OVERHEAD   (2 + 1 + 2 + 4)
+
+/* Host to device */
+#define UPDATE_PROBE   'P' /* any payload: device answers with HELLO */
+#define UPDATE_QUERY   'Q' /* length(4): CRC32 of the partition up to length */
+#define UPDATE_START   'S' /* total(4) offset(4): start or resume a transfer */
+#define UPDATE_DATA    'D' /* offset(4) data */
+
+/* Device to host */
+#define UPDATE_HELLO   'H' /* version(4) sector(4) max_size(4) frame(2)
+                            * window(1) */
+#define UPDATE_CRC     'C' /* length(4) crc32(4) */
+#define UPDATE_ACK     'A' /* base(4) bitmap(4): everything below base is
+                            * stored, bit n set: frame at base + n * frame
+                            * is received and waiting for the missing ones */
+#define UPDATE_ERROR   'E' /* code(1) */
+
+#define UPDATE_ERR_SIZE     1
+#define UPDATE_ERR_OFFSET   2
+#define UPDATE_ERR_STATE    3
+
+/* Payload of a data frame. Must divide the sector size. */
+#ifndef UPDATE_RX_FRAME_SIZE
+#define UPDATE_RX_FRAME_SIZE 512
+#endif
+
+/* Frames received out of order that can be held in RAM (max 32) */
+#ifndef UPDATE_RX_WINDOW
+#define UPDATE_RX_WINDOW 8
+#endif
+
+struct update_rx_ops {
+    /* Non-blocking: 1 if a byte was read, 0 otherwise */
+    int (*rx)(uint8_t *c);
+    void (*tx)(uint8_t c);
+    /* Offsets are relative to the start of the update partition */
+    int (*erase)(uint32_t off, uint32_t len);
+    int (*write)(uint32_t off, const uint8_t *data, uint32_t len);
+    int (*read)(uint32_t off, uint8_t *data, uint32_t len);
+    uint32_t sector_size;
+    uint32_t max_size;
+};
+
+uint32_t update_crc32(uint32_t crc, const uint8_t *data, uint32_t len);
+
+/* Receive an image into the update partition. Returns the image size once
+ * the whole image is stored, or a negative value if the flash could not be
+ * written. */
+int update_rx_run(const struct update_rx_ops *ops, uint32_t version);
+
+#endif /* !UPDATE_RX_H_INCLUDED */
@@ -32,6 +32,8 @@ ifeq ($(ARCH),)
   ALLOW_DOWNGRADE?=0
   NVM_FLASH_WRITEONCE?=0
   DISABLE_BACKUP?=0
+  SWAP_SECTORS?=1
+  SWAP_MOVE?=0
   WOLFBOOT_VERSION?=0
   V?=0
   LMS_LEVELS?=0
@@ -82,6 +84,7 @@ ifeq ($(ARCH),)
   FLASH_OTP_KEYSTORE?=0
   BIG_ENDIAN?=0
   FLASH_MULTI_SECTOR_ERASE=0
+  FLASH_BLANK_CHECK?=0
   WOLFHSM_CLIENT=0
   WOLFHSM_CLIENT_LOCAL_KEYS=0
 endif
@@ -89,7 +92,7 @@ endif
 CONFIG_VARS:= ARCH TARGET SIGN HASH MCUXSDK MCUXPRESSO MCUXPRESSO_CPU MCUXPRESSO_DRIVERS \
 	MCUXPRESSO_CMSIS FREEDOM_E_SDK STM32CUBE CYPRESS_PDL CYPRESS_CORE_LIB CYPRESS_TARGET_LIB DEBUG VTOR \
 	CORTEX_M0 CORTEX_M7 CORTEX_M33 NO_ASM EXT_FLASH SPI_FLASH NO_XIP UART_FLASH ALLOW_DOWNGRADE NVM_FLASH_WRITEONCE \
-	DISABLE_BACKUP WOLFBOOT_VERSION V NO_MPU ENCRYPT FLAGS_HOME FLAGS_INVERT \
+	DISABLE_BACKUP SWAP_SECTORS SWAP_MOVE WOLFBOOT_VERSION V NO_MPU ENCRYPT FLAGS_HOME FLAGS_INVERT \
 	SPMATH SPMATHALL RAM_CODE DUALBANK_SWAP IMAGE_HEADER_SIZE PKA TZEN PSOC6_CRYPTO \
     WOLFTPM WOLFBOOT_TPM_VERIFY MEASURED_BOOT WOLFBOOT_TPM_SEAL WOLFBOOT_TPM_KEYSTORE \
 	WOLFCRYPT_TZ WOLFCRYPT_TZ_PKCS11 \
@@ -106,6 +109,7 @@ CONFIG_VARS:= ARCH TARGET SIGN HASH MCUXSDK MCUXPRESSO MCUXPRESSO_CPU MCUXPRESSO
 	ELF BIG_ENDIAN \
 	NXP_CUSTOM_DCD NXP_CUSTOM_DCD_OBJS \
 	FLASH_OTP_KEYSTORE \
+	FLASH_BLANK_CHECK \
 	KEYVAULT_OBJ_SIZE \
 	KEYVAULT_MAX_ITEMS \
 	NO_ARM_ASM \
@@ -29,9 +29,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <time.h>
 
 static int gEnableUnitTest = 0;
 static int gParseFit = 0;
+static int gBenchmark = 0;
+static int gBatchTest = 0;
 #define UNIT_TEST_GROW_SIZE 1024
 
 /* Test case for "nxp_t1024.dtb" */
@@ -225,6 +228,301 @@ exit:
     return ret;
 }
 
+#define BENCH_ITERATIONS  2000
+#define BENCH_MAX_RESULTS 256
+
+/* Lookups issued by the HALs to apply the boot-time fixups, plus a few
+ * misses. Returns the number of lookups, results stored in res[] */
+static int fdt_bench_lookups(void* fdt, int* res, int max)
+{
+    const char* devtypes[] = {
+        "memory", "cpu", "soc", "serial", "qe", "open-pic", "pci"
+    };
+    const char* compats[] = {
+        "fsl-usb2-mph", "fsl-usb2-dr", "fsl,esdhc", "fsl,pq-sata-v2",
+        "fsl,tdm1.0", "fsl,qe", "fsl,elo3-dma", "fsl,qman", "fsl,bman",
+        "fsl,qoriq-pcie-v2.4", "fsl,qman-portal", "fsl,fman", "fsl,none"
+    };
+    const char* nodes[] = {
+        "cpus", "memory", "aliases", "chosen", "reserved-memory",
+        "qman-portal@0", "bman-portal@24000", "none"
+    };
+    int n = 0, i, off;
+
+    #define BENCH_RESULT(o) do { if (n < max) res[n] = (o); n++; } while (0)
+    for (i = 0; i < (int)(sizeof(devtypes)/sizeof(devtypes[0])); i++) {
+        off = -1;
+        do {
+            off = fdt_find_devtype(fdt, off, devtypes[i]);
+            BENCH_RESULT(off);
+        } while (off >= 0);
+    }
+    for (i = 0; i < (int)(sizeof(compats)/sizeof(compats[0])); i++) {
+        off = -1;
+        do {
+            off = fdt_node_offset_by_compatible(fdt, off, compats[i]);
+            BENCH_RESULT(off);
+        } while (off >= 0);
+    }
+    for (i = 0; i < (int)(sizeof(nodes)/sizeof(nodes[0])); i++) {
+        off = fdt_find_node_offset(fdt, -1, nodes[i]);
+        BENCH_RESULT(off);
+    }
+    #undef BENCH_RESULT
+    return n;
+}
+
+static double bench_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+static double fdt_bench_run(void* fdt, const char* desc, int* res, int *nres)
+{
+    int i, lookups = 0;
+    double start, elapsed;
+
+    start = bench_time();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        lookups += fdt_bench_lookups(fdt, res, BENCH_MAX_RESULTS);
+    }
+    elapsed = bench_time() - start;
+    *nres = lookups / BENCH_ITERATIONS;
+    printf("FDT Bench %s: %d lookups in %.3f ms, %.0f lookups/sec\n",
+        desc, lookups, elapsed * 1000.0, (double)lookups / elapsed);
+    return (double)lookups / elapsed;
+}
+
+/* Benchmark the node lookups used for fixups */
+static int fdt_bench(void* fdt)
+{
+    int ref[BENCH_MAX_RESULTS], nref = 0;
+#ifdef WOLFBOOT_FDT_INDEX
+    int res[BENCH_MAX_RESULTS], nres = 0, i;
+    double scan, indexed;
+
+    fdt_index_enable(0);
+    scan = fdt_bench_run(fdt, "scan", ref, &nref);
+    fdt_index_enable(1);
+    indexed = fdt_bench_run(fdt, "index", res, &nres);
+    if (nres > BENCH_MAX_RESULTS)
+        nres = BENCH_MAX_RESULTS;
+    for (i = 0; i < nres; i++) {
+        if ((nres != nref) || (res[i] != ref[i])) {
+            printf("FDT Bench: lookup %d mismatch: index %d, scan %d\n",
+                i, res[i], ref[i]);
+            return -1;
+        }
+    }
+    printf("FDT Bench: index speedup %.1fx\n", indexed / scan);
+#else
+    fdt_bench_run(fdt, "scan", ref, &nref);
+#endif
+    return 0;
+}
+
+#define BATCH_ITERATIONS 500
+
+typedef int (*fixup_setprop_cb)(void* ctx, int off, const char* name,
+    const void* val, int len);
+
+static int fixup_setprop_direct(void* ctx, int off, const char* name,
+    const void* val, int len)
+{
+    return fdt_setprop(ctx, off, name, val, len);
+}
+
+static int fixup_setprop_batch(void* ctx, int off, const char* name,
+    const void* val, int len)
+{
+    return fdt_batch_setprop((struct fdt_batch*)ctx, off, name, val, len);
+}
+
+/* Replay the fixups the nxp_t1024 HAL applies before booting Linux. Lookups
+ * are done in fdt, edits go through setprop. Returns the number of edits. */
+static int fixup_replay(void* fdt, fixup_setprop_cb setprop, void* ctx)
+{
+    const char* liodn_compat[] = {
+        "fsl-usb2-mph", "fsl-usb2-dr", "fsl,esdhc", "fsl,pq-sata-v2",
+        "fsl,tdm1.0", "fsl,qe", "fsl,elo3-dma", "fsl,qman", "fsl,bman",
+        "fsl,qoriq-pcie-v2.4"
+    };
+    int ret = 0, off, i, n = 0;
+    const uint32_t *reg;
+    uint32_t val, liodns[2];
+    uint64_t val64, ranges[2];
+    uint8_t mac[6] = { 0x00, 0xE0, 0x0C, 0x00, 0x00, 0x00 };
+
+    #define REPLAY_SET(o, name, v, l) do { \
+        ret = setprop(ctx, (o), (name), (v), (l)); \
+        if (ret != 0) return ret; \
+        n++; } while (0)
+    #define REPLAY_STR(o, name, str) \
+        REPLAY_SET(o, name, str, (int)strlen(str) + 1)
+    #define REPLAY_VAL(o, name, v) do { val = cpu_to_fdt32(v); \
+        REPLAY_SET(o, name, &val, sizeof(val)); } while (0)
+    #define REPLAY_VAL64(o, name, v) do { val64 = cpu_to_fdt64(v); \
+        REPLAY_SET(o, name, &val64, sizeof(val64)); } while (0)
+
+    off = fdt_find_devtype(fdt, -1, "memory");
+    if (off >= 0) {
+        ranges[0] = cpu_to_fdt64(DDR_ADDRESS);
+        ranges[1] = cpu_to_fdt64(DDR_SIZE);
+        REPLAY_SET(off, "reg", ranges, sizeof(ranges));
+    }
+    for (off = fdt_find_devtype(fdt, -1, "cpu"); off >= 0;
+         off = fdt_find_devtype(fdt, off, "cpu")) {
+        reg = fdt_getprop(fdt, off, "reg", NULL);
+        if (reg == NULL)
+            break;
+        i = (int)fdt32_to_cpu(*reg);
+        REPLAY_STR(off, "status", (i == 0) ? "okay" : "disabled");
+        REPLAY_VAL64(off, "cpu-release-addr", SPIN_TABLE_ADDR + i * ENTRY_SIZE);
+        REPLAY_STR(off, "enable-method", "spin-table");
+        REPLAY_VAL(off, "timebase-frequency", TIMEBASE_HZ);
+        REPLAY_VAL(off, "clock-frequency", PLAT_CLK);
+        REPLAY_VAL(off, "bus-frequency", PLAT_CLK);
+    }
+    off = fdt_find_devtype(fdt, -1, "soc");
+    if (off >= 0)
+        REPLAY_VAL(off, "bus-frequency", PLAT_CLK);
+    for (off = fdt_find_devtype(fdt, -1, "serial"); off >= 0;
+         off = fdt_find_devtype(fdt, off, "serial")) {
+        REPLAY_VAL(off, "clock-frequency", BUS_CLK);
+    }
+    off = fdt_find_devtype(fdt, -1, "qe");
+    if (off >= 0) {
+        REPLAY_VAL(off, "clock-frequency", BUS_CLK);
+        REPLAY_VAL(off, "bus-frequency", BUS_CLK);
+        REPLAY_VAL(off, "brg-frequency", BUS_CLK/2);
+    }
+    for (i = 0; i < (int)(sizeof(liodn_compat)/sizeof(liodn_compat[0])); i++) {
+        off = fdt_node_offset_by_compatible(fdt, -1, liodn_compat[i]);
+        if (off >= 0)
+            REPLAY_VAL(off, "fsl,liodn", 500 + i);
+    }
+    for (off = fdt_node_offset_by_compatible(fdt, -1, "fsl,qman-portal");
+         off >= 0;
+         off = fdt_node_offset_by_compatible(fdt, off, "fsl,qman-portal")) {
+        reg = fdt_getprop(fdt, off, "cell-index", NULL);
+        if (reg == NULL)
+            break;
+        liodns[0] = cpu_to_fdt32(fdt32_to_cpu(*reg) + 1);
+        liodns[1] = cpu_to_fdt32(fdt32_to_cpu(*reg) + 27);
+        REPLAY_SET(off, "fsl,liodn", liodns, sizeof(liodns));
+    }
+    off = fdt_node_offset_by_compatible(fdt, -1, "fsl,fman");
+    if (off >= 0)
+        REPLAY_VAL(off, "clock-frequency", BUS_CLK);
+    for (off = fdt_node_offset_by_compatible(fdt, -1, "fsl,fman-memac");
+         off >= 0;
+         off = fdt_node_offset_by_compatible(fdt, off, "fsl,fman-memac")) {
+        mac[5]++;
+        REPLAY_SET(off, "local-mac-address", mac, sizeof(mac));
+    }
+    off = fdt_find_devtype(fdt, -1, "open-pic");
+    if (off >= 0)
+        REPLAY_VAL(off, "clock-frequency", BUS_CLK);
+
+    #undef REPLAY_SET
+    #undef REPLAY_STR
+    #undef REPLAY_VAL
+    #undef REPLAY_VAL64
+    return n;
+}
+
+/* return: 0 if both trees have the same nodes and properties */
+static int fdt_compare(void* a, void* b)
+{
+    int noffa, noffb, poffa, poffb, lena, lenb;
+    const struct fdt_property *pa, *pb;
+
+    for (noffa = fdt_next_node(a, -1, NULL), noffb = fdt_next_node(b, -1, NULL);
+         noffa >= 0 && noffb >= 0;
+         noffa = fdt_next_node(a, noffa, NULL),
+         noffb = fdt_next_node(b, noffb, NULL))
+    {
+        if (strcmp(fdt_get_name(a, noffa, NULL), fdt_get_name(b, noffb, NULL)))
+            return -1;
+        for (poffa = fdt_first_property_offset(a, noffa),
+             poffb = fdt_first_property_offset(b, noffb);
+             poffa >= 0 && poffb >= 0;
+             poffa = fdt_next_property_offset(a, poffa),
+             poffb = fdt_next_property_offset(b, poffb))
+        {
+            pa = fdt_get_property_by_offset(a, poffa, &lena);
+            pb = fdt_get_property_by_offset(b, poffb, &lenb);
+            if ((lena != lenb) || (memcmp(pa->data, pb->data, lena) != 0) ||
+                strcmp(fdt_get_string(a, fdt32_to_cpu(pa->nameoff), NULL),
+                       fdt_get_string(b, fdt32_to_cpu(pb->nameoff), NULL))) {
+                printf("FDT Compare: %s: property mismatch at %d/%d\n",
+                    fdt_get_name(a, noffa, NULL), poffa, poffb);
+                return -1;
+            }
+        }
+        if (poffa != poffb)
+            return -1;
+    }
+    return (noffa == noffb) ? 0 : -1;
+}
+
+/* Replay a fixup set with fdt_setprop() and with a batch, compare results
+ * and timings */
+static int fdt_batch_test(void* fdt)
+{
+    static struct fdt_batch batch;
+    int ret = 0, i, n = 0;
+    uint32_t size = fdt_totalsize(fdt), outsz = size + UNIT_TEST_GROW_SIZE;
+    uint8_t *seq = malloc(outsz), *bat = malloc(outsz);
+    double start, t_seq, t_batch;
+
+    if (seq == NULL || bat == NULL) {
+        ret = -1;
+        goto exit;
+    }
+
+    start = bench_time();
+    for (i = 0; (i < BATCH_ITERATIONS) && (ret == 0); i++) {
+        memcpy(seq, fdt, size);
+        fdt_set_totalsize(seq, outsz);
+    #ifdef WOLFBOOT_FDT_INDEX
+        fdt_index_invalidate(); /* blob replaced in place */
+    #endif
+        n = fixup_replay(seq, fixup_setprop_direct, seq);
+        if (n < 0)
+            ret = n;
+    }
+    t_seq = (bench_time() - start) * 1000.0 / BATCH_ITERATIONS;
+
+    start = bench_time();
+    for (i = 0; (i < BATCH_ITERATIONS) && (ret == 0); i++) {
+        ret = fdt_batch_init(&batch, fdt);
+        if (ret == 0)
+            ret = fixup_replay(fdt, fixup_setprop_batch, &batch);
+        if (ret >= 0)
+            ret = fdt_batch_commit(&batch, bat, outsz);
+    }
+    t_batch = (bench_time() - start) * 1000.0 / BATCH_ITERATIONS;
+    if (ret != 0)
+        goto exit;
+
+    ret = fdt_compare(seq, bat);
+    fdt_shrink(seq);
+    fdt_shrink(bat);
+    printf("FDT Batch: %d edits, size %d -> %d (setprop) %d (batch)\n",
+        n, size, fdt_totalsize(seq), fdt_totalsize(bat));
+    printf("FDT Batch: setprop %.3f ms, batch %.3f ms per pass (%.1fx)\n",
+        t_seq, t_batch, t_seq / t_batch);
+
+exit:
+    printf("FDT Batch Test Result: %d\n", ret);
+    free(seq);
+    free(bat);
+    return ret;
+}
+
 static void print_bin(const uint8_t* buffer, uint32_t length)
 {
     uint32_t i, notprintable = 0;
@@ -439,9 +737,11 @@ int dts_parse(void* image)
 static void Usage(void)
 {
     printf("Expected usage:\n");
-    printf("./tools/fdt-parser/fdt-parser [-t] [-i] filename\n");
+    printf("./tools/fdt-parser/fdt-parser [-t] [-i] [-b] [-x] filename\n");
     printf("\t* -i: Parse Flattened uImage Tree (FIT) image\n");
     printf("\t* -t: Test several updates (used with nxp_t1024.dtb)\n");
+    printf("\t* -b: Benchmark node lookups (lookups/sec)\n");
+    printf("\t* -x: Compare fixups with fdt_setprop and batched (nxp_t1024.dtb)\n");
 }
 
 int main(int argc, char *argv[])
@@ -465,6 +765,12 @@ int main(int argc, char *argv[])
         else if (strcmp(argv[argc-1], "-i") == 0) {
             gParseFit = 1;
         }
+        else if (strcmp(argv[argc-1], "-b") == 0) {
+            gBenchmark = 1;
+        }
+        else if (strcmp(argv[argc-1], "-x") == 0) {
+            gBatchTest = 1;
+        }
         else if (*argv[argc-1] != '-') {
             filename = argv[argc-1];
         }
@@ -493,6 +799,12 @@ int main(int argc, char *argv[])
         printf("FDT Version %d, Size %d\n",
             fdt_version(image), fdt_totalsize(image));
     }
+    if (ret == 0 && gBenchmark) {
+        ret = fdt_bench(image);
+    }
+    if (ret == 0 && gBatchTest) {
+        ret = fdt_batch_test(image);
+    }
     if (ret == 0 && gEnableUnitTest) {
         ret = fdt_test(image);
         if (ret == 0) {
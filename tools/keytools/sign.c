@@ -57,6 +57,8 @@
 #ifdef _WIN32
 #include <io.h>
 #define HAVE_MMAP 0
+#define HAVE_PTHREAD 0
+#define HAVE_UNIX_SOCKET 0
 #define ftruncate(fd, len) _chsize(fd, len)
 static inline int fp_truncate(FILE *f, size_t len)
 {
@@ -68,12 +70,25 @@ static inline int fp_truncate(FILE *f, size_t len)
 }
 #else
 #define HAVE_MMAP 1
+#define HAVE_PTHREAD 1
+#define HAVE_UNIX_SOCKET 1
 #include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
 #endif
 
 #define MAX_SRC_SIZE (1 << 24)
 
+/* Maximum number of threads used to compute delta patches */
+#define DELTA_MAX_JOBS 64
+
+/* Maximum length of a line in a --batch manifest or a --server request */
+#define BATCH_LINE_MAX (2 * PATH_MAX + 64)
+
 #ifndef MAX_CUSTOM_TLVS
 #define MAX_CUSTOM_TLVS (16)
 #endif
@@ -172,6 +187,7 @@ static inline int fp_truncate(FILE *f, size_t len)
 #define HDR_IMG_DELTA_BASE 0x05
 #define HDR_IMG_DELTA_SIZE 0x06
 #define HDR_IMG_DELTA_BASE_HASH 0x07
+#define HDR_HASH_TREE 0x08
 #define HDR_IMG_DELTA_INVERSE 0x15
 #define HDR_IMG_DELTA_INVERSE_SIZE 0x16
 
@@ -229,6 +245,74 @@ static void header_append_tag(uint8_t* header, uint32_t* idx, uint16_t tag,
     *idx += len;
 }
 
+/* Map a whole input file in memory (read-only). Without mmap, the file is
+ * read into a heap buffer instead. Release with unmap_file().
+ */
+static uint8_t *map_file(const char *path, uint32_t *sz)
+{
+    struct stat st;
+    uint8_t *p;
+#if HAVE_MMAP
+    int fd;
+#else
+    FILE *f;
+#endif
+
+    if (stat(path, &st) < 0) {
+        printf("Cannot stat %s\n", path);
+        return NULL;
+    }
+    if ((uint64_t)st.st_size > UINT32_MAX) {
+        printf("%s: file too large\n", path);
+        return NULL;
+    }
+    *sz = (uint32_t)st.st_size;
+    if (*sz == 0)
+        return malloc(1);
+#if HAVE_MMAP
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Cannot open file %s\n", path);
+        return NULL;
+    }
+    p = mmap(NULL, *sz, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+#else
+    f = fopen(path, "rb");
+    if (f == NULL) {
+        printf("Cannot open file %s\n", path);
+        return NULL;
+    }
+    p = malloc(*sz);
+    if ((p != NULL) && (fread(p, 1, *sz, f) != *sz)) {
+        perror("fread");
+        free(p);
+        p = NULL;
+    }
+    fclose(f);
+#endif
+    return p;
+}
+
+static void unmap_file(uint8_t *p, uint32_t sz)
+{
+    if (p == NULL)
+        return;
+#if HAVE_MMAP
+    if (sz > 0) {
+        munmap(p, sz);
+        return;
+    }
+#else
+    (void)sz;
+#endif
+    free(p);
+}
+
 #include "../lms/lms_common.h"
 #include "../xmss/xmss_common.h"
 
@@ -268,6 +352,10 @@ struct cmd_options {
     const char *delta_base_file;
     const char *cert_chain_file;
     int no_base_sha;
+    uint32_t hash_tree_chunk;
+    const char *batch_file;
+    const char *server_path;
+    int jobs;
     char output_image_file[PATH_MAX];
     char output_diff_file[PATH_MAX];
     char output_encrypted_image_file[PATH_MAX];
@@ -286,12 +374,17 @@ struct cmd_options {
     } custom_tlv[MAX_CUSTOM_TLVS];
 };
 
+/* Images and versions come from --batch or --server instead of the command
+ * line */
+#define MULTI_IMAGE_MODE() ((CMD.batch_file != NULL) || (CMD.server_path != NULL))
+
 static struct cmd_options CMD = {
     .sign = SIGN_AUTO,
     .encrypt  = ENC_OFF,
     .hash_algo = HASH_SHA256,
     .partition_id = HDR_IMG_TYPE_APP,
-    .hybrid = 0
+    .hybrid = 0,
+    .jobs = 1
 };
 
 static uint16_t sign_tool_find_header(uint8_t *haystack, uint16_t type, uint8_t **ptr)
@@ -947,17 +1040,52 @@ failure:
 }
 
 /* Sign the digest */
+/* The RNG is seeded once, and reused for all the signatures of a run */
+static WC_RNG rng;
+static int rng_ready = 0;
+
+/* When signing several images (--batch, --server), the state of LMS/XMSS
+ * private keys is kept in memory between two signatures instead of being
+ * reloaded from the key file every time. This is only safe while the key file
+ * is locked by this process (see lock_key_file()), so nobody else can reuse a
+ * one-time key already consumed.
+ * Index 0 is the primary key, 1 the secondary key.
+ */
+static int stateful_key_locked[2];
+static int stateful_key_loaded[2];
+
+#if HAVE_UNIX_SOCKET
+static int lock_key_file(const char *path, int secondary)
+{
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        printf("Open key file %s failed: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        printf("Key file %s is in use by another signer\n", path);
+        close(fd);
+        return -1;
+    }
+    /* The descriptor is left open: the lock is held until exit */
+    stateful_key_locked[secondary] = 1;
+    return 0;
+}
+#endif
+
 static int sign_digest(int sign, int hash_algo,
     uint8_t* signature, uint32_t* signature_sz,
     uint8_t* digest, uint32_t digest_sz, int secondary)
 {
     int ret;
-    WC_RNG rng;
     printf("Sign: %02x\n", sign >> 8);
     (void)secondary;
 
-    if ((ret = wc_InitRng(&rng)) != 0) {
-        return ret;
+    if (!rng_ready) {
+        if ((ret = wc_InitRng(&rng)) != 0) {
+            return ret;
+        }
+        rng_ready = 1;
     }
 
     if (sign == SIGN_ED25519) {
@@ -1032,21 +1160,28 @@ static int sign_digest(int sign, int hash_algo,
         if (secondary) {
             key_file = CMD.secondary_key_file;
         }
-        /* Set the callbacks, so LMS can update the private key while signing */
-        ret = wc_LmsKey_SetWriteCb(&key.lms, lms_write_key);
-        if (ret == 0) {
-            ret = wc_LmsKey_SetReadCb(&key.lms, lms_read_key);
-        }
-        if (ret == 0) {
-            ret = wc_LmsKey_SetContext(&key.lms, (void*)key_file);
-        }
-        if (ret == 0) {
-            ret = wc_LmsKey_Reload(&key.lms);
+        ret = 0;
+        if (!stateful_key_loaded[secondary]) {
+            /* Set the callbacks, so LMS can update the private key while
+             * signing */
+            ret = wc_LmsKey_SetWriteCb(&key.lms, lms_write_key);
+            if (ret == 0) {
+                ret = wc_LmsKey_SetReadCb(&key.lms, lms_read_key);
+            }
+            if (ret == 0) {
+                ret = wc_LmsKey_SetContext(&key.lms, (void*)key_file);
+            }
+            if (ret == 0) {
+                ret = wc_LmsKey_Reload(&key.lms);
+            }
         }
         if (ret == 0) {
             ret = wc_LmsKey_Sign(&key.lms, signature, signature_sz, digest,
                                  digest_sz);
         }
+        if ((ret == 0) && stateful_key_locked[secondary] && !CMD.hybrid) {
+            stateful_key_loaded[secondary] = 1;
+        }
         if (ret != 0) {
             fprintf(stderr, "error signing with LMS: %d\n", ret);
         }
@@ -1057,27 +1192,34 @@ static int sign_digest(int sign, int hash_algo,
         if (secondary) {
             key_file = CMD.secondary_key_file;
         }
-        ret = wc_XmssKey_Init(&key.xmss, NULL, INVALID_DEVID);
-        /* Set the callbacks, so XMSS can update the private key while signing */
-        if (ret == 0) {
-            ret = wc_XmssKey_SetWriteCb(&key.xmss, xmss_write_key);
-        }
-        if (ret == 0) {
-            ret = wc_XmssKey_SetReadCb(&key.xmss, xmss_read_key);
-        }
-        if (ret == 0) {
-            ret = wc_XmssKey_SetContext(&key.xmss, (void*)key_file);
-        }
-        if (ret == 0) {
-            ret = wc_XmssKey_SetParamStr(&key.xmss, WOLFBOOT_XMSS_PARAMS);
-        }
-        if (ret == 0) {
-            ret = wc_XmssKey_Reload(&key.xmss);
+        ret = 0;
+        if (!stateful_key_loaded[secondary]) {
+            ret = wc_XmssKey_Init(&key.xmss, NULL, INVALID_DEVID);
+            /* Set the callbacks, so XMSS can update the private key while
+             * signing */
+            if (ret == 0) {
+                ret = wc_XmssKey_SetWriteCb(&key.xmss, xmss_write_key);
+            }
+            if (ret == 0) {
+                ret = wc_XmssKey_SetReadCb(&key.xmss, xmss_read_key);
+            }
+            if (ret == 0) {
+                ret = wc_XmssKey_SetContext(&key.xmss, (void*)key_file);
+            }
+            if (ret == 0) {
+                ret = wc_XmssKey_SetParamStr(&key.xmss, WOLFBOOT_XMSS_PARAMS);
+            }
+            if (ret == 0) {
+                ret = wc_XmssKey_Reload(&key.xmss);
+            }
         }
         if (ret == 0) {
             ret = wc_XmssKey_Sign(&key.xmss, signature, signature_sz, digest,
                                  digest_sz);
         }
+        if ((ret == 0) && stateful_key_locked[secondary] && !CMD.hybrid) {
+            stateful_key_loaded[secondary] = 1;
+        }
         if (ret != 0) {
             fprintf(stderr, "error signing with XMSS: %d\n", ret);
         }
@@ -1097,13 +1239,91 @@ static int sign_digest(int sign, int hash_algo,
     {
         ret = NOT_COMPILED_IN;
     }
-    wc_FreeRng(&rng);
     return ret;
 }
 
 #define ALIGN_8(x) while ((x % 8) != 4) { x++; }
 #define ALIGN_4(x) while ((x % 4) != 0) { x++; }
 
+/* Tree hash mode: hash each chunk of the image independently, and store the
+ * resulting digests in a heap buffer, returned in *leaves (release with
+ * free()). The image digest in the manifest is then calculated over the
+ * header followed by this buffer, instead of the image itself, so the chunks
+ * can be verified in parallel.
+ */
+static int hash_tree_leaves(const uint8_t *image, uint32_t image_sz,
+        uint8_t **leaves, uint32_t *leaves_sz)
+{
+    const uint8_t *chunk;
+    uint8_t *leaf;
+    uint32_t pos = 0, len, digest_sz = 0;
+    int ret = 0;
+
+    /* max digest size (48) per chunk */
+    *leaves = malloc(((image_sz / CMD.hash_tree_chunk) + 1) * 48);
+    if (*leaves == NULL) {
+        printf("Hash tree buffer malloc error!\n");
+        return -1;
+    }
+    *leaves_sz = 0;
+    while (ret == 0 && pos < image_sz) {
+        len = image_sz - pos;
+        if (len > CMD.hash_tree_chunk)
+            len = CMD.hash_tree_chunk;
+        chunk = image + pos;
+        leaf = *leaves + *leaves_sz;
+        if (CMD.hash_algo == HASH_SHA256) {
+    #ifndef NO_SHA256
+            wc_Sha256 sha;
+            ret = wc_InitSha256_ex(&sha, NULL, INVALID_DEVID);
+            if (ret == 0)
+                ret = wc_Sha256Update(&sha, chunk, len);
+            if (ret == 0)
+                ret = wc_Sha256Final(&sha, leaf);
+            wc_Sha256Free(&sha);
+            digest_sz = HDR_SHA256_LEN;
+    #endif
+        }
+        else if (CMD.hash_algo == HASH_SHA384) {
+    #ifndef NO_SHA384
+            wc_Sha384 sha;
+            ret = wc_InitSha384_ex(&sha, NULL, INVALID_DEVID);
+            if (ret == 0)
+                ret = wc_Sha384Update(&sha, chunk, len);
+            if (ret == 0)
+                ret = wc_Sha384Final(&sha, leaf);
+            wc_Sha384Free(&sha);
+            digest_sz = HDR_SHA384_LEN;
+    #endif
+        }
+        else if (CMD.hash_algo == HASH_SHA3) {
+    #ifdef WOLFSSL_SHA3
+            wc_Sha3 sha;
+            ret = wc_InitSha3_384(&sha, NULL, INVALID_DEVID);
+            if (ret == 0)
+                ret = wc_Sha3_384_Update(&sha, chunk, len);
+            if (ret == 0)
+                ret = wc_Sha3_384_Final(&sha, leaf);
+            wc_Sha3_384_Free(&sha);
+            digest_sz = HDR_SHA3_384_LEN;
+    #endif
+        }
+        if (digest_sz == 0)
+            ret = -1;
+        *leaves_sz += digest_sz;
+        pos += len;
+    }
+    if (ret != 0) {
+        free(*leaves);
+        *leaves = NULL;
+    }
+    if ((ret == 0) && (digest_sz > 0)) {
+        printf("Hash tree: %u chunks of %u bytes\n",
+                *leaves_sz / digest_sz, CMD.hash_tree_chunk);
+    }
+    return ret;
+}
+
 static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
         const char *image_file, const char *outfile,
         uint32_t delta_base_version, uint32_t patch_len, uint32_t patch_inv_off,
@@ -1112,7 +1332,7 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
 {
     uint32_t header_idx;
     uint8_t *header;
-    FILE *f, *f2, *fek, *fef;
+    FILE *f, *fek, *fef;
     uint32_t fw_version32;
     struct stat attrib;
     uint16_t image_type;
@@ -1122,10 +1342,13 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
     int ret = -1;
     uint8_t  buf[4096];
     uint8_t  second_buf[4096];
-    uint32_t read_sz, pos;
+    uint32_t pos;
     uint8_t  digest[48]; /* max digest */
     uint32_t digest_sz = 0;
     uint32_t image_sz = 0;
+    uint8_t *image = NULL;
+    uint8_t *hash_buf = NULL;
+    uint32_t hash_sz = 0;
     int io_sz;
     uint8_t*    cert_chain    = NULL;
     uint32_t    cert_chain_sz = 0;
@@ -1175,16 +1398,14 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
     }
     memset(header, 0xFF, CMD.header_sz);
 
-    /* Get size of image */
-    f = fopen(image_file, "rb");
-    if (f == NULL) {
+    /* Map the image: it is hashed and copied to the output from memory */
+    image = map_file(image_file, &image_sz);
+    if (image == NULL) {
         printf("Open image file %s failed\n", image_file);
         goto failure;
     }
-    fseek(f, 0, SEEK_END);
-    image_sz = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    fclose(f);
+    hash_buf = image;
+    hash_sz = image_sz;
 
     /* Append Magic header (spells 'WOLF') */
     header_append_u32(header, &header_idx, WOLFBOOT_MAGIC);
@@ -1236,26 +1457,26 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
             ALIGN_8(header_idx);
             if (!base_hash) {
                 fprintf(stderr, "Base hash for delta image not found.\n");
-                exit(1);
+                goto failure;
             }
             if (CMD.hash_algo == HASH_SHA256) {
                 if (base_hash_sz != HDR_SHA256_LEN) {
                     fprintf(stderr, "Invalid base hash size for SHA256.\n");
-                    exit(1);
+                    goto failure;
                 }
                 header_append_tag(header, &header_idx, HDR_IMG_DELTA_BASE_HASH,
                         HDR_SHA256_LEN, base_hash);
             } else if (CMD.hash_algo == HASH_SHA384) {
                 if  (base_hash_sz != HDR_SHA384_LEN) {
                     fprintf(stderr, "Invalid base hash size for SHA384.\n");
-                    exit(1);
+                    goto failure;
                 }
                 header_append_tag(header, &header_idx, HDR_IMG_DELTA_BASE_HASH,
                         HDR_SHA384_LEN, base_hash);
             } else if (CMD.hash_algo == HASH_SHA3) {
                 if (base_hash_sz != HDR_SHA3_384_LEN) {
                     fprintf(stderr, "Invalid base hash size for SHA3-384.\n");
-                    exit(1);
+                    goto failure;
                 }
                 header_append_tag(header, &header_idx, HDR_IMG_DELTA_BASE_HASH,
                         HDR_SHA3_384_LEN, base_hash);
@@ -1263,6 +1484,18 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
         }
     }
 
+    if (CMD.hash_tree_chunk > 0) {
+        /* Append pad bytes, so the field is 4-byte aligned */
+        ALIGN_4(header_idx);
+        header_append_tag(header, &header_idx, HDR_HASH_TREE, 4,
+                &CMD.hash_tree_chunk);
+        if (hash_tree_leaves(image, image_sz, &hash_buf, &hash_sz) != 0) {
+            printf("Error calculating hash tree\n");
+            hash_buf = image;
+            goto failure;
+        }
+    }
+
     /* Add custom TLVs */
     if (CMD.custom_tlvs > 0) {
         uint32_t i;
@@ -1395,22 +1628,9 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
             /* Hash Header */
             ret = wc_Sha256Update(&sha, header, header_idx);
 
-            /* Hash image file */
-            f = fopen(image_file, "rb");
-            pos = 0;
-            while (ret == 0 && pos < image_sz) {
-                read_sz = image_sz - pos;
-                if (read_sz > 32)
-                    read_sz = 32;
-                io_sz = (int)fread(buf, 1, read_sz, f);
-                if ((io_sz < 0) && !feof(f)) {
-                    ret = -1;
-                    break;
-                }
-                ret = wc_Sha256Update(&sha, buf, read_sz);
-                pos += read_sz;
-            }
-            fclose(f);
+            /* Hash image (or chunk digests, in tree hash mode) */
+            if (ret == 0)
+                ret = wc_Sha256Update(&sha, hash_buf, hash_sz);
             if (ret == 0) {
                 wc_Sha256Final(&sha, digest);
                 digest_sz = HDR_SHA256_LEN;
@@ -1464,22 +1684,9 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
             /* Hash Header */
             ret = wc_Sha384Update(&sha, header, header_idx);
 
-            /* Hash image file */
-            f = fopen(image_file, "rb");
-            pos = 0;
-            while (ret == 0 && pos < image_sz) {
-                read_sz = image_sz - pos;
-                if (read_sz > 32)
-                    read_sz = 32;
-                io_sz = (int)fread(buf, 1, read_sz, f);
-                if ((io_sz < 0) && !feof(f)) {
-                    ret = -1;
-                    break;
-                }
-                ret = wc_Sha384Update(&sha, buf, read_sz);
-                pos += read_sz;
-            }
-            fclose(f);
+            /* Hash image (or chunk digests, in tree hash mode) */
+            if (ret == 0)
+                ret = wc_Sha384Update(&sha, hash_buf, hash_sz);
             if (ret == 0) {
                 wc_Sha384Final(&sha, digest);
                 digest_sz = HDR_SHA384_LEN;
@@ -1531,22 +1738,9 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
             /* Hash Header */
             ret = wc_Sha3_384_Update(&sha, header, header_idx);
 
-            /* Hash image file */
-            f = fopen(image_file, "rb");
-            pos = 0;
-            while (ret == 0 && pos < image_sz) {
-                read_sz = image_sz - pos;
-                if (read_sz > 128)
-                    read_sz = 128;
-                io_sz = (int)fread(buf, 1, read_sz, f);
-                if ((io_sz < 0) && !feof(f)) {
-                    ret = -1;
-                    break;
-                }
-                ret = wc_Sha3_384_Update(&sha, buf, read_sz);
-                pos += read_sz;
-            }
-            fclose(f);
+            /* Hash image (or chunk digests, in tree hash mode) */
+            if (ret == 0)
+                ret = wc_Sha3_384_Update(&sha, hash_buf, hash_sz);
             if (ret == 0) {
                 ret = wc_Sha3_384_Final(&sha, digest);
                 digest_sz = HDR_SHA3_384_LEN;
@@ -1739,6 +1933,7 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
     }
 
     /* Create output image */
+    ret = -1;
     f = fopen(outfile, "w+b");
     if (f == NULL) {
         printf("Open output image file %s failed\n", outfile);
@@ -1746,17 +1941,10 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
     }
     fwrite(header, 1, header_idx, f);
     /* Copy image to output */
-    f2 = fopen(image_file, "rb");
-    pos = 0;
-    while (pos < image_sz) {
-        read_sz = image_sz;
-        if (read_sz > sizeof(buf))
-            read_sz = sizeof(buf);
-        read_sz = (uint32_t)fread(buf, 1, read_sz, f2);
-        if ((read_sz == 0) && (feof(f2)))
-            break;
-        fwrite(buf, 1, read_sz, f);
-        pos += read_sz;
+    if (fwrite(image, 1, image_sz, f) != image_sz) {
+        printf("Write output image file %s failed\n", outfile);
+        fclose(f);
+        goto failure;
     }
 
     if ((CMD.encrypt != ENC_OFF) && CMD.encrypt_key_file) {
@@ -1786,24 +1974,34 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
         if (fek == NULL) {
             fprintf(stderr, "Open encryption key file %s: %s\n",
                     CMD.encrypt_key_file, strerror(errno));
-            exit(1);
+            fclose(f);
+            goto failure;
         }
         ret = (int)fread(key, 1, keySz, fek);
         if (ret != keySz) {
             fprintf(stderr, "Error reading key from %s\n", CMD.encrypt_key_file);
-            exit(1);
+            fclose(fek);
+            fclose(f);
+            ret = -1;
+            goto failure;
         }
         ret = (int)fread(iv, 1, ivSz, fek);
         if (ret != ivSz) {
             fprintf(stderr, "Error reading IV from %s\n", CMD.encrypt_key_file);
-            exit(1);
+            fclose(fek);
+            fclose(f);
+            ret = -1;
+            goto failure;
         }
+        ret = -1;
         fclose(fek);
 
         fef = fopen(CMD.output_encrypted_image_file, "wb");
         if (!fef) {
             fprintf(stderr, "Open encrypted output file %s: %s\n",
-                    CMD.encrypt_key_file, strerror(errno));
+                    CMD.output_encrypted_image_file, strerror(errno));
+            fclose(f);
+            goto failure;
         }
         fsize = ftell(f);
         fseek(f, 0, SEEK_SET); /* restart the _signed file from 0 */
@@ -1813,7 +2011,9 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
 #ifndef HAVE_CHACHA
             fprintf(stderr, "Encryption not supported: chacha support not found"
                    "in wolfssl configuration.\n");
-            exit(100);
+            fclose(fef);
+            fclose(f);
+            goto failure;
 #endif
             wc_Chacha_SetKey(&cha, key, sizeof(key));
             wc_Chacha_SetIV(&cha, iv, 0);
@@ -1848,9 +2048,11 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
     }
     printf("Output image(s) successfully created.\n");
     ret = 0;
-    fclose(f2);
     fclose(f);
 failure:
+    if (hash_buf != image)
+        free(hash_buf);
+    unmap_file(image, image_sz);
     if (cert_chain)
         free(cert_chain);
     if (policy)
@@ -1891,82 +2093,176 @@ static int make_hybrid_header(uint8_t *pubkey, uint32_t pubkey_sz,
             secondary_key, secondary_key_sz, NULL, 0);
 }
 
-static int base_diff(const char *f_base, uint8_t *pubkey, uint32_t pubkey_sz, int padding)
+/* A delta job diffs one range of sectors of the destination image */
+struct delta_job {
+    WB_DIFF_CTX ctx;
+    uint32_t blksz;
+    uint8_t *patch;
+    uint32_t patch_sz;
+    int ret;
+};
+
+static void delta_job_run(struct delta_job *job)
 {
-#if HAVE_MMAP
-    int fd1 = -1, fd2 = -1, fd3 = -1;
-#else
-    FILE *f1 = NULL, *f2 = NULL, *f3 = NULL;
-#endif
-    int len1 = 0, len2 = 0, len3 = 0;
-    struct stat st;
-    void *base = NULL;
-    void *buffer = NULL;
-    uint8_t *dest = NULL;
-    uint8_t ff = 0xff;
+    uint32_t patch_max = 0;
+    uint8_t *patch;
     int r;
+
+    job->ret = -1;
+    do {
+        if (job->patch_sz + job->blksz > patch_max) {
+            patch_max = 2 * (job->patch_sz + job->blksz);
+            patch = realloc(job->patch, patch_max);
+            if (patch == NULL)
+                return;
+            job->patch = patch;
+        }
+        r = wb_diff(&job->ctx, job->patch + job->patch_sz, job->blksz);
+        if (r < 0)
+            return;
+        job->patch_sz += r;
+    } while (r > 0);
+    job->ret = 0;
+}
+
+#if HAVE_PTHREAD
+struct delta_pool {
+    struct delta_job *jobs;
+    int n_jobs;
+    int next;
+    pthread_mutex_t lock;
+};
+
+static void *delta_worker(void *arg)
+{
+    struct delta_pool *pool = (struct delta_pool *)arg;
+    int i;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        if (i >= pool->n_jobs)
+            break;
+        delta_job_run(&pool->jobs[i]);
+    }
+    return NULL;
+}
+#endif
+
+/* Run all the jobs, on up to CMD.jobs threads */
+static int delta_jobs_run(struct delta_job *jobs, int n_jobs)
+{
+    int i;
+#if HAVE_PTHREAD
+    pthread_t tid[DELTA_MAX_JOBS];
+    struct delta_pool pool;
+    int n_threads = CMD.jobs;
+
+    if (n_threads > n_jobs)
+        n_threads = n_jobs;
+    if (n_threads > 1) {
+        pool.jobs = jobs;
+        pool.n_jobs = n_jobs;
+        pool.next = 0;
+        pthread_mutex_init(&pool.lock, NULL);
+        for (i = 1; i < n_threads; i++) {
+            if (pthread_create(&tid[i], NULL, delta_worker, &pool) != 0)
+                break;
+        }
+        n_threads = i;
+        /* The calling thread is one of the workers */
+        delta_worker(&pool);
+        for (i = 1; i < n_threads; i++)
+            pthread_join(tid[i], NULL);
+        pthread_mutex_destroy(&pool.lock);
+    }
+    else
+#endif
+    {
+        for (i = 0; i < n_jobs; i++)
+            delta_job_run(&jobs[i]);
+    }
+    for (i = 0; i < n_jobs; i++) {
+        if (jobs[i].ret != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* Split the diff from src_a to src_b in independent, sector aligned ranges.
+ * With a single job, the whole image is one range and the patch is the same
+ * as the one produced by a sequential diff.
+ * Returns the number of jobs added, or -1 on error.
+ */
+static int delta_jobs_split(struct delta_job *jobs, uint8_t *src_a,
+        uint32_t len_a, uint8_t *src_b, uint32_t len_b,
+        uint32_t sector_sz)
+{
+    WB_DIFF_CTX ctx;
+    uint32_t n_sectors, n_ranges, range_sz, start, end;
+    int n = 0;
+
+    if (wb_diff_init(&ctx, src_a, len_a, src_b, len_b) < 0)
+        return -1;
+    n_sectors = (len_b + sector_sz - 1) / sector_sz;
+    n_ranges = 1;
+    if (CMD.jobs > 1)
+        n_ranges = 2 * (uint32_t)CMD.jobs;
+    if (n_ranges > n_sectors)
+        n_ranges = n_sectors;
+    range_sz = ((n_sectors + n_ranges - 1) / n_ranges) * sector_sz;
+    for (start = 0; start < len_b; start = end) {
+        end = start + range_sz;
+        if (end > len_b)
+            end = len_b;
+        memset(&jobs[n], 0, sizeof(jobs[n]));
+        jobs[n].ctx = ctx;
+        jobs[n].blksz = sector_sz;
+        if (wb_diff_range(&jobs[n].ctx, start, end) < 0)
+            return -1;
+        n++;
+    }
+    return n;
+}
+
+static int base_diff(const char *f_base, uint8_t *pubkey, uint32_t pubkey_sz, int padding)
+{
+    FILE *f3 = NULL;
+    uint32_t len1 = 0, len2 = 0, len3 = 0;
+    uint8_t *base = NULL;
+    uint8_t *buffer = NULL;
     uint32_t patch_sz, patch_inv_sz;
     uint32_t patch_inv_off;
     uint32_t *delta_base_version = NULL;
     uint16_t delta_base_version_sz = 0;
-    WB_DIFF_CTX diff_ctx;
+    struct delta_job *jobs = NULL;
+    int n_fwd = 0, n_inv = 0;
     int ret = -1;
-    int io_sz;
+    int i;
     uint8_t *base_hash = NULL;
     uint16_t base_hash_sz = 0;
     uint32_t wolfboot_sector_size = 0;
-    uint32_t blksz;
+    const uint8_t zero[64] = { 0 };
 
     wolfboot_sector_size = wb_diff_get_sector_size();
     printf("delta update: WOLFBOOT_SECTOR_SIZE: %u\n", wolfboot_sector_size);
-    blksz = wolfboot_sector_size;
-    dest = malloc(wolfboot_sector_size);
-    if (!dest) {
-        printf("Error allocating memory to prepare patch sectors\n");
+    if (wolfboot_sector_size == 0) {
+        printf("Invalid sector size\n");
         goto cleanup;
     }
 
-    /* Get source file size */
-    if (stat(f_base, &st) < 0) {
-        printf("Cannot stat %s\n", f_base);
+    /* Map base image */
+    base = map_file(f_base, &len1);
+    if (base == NULL) {
+        printf("Cannot open file %s\n", f_base);
         goto cleanup;
     }
-    len1 = st.st_size;
-
     if (len1 > MAX_SRC_SIZE) {
         printf("%s: file too large\n", f_base);
         goto cleanup;
     }
 
-#if HAVE_MMAP
-    /* Open base image */
-    fd1 = open(f_base, O_RDWR);
-    if (fd1 < 0) {
-        printf("Cannot open file %s\n", f_base);
-        goto cleanup;
-    }
-    base = mmap(NULL, len1, PROT_READ|PROT_WRITE, MAP_SHARED, fd1, 0);
-    if (base == (void *)(-1)) {
-        perror("mmap");
-        goto cleanup;
-    }
-#else
-    f1 = fopen(f_base, "wb");
-    if (f1 == NULL) {
-        printf("Cannot open file %s\n", f_base);
-        goto cleanup;
-    }
-    base = malloc(len1);
-    if (base == NULL) {
-        fprintf(stderr, "Error malloc for base %d\n", len1);
-        goto cleanup;
-    }
-    if (len1 != (int)fread(base, len1, 1, f1)) {
-        perror("read of base");
-        goto cleanup;
-    }
-#endif
-
     /* Check base image version */
     delta_base_version_sz = sign_tool_find_header((uint8_t *)base + 8, HDR_VERSION, (void *)&delta_base_version);
     if ((delta_base_version_sz != sizeof(uint32_t)) || (*delta_base_version == 0)) {
@@ -1984,156 +2280,75 @@ static int base_diff(const char *f_base, uint8_t *pubkey, uint32_t pubkey_sz, in
     else if (CMD.hash_algo == HASH_SHA3)
         base_hash_sz = sign_tool_find_header((uint8_t*)base + 8, HDR_SHA3_384, &base_hash);
 
-#if HAVE_MMAP
-    /* Open second image file */
-    fd2 = open(CMD.output_image_file, O_RDONLY);
-    if (fd2 < 0) {
+    /* Map second image file */
+    buffer = map_file(CMD.output_image_file, &len2);
+    if (buffer == NULL) {
         printf("Cannot open file %s\n", CMD.output_image_file);
         goto cleanup;
     }
-    /* Get second file size */
-    if (stat(CMD.output_image_file, &st) < 0) {
-        printf("Cannot stat %s\n", CMD.output_image_file);
-        goto cleanup;
-    }
-    len2 = st.st_size;
-    buffer = mmap(NULL, len2, PROT_READ, MAP_SHARED, fd2, 0);
-    if (buffer == (void *)(-1)) {
-        perror("mmap");
+    if (len2 == 0) {
+        printf("Invalid file size: %u\n", len2);
         goto cleanup;
     }
 
-    /* Open output file */
-    fd3 = open(wolfboot_delta_file, O_RDWR|O_CREAT|O_TRUNC, 0660);
-    if (fd3 < 0) {
-        printf("Cannot open file %s for writing\n", wolfboot_delta_file);
-        goto cleanup;
-    }
-    if (len2 <= 0) {
-        printf("Invalid file size: %d\n", len2);
-        goto cleanup;
-    }
-    lseek(fd3, MAX_SRC_SIZE -1, SEEK_SET);
-    io_sz = write(fd3, &ff, 1);
-    if (io_sz != 1) {
-        printf("Could not write to output file: %s\n", strerror(errno));
+    /* Direct base->second patch, then inverse second->base patch. Each one is
+     * split in sector ranges, all diffed in parallel. */
+    jobs = calloc(4 * DELTA_MAX_JOBS, sizeof(*jobs));
+    if (jobs == NULL) {
+        printf("Error allocating memory to prepare patch sectors\n");
         goto cleanup;
     }
-    lseek(fd3, 0, SEEK_SET);
-    len3 = 0;
-#else
-    /* Open second image file */
-    f2 = fopen(CMD.output_image_file, "rb");
-    if (f2 == NULL) {
-        printf("Cannot open file %s\n", CMD.output_image_file);
+    n_fwd = delta_jobs_split(jobs, base, len1, buffer, len2,
+            wolfboot_sector_size);
+    if (n_fwd < 0) {
+        n_fwd = 0;
         goto cleanup;
     }
-    /* Get second file size */
-    fseek(f2, 0L, SEEK_END);
-    len2 = ftell(f2);
-    fseek(f2, 0L, SEEK_SET);
-    buffer = malloc(len2);
-    if (buffer == NULL) {
-        fprintf(stderr, "Error malloc for buffer %d\n", len2);
+    n_inv = delta_jobs_split(jobs + n_fwd, buffer, len2, base, len1,
+            wolfboot_sector_size);
+    if (n_inv < 0) {
+        n_inv = 0;
         goto cleanup;
     }
-    if (len2 != (int)fread(buffer, len2, 1, f2)) {
-        perror("fread of buffer");
+    if (delta_jobs_run(jobs, n_fwd + n_inv) != 0)
         goto cleanup;
-    }
+
     /* Open output file */
     f3 = fopen(wolfboot_delta_file, "wb");
     if (f3 == NULL) {
         printf("Cannot open file %s for writing\n", wolfboot_delta_file);
         goto cleanup;
     }
-    if (len2 <= 0) {
-        goto cleanup;
-    }
-    fseek(f3, MAX_SRC_SIZE -1, SEEK_SET);
-    io_sz = (int)fwrite(&ff, 1, 1, f3);
-    if (io_sz != 1) {
-        goto cleanup;
-    }
-    fseek(f3, 0, SEEK_SET);
-    len3 = 0;
-#endif
-
-    /* Direct base->second patch */
-    if (wb_diff_init(&diff_ctx, base, len1, buffer, len2) < 0) {
-        goto cleanup;
-    }
-    do {
-        r = wb_diff(&diff_ctx, dest, blksz);
-        if (r < 0)
+    for (i = 0; i < n_fwd; i++) {
+        if (fwrite(jobs[i].patch, 1, jobs[i].patch_sz, f3) != jobs[i].patch_sz)
             goto cleanup;
-#if HAVE_MMAP
-        io_sz = write(fd3, dest, r);
-#else
-        io_sz = (int)fwrite(dest, r, 1, f3);
-#endif
-        if (io_sz != r) {
-            goto cleanup;
-        }
-        len3 += r;
-    } while (r > 0);
+        len3 += jobs[i].patch_sz;
+    }
     patch_sz = len3;
-    while ((len3 % padding) != 0) {
-        uint8_t zero = 0;
-#if HAVE_MMAP
-        io_sz = write(fd3, &zero, 1);
-#else
-        io_sz = (int)fwrite(&zero, 1, 1, f3);
-#endif
-        if (io_sz != 1) {
+    if ((len3 % padding) != 0) {
+        uint32_t pad = padding - (len3 % padding);
+        if (fwrite(zero, 1, pad, f3) != pad)
             goto cleanup;
-        }
-        len3++;
+        len3 += pad;
     }
     patch_inv_off = (uint32_t)len3 + CMD.header_sz;
     patch_inv_sz = 0;
-
-    /* Inverse second->base patch */
-    if (wb_diff_init(&diff_ctx, buffer, len2, base, len1) < 0) {
-        goto cleanup;
-    }
-    do {
-        r = wb_diff(&diff_ctx, dest, blksz);
-        if (r < 0)
-            goto cleanup;
-#if HAVE_MMAP
-        io_sz = write(fd3, dest, r);
-#else
-        io_sz = (int)fwrite(dest, r, 1, f3);
-#endif
-        if (io_sz != r) {
+    for (i = n_fwd; i < n_fwd + n_inv; i++) {
+        if (fwrite(jobs[i].patch, 1, jobs[i].patch_sz, f3) != jobs[i].patch_sz)
             goto cleanup;
-        }
-        patch_inv_sz += r;
-        len3 += r;
-    } while (r > 0);
-#if HAVE_MMAP
-    if (fd3 >= 0) {
-        if (len3 > 0) {
-            ret = ftruncate(fd3, len3);
-        }
-        close(fd3);
-        fd3 = -1;
-    }
-#else
-    if (f3 != NULL) {
-        if (len3 > 0) {
-            ret = fp_truncate(f3, len3);
-        }
-        fclose(f3);
-        f3 = NULL;
+        patch_inv_sz += jobs[i].patch_sz;
+        len3 += jobs[i].patch_sz;
     }
-#endif
-
+    ret = fclose(f3);
+    f3 = NULL;
 
     if (ret != 0) {
         goto cleanup;
     }
+    if (n_fwd + n_inv > 2) {
+        printf("Delta computed in %d ranges (%d threads)\n", n_fwd + n_inv,
+                CMD.jobs);
+    }
     printf("Successfully created output file %s\n", wolfboot_delta_file);
     /* Create delta file, with header, from the resulting patch */
 
@@ -2141,40 +2356,17 @@ static int base_diff(const char *f_base, uint8_t *pubkey, uint32_t pubkey_sz, in
             *delta_base_version, patch_sz, patch_inv_off, patch_inv_sz, base_hash, base_hash_sz);
 
 cleanup:
-    if (dest) {
-        free(dest);
-        dest = NULL;
+    if (f3 != NULL)
+        fclose(f3);
+    if (jobs != NULL) {
+        for (i = 0; i < n_fwd + n_inv; i++)
+            free(jobs[i].patch);
+        free(jobs);
     }
     /* Unlink output file */
     unlink(wolfboot_delta_file);
-#if HAVE_MMAP
-    /* Cleanup/close */
-    if (fd2 >= 0) {
-        if (len2 > 0) {
-            munmap(buffer, len2);
-        }
-        close(fd2);
-    }
-    if (fd1 >= 0) {
-        if (len1 > 0) {
-            munmap(base, len1);
-        }
-        close(fd1);
-    }
-#else
-    if (f2 != NULL) {
-        if (len2 > 0) {
-            free(buffer);
-        }
-        fclose(f2);
-    }
-    if (f1 != NULL) {
-        if (len1 > 0) {
-            free(base);
-        }
-        fclose(f1);
-    }
-#endif
+    unmap_file(buffer, len2);
+    unmap_file(base, len1);
     return ret;
 }
 
@@ -2401,24 +2593,331 @@ static void set_signature_sizes(int secondary)
     printf("Manifest header size: %u\n", CMD.header_sz);
 }
 
+/* Derive the names of the output files from the input image and version */
+static void set_output_files(void)
+{
+    char buf[PATH_MAX-32]; /* leave room to avoid "directive output may be truncated" */
+    char *tmpstr;
+
+    memset(buf, 0, sizeof(buf));
+    strncpy(buf, CMD.image_file, sizeof(buf)-1);
+    tmpstr = strrchr(buf, '.');
+    if (tmpstr) {
+        *tmpstr = '\0'; /* null terminate at last "." */
+    }
+    snprintf(CMD.output_image_file, sizeof(CMD.output_image_file) - 1,
+            "%s_v%s_%s.bin", buf, CMD.fw_version,
+            CMD.sha_only ? "digest" : "signed");
+
+    snprintf(CMD.output_encrypted_image_file,
+            sizeof(CMD.output_encrypted_image_file),
+            "%s_v%s_signed_and_encrypted.bin",
+            buf, CMD.fw_version);
+
+    if (CMD.delta) {
+        snprintf(CMD.output_diff_file, sizeof(CMD.output_image_file),
+                "%s_v%s_signed_diff.bin",
+                buf, CMD.fw_version);
+        snprintf(CMD.output_encrypted_image_file,
+                sizeof(CMD.output_encrypted_image_file),
+                "%s_v%s_signed_diff_encrypted.bin",
+                buf, CMD.fw_version);
+    }
+}
+
+/* Sign CMD.image_file, then create the delta update if requested */
+static int sign_image(uint8_t *pubkey, uint32_t pubkey_sz,
+        uint8_t *pubkey2, uint32_t pubkey_sz2)
+{
+    int ret;
+
+    if (CMD.hybrid) {
+        printf("Creating hybrid signature\n");
+        ret = make_hybrid_header(pubkey, pubkey_sz, CMD.image_file,
+                CMD.output_image_file, pubkey2, pubkey_sz2);
+        DEBUG_PRINT("Signature size: %u\n", CMD.signature_sz);
+        DEBUG_PRINT("Secondary signature size: %u\n", CMD.secondary_signature_sz);
+        DEBUG_PRINT("Header size: %u\n", CMD.header_sz);
+    } else {
+        ret = make_header(pubkey, pubkey_sz, CMD.image_file,
+                CMD.output_image_file);
+    }
+
+    if ((ret == 0) && CMD.delta) {
+        if (CMD.encrypt)
+            ret = base_diff(CMD.delta_base_file, pubkey, pubkey_sz, 64);
+        else
+            ret = base_diff(CMD.delta_base_file, pubkey, pubkey_sz, 16);
+    }
+    return ret;
+}
+
+/* Sign the job described by one line of a batch manifest or of a server
+ * request:
+ *
+ *   IMAGE VERSION [BASE_SIGNED_IMG]
+ *
+ * where the optional third field creates a delta update from that base.
+ * Returns 1 for empty lines and comments (starting with '#'), 0 when the image
+ * has been signed, or a negative value on error.
+ */
+static int sign_job(char *line, const char *src, int line_nr,
+        uint8_t *pubkey, uint32_t pubkey_sz,
+        uint8_t *pubkey2, uint32_t pubkey_sz2)
+{
+    static uint32_t header_sz, signature_sz, secondary_signature_sz, policy_sz;
+    static int sizes_saved = 0;
+    char *image, *version, *delta_base, *extra;
+    int ret;
+
+    /* Sizes are updated while signing: start each image from scratch */
+    if (!sizes_saved) {
+        header_sz = CMD.header_sz;
+        signature_sz = CMD.signature_sz;
+        secondary_signature_sz = CMD.secondary_signature_sz;
+        policy_sz = CMD.policy_sz;
+        sizes_saved = 1;
+    }
+
+    image = strtok(line, " \t\r\n");
+    if ((image == NULL) || (image[0] == '#'))
+        return 1;
+    version = strtok(NULL, " \t\r\n");
+    delta_base = strtok(NULL, " \t\r\n");
+    extra = strtok(NULL, " \t\r\n");
+    if ((version == NULL) || (extra != NULL)) {
+        printf("%s:%d: expected IMAGE VERSION [BASE_SIGNED_IMG]\n",
+                src, line_nr);
+        return -1;
+    }
+
+    CMD.header_sz = header_sz;
+    CMD.signature_sz = signature_sz;
+    CMD.secondary_signature_sz = secondary_signature_sz;
+    CMD.policy_sz = policy_sz;
+
+    CMD.image_file = image;
+    CMD.fw_version = version;
+    CMD.delta = (delta_base != NULL);
+    CMD.delta_base_file = delta_base;
+    if ((CMD.header_sz == 256) && (CMD.delta))
+        CMD.header_sz <<= 1;
+    set_output_files();
+    printf("\n[%s:%d] %s, version %s%s%s\n", src, line_nr, image, version,
+            delta_base ? ", delta from " : "",
+            delta_base ? delta_base : "");
+    ret = sign_image(pubkey, pubkey_sz, pubkey2, pubkey_sz2);
+    if (ret != 0) {
+        printf("%s:%d: signing %s failed (%d)\n", src, line_nr, image, ret);
+        if (ret > 0)
+            ret = -ret;
+    }
+    return ret;
+}
+
+/* Batch mode: sign all the images listed in the manifest CMD.batch_file with
+ * the keys already loaded, stopping at the first error.
+ */
+static int sign_batch(uint8_t *pubkey, uint32_t pubkey_sz,
+        uint8_t *pubkey2, uint32_t pubkey_sz2)
+{
+    FILE *f;
+    char line[BATCH_LINE_MAX];
+    int line_nr = 0, count = 0;
+    int ret = 0;
+
+    f = fopen(CMD.batch_file, "r");
+    if (f == NULL) {
+        printf("Open batch file %s failed: %s\n", CMD.batch_file,
+                strerror(errno));
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line_nr++;
+        ret = sign_job(line, CMD.batch_file, line_nr, pubkey, pubkey_sz,
+                pubkey2, pubkey_sz2);
+        if (ret < 0)
+            break;
+        if (ret == 0)
+            count++;
+        ret = 0;
+    }
+    fclose(f);
+    printf("Batch: %d image(s) signed\n", count);
+    return ret;
+}
+
+/* Server mode: answer the requests read from 'in' on 'out', one line each.
+ * A request is a manifest line (see sign_job()); the reply is either
+ *
+ *   OK SIGNED_IMG [DIFF_IMG] [ENCRYPTED_IMG]
+ *   ERR CODE
+ *
+ * "QUIT" stops the server. Requests are served one at a time, so the state
+ * of stateful hash-based keys is always written back to the key file before
+ * the reply is sent.
+ * Returns 1 when the server is asked to quit, 0 at the end of the stream.
+ */
+static int sign_serve(FILE *in, FILE *out, const char *src,
+        uint8_t *pubkey, uint32_t pubkey_sz,
+        uint8_t *pubkey2, uint32_t pubkey_sz2)
+{
+    char line[BATCH_LINE_MAX];
+    int line_nr = 0;
+    int ret;
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        line_nr++;
+        if (strncmp(line, "QUIT", 4) == 0) {
+            fprintf(out, "OK\n");
+            fflush(out);
+            return 1;
+        }
+        ret = sign_job(line, src, line_nr, pubkey, pubkey_sz,
+                pubkey2, pubkey_sz2);
+        fflush(stdout);
+        if (ret == 1)
+            continue;
+        if (ret < 0) {
+            fprintf(out, "ERR %d\n", ret);
+        } else {
+            fprintf(out, "OK %s", CMD.output_image_file);
+            if (CMD.delta)
+                fprintf(out, " %s", CMD.output_diff_file);
+            if (CMD.encrypt)
+                fprintf(out, " %s", CMD.output_encrypted_image_file);
+            fprintf(out, "\n");
+        }
+        if (fflush(out) != 0)
+            break;
+    }
+    return 0;
+}
+
+/* With "--server -" the replies go to the original stdout, and everything
+ * else that the tool prints is moved to stderr. */
+static FILE *server_stdout;
+
+static int server_stdout_detach(void)
+{
+    int fd;
+
+    fflush(stdout);
+    fd = dup(fileno(stdout));
+    if (fd >= 0)
+        server_stdout = fdopen(fd, "w");
+    if ((server_stdout == NULL) ||
+            (dup2(fileno(stderr), fileno(stdout)) < 0)) {
+        fprintf(stderr, "Cannot redirect the log to stderr\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int sign_server(uint8_t *pubkey, uint32_t pubkey_sz,
+        uint8_t *pubkey2, uint32_t pubkey_sz2)
+{
+    FILE *in, *out;
+    int ret = 0;
+
+    if (strcmp(CMD.server_path, "-") == 0) {
+        sign_serve(stdin, server_stdout, "stdin", pubkey, pubkey_sz,
+                pubkey2, pubkey_sz2);
+        fclose(server_stdout);
+        return 0;
+    }
+#if HAVE_UNIX_SOCKET
+    {
+        struct sockaddr_un addr;
+        int sfd, cfd;
+        int quit = 0;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(CMD.server_path) >= sizeof(addr.sun_path)) {
+            printf("Socket path too long: %s\n", CMD.server_path);
+            return -1;
+        }
+        strcpy(addr.sun_path, CMD.server_path);
+        sfd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sfd < 0) {
+            perror("socket");
+            return -1;
+        }
+        unlink(CMD.server_path);
+        if ((bind(sfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+                (chmod(CMD.server_path, 0600) < 0) ||
+                (listen(sfd, 16) < 0)) {
+            perror(CMD.server_path);
+            close(sfd);
+            return -1;
+        }
+        /* A client going away must not take the server down */
+        signal(SIGPIPE, SIG_IGN);
+        printf("Listening on %s\n", CMD.server_path);
+        fflush(stdout);
+        while (!quit) {
+            cfd = accept(sfd, NULL, NULL);
+            if (cfd < 0) {
+                if (errno == EINTR)
+                    continue;
+                perror("accept");
+                ret = -1;
+                break;
+            }
+            in = fdopen(cfd, "r");
+            if (in == NULL) {
+                close(cfd);
+                continue;
+            }
+            out = fdopen(dup(cfd), "w");
+            if (out == NULL) {
+                fclose(in);
+                continue;
+            }
+            quit = sign_serve(in, out, CMD.server_path, pubkey, pubkey_sz,
+                    pubkey2, pubkey_sz2);
+            fclose(out);
+            fclose(in);
+        }
+        close(sfd);
+        unlink(CMD.server_path);
+    }
+#else
+    in = NULL;
+    (void)in;
+    printf("--server only supports '-' (stdin) on this platform\n");
+    ret = -1;
+#endif
+    return ret;
+}
+
 int main(int argc, char** argv)
 {
     int ret = 0;
     int i;
-    char* tmpstr;
     const char* sign_str = "AUTO";
     const char* hash_str = "SHA256";
     const char* secondary_sign_str = "NONE";
-    uint8_t  buf[PATH_MAX-32]; /* leave room to avoid "directive output may be truncated" */
     uint8_t *pubkey = NULL;
     uint32_t pubkey_sz = 0;
-    uint8_t *kbuf=NULL, *key_buffer, *key_buffer2;
+    uint8_t *pubkey2 = NULL;
+    uint32_t pubkey_sz2 = 0;
+    uint8_t *kbuf=NULL, *kbuf2 = NULL, *key_buffer, *key_buffer2;
     uint32_t key_buffer_sz, key_buffer_sz2;
 
 #ifdef DEBUG_SIGNTOOL
     wolfSSL_Debugging_ON();
 #endif
 
+    for (i = 1; i < argc - 1; i++) {
+        if ((strcmp(argv[i], "--server") == 0) &&
+                (strcmp(argv[i + 1], "-") == 0) &&
+                (server_stdout_detach() != 0)) {
+            exit(1);
+        }
+    }
+
     printf("wolfBoot KeyTools (Compiled C version)\n");
     printf("wolfBoot version %X\n", WOLFBOOT_VERSION);
 
@@ -2634,6 +3133,19 @@ int main(int argc, char** argv)
         else if (strcmp(argv[i], "--no-ts") == 0) {
             CMD.no_ts = 1;
         }
+        else if (strcmp(argv[i], "--hash-tree") == 0) {
+            if (argc <= (i + 1)) {
+                fprintf(stderr, "Missing hash tree chunk size argument\n");
+                exit(16);
+            }
+            CMD.hash_tree_chunk = (uint32_t)strtoul(argv[++i], NULL, 0);
+            if ((CMD.hash_tree_chunk < 256) ||
+                    ((CMD.hash_tree_chunk & (CMD.hash_tree_chunk - 1)) != 0)) {
+                fprintf(stderr, "Hash tree chunk size must be a power of two, "
+                        "256 bytes or more\n");
+                exit(16);
+            }
+        }
         else if (strcmp(argv[i], "--policy") == 0) {
             CMD.policy_sign = 1;
             CMD.policy_file = argv[++i];
@@ -2751,6 +3263,32 @@ int main(int argc, char** argv)
             CMD.custom_tlvs++;
             i += 2;
         }
+        else if (strcmp(argv[i], "--batch") == 0) {
+            if (argc <= (i + 1)) {
+                fprintf(stderr, "Missing batch manifest file argument\n");
+                exit(16);
+            }
+            CMD.batch_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--server") == 0) {
+            if (argc <= (i + 1)) {
+                fprintf(stderr, "Missing server socket path argument\n");
+                exit(16);
+            }
+            CMD.server_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--jobs") == 0) {
+            if (argc <= (i + 1)) {
+                fprintf(stderr, "Missing number of jobs argument\n");
+                exit(16);
+            }
+            CMD.jobs = (int)strtol(argv[++i], NULL, 10);
+            if ((CMD.jobs < 1) || (CMD.jobs > DELTA_MAX_JOBS)) {
+                fprintf(stderr, "Number of jobs must be between 1 and %d\n",
+                        DELTA_MAX_JOBS);
+                exit(16);
+            }
+        }
         else if (strcmp(argv[i], "--cert-chain") == 0) {
             if (argc <= (i + 1)) {
                 fprintf(stderr, "Missing certificate chain file argument\n");
@@ -2771,7 +3309,23 @@ int main(int argc, char** argv)
     }
 
 
-    if (CMD.sign != NO_SIGN) {
+    if ((CMD.batch_file != NULL) && (CMD.server_path != NULL)) {
+        fprintf(stderr, "--batch and --server are mutually exclusive\n");
+        exit(16);
+    }
+    if (MULTI_IMAGE_MODE()) {
+        if (CMD.sha_only || CMD.manual_sign || CMD.delta) {
+            fprintf(stderr, "--batch/--server can't be combined with "
+                    "--sha-only, --manual-sign or --delta\n");
+            exit(16);
+        }
+        /* Images and versions come from the manifest */
+        if (CMD.sign != NO_SIGN) {
+            CMD.key_file = argv[i+1];
+            if (CMD.hybrid)
+                CMD.secondary_key_file = argv[i+2];
+        }
+    } else if (CMD.sign != NO_SIGN) {
         if (CMD.hybrid) {
             printf("Parsing arguments in hybrid mode\n");
             CMD.image_file = argv[i+1];
@@ -2798,20 +3352,8 @@ int main(int argc, char** argv)
         CMD.fw_version = argv[i+2];
     }
 
-    memset(buf, 0, sizeof(buf));
-    strncpy((char*)buf, CMD.image_file, sizeof(buf)-1);
-    tmpstr = strrchr((char*)buf, '.');
-    if (tmpstr) {
-        *tmpstr = '\0'; /* null terminate at last "." */
-    }
-    snprintf(CMD.output_image_file, sizeof(CMD.output_image_file) - 1,
-            "%s_v%s_%s.bin", (char*)buf, CMD.fw_version,
-            CMD.sha_only ? "digest" : "signed");
-
-    snprintf(CMD.output_encrypted_image_file,
-            sizeof(CMD.output_encrypted_image_file),
-            "%s_v%s_signed_and_encrypted.bin",
-            (char*)buf, CMD.fw_version);
+    if (!MULTI_IMAGE_MODE())
+        set_output_files();
 
     printf("Update type:          %s\n",
             CMD.self_update ? "wolfBoot" : "Firmware");
@@ -2828,7 +3370,12 @@ int main(int argc, char** argv)
                 printf("Encryption Algorithm: AES256-CTR\n");
                 break;
     }
-    printf("Input image:          %s\n", CMD.image_file);
+    if (CMD.batch_file != NULL)
+        printf("Batch manifest:       %s\n", CMD.batch_file);
+    else if (CMD.server_path != NULL)
+        printf("Server:               %s\n", CMD.server_path);
+    else
+        printf("Input image:          %s\n", CMD.image_file);
     printf("Selected cipher:      %s\n", sign_str);
     printf("Selected hash  :      %s\n", hash_str);
     if (CMD.sign != NO_SIGN) {
@@ -2840,18 +3387,13 @@ int main(int argc, char** argv)
     }
     if (CMD.delta) {
         printf("Delta Base file:      %s\n", CMD.delta_base_file);
-        snprintf(CMD.output_diff_file, sizeof(CMD.output_image_file),
-                "%s_v%s_signed_diff.bin",
-                (char*)buf, CMD.fw_version);
-        snprintf(CMD.output_encrypted_image_file,
-                sizeof(CMD.output_encrypted_image_file),
-                "%s_v%s_signed_diff_encrypted.bin",
-                (char*)buf, CMD.fw_version);
     }
-    printf("Output %6s:        %s\n",    CMD.sha_only ? "digest" : "image",
-            CMD.output_image_file);
-    if (CMD.encrypt) {
-        printf("Encrypted output:     %s\n", CMD.output_encrypted_image_file);
+    if (!MULTI_IMAGE_MODE()) {
+        printf("Output %6s:        %s\n",    CMD.sha_only ? "digest" : "image",
+                CMD.output_image_file);
+        if (CMD.encrypt) {
+            printf("Encrypted output:     %s\n", CMD.output_encrypted_image_file);
+        }
     }
     printf("Target partition id : %hu ", CMD.partition_id);
     if (CMD.partition_id == HDR_IMG_TYPE_WOLFBOOT)
@@ -2904,32 +3446,35 @@ int main(int argc, char** argv)
     } /* CMD.sign != NO_SIGN */
 
     if (CMD.hybrid) {
-        uint8_t *kbuf2 = NULL;
-        uint8_t *pubkey2 = NULL;
-        uint32_t pubkey_sz2;
         DEBUG_PRINT("Loading secondary key\n");
         kbuf2 = load_key(&key_buffer2, &key_buffer_sz2, &pubkey2, &pubkey_sz2, 1);
-        printf("Creating hybrid signature\n");
-        make_hybrid_header(pubkey, pubkey_sz, CMD.image_file, CMD.output_image_file,
-                pubkey2, pubkey_sz2);
-        DEBUG_PRINT("Signature size: %u\n", CMD.signature_sz);
-        DEBUG_PRINT("Secondary signature size: %u\n", CMD.secondary_signature_sz);
-        DEBUG_PRINT("Header size: %u\n", CMD.header_sz);
-        if (kbuf2)
-            free(kbuf2);
-        if (pubkey2)
-            free(pubkey2);
-    } else {
-        make_header(pubkey, pubkey_sz, CMD.image_file, CMD.output_image_file);
     }
 
-
-    if (CMD.delta) {
-        if (CMD.encrypt)
-            ret = base_diff(CMD.delta_base_file, pubkey, pubkey_sz, 64);
-        else
-            ret = base_diff(CMD.delta_base_file, pubkey, pubkey_sz, 16);
+#if HAVE_UNIX_SOCKET
+    /* Stateful keys: lock them for exclusive use while this process runs */
+    if (((CMD.sign == SIGN_LMS) || (CMD.sign == SIGN_XMSS)) &&
+            (lock_key_file(CMD.key_file, 0) != 0)) {
+        exit(1);
+    }
+    if (CMD.hybrid &&
+            ((CMD.secondary_sign == SIGN_LMS) ||
+             (CMD.secondary_sign == SIGN_XMSS)) &&
+            (lock_key_file(CMD.secondary_key_file, 1) != 0)) {
+        exit(1);
     }
+#endif
+
+    if (CMD.server_path != NULL)
+        ret = sign_server(pubkey, pubkey_sz, pubkey2, pubkey_sz2);
+    else if (CMD.batch_file != NULL)
+        ret = sign_batch(pubkey, pubkey_sz, pubkey2, pubkey_sz2);
+    else
+        ret = sign_image(pubkey, pubkey_sz, pubkey2, pubkey_sz2);
+
+    if (kbuf2)
+        free(kbuf2);
+    if (pubkey2)
+        free(pubkey2);
 
     /* Add pubkey cleanup */
     if (pubkey)
@@ -2962,5 +3507,7 @@ int main(int argc, char** argv)
     else if (CMD.sign == SIGN_ML_DSA) {
         wc_MlDsaKey_Free(&key.ml_dsa);
     }
+    if (rng_ready)
+        wc_FreeRng(&rng);
     return ret;
 }
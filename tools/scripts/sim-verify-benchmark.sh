@@ -0,0 +1,44 @@
+#!/bin/bash
+#
+# Measure the time spent verifying the image signature on the sim target,
+# for each ECC curve, with and without ECC_FAST_VERIFY=1.
+#
+# Run from the root of the wolfBoot tree. Results are printed as a Markdown
+# table.
+
+RUNS=${RUNS:-50}
+
+function set_benchmark {
+    NAME=$1
+    shift
+    echo -n "| $NAME | $@ | "
+    make clean &>/dev/null
+    make keysclean &>/dev/null
+    if ! make $@ VERIFY_BENCHMARK=$RUNS test-sim-internal-flash-with-update \
+            &>/dev/null; then
+        echo "build failed | - |"
+        return
+    fi
+    echo -n `ls -l wolfboot.elf | cut -d " " -f 5 | tr -d '\n'`
+    echo -n " | "
+    ./wolfboot.elf get_version 2>&1 >/dev/null | \
+        sed -n 's/^Verify benchmark: .*, \([0-9]*\) us\/verify/\1/p' | \
+        head -n 1 | tr -d '\n'
+    echo " |"
+}
+
+cp config/examples/sim.config .config
+make keytools &>/dev/null
+
+echo "| Name | Configuration | wolfboot.elf size | Verify time (us) |"
+echo "|------|---------------|-------------------|------------------|"
+
+set_benchmark "ecdsa256" SIGN=ECC256
+set_benchmark "ecdsa256, fast verify" SIGN=ECC256 ECC_FAST_VERIFY=1
+set_benchmark "ecdsa384" SIGN=ECC384
+set_benchmark "ecdsa384, fast verify" SIGN=ECC384 ECC_FAST_VERIFY=1
+set_benchmark "ecdsa521" SIGN=ECC521
+set_benchmark "ecdsa521, fast verify" SIGN=ECC521 ECC_FAST_VERIFY=1
+set_benchmark "ecdsa256, fast math" SIGN=ECC256 SPMATH=0
+set_benchmark "ecdsa256, fast math, fast verify" SIGN=ECC256 SPMATH=0 ECC_FAST_VERIFY=1
+set_benchmark "ed25519" SIGN=ED25519
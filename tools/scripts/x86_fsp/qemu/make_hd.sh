@@ -1,6 +1,8 @@
 #!/bin/bash
 SIGN=${SIGN:-"--ecc256"}
 HASH=${HASH:-"--sha256"}
+# extra sign options, e.g. SIGN_EXTRA="--hash-tree 65536"
+SIGN_EXTRA=${SIGN_EXTRA:-""}
 
 IMAGE=${IMAGE:-"bzImage"}
 
@@ -29,7 +31,7 @@ w
 EOF
 
 cp ${IMAGE} "image.bin"
-tools/keytools/sign $SIGN $HASH image.bin wolfboot_signing_private_key.der 1
-tools/keytools/sign $SIGN $HASH image.bin wolfboot_signing_private_key.der 2
+tools/keytools/sign $SIGN $HASH $SIGN_EXTRA image.bin wolfboot_signing_private_key.der 1
+tools/keytools/sign $SIGN $HASH $SIGN_EXTRA image.bin wolfboot_signing_private_key.der 2
 dd if=image_v1_signed.bin of=app.bin bs=512 seek=2048 conv=notrunc
 dd if=image_v2_signed.bin of=app.bin bs=512 seek=34816 conv=notrunc
@@ -11,6 +11,7 @@
 # For DEBUG_STAGE2 without waiting for GDB (default): ./qemu.sh
 # For DEBUG_STAGE1 with waiting for GDB: ./qemu.sh -d DEBUG_STAGE1 -w
 # For DEBUG_STAGE2 with waiting for GDB: ./qemu.sh -w
+# For DEBUG_STAGE2 with 4 cores: ./qemu.sh -c 4
 
 
 # To DEBUG_STAGE1
@@ -33,6 +34,7 @@
 # Default values
 DEBUG_STAGE="DEBUG_STAGE2"
 WAIT_FOR_GDB=false
+CORES=1
 
 echo "Running wolfBoot on QEMU"
 
@@ -40,7 +42,7 @@ set -e
 set -x
 
 # Parse command line options
-while getopts "d:wpt" opt; do
+while getopts "d:wptc:" opt; do
     case "$opt" in
         d)
             DEBUG_STAGE="$OPTARG"
@@ -53,11 +55,15 @@ while getopts "d:wpt" opt; do
             ;;
         t)  ENABLE_TPM=true
             ;;
+        c)
+            CORES="$OPTARG"
+            ;;
         *)
-            echo "Usage: $0 [-d DEBUG_STAGE1 | DEBUG_STAGE2] [-w] [-p]"
+            echo "Usage: $0 [-d DEBUG_STAGE1 | DEBUG_STAGE2] [-w] [-p] [-t] [-c CORES]"
             echo "-p : create /tmp/qemu_mon.in and /tmp/qemu_mon.out pipes for monitor qemu"
             echo "-w : wait for GDB to connect to the QEMU gdb server"
             echo "-t : enable TPM emulation (requires swtpm)"
+            echo "-c : number of cores (default 1)"
             exit 1
             ;;
     esac
@@ -80,7 +86,7 @@ QEMU_TPM_OPTIONS=" \
     "
 
 QEMU_OPTIONS=" \
-    -m 1G -machine q35 -nographic \
+    -m 1G -machine q35 -smp $CORES -nographic \
     -pflash wolfboot_stage1.bin -drive id=mydisk,format=raw,file=app.bin,if=none \
     -device ide-hd,drive=mydisk \
     "
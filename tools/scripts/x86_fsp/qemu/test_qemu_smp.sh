@@ -0,0 +1,48 @@
+#/bin/bash
+# Boot a tree-hashed image (HASH_TREE=1) on a 4-core QEMU: the chunks are
+# hashed on the secondary cores started by src/x86/smp.c
+
+set -e
+
+CORES=4
+CONFIG=x86_fsp_qemu.config
+
+make distclean
+cp "config/examples/${CONFIG}" .config
+./tools/scripts/x86_fsp/qemu/qemu_build_fsp.sh
+make keytools
+./tools/keytools/keygen --force --ecc256 -g wolfboot_signing_private_key.der -keystoreDir src/
+
+make HASH_TREE=1
+
+# test-app
+make test-app/image.elf
+IMAGE=test-app/image.elf SIGN=--ecc256 SIGN_EXTRA="--hash-tree 65536" \
+    ./tools/scripts/x86_fsp/qemu/make_hd.sh
+
+echo "RUNNING QEMU"
+# launch qemu in background
+./tools/scripts/x86_fsp/qemu/qemu.sh -p -c $CORES | tee /tmp/qemu_output &
+echo "WAITING FOR QEMU TO RUN"
+sleep 5
+
+# close qemu
+timeout 5 echo 'quit' > /tmp/qemu_mon.in
+output=$(cat /tmp/qemu_output)
+set +e
+smp=$(echo "$output" | grep -m 1 "SMP: $((CORES - 1)) secondary cores started")
+if [ -z "$smp" ]; then
+  echo "$output"
+  echo -e "\e[31mTEST FAILED: secondary cores not started\e[0m"
+  exit 255
+fi
+
+app=$(echo "$output" | grep -m 1 "wolfBoot QEMU x86 FSP test app")
+if [ -n "$app" ]; then
+  echo -e "\e[32mTEST OK\e[0m"
+  exit 0
+else
+  echo "$output"
+  echo -e "\e[31mTEST FAILED\e[0m"
+  exit 255
+fi
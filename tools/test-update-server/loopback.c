@@ -0,0 +1,255 @@
+/* loopback.c
+ *
+ * Host loopback test for the v2 UART update protocol: runs the server on one
+ * side of a pseudo-terminal, and the device-side receiver (test-app/update_rx.c)
+ * on the other, storing the image in RAM. The line rate of a real UART can
+ * be emulated, as well as corrupted bytes and target resets.
+ *
+ * Copyright (C) 2025 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ *
+ * Usage: ./loopback [-s size] [-b baudrate] [-e N] [-r offset]
+ *   -s  image size (default 1MB)
+ *   -b  emulated line rate, 0 for none (default 115200)
+ *   -e  corrupt one received byte every N (default: no errors)
+ *   -r  reset the target once, when the image is stored up to offset
+ */
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+#include <sys/wait.h>
+
+#include "update_rx.h"
+
+#define SECTOR_SIZE     4096
+#define IMAGE_FILE      "/tmp/wolfboot-loopback.bin"
+
+static int master = -1;
+static uint8_t *flash;
+static uint32_t flash_size;
+static unsigned int baudrate = 115200;
+static uint32_t error_every;
+static uint32_t reset_at;
+static int reset_pending;
+static uint64_t rx_count;
+static uint64_t line_us;  /* emulated time on the line */
+static pid_t server_pid;
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int lb_rx(uint8_t *c)
+{
+    struct pollfd pfd;
+    uint64_t now;
+
+    if (read(master, c, 1) != 1) {
+        if (waitpid(server_pid, NULL, WNOHANG) == server_pid) {
+            fprintf(stderr, "loopback: server failed\n");
+            exit(1);
+        }
+        pfd.fd = master;
+        pfd.events = POLLIN;
+        poll(&pfd, 1, 10);
+        return 0;
+    }
+    rx_count++;
+    if ((error_every != 0) && ((rx_count % error_every) == 0))
+        *c ^= 0x10;
+    if (baudrate != 0) {
+        /* 10 bits per byte: don't go faster than the line */
+        now = now_us();
+        if (line_us < now)
+            line_us = now;
+        line_us += 10000000ULL / baudrate;
+        if (line_us > now + 1000)
+            usleep((useconds_t)(line_us - now));
+    }
+    return 1;
+}
+
+static void lb_tx(uint8_t c)
+{
+    while (write(master, &c, 1) != 1) {
+        if ((errno != EAGAIN) && (errno != EINTR))
+            return;
+        usleep(100);
+    }
+}
+
+static int lb_erase(uint32_t off, uint32_t len)
+{
+    if (off + len > flash_size)
+        return -1;
+    memset(flash + off, 0xFF, len);
+    return 0;
+}
+
+static int lb_write(uint32_t off, const uint8_t *data, uint32_t len)
+{
+    if (off + len > flash_size)
+        return -1;
+    if (reset_pending && (off + len > reset_at)) {
+        reset_pending = 0;
+        return -1;
+    }
+    memcpy(flash + off, data, len);
+    return 0;
+}
+
+static int lb_read(uint32_t off, uint8_t *data, uint32_t len)
+{
+    if (off + len > flash_size)
+        return -1;
+    memcpy(data, flash + off, len);
+    return 0;
+}
+
+static const struct update_rx_ops lb_ops = {
+    lb_rx, lb_tx, lb_erase, lb_write, lb_read, SECTOR_SIZE, 0
+};
+
+int main(int argc, char **argv)
+{
+    struct update_rx_ops ops = lb_ops;
+    uint32_t size = 1024 * 1024, i;
+    struct termios tty;
+    char baud[16];
+    uint8_t *image;
+    uint64_t t_start, t;
+    uint8_t c;
+    const char *slave;
+    pid_t pid;
+    int status;
+    int fd, opt, ret;
+
+    while ((opt = getopt(argc, argv, "s:b:e:r:")) != -1) {
+        switch (opt) {
+            case 's':
+                size = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                baudrate = (unsigned int)strtoul(optarg, NULL, 0);
+                break;
+            case 'e':
+                error_every = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                reset_at = (uint32_t)strtoul(optarg, NULL, 0);
+                reset_pending = 1;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-s size] [-b baudrate] [-e N] "
+                    "[-r offset]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    /* Test image and target flash */
+    image = malloc(size);
+    flash_size = ((size + SECTOR_SIZE - 1) / SECTOR_SIZE + 1) * SECTOR_SIZE;
+    flash = malloc(flash_size);
+    if ((image == NULL) || (flash == NULL))
+        return 1;
+    srand(size);
+    for (i = 0; i < size; i++)
+        image[i] = (uint8_t)rand();
+    memset(flash, 0xFF, flash_size);
+    ops.max_size = flash_size;
+    fd = open(IMAGE_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if ((fd < 0) || (write(fd, image, size) != (ssize_t)size)) {
+        perror(IMAGE_FILE);
+        return 1;
+    }
+    close(fd);
+
+    /* Pseudo-terminal: the server opens the slave side */
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0)) {
+        perror("posix_openpt");
+        return 1;
+    }
+    slave = ptsname(master);
+    fd = open(slave, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        perror(slave);
+        return 1;
+    }
+    tcgetattr(fd, &tty);
+    cfmakeraw(&tty);
+    tcsetattr(fd, TCSANOW, &tty);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    snprintf(baud, sizeof(baud), "%u", baudrate ? baudrate : 115200);
+    pid = server_pid = fork();
+    if (pid == 0) {
+        close(master);
+        close(fd);
+        execl("./server", "server", "-d", slave, "-b", baud, IMAGE_FILE,
+            (char *)NULL);
+        perror("./server");
+        _exit(127);
+    }
+    close(fd);
+
+    t_start = now_us();
+    while ((ret = update_rx_run(&ops, 1)) < 0) {
+        printf("loopback: target reset\n");
+        /* Whatever was in flight is lost */
+        usleep(100000);
+        while (read(master, &c, 1) == 1)
+            ;
+    }
+    t = now_us() - t_start;
+
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+            (WEXITSTATUS(status) != 0)) {
+        fprintf(stderr, "loopback: server failed\n");
+        return 1;
+    }
+    if (((uint32_t)ret != size) || (memcmp(flash, image, size) != 0)) {
+        fprintf(stderr, "loopback: image mismatch\n");
+        return 1;
+    }
+    printf("loopback: %u bytes received in %.2f s (%.1f KB/s)", size,
+        t / 1000000.0, size / (t / 1000000.0) / 1024.0);
+    if (baudrate != 0) {
+        printf(", %.0f%% of the line rate",
+            100.0 * ((double)size * 10 / baudrate) / (t / 1000000.0));
+    }
+    printf("\n");
+    free(image);
+    free(flash);
+    unlink(IMAGE_FILE);
+    return 0;
+}
@@ -22,6 +22,10 @@
  *
  * OTA Upgrade mechanism implemented using UART
  *
+ * Two protocols are supported, selected by the target when it connects:
+ *  - v1 ('*'): 16-byte packets, one at a time, additive checksum
+ *  - v2 (HELLO frame, see test-app/update_rx.h): large CRC32 frames,
+ *    sliding window with selective acks, resume after a target reset
  */
 
 #define _XOPEN_SOURCE 600
@@ -40,6 +44,10 @@
 #include <termios.h>
 #include <signal.h>
 #include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+#include "update_rx.h"
 
 #define MSGLEN      (4 + 4 + 8)
 #ifndef UART_DEV
@@ -53,6 +61,12 @@
 #define B115200 115200
 #endif
 
+/* v2 limits on the host side */
+#define V2_MAX_FRAME    4096
+#define V2_MAX_WINDOW   32
+#define V2_RETRIES      10
+#define V2_RESTART      1
+
 static volatile int cleanup;                 /* To handle shutdown */
 union usb_ack {
     uint32_t offset;
@@ -64,6 +78,7 @@ static uint8_t      pktbuf[MSGLEN];
 static unsigned int pktbuf_size = 0;
 static int serialfd = -1;
 static uint32_t high_ack;
+static unsigned int baudrate = 115200;
 
 
 void alarm_handler(int signo)
@@ -119,76 +134,13 @@ static void check(uint8_t *pkt, int size)
         *c += p[i];
 }
 
-
-int main(int argc, char** argv)
+static void update_v1(int ffd, uint32_t tot_len)
 {
-    /* Variables for awaiting datagram */
-    int           res = 1;
-    uint32_t      len, tot_len;
-    int           ffd; /* Firmware file descriptor */
-    struct stat   st;
+    int res;
+    uint32_t len;
     union usb_ack ack;
-    struct termios tty;
-    sigset(SIGALRM, alarm_handler);
-
-    if (argc != 2) {
-        printf("Usage: %s firmware_filename\n", argv[0]);
-        exit(1);
-    }
 
-    /* open file and get size */
-    ffd = open(argv[1], O_RDONLY);
-    if (ffd < 0) {
-        perror("opening file");
-        exit(2);
-    }
-    res = fstat(ffd, &st);
-    if (res != 0) {
-        perror("fstat file");
-        exit(2);
-    }
-    tot_len = st.st_size;
-
-    /* open UART */
-    printf("Opening %s UART\n", UART_DEV);
-    serialfd = open(UART_DEV, O_RDWR | O_NOCTTY);
-    if (serialfd < 0) {
-        fprintf(stderr, "failed opening serial %s\n", UART_DEV);
-        exit(2);
-    }
-    tcgetattr(serialfd, &tty);
-    cfsetospeed(&tty, B115200);
-    cfsetispeed(&tty, B115200);
-    tty.c_cflag = (tty.c_cflag & ~CSIZE) | (CS8);
-    tty.c_iflag &= ~(IGNBRK | IXON | IXOFF | IXANY| INLCR | ICRNL);
-    tty.c_oflag &= ~OPOST;
-    tty.c_oflag &= ~(ONLCR|OCRNL);
-    tty.c_cflag &= ~(PARENB | PARODD | CSTOPB);
-    tty.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
-    tty.c_iflag &= ~ISTRIP;
-    tty.c_cc[VMIN] = 0;
-    tty.c_cc[VTIME] = 5;
-    tcsetattr(serialfd, TCSANOW, &tty);
-
-    /* Wait for start hash (asterisk) */
-    while (1) {
-        char c;
-
-        res = read(serialfd, &c, 1);
-        if (res <= 0) {
-            usleep(10000);
-            continue;
-        }
-        if (c == '*') {
-            break;
-        }
-        else {
-            printf("%c",c);
-            fflush(stdout);
-        }
-
-    }
-    printf("Target connected.\n");
+    sigset(SIGALRM, alarm_handler);
     usleep(500000);
     printf("Starting update.\n");
 
@@ -247,6 +199,477 @@ int main(int argc, char** argv)
             break;
         }
     }
+}
+
+/* Protocol v2 */
+
+struct v2_frame {
+    uint8_t type;
+    uint16_t len;
+    uint8_t payload[64];
+};
+
+static struct {
+    uint32_t version;
+    uint32_t sector;
+    uint32_t max_size;
+    uint32_t frame;
+    uint32_t window;
+} target;
+
+static uint8_t *image;
+static uint32_t retransmits;
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void write_all(const uint8_t *buf, size_t len)
+{
+    ssize_t res;
+    while (len > 0) {
+        res = write(serialfd, buf, len);
+        if (res < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            perror("write");
+            exit(3);
+        }
+        buf += res;
+        len -= res;
+    }
+}
+
+static void v2_send(uint8_t type, const uint8_t *p1, uint16_t len1,
+    const uint8_t *p2, uint16_t len2)
+{
+    uint8_t buf[5 + 4 + V2_MAX_FRAME + 4];
+    uint16_t len = len1 + len2;
+    uint32_t crc;
+
+    buf[0] = UPDATE_SYNC0;
+    buf[1] = UPDATE_SYNC1;
+    buf[2] = type;
+    buf[3] = len & 0xFF;
+    buf[4] = len >> 8;
+    if (len1 > 0)
+        memcpy(buf + 5, p1, len1);
+    if (len2 > 0)
+        memcpy(buf + 5 + len1, p2, len2);
+    crc = update_crc32(0, buf + 2, 3 + len);
+    put_u32(buf + 5 + len, crc);
+    write_all(buf, 5 + len + 4);
+}
+
+/* Wait up to timeout_ms for a valid frame from the target. In 'hello_only'
+ * mode, a v1 target announcing itself with '*' returns 1, and any other
+ * character is printed, as the target console shares the UART. Returns 0
+ * when a frame is received, -1 on timeout. */
+static int v2_recv(struct v2_frame *f, int timeout_ms, int hello_only)
+{
+    static uint8_t buf[5 + sizeof(f->payload) + 4];
+    static uint32_t pos;
+    uint64_t deadline = now_ms() + timeout_ms;
+    uint32_t len;
+    struct pollfd pfd;
+    uint8_t c;
+    int64_t left;
+
+    pfd.fd = serialfd;
+    pfd.events = POLLIN;
+    while (1) {
+        if (read(serialfd, &c, 1) != 1) {
+            left = (int64_t)(deadline - now_ms());
+            if (left <= 0)
+                return -1;
+            pfd.revents = 0;
+            poll(&pfd, 1, (int)left);
+            continue;
+        }
+        if (pos == 0) {
+            if (c == UPDATE_SYNC0) {
+                buf[pos++] = c;
+            } else if (hello_only) {
+                if (c == '*')
+                    return 1;
+                printf("%c", c);
+                fflush(stdout);
+            }
+            continue;
+        }
+        if (pos == 1) {
+            if (c == UPDATE_SYNC1)
+                buf[pos++] = c;
+            else if (c != UPDATE_SYNC0)
+                pos = 0;
+            continue;
+        }
+        buf[pos++] = c;
+        if (pos < 5)
+            continue;
+        len = buf[3] | (buf[4] << 8);
+        if (len > sizeof(f->payload)) {
+            pos = 0;
+            continue;
+        }
+        if (pos < 5 + len + 4)
+            continue;
+        pos = 0;
+        if (update_crc32(0, buf + 2, 3 + len) != get_u32(buf + 5 + len))
+            continue;
+        f->type = buf[2];
+        f->len = len;
+        memcpy(f->payload, buf + 5, len);
+        return 0;
+    }
+}
+
+static int v2_hello(const struct v2_frame *f)
+{
+    if ((f->type != UPDATE_HELLO) || (f->len < 15))
+        return -1;
+    target.version = get_u32(f->payload);
+    target.sector = get_u32(f->payload + 4);
+    target.max_size = get_u32(f->payload + 8);
+    target.frame = f->payload[12] | (f->payload[13] << 8);
+    target.window = f->payload[14];
+    if (target.frame > V2_MAX_FRAME)
+        target.frame = V2_MAX_FRAME;
+    if (target.window > V2_MAX_WINDOW)
+        target.window = V2_MAX_WINDOW;
+    if ((target.frame == 0) || (target.window == 0) || (target.sector == 0) ||
+            ((target.sector % target.frame) != 0))
+        return -1;
+    printf("Target: v2, firmware version %u, sector %u, frame %u, window %u\n",
+        target.version, target.sector, target.frame, target.window);
+    return 0;
+}
+
+/* Send 'type' and wait for a reply of type 'reply' */
+static int v2_request(uint8_t type, const uint8_t *p, uint16_t len,
+    uint8_t reply, struct v2_frame *f)
+{
+    int i;
+    for (i = 0; i < V2_RETRIES; i++) {
+        v2_send(type, p, len, NULL, 0);
+        while (v2_recv(f, 1000, 0) == 0) {
+            if (f->type == UPDATE_HELLO) {
+                v2_hello(f);
+                return V2_RESTART;
+            }
+            if (f->type == UPDATE_ERROR) {
+                fprintf(stderr, "Target error %u\n", f->len ? f->payload[0] : 0);
+                return -1;
+            }
+            if (f->type == reply)
+                return 0;
+        }
+    }
+    fprintf(stderr, "No reply from target\n");
+    return -1;
+}
+
+/* Largest number of whole sectors already in the update partition */
+static int v2_resume_offset(uint32_t tot_len, uint32_t *off)
+{
+    struct v2_frame f;
+    uint32_t lo = 0, hi, mid, len;
+    uint8_t p[4];
+    int ret;
+
+    hi = tot_len / target.sector;
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        len = mid * target.sector;
+        put_u32(p, len);
+        do {
+            ret = v2_request(UPDATE_QUERY, p, sizeof(p), UPDATE_CRC, &f);
+            if (ret != 0)
+                return ret;
+        } while ((f.len != 8) || (get_u32(f.payload) != len));
+        if (get_u32(f.payload + 4) == update_crc32(0, image, len))
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    *off = lo * target.sector;
+    return 0;
+}
+
+static void v2_send_data(uint32_t off, uint32_t tot_len)
+{
+    uint8_t p[4];
+    uint32_t len = target.frame;
+    if (len > tot_len - off)
+        len = tot_len - off;
+    put_u32(p, off);
+    v2_send(UPDATE_DATA, p, sizeof(p), image + off, len);
+}
+
+static int v2_transfer(uint32_t tot_len)
+{
+    struct v2_frame f;
+    uint32_t start, base, next, bitmap = 0, off, i, top;
+    uint32_t fast_retx[V2_MAX_WINDOW];
+    uint32_t frame = target.frame, window = target.window;
+    uint64_t t_start, last_progress, rto;
+    uint8_t p[8];
+    int stalls = 0;
+    int ret;
+
+    if (tot_len > target.max_size) {
+        fprintf(stderr, "Image too large for the target (%u > %u)\n",
+            tot_len, target.max_size);
+        return -1;
+    }
+    ret = v2_resume_offset(tot_len, &start);
+    if (ret != 0)
+        return ret;
+    if (start > 0)
+        printf("Resuming at offset %u\n", start);
+    put_u32(p, tot_len);
+    put_u32(p + 4, start);
+    ret = v2_request(UPDATE_START, p, sizeof(p), UPDATE_ACK, &f);
+    if (ret != 0)
+        return ret;
+
+    /* Retransmit timeout: time to send a full window on the line, plus
+     * some margin for the flash writes */
+    rto = 200 + (3000ULL * window * (frame + UPDATE_FRAME_OVERHEAD + 4) * 10) /
+        baudrate;
+    memset(fast_retx, 0xFF, sizeof(fast_retx));
+    base = next = start;
+    t_start = last_progress = now_ms();
+    while (base < tot_len) {
+        while ((next < tot_len) && (next < base + window * frame)) {
+            v2_send_data(next, tot_len);
+            next += frame;
+        }
+        if (v2_recv(&f, (int)rto, 0) != 0) {
+            f.type = 0;
+        }
+        if (f.type == UPDATE_HELLO) {
+            printf("\nTarget reset\n");
+            v2_hello(&f);
+            return V2_RESTART;
+        }
+        if (f.type == UPDATE_ERROR) {
+            fprintf(stderr, "\nTarget error %u\n", f.len ? f.payload[0] : 0);
+            return -1;
+        }
+        if ((f.type == UPDATE_ACK) && (f.len == 8)) {
+            off = get_u32(f.payload);
+            if ((off >= base) && (off <= tot_len)) {
+                if (off > base) {
+                    last_progress = now_ms();
+                    stalls = 0;
+                }
+                base = off;
+                bitmap = get_u32(f.payload + 4);
+                if (next < base)
+                    next = base;
+                /* Selective retransmit: frames missing before the last one
+                 * received, once per gap */
+                for (top = 32; top > 0; top--) {
+                    if (bitmap & (1U << (top - 1)))
+                        break;
+                }
+                for (i = 0; i + 1 < top; i++) {
+                    off = base + i * frame;
+                    if ((bitmap & (1U << i)) || (off >= next))
+                        continue;
+                    if (fast_retx[(off / frame) % window] == off)
+                        continue;
+                    fast_retx[(off / frame) % window] = off;
+                    v2_send_data(off, tot_len);
+                    retransmits++;
+                }
+                printf("Sent bytes: %u/%u \r", base, tot_len);
+                fflush(stdout);
+            }
+        }
+        if (now_ms() - last_progress > rto) {
+            if (++stalls > V2_RETRIES) {
+                fprintf(stderr, "\nTransfer stalled at offset %u\n", base);
+                return -1;
+            }
+            /* Timeout: resend everything in flight that is not acked */
+            for (i = 0; base + i * frame < next; i++) {
+                if ((i < 32) && (bitmap & (1U << i)))
+                    continue;
+                off = base + i * frame;
+                fast_retx[(off / frame) % window] = off;
+                v2_send_data(off, tot_len);
+                retransmits++;
+            }
+            last_progress = now_ms();
+        }
+    }
+    t_start = now_ms() - t_start;
+    if (t_start == 0)
+        t_start = 1;
+    printf("\nTransfer complete: %u bytes in %.2f s (%.1f KB/s, "
+        "%u retransmitted frames)\n", tot_len - start, t_start / 1000.0,
+        (tot_len - start) / (double)t_start * 1000.0 / 1024.0, retransmits);
+    return 0;
+}
+
+static int update_v2(int ffd, uint32_t tot_len)
+{
+    ssize_t res;
+    uint32_t len = 0;
+    int ret;
+
+    image = malloc(tot_len);
+    if (image == NULL) {
+        fprintf(stderr, "Cannot allocate %u bytes\n", tot_len);
+        return -1;
+    }
+    lseek(ffd, 0, SEEK_SET);
+    while (len < tot_len) {
+        res = read(ffd, image + len, tot_len - len);
+        if (res <= 0) {
+            perror("reading file");
+            free(image);
+            return -1;
+        }
+        len += res;
+    }
+    do {
+        ret = v2_transfer(tot_len);
+    } while (ret == V2_RESTART);
+    free(image);
+    return ret;
+}
+
+static speed_t baud_flag(unsigned int baud)
+{
+    switch (baud) {
+#ifdef B230400
+        case 230400: return B230400;
+#endif
+#ifdef B460800
+        case 460800: return B460800;
+#endif
+#ifdef B921600
+        case 921600: return B921600;
+#endif
+        default:
+            baudrate = 115200;
+            return B115200;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    /* Variables for awaiting datagram */
+    int           res = 1;
+    uint32_t      tot_len;
+    int           ffd; /* Firmware file descriptor */
+    struct stat   st;
+    struct termios tty;
+    const char   *dev = UART_DEV;
+    struct v2_frame f;
+    uint64_t      probe = 0;
+    /* Even-sized probe, so that v1 targets parsing 2-byte headers stay in
+     * sync */
+    const uint8_t probe_pad = 2;
+    int           opt;
+
+    while ((opt = getopt(argc, argv, "d:b:")) != -1) {
+        switch (opt) {
+            case 'd':
+                dev = optarg;
+                break;
+            case 'b':
+                baudrate = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                argc = 0;
+                break;
+        }
+    }
+    if (argc != optind + 1) {
+        printf("Usage: %s [-d device] [-b baudrate] firmware_filename\n",
+            argv[0]);
+        exit(1);
+    }
+
+    /* open file and get size */
+    ffd = open(argv[optind], O_RDONLY);
+    if (ffd < 0) {
+        perror("opening file");
+        exit(2);
+    }
+    res = fstat(ffd, &st);
+    if (res != 0) {
+        perror("fstat file");
+        exit(2);
+    }
+    tot_len = st.st_size;
+
+    /* open UART */
+    printf("Opening %s UART\n", dev);
+    serialfd = open(dev, O_RDWR | O_NOCTTY);
+    if (serialfd < 0) {
+        fprintf(stderr, "failed opening serial %s\n", dev);
+        exit(2);
+    }
+    tcgetattr(serialfd, &tty);
+    cfsetospeed(&tty, baud_flag(baudrate));
+    cfsetispeed(&tty, baud_flag(baudrate));
+    tty.c_cflag = (tty.c_cflag & ~CSIZE) | (CS8);
+    tty.c_iflag &= ~(IGNBRK | IXON | IXOFF | IXANY| INLCR | ICRNL);
+    tty.c_oflag &= ~OPOST;
+    tty.c_oflag &= ~(ONLCR|OCRNL);
+    tty.c_cflag &= ~(PARENB | PARODD | CSTOPB);
+    tty.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
+    tty.c_iflag &= ~ISTRIP;
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+    tcsetattr(serialfd, TCSANOW, &tty);
+
+    /* Wait for start hash (asterisk), or a v2 HELLO. Probe every second in
+     * case the target announced itself before we were listening. */
+    while (1) {
+        if (now_ms() - probe >= 1000) {
+            v2_send(UPDATE_PROBE, &probe_pad, 1, NULL, 0);
+            probe = now_ms();
+        }
+        res = v2_recv(&f, 100, 1);
+        if (res == 1)
+            break;
+        if ((res == 0) && (v2_hello(&f) == 0))
+            break;
+    }
+    printf("Target connected.\n");
+
+    if (res == 1) {
+        /* v1 reads wait for data */
+        tty.c_cc[VTIME] = 5;
+        tcsetattr(serialfd, TCSANOW, &tty);
+        update_v1(ffd, tot_len);
+    } else if (update_v2(ffd, tot_len) != 0) {
+        close(serialfd);
+        exit(4);
+    }
     printf("All done.\n");
     close(serialfd);
 
@@ -34,6 +34,29 @@
 #define DST_SIZE 4096
 #define DIFF_SIZE 8192
 
+#ifdef EXT_FLASH
+/* Mock external flash holding the patch and, with PART_BOOT_EXT, the base
+ * image, at offsets which are not aligned to DELTA_PATCH_BLOCK_SIZE */
+#define EXT_PATCH_OFFSET 100
+#define EXT_SRC_OFFSET (PATCH_SIZE + DELTA_PATCH_BLOCK_SIZE + 36)
+static uint8_t ext_flash[EXT_SRC_OFFSET + SRC_SIZE + DELTA_PATCH_BLOCK_SIZE]
+    __attribute__((aligned(DELTA_PATCH_BLOCK_SIZE)));
+static uint32_t ext_read_bytes;
+
+int ext_flash_read(uintptr_t address, uint8_t *data, int len)
+{
+    ck_assert_uint_ge(address, (uintptr_t)ext_flash);
+    ck_assert_uint_le(address + len, (uintptr_t)ext_flash + sizeof(ext_flash));
+    /* Reads are aligned to the flash page */
+    ck_assert_uint_eq(address % DELTA_PATCH_BLOCK_SIZE, 0);
+    ck_assert_uint_eq(len, DELTA_PATCH_BLOCK_SIZE);
+    memcpy(data, (void *)address, len);
+    /* Count the reads of the patch only */
+    if (address < (uintptr_t)ext_flash + PATCH_SIZE + DELTA_PATCH_BLOCK_SIZE)
+        ext_read_bytes += len;
+    return len;
+}
+#endif
 
 
 START_TEST(test_wb_patch_init_invalid)
@@ -61,6 +84,75 @@ START_TEST(test_wb_diff_init_invalid)
 }
 END_TEST
 
+#ifdef EXT_FLASH
+START_TEST(test_wb_patch_ext_flash)
+{
+    WB_DIFF_CTX diff_ctx;
+    WB_PATCH_CTX patch_ctx;
+    uint8_t src_a[SRC_SIZE];
+    uint8_t src_b[SRC_SIZE];
+    uint8_t patch[PATCH_SIZE];
+    uint8_t patched_dst[DST_SIZE];
+    uint8_t *src = src_a;
+    const uint32_t chunks[] = { BLOCK_HDR_SIZE, 100, DELTA_BLOCK_SIZE };
+    uint32_t pseudo_rand = 0;
+    uint32_t p_written = 0;
+    uint32_t pages;
+    int ret;
+    int i, c;
+
+    /* Enough literal bytes for the patch to span a few flash pages, with
+     * matching blocks in between */
+    for (i = 0; i < SRC_SIZE; i++) {
+        pseudo_rand = pseudo_rand * 1664525 + 1013904223;
+        src_a[i] = (uint8_t)(pseudo_rand >> 24);
+        src_b[i] = src_a[i];
+        if ((i % 512) < 300)
+            src_b[i] = (uint8_t)(pseudo_rand >> 16);
+    }
+    src_b[3000] = ESC;
+    memcpy(src_b + 3500, src_a + 100, 100);
+
+    ret = wb_diff_init(&diff_ctx, src_a, SRC_SIZE, src_b, SRC_SIZE);
+    ck_assert_int_eq(ret, 0);
+    do {
+        ret = wb_diff(&diff_ctx, patch + p_written, DELTA_BLOCK_SIZE);
+        ck_assert_int_ge(ret, 0);
+        p_written += ret;
+    } while (ret > 0);
+    ck_assert_int_gt(p_written, 2 * DELTA_PATCH_BLOCK_SIZE);
+    memset(ext_flash, 0xFF, sizeof(ext_flash));
+    memcpy(ext_flash + EXT_PATCH_OFFSET, patch, p_written);
+#ifdef PART_BOOT_EXT
+    memcpy(ext_flash + EXT_SRC_OFFSET, src_a, SRC_SIZE);
+    src = ext_flash + EXT_SRC_OFFSET;
+#endif
+
+    /* Flash pages touched by the patch, plus the one after it */
+    pages = (EXT_PATCH_OFFSET + p_written) / DELTA_PATCH_BLOCK_SIZE + 2;
+
+    for (c = 0; c < (int)(sizeof(chunks) / sizeof(chunks[0])); c++) {
+        ret = wb_patch_init(&patch_ctx, src, SRC_SIZE,
+                ext_flash + EXT_PATCH_OFFSET, p_written);
+        ck_assert_int_eq(ret, 0);
+        ext_read_bytes = 0;
+        for (i = 0; i < SRC_SIZE;) {
+            ret = wb_patch(&patch_ctx, patched_dst + i, chunks[c]);
+            ck_assert_int_ge(ret, 0);
+            if (ret == 0)
+                break;
+            i += ret;
+        }
+        ck_assert_int_eq(i, SRC_SIZE);
+        ck_assert_mem_eq(patched_dst, src_b, SRC_SIZE);
+        /* Each page of the patch is read once */
+        ck_assert_uint_le(ext_read_bytes, pages * DELTA_PATCH_BLOCK_SIZE);
+    }
+}
+END_TEST
+
+#else
+
 static void initialize_buffers(uint8_t *src_a, uint8_t *src_b)
 {
     uint32_t pseudo_rand = 0;
@@ -149,6 +241,67 @@ START_TEST(test_wb_patch_and_diff)
 }
 END_TEST
 
+START_TEST(test_wb_diff_ranges)
+{
+    WB_DIFF_CTX diff_ctx;
+    WB_PATCH_CTX patch_ctx;
+    uint8_t src_a[SRC_SIZE];
+    uint8_t src_b[SRC_SIZE];
+    uint8_t patch[PATCH_SIZE];
+    uint8_t patched_dst[DST_SIZE];
+    uint32_t half = SRC_SIZE / 2;
+    uint32_t p_written = 0;
+    int ret;
+    int i, r;
+
+    initialize_buffers(src_a, src_b);
+
+    ret = wb_diff_init(&diff_ctx, src_a, SRC_SIZE, src_b, SRC_SIZE);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_int_eq(wb_diff_range(NULL, 0, half), -1);
+    ck_assert_int_eq(wb_diff_range(&diff_ctx, half, half), -1);
+    ck_assert_int_eq(wb_diff_range(&diff_ctx, 0, SRC_SIZE + 1), -1);
+    ck_assert_int_eq(wb_diff_range(&diff_ctx, 1, half), -1);
+
+    /* Diff the second half first: ranges don't depend on each other */
+    for (r = 1; r >= 0; r--) {
+        uint8_t part[PATCH_SIZE];
+        uint32_t part_sz = 0;
+        ret = wb_diff_init(&diff_ctx, src_a, SRC_SIZE, src_b, SRC_SIZE);
+        ck_assert_int_eq(ret, 0);
+        ret = wb_diff_range(&diff_ctx, r * half, (r + 1) * half);
+        ck_assert_int_eq(ret, 0);
+        do {
+            ret = wb_diff(&diff_ctx, part + part_sz, DELTA_BLOCK_SIZE);
+            ck_assert_int_ge(ret, 0);
+            part_sz += ret;
+        } while (ret > 0);
+        ck_assert_uint_eq(diff_ctx.off_b, (r + 1) * half);
+        if (r == 1) {
+            memcpy(patch + PATCH_SIZE / 2, part, part_sz);
+            p_written = part_sz;
+        } else {
+            memmove(patch + part_sz, patch + PATCH_SIZE / 2, p_written);
+            memcpy(patch, part, part_sz);
+            p_written += part_sz;
+        }
+    }
+
+    ret = wb_patch_init(&patch_ctx, src_a, SRC_SIZE, patch, p_written);
+    ck_assert_int_eq(ret, 0);
+    for (i = 0; i < SRC_SIZE;) {
+        ret = wb_patch(&patch_ctx, patched_dst + i, DELTA_BLOCK_SIZE);
+        ck_assert_int_ge(ret, 0);
+        if (ret == 0)
+            break;
+        i += ret;
+    }
+    ck_assert_int_eq(i, SRC_SIZE);
+    ck_assert_mem_eq(patched_dst, src_b, SRC_SIZE);
+}
+END_TEST
+
+#endif /* EXT_FLASH */
 
 Suite *patch_diff_suite(void)
 {
@@ -162,7 +315,12 @@ Suite *patch_diff_suite(void)
 
     tcase_add_test(tc_wolfboot_delta, test_wb_patch_init_invalid);
     tcase_add_test(tc_wolfboot_delta, test_wb_diff_init_invalid);
+#ifdef EXT_FLASH
+    tcase_add_test(tc_wolfboot_delta, test_wb_patch_ext_flash);
+#else
     tcase_add_test(tc_wolfboot_delta, test_wb_patch_and_diff);
+    tcase_add_test(tc_wolfboot_delta, test_wb_diff_ranges);
+#endif
     suite_add_tcase(s, tc_wolfboot_delta);
 
     return s;
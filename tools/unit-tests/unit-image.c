@@ -56,6 +56,11 @@
 
 #include "unit-keystore.c"
 
+#ifdef WOLFBOOT_VERIFY_CACHE
+static uint8_t verify_cache_sector[0x400];
+#define WOLFBOOT_VERIFY_CACHE_ADDRESS ((uintptr_t)verify_cache_sector)
+#endif
+
 #include "image.c"
 
 const uint8_t a;
@@ -516,6 +521,256 @@ START_TEST(test_verify_integrity)
 }
 END_TEST
 
+#ifdef WOLFBOOT_HASH_TREE
+#include <pthread.h>
+
+#define TEST_SMP_CORES 4
+static int smp_started = 0;
+static struct test_smp_core {
+    pthread_t thread;
+    void (*fn)(void *);
+    void *arg;
+} test_smp[TEST_SMP_CORES];
+
+static void *test_smp_entry(void *arg)
+{
+    struct test_smp_core *core = (struct test_smp_core *)arg;
+    core->fn(core->arg);
+    return NULL;
+}
+
+int hal_smp_cores(void)
+{
+    return TEST_SMP_CORES;
+}
+
+int hal_smp_start(int core, void (*fn)(void *), void *arg)
+{
+    ck_assert_int_gt(core, 0);
+    ck_assert_int_lt(core, TEST_SMP_CORES);
+    test_smp[core].fn = fn;
+    test_smp[core].arg = arg;
+    if (pthread_create(&test_smp[core].thread, NULL, test_smp_entry,
+                &test_smp[core]) != 0)
+        return -1;
+    smp_started++;
+    return 0;
+}
+
+void hal_smp_wait(int core)
+{
+    pthread_join(test_smp[core].thread, NULL);
+}
+
+START_TEST(test_verify_integrity_hash_tree)
+{
+    const uint32_t chunk = 1024;
+    const uint32_t fw_size = 5 * 1024 + 100; /* 6 chunks, last one partial */
+    static uint8_t tree_img[IMAGE_HEADER_SIZE + 5 * 1024 + 100];
+    uint8_t leaf[SHA256_DIGEST_SIZE];
+    struct wolfBoot_image img;
+    wc_Sha256 sha, leaf_sha;
+    uint32_t magic = WOLFBOOT_MAGIC;
+    uint32_t pos, len;
+    int ret;
+
+    /* Manifest: magic, size, HDR_HASH_TREE, HDR_SHA256 */
+    memset(tree_img, 0xFF, IMAGE_HEADER_SIZE);
+    memcpy(tree_img, &magic, sizeof(uint32_t));
+    memcpy(tree_img + 4, &fw_size, sizeof(uint32_t));
+    tree_img[8] = HDR_HASH_TREE;
+    tree_img[9] = 0;
+    tree_img[10] = sizeof(uint32_t);
+    tree_img[11] = 0;
+    memcpy(tree_img + 12, &chunk, sizeof(uint32_t));
+    tree_img[16] = HDR_SHA256;
+    tree_img[17] = 0;
+    tree_img[18] = SHA256_DIGEST_SIZE;
+    tree_img[19] = 0;
+    for (pos = 0; pos < fw_size; pos++)
+        tree_img[IMAGE_HEADER_SIZE + pos] = (uint8_t)(pos * 7);
+
+    /* Digest: header up to the hash field, then the digest of each chunk */
+    wc_InitSha256(&sha);
+    wc_Sha256Update(&sha, tree_img, 16);
+    for (pos = 0; pos < fw_size; pos += len) {
+        len = fw_size - pos;
+        if (len > chunk)
+            len = chunk;
+        wc_InitSha256(&leaf_sha);
+        wc_Sha256Update(&leaf_sha, tree_img + IMAGE_HEADER_SIZE + pos, len);
+        wc_Sha256Final(&leaf_sha, leaf);
+        wc_Sha256Update(&sha, leaf, SHA256_DIGEST_SIZE);
+    }
+    wc_Sha256Final(&sha, tree_img + 20);
+
+    find_header_mocked = 0;
+    memset(&img, 0, sizeof(struct wolfBoot_image));
+    img.part = PART_BOOT;
+    ret = wolfBoot_open_image_address(&img, tree_img);
+    ck_assert_int_eq(ret, 0);
+
+    /* Two rounds: 4 chunks, then 2. The boot core takes one in each. */
+    smp_started = 0;
+    ret = wolfBoot_verify_integrity(&img);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_int_eq(img.sha_ok, 1);
+    ck_assert_int_eq(smp_started, 4);
+
+    /* A flat digest of the same image is rejected */
+    ret = image_hash(&img, digest);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_int_ne(memcmp(digest, tree_img + 20, SHA256_DIGEST_SIZE), 0);
+
+    /* Corrupt the last chunk, handled by a secondary core */
+    img.sha_ok = 0;
+    tree_img[IMAGE_HEADER_SIZE + fw_size - 1] ^= 0x01;
+    ret = wolfBoot_verify_integrity(&img);
+    ck_assert_int_eq(ret, -1);
+    ck_assert_int_eq(img.sha_ok, 0);
+
+    /* Invalid chunk size */
+    tree_img[IMAGE_HEADER_SIZE + fw_size - 1] ^= 0x01;
+    tree_img[12] = 0x01;
+    ret = wolfBoot_verify_integrity(&img);
+    ck_assert_int_eq(ret, -1);
+}
+END_TEST
+#endif /* WOLFBOOT_HASH_TREE */
+
+#ifdef WOLFBOOT_VERIFY_CACHE
+static uint8_t cache_part_state = IMG_STATE_SUCCESS;
+static int cache_key_fail = 0;
+static int cache_erased = 0;
+
+int wolfBoot_get_partition_state(uint8_t part, uint8_t *st)
+{
+    *st = cache_part_state;
+    return 0;
+}
+
+int hal_verify_cache_key(uint8_t *key, int len)
+{
+    if (cache_key_fail)
+        return -1;
+    memset(key, 0xA5, len);
+    return 0;
+}
+
+void hal_flash_unlock(void)
+{
+}
+
+void hal_flash_lock(void)
+{
+}
+
+int hal_flash_erase(haladdr_t address, int len)
+{
+    ck_assert_uint_eq(address, (haladdr_t)WOLFBOOT_VERIFY_CACHE_ADDRESS);
+    memset(verify_cache_sector, 0xFF, len);
+    cache_erased++;
+    return 0;
+}
+
+int hal_flash_write(haladdr_t address, const uint8_t *data, int len)
+{
+    ck_assert_uint_eq(address, (haladdr_t)WOLFBOOT_VERIFY_CACHE_ADDRESS);
+    memcpy(verify_cache_sector, data, len);
+    return 0;
+}
+
+static int cache_verify(void)
+{
+    struct wolfBoot_image img;
+    int ret;
+
+    memset(&img, 0, sizeof(struct wolfBoot_image));
+    hdr_cpy_done = 0;
+    ret = wolfBoot_open_image(&img, PART_UPDATE);
+    ck_assert_int_eq(ret, 0);
+    ret = wolfBoot_verify_cached(&img);
+    if (ret == 0) {
+        ck_assert_int_eq(img.sha_ok, 1);
+        ck_assert_int_eq(img.signature_ok, 1);
+    }
+    return ret;
+}
+
+START_TEST(test_verify_cached)
+{
+    uint8_t record[sizeof(struct verify_cache_record)];
+    uint8_t b;
+
+    find_header_mocked = 0;
+    find_header_fail = 0;
+    ecc_import_fail = 0;
+    ecc_init_fail = 0;
+    memset(verify_cache_sector, 0xFF, sizeof(verify_cache_sector));
+    ext_flash_erase(WOLFBOOT_PARTITION_UPDATE_ADDRESS, WOLFBOOT_SECTOR_SIZE);
+    ext_flash_write(WOLFBOOT_PARTITION_UPDATE_ADDRESS,
+            test_img_v123_signed_bin,
+            test_img_v123_signed_bin_len);
+
+    /* No record: full verification, then the record is stored */
+    verify_called = 0;
+    ck_assert_int_eq(cache_verify(), 0);
+    ck_assert_int_eq(verify_called, 1);
+    ck_assert_uint_eq(*(uint32_t *)verify_cache_sector, VERIFY_CACHE_MAGIC);
+    memcpy(record, verify_cache_sector, sizeof(record));
+
+    /* Record matches: no signature verification */
+    verify_called = 0;
+    ck_assert_int_eq(cache_verify(), 0);
+    ck_assert_int_eq(verify_called, 0);
+
+    /* Other partition state: full verification, the record is kept */
+    cache_part_state = IMG_STATE_TESTING;
+    ck_assert_int_eq(cache_verify(), 0);
+    ck_assert_int_eq(verify_called, 1);
+    ck_assert_mem_eq(verify_cache_sector, record, sizeof(record));
+    cache_part_state = IMG_STATE_SUCCESS;
+
+    /* Modified firmware: the record does not match, full verification
+     * fails */
+    ext_flash_read(WOLFBOOT_PARTITION_UPDATE_ADDRESS + IMAGE_HEADER_SIZE + 2,
+            &b, 1);
+    b ^= 0x01;
+    ext_flash_write(WOLFBOOT_PARTITION_UPDATE_ADDRESS + IMAGE_HEADER_SIZE + 2,
+            &b, 1);
+    ck_assert_int_lt(cache_verify(), 0);
+    b ^= 0x01;
+    ext_flash_write(WOLFBOOT_PARTITION_UPDATE_ADDRESS + IMAGE_HEADER_SIZE + 2,
+            &b, 1);
+
+    /* Forged record */
+    verify_cache_sector[8] ^= 0x01;
+    verify_called = 0;
+    ck_assert_int_eq(cache_verify(), 0);
+    ck_assert_int_eq(verify_called, 1);
+    ck_assert_mem_eq(verify_cache_sector, record, sizeof(record));
+
+    /* Invalidated record */
+    cache_erased = 0;
+    wolfBoot_verify_cache_invalidate();
+    ck_assert_int_eq(cache_erased, 1);
+    wolfBoot_verify_cache_invalidate();
+    ck_assert_int_eq(cache_erased, 1);
+    verify_called = 0;
+    ck_assert_int_eq(cache_verify(), 0);
+    ck_assert_int_eq(verify_called, 1);
+
+    /* No device secret: nothing is stored */
+    wolfBoot_verify_cache_invalidate();
+    cache_key_fail = 1;
+    ck_assert_int_eq(cache_verify(), 0);
+    ck_assert_int_eq(cache_verify(), 0);
+    ck_assert_int_eq(verify_called, 3);
+    ck_assert_uint_ne(*(uint32_t *)verify_cache_sector, VERIFY_CACHE_MAGIC);
+}
+END_TEST
+#endif /* WOLFBOOT_VERIFY_CACHE */
+
 START_TEST(test_open_image)
 {
     struct wolfBoot_image img;
@@ -585,6 +840,22 @@ Suite *wolfboot_suite(void)
     tcase_add_test(tcase_verify_integrity, test_verify_integrity);
     suite_add_tcase(s, tcase_verify_integrity);
 
+#ifdef WOLFBOOT_HASH_TREE
+    TCase* tcase_verify_integrity_hash_tree =
+        tcase_create("verify_integrity_hash_tree");
+    tcase_set_timeout(tcase_verify_integrity_hash_tree, 20);
+    tcase_add_test(tcase_verify_integrity_hash_tree,
+            test_verify_integrity_hash_tree);
+    suite_add_tcase(s, tcase_verify_integrity_hash_tree);
+#endif
+
+#ifdef WOLFBOOT_VERIFY_CACHE
+    TCase* tcase_verify_cached = tcase_create("verify_cached");
+    tcase_set_timeout(tcase_verify_cached, 20);
+    tcase_add_test(tcase_verify_cached, test_verify_cached);
+    suite_add_tcase(s, tcase_verify_cached);
+#endif
+
     TCase* tcase_open_image = tcase_create("open_image");
     tcase_set_timeout(tcase_open_image, 20);
     tcase_add_test(tcase_open_image, test_open_image);
@@ -34,6 +34,18 @@ static int erased_vault = 0;
 const char *argv0;
 
 #include <sys/stat.h>
+#include <setjmp.h>
+
+/* Power failure: the erase that brings the countdown to zero never happens,
+ * execution resumes at the setjmp() of the test instead */
+int erase_fail_countdown = 0;
+jmp_buf erase_fail_jmp;
+
+static void erase_power_fail(void)
+{
+    if ((erase_fail_countdown > 0) && (--erase_fail_countdown == 0))
+        longjmp(erase_fail_jmp, 1);
+}
 
 
 /* Mocks */
@@ -75,6 +87,7 @@ int hal_flash_write(haladdr_t address, const uint8_t *data, int len)
 int hal_flash_erase(haladdr_t address, int len)
 {
     ck_assert_msg(!locked, "Attempting to erase a locked FLASH");
+    erase_power_fail();
     if ((address >= WOLFBOOT_PARTITION_BOOT_ADDRESS) &&
             (address < WOLFBOOT_PARTITION_BOOT_ADDRESS + WOLFBOOT_PARTITION_SIZE)) {
         erased_boot++;
@@ -126,6 +139,7 @@ void hal_prepare_boot(void)
 
 int ext_flash_erase(uintptr_t address, int len)
 {
+    erase_power_fail();
 #ifdef PART_BOOT_EXT
     if ((address >= WOLFBOOT_PARTITION_BOOT_ADDRESS) &&
             (address < WOLFBOOT_PARTITION_BOOT_ADDRESS + WOLFBOOT_PARTITION_SIZE)) {
@@ -285,6 +285,60 @@ START_TEST (test_nvm_select_fresh_sector)
 }
 END_TEST
 
+#if WOLFBOOT_SWAP_SECTORS > 1
+START_TEST (test_nvm_sector_flags_batch)
+{
+    int ret, i, erased, single, batch;
+    uint8_t st;
+
+    ret = mmap_file("/tmp/wolfboot-unit-file.bin", (void *)MOCK_ADDRESS,
+            WOLFBOOT_PARTITION_SIZE, NULL);
+    ck_assert(ret >= 0);
+#ifdef FLAGS_HOME
+    ret = mmap_file("/tmp/wolfboot-unit-int-file.bin", (void *)MOCK_ADDRESS_BOOT,
+            WOLFBOOT_PARTITION_SIZE, NULL);
+    ck_assert(ret >= 0);
+#endif
+    hal_flash_unlock();
+    wolfBoot_erase_partition(PART_UPDATE);
+#ifdef FLAGS_HOME
+    wolfBoot_erase_partition(PART_BOOT);
+#endif
+    wolfBoot_set_update_sector_flag(0, SECT_FLAG_SWAPPING);
+
+    /* One sector flag costs one rewrite of the trailer... */
+    erased = erased_update + erased_boot;
+    wolfBoot_set_update_sector_flag(0, SECT_FLAG_BACKUP);
+    single = erased_update + erased_boot - erased;
+
+    /* ...and so do the flags of a group of sectors */
+    erased = erased_update + erased_boot;
+    ret = wolfBoot_set_update_sector_flags(1, 6, SECT_FLAG_SWAPPING);
+    ck_assert_int_eq(ret, 0);
+    batch = erased_update + erased_boot - erased;
+    ck_assert_int_eq(batch, single);
+
+    ret = wolfBoot_get_update_sector_flag(0, &st);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_uint_eq(st, SECT_FLAG_BACKUP);
+    for (i = 1; i < 7; i++) {
+        ret = wolfBoot_get_update_sector_flag(i, &st);
+        ck_assert_int_eq(ret, 0);
+        ck_assert_uint_eq(st, SECT_FLAG_SWAPPING);
+    }
+    ret = wolfBoot_get_update_sector_flag(7, &st);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_uint_eq(st, SECT_FLAG_NEW);
+
+    /* Nothing to write if the flags are already set */
+    erased = erased_update + erased_boot;
+    wolfBoot_set_update_sector_flags(1, 6, SECT_FLAG_SWAPPING);
+    ck_assert_int_eq(erased_update + erased_boot, erased);
+    hal_flash_lock();
+}
+END_TEST
+#endif
+
 
 Suite *wolfboot_suite(void)
 {
@@ -295,6 +349,11 @@ Suite *wolfboot_suite(void)
     TCase *nvm_select_fresh_sector = tcase_create("NVM select fresh sector");
     tcase_add_test(nvm_select_fresh_sector, test_nvm_select_fresh_sector);
     suite_add_tcase(s, nvm_select_fresh_sector);
+#if WOLFBOOT_SWAP_SECTORS > 1
+    TCase *nvm_sector_flags_batch = tcase_create("NVM sector flags batch");
+    tcase_add_test(nvm_sector_flags_batch, test_nvm_sector_flags_batch);
+    suite_add_tcase(s, nvm_sector_flags_batch);
+#endif
 
     return s;
 }
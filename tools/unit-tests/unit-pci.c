@@ -31,6 +31,7 @@
 #define MOCKED_LEN (1024*1024*1024ULL)
 #define PCI_USE_ECAM
 #define PCI_ECAM_BASE MOCKED_BASE
+#define WOLFBOOT_PCI_BAR_CACHE
 
 #include <pci.h>
 #include <pci.c>
@@ -111,14 +112,77 @@ struct type1_pci_header type1_pci_header_mock = {
     .interrupt_line = 0x0a
 };
 
+/* Functions on bus 0 used by the enumeration tests. BAR registers keep only
+ * the bits in mask, and always read back flags in the low bits, like a real
+ * device would do when sized with 0xffffffff. */
+struct mock_pci_fun {
+    uint8_t dev;
+    uint8_t fun;
+    uint8_t header_type;
+    uint32_t vd_code;
+    uint32_t bar_mask[PCI_ENUM_MAX_BARS];
+    uint32_t bar_flags[PCI_ENUM_MAX_BARS];
+};
+
+static struct mock_pci_fun mock_funs[] = {
+    /* host bridge, no BARs */
+    { 0, 0, 0x00, 0x12348086, { 0 }, { 0 } },
+    /* multifunction: 64KB mem BAR0, 1MB 64-bit prefetchable BAR2 */
+    { 2, 0, 0x80, 0x5678abcd,
+        { 0xffff0000, 0, 0xfff00000, 0xffffffff, 0, 0 },
+        { 0x0, 0, 0xc, 0, 0, 0 } },
+    /* second function: 256 bytes io BAR0 */
+    { 2, 1, 0x00, 0x5679abcd,
+        { 0xffffff00, 0, 0, 0, 0, 0 },
+        { 0x1, 0, 0, 0, 0, 0 } },
+    /* 4KB mem BAR0 */
+    { 5, 0, 0x00, 0x9abcabcd,
+        { 0xfffff000, 0, 0, 0, 0, 0 },
+        { 0x0, 0, 0, 0, 0, 0 } },
+};
+#define MOCK_FUNS (sizeof(mock_funs) / sizeof(mock_funs[0]))
+
+static unsigned int cfg_reads, cfg_writes, cfg_sizing_writes;
+static int mock_bars_enabled;
+
+static struct mock_pci_fun *mock_pci_lookup(uintptr_t address, int *bar)
+{
+    uint32_t off = (uint32_t)(address - MOCKED_BASE);
+    uint32_t reg = off & 0xfff;
+    unsigned int i;
+
+    if (!mock_bars_enabled || (off >> 20) != 0 || reg < PCI_BAR0_OFFSET ||
+        reg >= PCI_BAR0_OFFSET + 4 * PCI_ENUM_MAX_BARS)
+        return NULL;
+    for (i = 0; i < MOCK_FUNS; i++) {
+        if (mock_funs[i].dev == ((off >> 15) & 0x1f) &&
+            mock_funs[i].fun == ((off >> 12) & 0x7)) {
+            *bar = (reg - PCI_BAR0_OFFSET) / 4;
+            return &mock_funs[i];
+        }
+    }
+    return NULL;
+}
+
 void mmio_write32(uintptr_t address, uint32_t value)
 {
     uint32_t *p = (uint32_t*)address;
+    struct mock_pci_fun *f;
+    int bar;
+
+    cfg_writes++;
+    f = mock_pci_lookup(address, &bar);
+    if (f != NULL) {
+        if (value == 0xffffffff)
+            cfg_sizing_writes++;
+        value = (value & f->bar_mask[bar]) | f->bar_flags[bar];
+    }
     *p = value;
 }
 
 uint32_t mmio_read32(uintptr_t address)
 {
+    cfg_reads++;
     return *((uint32_t*)(address));
 }
 
@@ -173,6 +237,109 @@ START_TEST (test_pci_config_write)
 }
 END_TEST
 
+static uint8_t *mock_pci_bus_setup(void)
+{
+    uint8_t *ecam;
+    uint8_t *cfg;
+    unsigned int i;
+    int b;
+
+    ecam = (uint8_t *)mmap((uint8_t *)MOCKED_BASE, MOCKED_LEN,
+                           PROT_WRITE | PROT_READ,
+                           MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS, -1, 0);
+    ck_assert_ptr_eq(ecam, (uint8_t*)MOCKED_BASE);
+
+    /* bus 0: nothing answers unless listed in mock_funs */
+    memset(ecam, 0xff, 1024 * 1024);
+    for (i = 0; i < MOCK_FUNS; i++) {
+        cfg = ecam + (mock_funs[i].dev << 15) + (mock_funs[i].fun << 12);
+        memset(cfg, 0, 4096);
+        memcpy(cfg + PCI_VENDOR_ID_OFFSET, &mock_funs[i].vd_code, 4);
+        cfg[PCI_HEADER_TYPE_OFFSET] = mock_funs[i].header_type;
+        for (b = 0; b < PCI_ENUM_MAX_BARS; b++)
+            memcpy(cfg + PCI_BAR0_OFFSET + 4 * b, &mock_funs[i].bar_flags[b], 4);
+    }
+    cfg_reads = cfg_writes = cfg_sizing_writes = 0;
+    mock_bars_enabled = 1;
+    return ecam;
+}
+
+static uint32_t mock_pci_bar(uint8_t *ecam, uint8_t dev, uint8_t fun,
+                             uint8_t bar)
+{
+    uint32_t val;
+    memcpy(&val, ecam + (dev << 15) + (fun << 12) + PCI_BAR0_OFFSET + 4 * bar,
+           4);
+    return val;
+}
+
+START_TEST (test_pci_enum_access_count)
+{
+    static const struct pci_enum_skip skip[] = { { 0, 5, PCI_ENUM_ANY } };
+    struct pci_bar_cache cache;
+    unsigned int cold_accesses, warm_accesses;
+    uint32_t bars[3];
+    uint8_t *ecam;
+
+    memset(&cache, 0, sizeof(cache));
+    pci_enum_set_skip_list(skip, 1);
+
+    /* Cold boot: every BAR is sized, the assignment is recorded */
+    ecam = mock_pci_bus_setup();
+    pci_enum_set_bar_cache(&cache);
+    ck_assert_int_eq(pci_enum_do(), 0);
+    cold_accesses = cfg_reads + cfg_writes;
+    ck_assert_uint_gt(cfg_sizing_writes, 0);
+    ck_assert_int_eq(pci_enum_bar_cache_updated(), 1);
+    ck_assert_uint_eq(cache.magic, PCI_BAR_CACHE_MAGIC);
+    ck_assert_uint_eq(cache.count, 3);
+    bars[0] = mock_pci_bar(ecam, 2, 0, 0);
+    bars[1] = mock_pci_bar(ecam, 2, 0, 2);
+    bars[2] = mock_pci_bar(ecam, 2, 1, 0);
+    ck_assert_uint_eq(bars[0], PCI_MMIO32_BASE);
+    ck_assert_uint_eq(bars[1], PCI_MMIO32_PREFETCH_BASE | 0xc);
+    ck_assert_uint_eq(bars[2], PCI_IO32_BASE | 0x1);
+    /* skipped device is left alone */
+    ck_assert_uint_eq(mock_pci_bar(ecam, 5, 0, 0), 0);
+    munmap(ecam, MOCKED_LEN);
+
+    /* Warm boot: same devices, no sizing at all, same assignment */
+    ecam = mock_pci_bus_setup();
+    pci_enum_set_bar_cache(&cache);
+    ck_assert_int_eq(pci_enum_do(), 0);
+    warm_accesses = cfg_reads + cfg_writes;
+    ck_assert_uint_eq(cfg_sizing_writes, 0);
+    ck_assert_uint_lt(warm_accesses, cold_accesses);
+    ck_assert_int_eq(pci_enum_bar_cache_updated(), 0);
+    ck_assert_uint_eq(mock_pci_bar(ecam, 2, 0, 0), bars[0]);
+    ck_assert_uint_eq(mock_pci_bar(ecam, 2, 0, 2), bars[1]);
+    ck_assert_uint_eq(mock_pci_bar(ecam, 2, 1, 0), bars[2]);
+    munmap(ecam, MOCKED_LEN);
+
+    /* A different device in 2.1: only that function is sized again */
+    mock_funs[2].vd_code = 0x567aabcd;
+    ecam = mock_pci_bus_setup();
+    pci_enum_set_bar_cache(&cache);
+    ck_assert_int_eq(pci_enum_do(), 0);
+    ck_assert_uint_gt(cfg_sizing_writes, 0);
+    ck_assert_uint_lt(cfg_reads + cfg_writes, cold_accesses);
+    ck_assert_int_eq(pci_enum_bar_cache_updated(), 1);
+    ck_assert_uint_eq(cache.entry[2].vd_code, 0x567aabcd);
+    ck_assert_uint_eq(mock_pci_bar(ecam, 2, 1, 0), bars[2]);
+    munmap(ecam, MOCKED_LEN);
+    mock_funs[2].vd_code = 0x5679abcd;
+
+    /* Without the skip list device 5 is found and programmed */
+    pci_enum_set_skip_list(NULL, 0);
+    ecam = mock_pci_bus_setup();
+    pci_enum_set_bar_cache(NULL);
+    ck_assert_int_eq(pci_enum_do(), 0);
+    ck_assert_uint_ne(mock_pci_bar(ecam, 5, 0, 0), 0);
+    munmap(ecam, MOCKED_LEN);
+    mock_bars_enabled = 0;
+}
+END_TEST
+
 Suite *wolfboot_suite(void)
 {
 
@@ -186,6 +353,11 @@ Suite *wolfboot_suite(void)
     tcase_set_timeout(pci_config, 60*5);
     suite_add_tcase(s, pci_config);
 
+    TCase *pci_enum = tcase_create("pci-enum-access-count");
+    tcase_add_test(pci_enum, test_pci_enum_access_count);
+    tcase_set_timeout(pci_enum, 60*5);
+    suite_add_tcase(s, pci_enum);
+
     return s;
 }
 
@@ -267,6 +267,84 @@ START_TEST (test_store_and_load_objs) {
 }
 END_TEST
 
+START_TEST (test_store_erase_count) {
+    CK_ULONG id_tok = 1, id_obj = 1;
+    int type = DYNAMIC_TYPE_ECC;
+    int ret, i;
+    void *store = NULL;
+    char first[] = "first";
+    char chunk[32];
+    char secret_rd[KEYVAULT_OBJ_SIZE];
+    const int n_writes = 16;
+
+    ret = mmap_file("/tmp/wolfboot-unit-keyvault.bin", vault_base,
+            keyvault_size, NULL);
+    ck_assert(ret == 0);
+    memset(vault_base, 0xEE, keyvault_size);
+
+    /* Format the vault with a first object */
+    ret = wolfPKCS11_Store_Open(type, id_tok, id_obj, 0, &store);
+    ck_assert_msg(ret == 0, "Failed to open the vault: %d", ret);
+    ret = wolfPKCS11_Store_Write(store, first, sizeof(first));
+    ck_assert_int_eq(ret, sizeof(first));
+    wolfPKCS11_Store_Close(store);
+
+    /* Create a new object using several small writes */
+    erased_vault = 0;
+    id_obj = 2;
+    ret = wolfPKCS11_Store_Open(type, id_tok, id_obj, 0, &store);
+    ck_assert_msg(ret == 0, "Failed to create object: %d", ret);
+    for (i = 0; i < n_writes; i++) {
+        memset(chunk, 'a' + i, sizeof(chunk));
+        ret = wolfPKCS11_Store_Write(store, chunk, sizeof(chunk));
+        ck_assert_int_eq(ret, sizeof(chunk));
+    }
+    ck_assert_int_eq(erased_vault, 0);
+    wolfPKCS11_Store_Close(store);
+    printf("Create object, %d writes: %d erase(s)\n", n_writes, erased_vault);
+    /* One commit for the object sector and one for the nodes table,
+     * two erases each (backup + target)
+     */
+    ck_assert_int_eq(erased_vault, 4);
+
+    /* Rewrite the same content: nothing to commit */
+    erased_vault = 0;
+    ret = wolfPKCS11_Store_Open(type, id_tok, id_obj, 0, &store);
+    ck_assert_msg(ret == 0, "Failed to reopen object: %d", ret);
+    for (i = 0; i < n_writes; i++) {
+        memset(chunk, 'a' + i, sizeof(chunk));
+        wolfPKCS11_Store_Write(store, chunk, sizeof(chunk));
+    }
+    wolfPKCS11_Store_Close(store);
+    printf("Rewrite same object: %d erase(s)\n", erased_vault);
+    ck_assert_int_eq(erased_vault, 0);
+
+    /* Update the content, same size: the nodes table is untouched */
+    erased_vault = 0;
+    ret = wolfPKCS11_Store_Open(type, id_tok, id_obj, 0, &store);
+    ck_assert_msg(ret == 0, "Failed to reopen object: %d", ret);
+    for (i = 0; i < n_writes; i++) {
+        memset(chunk, 'A' + i, sizeof(chunk));
+        wolfPKCS11_Store_Write(store, chunk, sizeof(chunk));
+    }
+    wolfPKCS11_Store_Close(store);
+    printf("Update object: %d erase(s)\n", erased_vault);
+    ck_assert_int_eq(erased_vault, 2);
+
+    /* Read back the last content */
+    ret = wolfPKCS11_Store_Open(type, id_tok, id_obj, 1, &store);
+    ck_assert_msg(ret == 0, "Failed to reopen object: %d", ret);
+    ret = wolfPKCS11_Store_Read(store, secret_rd, KEYVAULT_OBJ_SIZE);
+    ck_assert_int_eq(ret, n_writes * sizeof(chunk));
+    for (i = 0; i < n_writes; i++) {
+        memset(chunk, 'A' + i, sizeof(chunk));
+        ck_assert(memcmp(secret_rd + i * sizeof(chunk), chunk,
+                    sizeof(chunk)) == 0);
+    }
+    wolfPKCS11_Store_Close(store);
+}
+END_TEST
+
 Suite *wolfboot_suite(void)
 {
     /* Suite initialization */
@@ -275,6 +353,10 @@ Suite *wolfboot_suite(void)
     TCase* tcase_store_and_load_objs = tcase_create("store_and_load_objs");
     tcase_add_test(tcase_store_and_load_objs, test_store_and_load_objs);
     suite_add_tcase(s, tcase_store_and_load_objs);
+
+    TCase* tcase_store_erase_count = tcase_create("store_erase_count");
+    tcase_add_test(tcase_store_erase_count, test_store_erase_count);
+    suite_add_tcase(s, tcase_store_erase_count);
     return s;
 }
 
@@ -69,6 +69,15 @@ static void reset_mock_stats(void)
     wolfBoot_panicked = 0;
 }
 
+#ifdef WOLFBOOT_FLASH_MULTI_SECTOR_ERASE
+/* Mock flash: sectors, and blocks of 4 sectors */
+#define MOCK_ERASE_BLOCK_SIZE (4 * WOLFBOOT_SECTOR_SIZE)
+uint32_t hal_flash_erase_granularity(void)
+{
+    return WOLFBOOT_SECTOR_SIZE | MOCK_ERASE_BLOCK_SIZE;
+}
+#endif
+
 
 static void prepare_flash(void)
 {
@@ -80,7 +89,7 @@ static void prepare_flash(void)
             WOLFBOOT_PARTITION_SIZE, NULL);
     ck_assert(ret >= 0);
     ret = mmap_file("/tmp/wolfboot-unit-swap.bin", (void *)MOCK_ADDRESS_SWAP,
-            WOLFBOOT_SECTOR_SIZE, NULL);
+            WOLFBOOT_SECTOR_SIZE * WOLFBOOT_SWAP_SECTORS, NULL);
     ck_assert(ret >= 0);
     hal_flash_unlock();
     hal_flash_erase(WOLFBOOT_PARTITION_BOOT_ADDRESS, WOLFBOOT_PARTITION_SIZE);
@@ -92,7 +101,8 @@ static void cleanup_flash(void)
 {
     munmap((void *)MOCK_ADDRESS_UPDATE, WOLFBOOT_PARTITION_SIZE);
     munmap((void *)MOCK_ADDRESS_BOOT, WOLFBOOT_PARTITION_SIZE);
-    munmap((void *)MOCK_ADDRESS_SWAP, WOLFBOOT_SECTOR_SIZE);
+    munmap((void *)MOCK_ADDRESS_SWAP, WOLFBOOT_SECTOR_SIZE *
+        WOLFBOOT_SWAP_SECTORS);
 }
 
 
@@ -257,6 +267,26 @@ START_TEST (test_forward_update_tosmaller) {
 }
 END_TEST
 
+START_TEST (test_forward_update_rollback) {
+    reset_mock_stats();
+    prepare_flash();
+    add_payload(PART_BOOT, 1, TEST_SIZE_SMALL);
+    add_payload(PART_UPDATE, 2, TEST_SIZE_LARGE);
+    wolfBoot_update_trigger();
+    wolfBoot_start();
+    ck_assert(!wolfBoot_panicked);
+    ck_assert(wolfBoot_current_firmware_version() == 2);
+    /* Version 2 is never confirmed: fall back to the previous version */
+    reset_mock_stats();
+    wolfBoot_start();
+    ck_assert(!wolfBoot_panicked);
+    ck_assert(wolfBoot_staged_ok);
+    ck_assert(wolfBoot_current_firmware_version() == 1);
+    ck_assert(*(uint32_t *)(WOLFBOOT_PARTITION_BOOT_ADDRESS + 4) == TEST_SIZE_SMALL);
+    cleanup_flash();
+}
+END_TEST
+
 START_TEST (test_forward_update_sameversion_denied) {
     reset_mock_stats();
     prepare_flash();
@@ -412,6 +442,114 @@ START_TEST (test_empty_boot_but_update_sha_corrupted_denied) {
     cleanup_flash();
 }
 
+START_TEST (test_forward_update_powerfail) {
+    int n, boots, done = 0;
+    for (n = 1; !done; n++) {
+        reset_mock_stats();
+        prepare_flash();
+        add_payload(PART_BOOT, 1, TEST_SIZE_SMALL);
+        add_payload(PART_UPDATE, 2, TEST_SIZE_LARGE);
+        wolfBoot_update_trigger();
+        /* Power failure at the n-th erase, then boot again */
+        erase_fail_countdown = n;
+        if (setjmp(erase_fail_jmp) == 0) {
+            wolfBoot_start();
+            done = (erase_fail_countdown > 0);
+        }
+        erase_fail_countdown = 0;
+        locked = 1;
+        ext_locked = 1;
+        /* A failure while writing the final state may need one more boot
+         * (see tools/scripts/sim-update-powerfail-resume.sh) */
+        for (boots = 0; boots < 2; boots++) {
+            reset_mock_stats();
+            wolfBoot_start();
+            if (wolfBoot_current_firmware_version() == 2)
+                break;
+        }
+        ck_assert_msg(!wolfBoot_panicked, "Panic after power failure %d", n);
+        ck_assert(wolfBoot_staged_ok);
+        ck_assert_msg(wolfBoot_current_firmware_version() == 2,
+            "Wrong version after power failure %d", n);
+        cleanup_flash();
+    }
+}
+END_TEST
+
+#ifdef WOLFBOOT_FLASH_BLANK_CHECK
+START_TEST (test_erase_partition_blank_check)
+{
+    uint32_t i;
+    prepare_flash();
+    /* Written: BOOT sectors 2, 3 and 6, UPDATE sector 4 */
+    memset((void *)(WOLFBOOT_PARTITION_BOOT_ADDRESS + 2 * WOLFBOOT_SECTOR_SIZE),
+        0xA5, 2 * WOLFBOOT_SECTOR_SIZE);
+    *(uint32_t *)(WOLFBOOT_PARTITION_BOOT_ADDRESS +
+        7 * WOLFBOOT_SECTOR_SIZE - 4) = 0;
+    *(uint8_t *)(WOLFBOOT_PARTITION_UPDATE_ADDRESS +
+        4 * WOLFBOOT_SECTOR_SIZE + 1) = 0x5A;
+    erased_boot = 0;
+    erased_update = 0;
+    hal_flash_unlock();
+    wolfBoot_erase_partition(PART_BOOT);
+    wolfBoot_erase_partition(PART_UPDATE);
+    hal_flash_lock();
+#ifdef NVM_FLASH_WRITEONCE
+    /* Unknown state of the internal flash: erased as a whole */
+    ck_assert_int_eq(erased_boot, 1);
+#else
+    /* One erase for each run of written sectors */
+    ck_assert_int_eq(erased_boot, 2);
+#endif
+    ck_assert_int_eq(erased_update, 1);
+    for (i = 0; i < WOLFBOOT_PARTITION_SIZE; i++) {
+        ck_assert_uint_eq(
+            *(uint8_t *)(WOLFBOOT_PARTITION_BOOT_ADDRESS + i), 0xFF);
+        ck_assert_uint_eq(
+            *(uint8_t *)(WOLFBOOT_PARTITION_UPDATE_ADDRESS + i), 0xFF);
+    }
+    erased_boot = 0;
+    hal_flash_unlock();
+    wolfBoot_erase_partition(PART_BOOT);
+    hal_flash_lock();
+#ifdef NVM_FLASH_WRITEONCE
+    ck_assert_int_eq(erased_boot, 1);
+#else
+    /* Nothing left to erase */
+    ck_assert_int_eq(erased_boot, 0);
+#endif
+    cleanup_flash();
+}
+END_TEST
+#endif
+
+#ifdef WOLFBOOT_FLASH_MULTI_SECTOR_ERASE
+START_TEST (test_erase_range_plan)
+{
+    uint32_t i;
+    prepare_flash();
+    memset((void *)WOLFBOOT_PARTITION_BOOT_ADDRESS, 0xA5,
+        WOLFBOOT_PARTITION_SIZE);
+    erased_boot = 0;
+    hal_flash_unlock();
+    /* 3 sectors up to the first block boundary, 1 block, 3 sectors */
+    ck_assert_int_eq(wolfBoot_flash_erase_range(
+        WOLFBOOT_PARTITION_BOOT_ADDRESS + WOLFBOOT_SECTOR_SIZE,
+        MOCK_ERASE_BLOCK_SIZE + 6 * WOLFBOOT_SECTOR_SIZE), 0);
+    hal_flash_lock();
+    ck_assert_int_eq(erased_boot, 7);
+    for (i = 0; i < WOLFBOOT_PARTITION_SIZE; i++) {
+        uint8_t exp = ((i >= WOLFBOOT_SECTOR_SIZE) &&
+            (i < MOCK_ERASE_BLOCK_SIZE + 7 * WOLFBOOT_SECTOR_SIZE)) ?
+            0xFF : 0xA5;
+        ck_assert_uint_eq(((uint8_t *)WOLFBOOT_PARTITION_BOOT_ADDRESS)[i],
+            exp);
+    }
+    cleanup_flash();
+}
+END_TEST
+#endif
+
 
 Suite *wolfboot_suite(void)
 {
@@ -427,6 +565,8 @@ Suite *wolfboot_suite(void)
     TCase *forward_update_tolarger =
         tcase_create("Forward update to larger size");
     TCase *forward_update_tosmaller = tcase_create("Forward update to smaller size");
+    TCase *forward_update_rollback =
+        tcase_create("Forward update rolled back");
     TCase *forward_update_sameversion_denied =
         tcase_create("Forward update to same version denied");
     TCase *update_oldversion_denied =
@@ -439,14 +579,31 @@ Suite *wolfboot_suite(void)
     TCase *emergency_rollback_failure_due_to_bad_update = tcase_create("Emergency rollback failure due to bad update");
     TCase *empty_boot_partition_update = tcase_create("Empty boot partition update");
     TCase *empty_boot_but_update_sha_corrupted_denied = tcase_create("Empty boot partition but update SHA corrupted");
+    TCase *forward_update_powerfail =
+        tcase_create("Forward update resumed after power failures");
+
 
 
+#ifdef WOLFBOOT_FLASH_BLANK_CHECK
+    TCase *erase_partition_blank_check =
+        tcase_create("Erase partition with blank check");
+    tcase_add_test(erase_partition_blank_check,
+        test_erase_partition_blank_check);
+    suite_add_tcase(s, erase_partition_blank_check);
+#endif
+
+#ifdef WOLFBOOT_FLASH_MULTI_SECTOR_ERASE
+    TCase *erase_range_plan = tcase_create("Multi-sector erase plan");
+    tcase_add_test(erase_range_plan, test_erase_range_plan);
+    suite_add_tcase(s, erase_range_plan);
+#endif
 
     tcase_add_test(empty_panic, test_empty_panic);
     tcase_add_test(sunnyday_noupdate, test_sunnyday_noupdate);
     tcase_add_test(forward_update_samesize, test_forward_update_samesize);
     tcase_add_test(forward_update_tolarger, test_forward_update_tolarger);
     tcase_add_test(forward_update_tosmaller, test_forward_update_tosmaller);
+    tcase_add_test(forward_update_rollback, test_forward_update_rollback);
     tcase_add_test(forward_update_sameversion_denied, test_forward_update_sameversion_denied);
     tcase_add_test(update_oldversion_denied, test_update_oldversion_denied);
     tcase_add_test(invalid_update_type, test_invalid_update_type);
@@ -456,6 +613,7 @@ Suite *wolfboot_suite(void)
     tcase_add_test(emergency_rollback_failure_due_to_bad_update, test_emergency_rollback_failure_due_to_bad_update);
     tcase_add_test(empty_boot_partition_update, test_empty_boot_partition_update);
     tcase_add_test(empty_boot_but_update_sha_corrupted_denied, test_empty_boot_but_update_sha_corrupted_denied);
+    tcase_add_test(forward_update_powerfail, test_forward_update_powerfail);
 
 
 
@@ -464,6 +622,7 @@ Suite *wolfboot_suite(void)
     suite_add_tcase(s, forward_update_samesize);
     suite_add_tcase(s, forward_update_tolarger);
     suite_add_tcase(s, forward_update_tosmaller);
+    suite_add_tcase(s, forward_update_rollback);
     suite_add_tcase(s, forward_update_sameversion_denied);
     suite_add_tcase(s, update_oldversion_denied);
     suite_add_tcase(s, invalid_update_type);
@@ -473,6 +632,7 @@ Suite *wolfboot_suite(void)
     suite_add_tcase(s, emergency_rollback_failure_due_to_bad_update);
     suite_add_tcase(s, empty_boot_partition_update);
     suite_add_tcase(s, empty_boot_but_update_sha_corrupted_denied);
+    suite_add_tcase(s, forward_update_powerfail);
 
 
 
@@ -0,0 +1,195 @@
+/* unit-update-writer.c
+ *
+ * unit tests for the streaming update writer in libwolfboot
+ *
+ * Copyright (C) 2025 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+#ifndef WOLFBOOT_HASH_SHA256
+    #define WOLFBOOT_HASH_SHA256
+#endif
+#define IMAGE_HEADER_SIZE 256
+#define WOLFBOOT_UPDATE_WRITER_BUF_SIZE 256
+#define MOCK_ADDRESS 0xCC000000
+#define WC_RSA_BLINDING
+#define ECC_TIMING_RESISTANT
+#include <stdio.h>
+#include "libwolfboot.c"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <check.h>
+
+#include "unit-mock-flash.c"
+
+#define TEST_FW_SIZE 3000
+
+static uint8_t test_img[IMAGE_HEADER_SIZE + TEST_FW_SIZE];
+
+Suite *wolfboot_suite(void);
+
+/* Header: magic, size, version, sha256 (over the header up to the hash
+ * field, then the firmware), padding */
+static void build_image(uint32_t fw_size)
+{
+    wc_Sha256 sha;
+    uint32_t word;
+    uint16_t field;
+    uint8_t *p = test_img;
+    uint32_t i;
+
+    memset(test_img, 0xFF, sizeof(test_img));
+    word = WOLFBOOT_MAGIC;
+    memcpy(p, &word, 4);
+    memcpy(p + 4, &fw_size, 4);
+    p += IMAGE_HEADER_OFFSET;
+    field = HDR_VERSION;
+    memcpy(p, &field, 2);
+    field = 4;
+    memcpy(p + 2, &field, 2);
+    word = 7;
+    memcpy(p + 4, &word, 4);
+    p += 8;
+    field = HDR_SHA256;
+    memcpy(p, &field, 2);
+    field = WOLFBOOT_SHA_DIGEST_SIZE;
+    memcpy(p + 2, &field, 2);
+    for (i = 0; i < TEST_FW_SIZE; i++)
+        test_img[IMAGE_HEADER_SIZE + i] = (uint8_t)(i * 7 + (i >> 8));
+
+    wc_InitSha256(&sha);
+    wc_Sha256Update(&sha, test_img, p - test_img);
+    wc_Sha256Update(&sha, test_img + IMAGE_HEADER_SIZE, TEST_FW_SIZE);
+    wc_Sha256Final(&sha, p + 4);
+    p[4 + WOLFBOOT_SHA_DIGEST_SIZE] = HDR_END;
+}
+
+static void write_image(size_t chunk)
+{
+    size_t off = 0, n;
+    while (off < sizeof(test_img)) {
+        n = chunk;
+        if (n > sizeof(test_img) - off)
+            n = sizeof(test_img) - off;
+        ck_assert_int_eq(wolfBoot_update_writer_write(test_img + off, n), 0);
+        off += n;
+    }
+}
+
+START_TEST (test_update_writer)
+{
+    static const size_t chunks[] = { 1, 13, 256, 1000, sizeof(test_img) };
+    uint8_t digest[WOLFBOOT_SHA_DIGEST_SIZE];
+    uint8_t *stored_sha;
+    unsigned int i;
+    int ret;
+
+    ret = mmap_file("/tmp/wolfboot-unit-file.bin", (void *)MOCK_ADDRESS,
+            WOLFBOOT_PARTITION_SIZE, NULL);
+    ck_assert(ret >= 0);
+    build_image(TEST_FW_SIZE);
+
+    /* Any chunk size produces the same image in flash */
+    for (i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        memset((void *)WOLFBOOT_PARTITION_UPDATE_ADDRESS, 0,
+            WOLFBOOT_PARTITION_SIZE);
+        ck_assert_int_eq(wolfBoot_update_writer_open(), 0);
+        write_image(chunks[i]);
+        ck_assert_int_eq(wolfBoot_update_writer_finalize(), 0);
+        ck_assert_int_eq(memcmp((void *)WOLFBOOT_PARTITION_UPDATE_ADDRESS,
+            test_img, sizeof(test_img)), 0);
+        ck_assert_int_eq(wolfBoot_update_writer_digest(digest), 0);
+        wolfBoot_find_header(test_img + IMAGE_HEADER_OFFSET, HDR_SHA256,
+            &stored_sha);
+        ck_assert_int_eq(memcmp(digest, stored_sha, sizeof(digest)), 0);
+        /* No data accepted after the image is complete */
+        ck_assert_int_eq(wolfBoot_update_writer_write(test_img, 1), -1);
+        ck_assert(locked);
+    }
+
+    /* Corrupted firmware: rejected at finalize */
+    test_img[IMAGE_HEADER_SIZE + 1234] ^= 0x01;
+    ck_assert_int_eq(wolfBoot_update_writer_open(), 0);
+    write_image(100);
+    ck_assert_int_eq(wolfBoot_update_writer_finalize(), -1);
+    ck_assert_int_eq(wolfBoot_update_writer_digest(digest), -1);
+    test_img[IMAGE_HEADER_SIZE + 1234] ^= 0x01;
+
+    /* Truncated image */
+    ck_assert_int_eq(wolfBoot_update_writer_open(), 0);
+    ck_assert_int_eq(wolfBoot_update_writer_write(test_img,
+        sizeof(test_img) - 1), 0);
+    ck_assert_int_eq(wolfBoot_update_writer_finalize(), -1);
+
+    /* Data beyond the declared size */
+    ck_assert_int_eq(wolfBoot_update_writer_open(), 0);
+    write_image(sizeof(test_img));
+    ck_assert_int_eq(wolfBoot_update_writer_write(test_img, 1), -1);
+    ck_assert_int_eq(wolfBoot_update_writer_finalize(), -1);
+
+    /* Bad magic: rejected as soon as the header is complete */
+    test_img[0] ^= 0xFF;
+    ck_assert_int_eq(wolfBoot_update_writer_open(), 0);
+    ck_assert_int_eq(wolfBoot_update_writer_write(test_img,
+        IMAGE_HEADER_SIZE - 1), 0);
+    ck_assert_int_eq(wolfBoot_update_writer_write(test_img +
+        IMAGE_HEADER_SIZE - 1, 1), -1);
+    ck_assert_int_eq(wolfBoot_update_writer_write(test_img +
+        IMAGE_HEADER_SIZE, 1), -1);
+    test_img[0] ^= 0xFF;
+
+    /* Image too large for the partition (last sector holds the flags) */
+    build_image(WOLFBOOT_PARTITION_SIZE - WOLFBOOT_SECTOR_SIZE -
+        IMAGE_HEADER_SIZE + 1);
+    ck_assert_int_eq(wolfBoot_update_writer_open(), 0);
+    ck_assert_int_eq(wolfBoot_update_writer_write(test_img,
+        IMAGE_HEADER_SIZE), -1);
+
+    /* Not opened */
+    wolfBoot_update_writer_open();
+    wolfBoot_update_writer_finalize();
+    ck_assert_int_eq(wolfBoot_update_writer_write(test_img, 1), -1);
+}
+END_TEST
+
+
+Suite *wolfboot_suite(void)
+{
+    /* Suite initialization */
+    Suite *s = suite_create("wolfboot");
+
+    /* Test cases */
+    TCase *update_writer = tcase_create("Update writer");
+    tcase_add_test(update_writer, test_update_writer);
+    suite_add_tcase(s, update_writer);
+
+    return s;
+}
+
+
+int main(int argc, char *argv[])
+{
+    int fails;
+    argv0 = strdup(argv[0]);
+    Suite *s = wolfboot_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    fails = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return fails;
+}